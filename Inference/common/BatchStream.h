@@ -16,6 +16,7 @@
 #ifndef BATCH_STREAM_H
 #define BATCH_STREAM_H
 
+#include "ImagePreprocess.h"
 #include "NvInfer.h"
 #include "common.h"
 #include <algorithm>
@@ -345,20 +346,13 @@ private:
             }
 
             std::vector<float> data(samplesCommon::volume(mDims));
-            const float scale = 2.0 / 255.0;
-            const float bias = 1.0;
-            long int volChl = mDims.d[2] * mDims.d[3];
+            const auto affine = samplesCommon::ChannelAffine::uniform(mDims.d[1], 2.0 / 255.0, -1.0);
 
             // Normalize input data
             for (int i = 0, volImg = mDims.d[1] * mDims.d[2] * mDims.d[3]; i < mBatchSize; ++i)
             {
-                for (int c = 0; c < mDims.d[1]; ++c)
-                {
-                    for (int j = 0; j < volChl; ++j)
-                    {
-                        data[i * volImg + c * volChl + j] = scale * float(ppms[i].buffer[j * mDims.d[1] + c]) - bias;
-                    }
-                }
+                samplesCommon::normalizeImage(ppms[i].buffer, mDims.d[2], mDims.d[3], samplesCommon::PixelLayout::kHWC,
+                    affine, data.data() + i * volImg);
             }
 
             std::copy_n(data.data(), mDims.d[0] * mImageSize, getFileBatch());
@@ -0,0 +1,478 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef TENSORRT_BOUNDARY_TENSORS_H
+#define TENSORRT_BOUNDARY_TENSORS_H
+
+#include "BatchStream.h"
+#include "MappedDataset.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+//!
+//! \file BoundaryTensors.h
+//!
+//! \brief Activations captured at a stage boundary of a split model, so that later stages can be calibrated on what
+//!        actually reaches them.
+//!
+//! \details Stage k > 0 of a split model consumes the boundary tensor of stage k - 1, not images. BoundaryTensorWriter
+//!          stores the boundary tensors of a calibration set, one sample at a time, in fixed-size chunks of float or
+//!          half values followed by an index of the chunks. BoundaryTensorFile maps such a file and converts samples
+//!          back to float, and BoundaryTensorStream replays them as an IBatchStream for the calibrator of stage k.
+//!
+
+namespace samplesCommon
+{
+
+//! Samples have fewer dimensions than this, so that batches of them still fit in a Dims.
+inline int32_t maxSampleDims()
+{
+    return nvinfer1::Dims::MAX_DIMS;
+}
+
+//!
+//! \brief Header of a boundary tensor file. Little-endian.
+//!
+struct BoundaryTensorHeader
+{
+    static constexpr size_t kMAGIC_SIZE = 8;
+    static constexpr uint64_t kSECTION_ALIGNMENT = 64;
+
+    static const char* getMagic()
+    {
+        return "TRTBND01";
+    }
+
+    char magic[kMAGIC_SIZE];
+    int32_t dataType; //!< nvinfer1::DataType of the stored values, kFLOAT or kHALF.
+    int32_t nbDims;
+    int32_t dims[nvinfer1::Dims::MAX_DIMS]; //!< Dimensions of one sample, without the batch dimension.
+    uint32_t samplesPerChunk;
+    uint32_t reserved;
+    uint64_t nbSamples;
+    uint64_t nbChunks;
+    uint64_t indexOffset; //!< Offset of nbChunks BoundaryChunkEntry.
+};
+static_assert(sizeof(BoundaryTensorHeader) == 80, "BoundaryTensorHeader is a file format");
+
+//!
+//! \brief Where a chunk of samples starts. Every chunk but the last holds samplesPerChunk samples.
+//!
+struct BoundaryChunkEntry
+{
+    uint64_t offset;
+    uint32_t nbSamples;
+    uint32_t reserved;
+};
+static_assert(sizeof(BoundaryChunkEntry) == 16, "BoundaryChunkEntry is a file format");
+
+//!
+//! \brief Writes boundary tensors to a file as they are captured, without holding more than a chunk in memory.
+//!
+class BoundaryTensorWriter
+{
+public:
+    BoundaryTensorWriter() = default;
+    BoundaryTensorWriter(const BoundaryTensorWriter&) = delete;
+    BoundaryTensorWriter& operator=(const BoundaryTensorWriter&) = delete;
+
+    //! Drops an unfinished file.
+    ~BoundaryTensorWriter()
+    {
+        if (mOut.is_open())
+        {
+            mOut.close();
+            std::remove(getPartialPath().c_str());
+        }
+    }
+
+    //!
+    //! \brief Start writing path, for samples of sampleDims stored as dataType (kFLOAT or kHALF). Returns false,
+    //!        logging why, if the file cannot be created or the arguments are not supported.
+    //!
+    bool open(const std::string& path, const nvinfer1::Dims& sampleDims, nvinfer1::DataType dataType,
+        int samplesPerChunk = 256)
+    {
+        if ((dataType != nvinfer1::DataType::kFLOAT && dataType != nvinfer1::DataType::kHALF) || samplesPerChunk <= 0
+            || sampleDims.nbDims <= 0 || sampleDims.nbDims >= maxSampleDims()
+            || samplesCommon::volume(sampleDims) <= 0)
+        {
+            sample::gLogError << "Unsupported boundary tensor layout for " << path << std::endl;
+            return false;
+        }
+        mPath = path;
+        mHeader = BoundaryTensorHeader{};
+        mHeader.dataType = static_cast<int32_t>(dataType);
+        mHeader.nbDims = sampleDims.nbDims;
+        std::copy_n(sampleDims.d, sampleDims.nbDims, mHeader.dims);
+        mHeader.samplesPerChunk = samplesPerChunk;
+        mSampleVolume = samplesCommon::volume(sampleDims);
+        mChunk.clear();
+        mChunkSamples = 0;
+        mIndex.clear();
+
+        // Written under a temporary name, so that an interrupted capture never leaves a file that looks complete.
+        mOut.open(getPartialPath(), std::ios::binary | std::ios::trunc);
+        if (!mOut)
+        {
+            sample::gLogError << "Could not create " << getPartialPath() << std::endl;
+            return false;
+        }
+        mOut.write(reinterpret_cast<const char*>(&mHeader), sizeof(mHeader));
+        return true;
+    }
+
+    //!
+    //! \brief Append nbSamples samples of float values.
+    //!
+    bool append(const float* samples, int nbSamples)
+    {
+        assert(mOut.is_open());
+        const size_t elementSize = samplesCommon::getElementSize(getDataType());
+        for (int s = 0; s < nbSamples; ++s)
+        {
+            const float* sample = samples + size_t(s) * mSampleVolume;
+            const size_t begin = mChunk.size();
+            mChunk.resize(begin + mSampleVolume * elementSize);
+            if (getDataType() == nvinfer1::DataType::kHALF)
+            {
+                uint16_t* dst = reinterpret_cast<uint16_t*>(mChunk.data() + begin);
+                std::transform(sample, sample + mSampleVolume, dst, preprocess::floatToHalf);
+            }
+            else
+            {
+                std::memcpy(mChunk.data() + begin, sample, mSampleVolume * sizeof(float));
+            }
+            ++mHeader.nbSamples;
+            if (++mChunkSamples == mHeader.samplesPerChunk && !flushChunk())
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    //!
+    //! \brief Write the last chunk and the index, and move the file into place.
+    //!
+    bool close()
+    {
+        assert(mOut.is_open());
+        bool ok = flushChunk();
+        mHeader.indexOffset = pad();
+        mHeader.nbChunks = mIndex.size();
+        mOut.write(reinterpret_cast<const char*>(mIndex.data()), mIndex.size() * sizeof(BoundaryChunkEntry));
+        std::memcpy(mHeader.magic, BoundaryTensorHeader::getMagic(), BoundaryTensorHeader::kMAGIC_SIZE);
+        mOut.seekp(0);
+        mOut.write(reinterpret_cast<const char*>(&mHeader), sizeof(mHeader));
+        mOut.close();
+        ok = ok && mOut && std::rename(getPartialPath().c_str(), mPath.c_str()) == 0;
+        if (!ok)
+        {
+            sample::gLogError << "Could not write boundary tensors " << mPath << std::endl;
+            std::remove(getPartialPath().c_str());
+        }
+        return ok;
+    }
+
+    uint64_t getNbSamples() const
+    {
+        return mHeader.nbSamples;
+    }
+
+    nvinfer1::DataType getDataType() const
+    {
+        return static_cast<nvinfer1::DataType>(mHeader.dataType);
+    }
+
+private:
+    std::string getPartialPath() const
+    {
+        return mPath + ".partial";
+    }
+
+    //! Pad the file to the section alignment, returning the new offset.
+    uint64_t pad()
+    {
+        const uint64_t offset = static_cast<uint64_t>(mOut.tellp());
+        const uint64_t alignment = BoundaryTensorHeader::kSECTION_ALIGNMENT;
+        const uint64_t aligned = (offset + alignment - 1) / alignment * alignment;
+        const std::vector<char> padding(aligned - offset, 0);
+        mOut.write(padding.data(), padding.size());
+        return aligned;
+    }
+
+    bool flushChunk()
+    {
+        if (mChunkSamples == 0)
+        {
+            return static_cast<bool>(mOut);
+        }
+        BoundaryChunkEntry entry{};
+        entry.offset = pad();
+        entry.nbSamples = mChunkSamples;
+        mIndex.push_back(entry);
+        mOut.write(mChunk.data(), mChunk.size());
+        mChunk.clear();
+        mChunkSamples = 0;
+        return static_cast<bool>(mOut);
+    }
+
+    std::string mPath;
+    std::ofstream mOut;
+    BoundaryTensorHeader mHeader{};
+    size_t mSampleVolume{0};
+    std::vector<char> mChunk;
+    uint32_t mChunkSamples{0};
+    std::vector<BoundaryChunkEntry> mIndex;
+};
+
+//!
+//! \brief A boundary tensor file mapped read-only.
+//!
+class BoundaryTensorFile
+{
+public:
+    //!
+    //! \brief Map path. Returns false, logging why, if it is missing or malformed.
+    //!
+    bool open(const std::string& path)
+    {
+        mNbSamples = 0;
+        mChunks = nullptr;
+        if (!mFile.open(path))
+        {
+            return false;
+        }
+        BoundaryTensorHeader header;
+        if (mFile.size() < sizeof(header)
+            || std::memcmp(mFile.data(), BoundaryTensorHeader::getMagic(), BoundaryTensorHeader::kMAGIC_SIZE) != 0)
+        {
+            sample::gLogError << path << " is not a boundary tensor file" << std::endl;
+            mFile.close();
+            return false;
+        }
+        std::memcpy(&header, mFile.data(), sizeof(header));
+        if (!validate(header))
+        {
+            sample::gLogError << "Boundary tensor file " << path << " is truncated or corrupt" << std::endl;
+            mFile.close();
+            return false;
+        }
+        mHeader = header;
+        mChunks = reinterpret_cast<const BoundaryChunkEntry*>(mFile.data() + header.indexOffset);
+        mNbSamples = header.nbSamples;
+        return true;
+    }
+
+    uint64_t size() const
+    {
+        return mNbSamples;
+    }
+
+    nvinfer1::Dims getSampleDims() const
+    {
+        nvinfer1::Dims dims{};
+        dims.nbDims = mHeader.nbDims;
+        std::copy_n(mHeader.dims, mHeader.nbDims, dims.d);
+        return dims;
+    }
+
+    size_t getSampleVolume() const
+    {
+        return samplesCommon::volume(getSampleDims());
+    }
+
+    nvinfer1::DataType getDataType() const
+    {
+        return static_cast<nvinfer1::DataType>(mHeader.dataType);
+    }
+
+    //!
+    //! \brief Convert samples [first, first + count) to float into dst.
+    //!
+    void read(uint64_t first, uint64_t count, float* dst) const
+    {
+        assert(first + count <= mNbSamples);
+        const size_t volume = getSampleVolume();
+        for (uint64_t s = first; s < first + count; ++s, dst += volume)
+        {
+            const uint8_t* src = getSample(s);
+            if (getDataType() == nvinfer1::DataType::kHALF)
+            {
+                const uint16_t* half = reinterpret_cast<const uint16_t*>(src);
+                std::transform(half, half + volume, dst, preprocess::halfToFloat);
+            }
+            else
+            {
+                std::memcpy(dst, src, volume * sizeof(float));
+            }
+        }
+    }
+
+    //!
+    //! \brief Start reading samples [first, first + count) in the background.
+    //!
+    void prefetch(uint64_t first, uint64_t count) const
+    {
+        if (count == 0 || first >= mNbSamples)
+        {
+            return;
+        }
+        const uint64_t last = std::min(first + count, mNbSamples) - 1;
+        const size_t begin = getSample(first) - mFile.data();
+        mFile.prefetch(begin, getSample(last) - mFile.data() + getSampleBytes());
+    }
+
+private:
+    size_t getSampleBytes() const
+    {
+        return getSampleVolume() * samplesCommon::getElementSize(getDataType());
+    }
+
+    const uint8_t* getSample(uint64_t s) const
+    {
+        const BoundaryChunkEntry& chunk = mChunks[s / mHeader.samplesPerChunk];
+        return mFile.data() + chunk.offset + (s % mHeader.samplesPerChunk) * getSampleBytes();
+    }
+
+    bool validate(const BoundaryTensorHeader& header) const
+    {
+        const auto type = static_cast<nvinfer1::DataType>(header.dataType);
+        if ((type != nvinfer1::DataType::kFLOAT && type != nvinfer1::DataType::kHALF) || header.nbDims <= 0
+            || header.nbDims >= maxSampleDims() || header.samplesPerChunk == 0
+            || header.nbChunks != (header.nbSamples + header.samplesPerChunk - 1) / header.samplesPerChunk
+            || header.indexOffset % alignof(BoundaryChunkEntry) != 0
+            || header.indexOffset + header.nbChunks * sizeof(BoundaryChunkEntry) > mFile.size())
+        {
+            return false;
+        }
+        int64_t volume = 1;
+        for (int32_t i = 0; i < header.nbDims; ++i)
+        {
+            if (header.dims[i] <= 0)
+            {
+                return false;
+            }
+            volume *= header.dims[i];
+        }
+        const uint64_t sampleBytes = volume * samplesCommon::getElementSize(type);
+        const auto* chunks = reinterpret_cast<const BoundaryChunkEntry*>(mFile.data() + header.indexOffset);
+        for (uint64_t c = 0; c < header.nbChunks; ++c)
+        {
+            const uint64_t expected
+                = std::min<uint64_t>(header.samplesPerChunk, header.nbSamples - c * header.samplesPerChunk);
+            if (chunks[c].nbSamples != expected || chunks[c].offset % sizeof(float) != 0
+                || chunks[c].offset + expected * sampleBytes > mFile.size())
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    MappedFile mFile;
+    BoundaryTensorHeader mHeader{};
+    const BoundaryChunkEntry* mChunks{nullptr};
+    uint64_t mNbSamples{0};
+};
+
+//!
+//! \brief IBatchStream replaying a boundary tensor file, for the calibrator of the stage that consumes it.
+//!
+//! \details Batches are whole: a tail of fewer than batchSize samples is not returned. There are no labels, so
+//!          getLabels() returns zeros. Copies share the file and read independently.
+//!
+class BoundaryTensorStream : public IBatchStream
+{
+public:
+    //! \param maxBatches Batches to return at most, 0 for all the whole batches of the file.
+    BoundaryTensorStream(std::shared_ptr<const BoundaryTensorFile> file, int batchSize, int maxBatches = 0)
+        : mFile(std::move(file))
+        , mBatchSize(batchSize)
+        , mNbBatches(static_cast<int>(mFile->size() / batchSize))
+        , mBatch(mFile->getSampleVolume() * batchSize)
+        , mLabels(batchSize, 0.0F)
+    {
+        if (maxBatches > 0)
+        {
+            mNbBatches = std::min(mNbBatches, maxBatches);
+        }
+    }
+
+    void reset(int firstBatch) override
+    {
+        mBatchCount = 0;
+        mNextBatch = firstBatch;
+    }
+
+    bool next() override
+    {
+        if (mNextBatch >= mNbBatches)
+        {
+            return false;
+        }
+        const uint64_t first = uint64_t(mNextBatch) * mBatchSize;
+        mFile->read(first, mBatchSize, mBatch.data());
+        // Ask for the pages of the next batch while this one is being calibrated on.
+        mFile->prefetch(first + mBatchSize, mBatchSize);
+        ++mNextBatch;
+        ++mBatchCount;
+        return true;
+    }
+
+    void skip(int skipCount) override
+    {
+        mNextBatch += skipCount;
+    }
+
+    float* getBatch() override
+    {
+        return mBatch.data();
+    }
+
+    float* getLabels() override
+    {
+        return mLabels.data();
+    }
+
+    int getBatchesRead() const override
+    {
+        return mBatchCount;
+    }
+
+    int getBatchSize() const override
+    {
+        return mBatchSize;
+    }
+
+    nvinfer1::Dims getDims() const override
+    {
+        const nvinfer1::Dims sample = mFile->getSampleDims();
+        nvinfer1::Dims dims{};
+        dims.nbDims = sample.nbDims + 1;
+        dims.d[0] = mBatchSize;
+        std::copy_n(sample.d, sample.nbDims, dims.d + 1);
+        return dims;
+    }
+
+private:
+    std::shared_ptr<const BoundaryTensorFile> mFile;
+    int mBatchSize;
+    int mNbBatches;
+    int mBatchCount{0};
+    int mNextBatch{0};
+    std::vector<float> mBatch;
+    std::vector<float> mLabels;
+};
+
+} // namespace samplesCommon
+
+#endif // TENSORRT_BOUNDARY_TENSORS_H
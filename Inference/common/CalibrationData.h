@@ -0,0 +1,352 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef TENSORRT_CALIBRATION_DATA_H
+#define TENSORRT_CALIBRATION_DATA_H
+
+#include "InputPipeline.h"
+#include "MappedDataset.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+//!
+//! \file CalibrationData.h
+//!
+//! \brief Calibration batches preprocessed once into a memory-mapped file and served to any number of calibrators.
+//!
+//! \details Calibrating each stage of a split model, or the same network at several precisions, used to decode and
+//!          normalize the calibration set again for every calibrator. CalibrationBlob writes the batches of any
+//!          IBatchStream to a file once, as the float tensors the network consumes, and maps it on later runs.
+//!          CalibrationBatchStream then serves the mapped batches to one calibrator through a prefetch thread that
+//!          copies them into pinned slots ahead of getBatch(); all streams over one blob share its pages.
+//!
+
+namespace samplesCommon
+{
+
+//!
+//! \brief Header of a calibration blob file: batches of dims floats followed by their labels. Little-endian.
+//!
+struct CalibrationBlobHeader
+{
+    static constexpr size_t kMAGIC_SIZE = 8;
+    static constexpr uint64_t kSECTION_ALIGNMENT = 64;
+
+    static const char* getMagic()
+    {
+        return "TRTCAL01";
+    }
+
+    char magic[kMAGIC_SIZE];
+    int32_t nbDims;
+    int32_t dims[nvinfer1::Dims::MAX_DIMS]; //!< Dimensions of one batch, including the batch size.
+    uint32_t reserved;
+    uint64_t nbBatches;
+    uint64_t dataOffset;
+    uint64_t labelsOffset;
+};
+static_assert(sizeof(CalibrationBlobHeader) == 72, "CalibrationBlobHeader is a file format");
+
+//!
+//! \brief A calibration blob file mapped read-only.
+//!
+class CalibrationBlob
+{
+public:
+    //!
+    //! \brief Read nbBatches batches of stream, from firstBatch, and write them to path. Returns false, logging why,
+    //!        if the file cannot be written; a short stream writes the batches it has.
+    //!
+    static bool write(IBatchStream& stream, int firstBatch, int nbBatches, const std::string& path)
+    {
+        const nvinfer1::Dims dims = stream.getDims();
+        const size_t volume = samplesCommon::volume(dims);
+        const size_t batchSize = stream.getBatchSize();
+        std::vector<float> labels;
+        // Written under a temporary name, so that an interrupted run never leaves a blob that looks complete.
+        const std::string partial = path + ".partial";
+        std::ofstream out(partial, std::ios::binary);
+        CalibrationBlobHeader header{};
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        const std::vector<char> padding(CalibrationBlobHeader::kSECTION_ALIGNMENT, 0);
+        header.dataOffset = align(sizeof(header));
+        out.write(padding.data(), header.dataOffset - sizeof(header));
+
+        stream.reset(firstBatch);
+        uint64_t nbWritten = 0;
+        while (static_cast<int>(nbWritten) < nbBatches && stream.next())
+        {
+            out.write(reinterpret_cast<const char*>(stream.getBatch()), volume * sizeof(float));
+            labels.insert(labels.end(), stream.getLabels(), stream.getLabels() + batchSize);
+            ++nbWritten;
+        }
+        header.labelsOffset = align(header.dataOffset + nbWritten * volume * sizeof(float));
+        out.write(padding.data(), header.labelsOffset - (header.dataOffset + nbWritten * volume * sizeof(float)));
+        out.write(reinterpret_cast<const char*>(labels.data()), labels.size() * sizeof(float));
+
+        std::memcpy(header.magic, CalibrationBlobHeader::getMagic(), CalibrationBlobHeader::kMAGIC_SIZE);
+        header.nbDims = dims.nbDims;
+        std::copy_n(dims.d, dims.nbDims, header.dims);
+        header.nbBatches = nbWritten;
+        out.seekp(0);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.close();
+        if (!out || std::rename(partial.c_str(), path.c_str()) != 0)
+        {
+            sample::gLogError << "Could not write calibration blob " << path << std::endl;
+            std::remove(partial.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    //!
+    //! \brief Map path. Returns false, logging why, if it is missing or malformed.
+    //!
+    bool open(const std::string& path)
+    {
+        mNbBatches = 0;
+        if (!mFile.open(path))
+        {
+            return false;
+        }
+        CalibrationBlobHeader header;
+        if (mFile.size() < sizeof(header)
+            || std::memcmp(mFile.data(), CalibrationBlobHeader::getMagic(), CalibrationBlobHeader::kMAGIC_SIZE) != 0)
+        {
+            sample::gLogError << path << " is not a calibration blob" << std::endl;
+            mFile.close();
+            return false;
+        }
+        std::memcpy(&header, mFile.data(), sizeof(header));
+        const int32_t maxDims = nvinfer1::Dims::MAX_DIMS;
+        mDims.nbDims = std::min(std::max<int32_t>(header.nbDims, 0), maxDims);
+        std::copy_n(header.dims, mDims.nbDims, mDims.d);
+        const size_t volume = samplesCommon::volume(mDims);
+        const size_t batchSize = mDims.nbDims > 0 ? mDims.d[0] : 0;
+        if (mDims.nbDims != header.nbDims || volume == 0 || batchSize == 0
+            || header.dataOffset % sizeof(float) != 0 || header.labelsOffset % sizeof(float) != 0
+            || header.dataOffset + header.nbBatches * volume * sizeof(float) > header.labelsOffset
+            || header.labelsOffset + header.nbBatches * batchSize * sizeof(float) > mFile.size())
+        {
+            sample::gLogError << "Calibration blob " << path << " is truncated or corrupt" << std::endl;
+            mFile.close();
+            return false;
+        }
+        mData = reinterpret_cast<const float*>(mFile.data() + header.dataOffset);
+        mLabels = reinterpret_cast<const float*>(mFile.data() + header.labelsOffset);
+        mNbBatches = header.nbBatches;
+        return true;
+    }
+
+    //!
+    //! \brief Map path if it holds at least nbBatches batches of the dims of stream, and write it from stream first
+    //!        otherwise. This is what makes the preprocessing run once across calibrations.
+    //!
+    bool openOrWrite(IBatchStream& stream, int firstBatch, int nbBatches, const std::string& path)
+    {
+        std::ifstream probe(path);
+        if (probe.good())
+        {
+            probe.close();
+            if (open(path) && getNbBatches() >= nbBatches && sameDims(mDims, stream.getDims()))
+            {
+                return true;
+            }
+            sample::gLogInfo << "Calibration blob " << path << " does not match the stream, writing it again"
+                             << std::endl;
+            mFile.close();
+            mNbBatches = 0;
+        }
+        return write(stream, firstBatch, nbBatches, path) && open(path);
+    }
+
+    int getNbBatches() const
+    {
+        return static_cast<int>(mNbBatches);
+    }
+
+    nvinfer1::Dims getDims() const
+    {
+        return mDims;
+    }
+
+    int getBatchSize() const
+    {
+        return mDims.d[0];
+    }
+
+    size_t getBatchVolume() const
+    {
+        return samplesCommon::volume(mDims);
+    }
+
+    const float* getBatch(int i) const
+    {
+        assert(i >= 0 && static_cast<size_t>(i) < mNbBatches);
+        return mData + i * getBatchVolume();
+    }
+
+    const float* getLabels(int i) const
+    {
+        assert(i >= 0 && static_cast<size_t>(i) < mNbBatches);
+        return mLabels + size_t(i) * getBatchSize();
+    }
+
+    //!
+    //! \brief Start reading batches [first, first + count) in the background.
+    //!
+    void prefetch(int first, int count) const
+    {
+        const uint8_t* base = mFile.data();
+        const size_t bytes = getBatchVolume() * sizeof(float);
+        const size_t begin = reinterpret_cast<const uint8_t*>(mData) - base + size_t(first) * bytes;
+        mFile.prefetch(begin, begin + size_t(count) * bytes);
+    }
+
+private:
+    static uint64_t align(uint64_t offset)
+    {
+        const uint64_t alignment = CalibrationBlobHeader::kSECTION_ALIGNMENT;
+        return (offset + alignment - 1) / alignment * alignment;
+    }
+
+    static bool sameDims(const nvinfer1::Dims& a, const nvinfer1::Dims& b)
+    {
+        return a.nbDims == b.nbDims && std::equal(a.d, a.d + a.nbDims, b.d);
+    }
+
+    MappedFile mFile;
+    nvinfer1::Dims mDims{};
+    const float* mData{nullptr};
+    const float* mLabels{nullptr};
+    uint64_t mNbBatches{0};
+};
+
+//!
+//! \brief IBatchStream over a CalibrationBlob, prefetched into pinned slots by a background thread, so that it can
+//!        be passed to Int8EntropyCalibrator2 like any other batch stream.
+//!
+//! \details Copies share the blob but not the prefetch thread: a copy starts its own on its first reset(), so that a
+//!          stream can be passed by value to a calibrator, and one blob can feed several calibrators at once.
+//!
+class CalibrationBatchStream : public IBatchStream
+{
+public:
+    //! \param nbSlots Batches prefetched ahead of the calibrator.
+    CalibrationBatchStream(std::shared_ptr<const CalibrationBlob> blob, int nbSlots = 3)
+        : mBlob(std::move(blob))
+        , mNbSlots(nbSlots)
+    {
+    }
+
+    CalibrationBatchStream(const CalibrationBatchStream& other)
+        : mBlob(other.mBlob)
+        , mNbSlots(other.mNbSlots)
+    {
+    }
+
+    CalibrationBatchStream& operator=(const CalibrationBatchStream&) = delete;
+
+    void reset(int firstBatch) override
+    {
+        if (!mPipeline)
+        {
+            const std::shared_ptr<const CalibrationBlob> blob = mBlob;
+            const int nbSlots = mNbSlots;
+            mPipeline.reset(new InputPipeline(blob->getBatchSize(), blob->getBatchVolume() / blob->getBatchSize(),
+                nbSlots, 1, [blob, nbSlots](HostBatch& batch) {
+                    if (batch.index >= blob->getNbBatches())
+                    {
+                        return false;
+                    }
+                    // Ask for the pages of the batches behind this one while copying it.
+                    blob->prefetch(batch.index + 1, std::min(nbSlots, blob->getNbBatches() - batch.index - 1));
+                    std::copy_n(blob->getBatch(batch.index), blob->getBatchVolume(), batch.data);
+                    std::copy_n(blob->getLabels(batch.index), blob->getBatchSize(), batch.labels);
+                    batch.size = blob->getBatchSize();
+                    return true;
+                }));
+        }
+        mCurrent = nullptr;
+        mBatchCount = 0;
+        mNextBatch = firstBatch;
+        mPipeline->start(firstBatch, std::max(0, mBlob->getNbBatches() - firstBatch));
+    }
+
+    bool next() override
+    {
+        if (!mPipeline)
+        {
+            reset(0);
+        }
+        if (mCurrent)
+        {
+            mPipeline->release(mCurrent);
+        }
+        mCurrent = mPipeline->acquire();
+        if (!mCurrent)
+        {
+            return false;
+        }
+        ++mNextBatch;
+        ++mBatchCount;
+        return true;
+    }
+
+    void skip(int skipCount) override
+    {
+        const int batchCount = mBatchCount;
+        reset(mNextBatch + skipCount);
+        mBatchCount = batchCount;
+    }
+
+    float* getBatch() override
+    {
+        return mCurrent ? mCurrent->data : nullptr;
+    }
+
+    float* getLabels() override
+    {
+        return mCurrent ? mCurrent->labels : nullptr;
+    }
+
+    int getBatchesRead() const override
+    {
+        return mBatchCount;
+    }
+
+    int getBatchSize() const override
+    {
+        return mBlob->getBatchSize();
+    }
+
+    nvinfer1::Dims getDims() const override
+    {
+        return mBlob->getDims();
+    }
+
+    //! Whether the prefetched batches are pinned, so that copies of them to the device are asynchronous.
+    bool isPinned() const
+    {
+        return mPipeline && mPipeline->isPinned();
+    }
+
+private:
+    std::shared_ptr<const CalibrationBlob> mBlob;
+    int mNbSlots{3};
+    int mBatchCount{0};
+    int mNextBatch{0};
+    HostBatch* mCurrent{nullptr};
+    std::unique_ptr<InputPipeline> mPipeline;
+};
+
+} // namespace samplesCommon
+
+#endif // TENSORRT_CALIBRATION_DATA_H
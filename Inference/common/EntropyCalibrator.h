@@ -37,13 +37,22 @@ public:
     {
         nvinfer1::Dims dims = mStream.getDims();
         mInputCount = samplesCommon::volume(dims);
-        CHECK(cudaMalloc(&mDeviceInput, mInputCount * sizeof(float)));
+        for (auto& input : mDeviceInput)
+        {
+            CUDACHECK(cudaMalloc(&input, mInputCount * sizeof(float)));
+        }
+        CUDACHECK(cudaStreamCreateWithFlags(&mCopyStream, cudaStreamNonBlocking));
         mStream.reset(firstBatch);
     }
 
     virtual ~EntropyCalibratorImpl()
     {
-        CHECK(cudaFree(mDeviceInput));
+        CUDACHECK(cudaStreamSynchronize(mCopyStream));
+        CUDACHECK(cudaStreamDestroy(mCopyStream));
+        for (auto& input : mDeviceInput)
+        {
+            CUDACHECK(cudaFree(input));
+        }
     }
 
     int getBatchSize() const noexcept
@@ -51,15 +60,27 @@ public:
         return mStream.getBatchSize();
     }
 
+    //!
+    //! \brief Returns the batch copied during the previous call, and starts copying the next one into the other
+    //!        device buffer while TensorRT calibrates on this one.
+    //!
     bool getBatch(void* bindings[], const char* names[], int nbBindings) noexcept
     {
-        if (!mStream.next())
+        if (!mStarted)
+        {
+            mStarted = true;
+            mPrefetched = copyNextBatch();
+        }
+        // The copy has read the host batch, so the stream may move on to the next one.
+        CUDACHECK(cudaStreamSynchronize(mCopyStream));
+        if (!mPrefetched)
         {
             return false;
         }
-        CHECK(cudaMemcpy(mDeviceInput, mStream.getBatch(), mInputCount * sizeof(float), cudaMemcpyHostToDevice));
         ASSERT(!strcmp(names[0], mInputBlobName));
-        bindings[0] = mDeviceInput;
+        bindings[0] = mDeviceInput[mCurrentInput];
+        mCurrentInput ^= 1;
+        mPrefetched = copyNextBatch();
         return true;
     }
 
@@ -84,12 +105,27 @@ public:
     }
 
 private:
+    bool copyNextBatch()
+    {
+        if (!mStream.next())
+        {
+            return false;
+        }
+        CUDACHECK(cudaMemcpyAsync(mDeviceInput[mCurrentInput], mStream.getBatch(), mInputCount * sizeof(float),
+            cudaMemcpyHostToDevice, mCopyStream));
+        return true;
+    }
+
     TBatchStream mStream;
     size_t mInputCount;
     std::string mCalibrationTableName;
     const char* mInputBlobName;
     bool mReadCache{true};
-    void* mDeviceInput{nullptr};
+    void* mDeviceInput[2]{nullptr, nullptr};
+    int mCurrentInput{0};
+    cudaStream_t mCopyStream{nullptr};
+    bool mStarted{false};
+    bool mPrefetched{false};
     std::vector<char> mCalibrationCache;
 };
 
@@ -0,0 +1,568 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef TENSORRT_EXIT_TRACE_H
+#define TENSORRT_EXIT_TRACE_H
+
+#include "MappedDataset.h"
+#include "logger.h"
+#include "rapidjson/error/en.h"
+#include "rapidjson/filereadstream.h"
+#include "rapidjson/reader.h"
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+//!
+//! \file ExitTrace.h
+//!
+//! \brief Recorded early-exit decisions of a model over a dataset, as one bitset per exit.
+//!
+//! \details Training writes, for every exit, a moveon json: an object of arrays with one flag per sample, true when
+//!          the sample did not exit there and moves on to the next stage. The flags are cumulative, a sample that
+//!          exited earlier is false at every later exit. Read through a DOM, these files take seconds for ImageNet
+//!          sized traces. ExitTrace streams them through the rapidjson SAX reader into bitsets, and writes the
+//!          bitsets of all exits to a binary trace that ExitTraceFile maps, so that loading a trace costs a page
+//!          fault per batch rather than a parse. Both hand out ExitMaskView, which counts and lists the survivors
+//!          of a batch without unpacking the trace, and ExitTraceReplay chains the views of successive exits into
+//!          the gather indices of each stage.
+//!
+
+namespace samplesCommon
+{
+
+//!
+//! \brief Header of a binary exit trace. Little-endian.
+//!
+struct ExitTraceHeader
+{
+    static constexpr size_t kMAGIC_SIZE = 8;
+    static constexpr uint32_t kMAX_EXITS = 16;
+
+    static const char* getMagic()
+    {
+        return "TRTEXT01";
+    }
+
+    char magic[kMAGIC_SIZE];
+    uint32_t batchSize; //!< Batch size the trace was recorded with, the default for views of it.
+    uint32_t nbExits;
+    uint64_t nbSamples;
+    uint64_t wordsPerExit;     //!< 64-bit words of the bitset of one exit.
+    uint64_t masksOffset;      //!< Offset of nbExits bitsets, in the order of exits.
+    int32_t exits[kMAX_EXITS]; //!< Layer each exit follows, as in the split point of the models.
+};
+static_assert(sizeof(ExitTraceHeader) == 104, "ExitTraceHeader is a file format");
+
+//!
+//! \brief The moveon flags of one exit, bit i of the words set when sample i moves on past the exit, grouped into
+//!        batches of batchSize samples. The last batch may be partial.
+//!
+class ExitMaskView
+{
+public:
+    ExitMaskView() = default;
+
+    ExitMaskView(const uint64_t* words, uint64_t nbSamples, int batchSize)
+        : mWords(words)
+        , mNbSamples(nbSamples)
+        , mBatchSize(batchSize)
+    {
+        assert(batchSize > 0);
+    }
+
+    uint64_t size() const
+    {
+        return mNbSamples;
+    }
+
+    int getBatchSize() const
+    {
+        return mBatchSize;
+    }
+
+    size_t getNbBatches() const
+    {
+        return mBatchSize > 0 ? static_cast<size_t>((mNbSamples + mBatchSize - 1) / mBatchSize) : 0;
+    }
+
+    //! Samples of batch, usually batchSize.
+    int getBatchLength(size_t batch) const
+    {
+        const uint64_t first = uint64_t(batch) * mBatchSize;
+        return static_cast<int>(std::min<uint64_t>(mBatchSize, mNbSamples - first));
+    }
+
+    bool movesOn(uint64_t sample) const
+    {
+        assert(sample < mNbSamples);
+        return (mWords[sample / 64] >> (sample % 64)) & 1u;
+    }
+
+    //! Samples of batch that move on past the exit.
+    int getSurvivorCount(size_t batch) const
+    {
+        assert(batch < getNbBatches());
+        uint64_t begin = uint64_t(batch) * mBatchSize;
+        const uint64_t end = begin + getBatchLength(batch);
+        int count = 0;
+        while (begin < end)
+        {
+            // The part of the batch in this word.
+            const uint64_t bits = std::min<uint64_t>(64 - begin % 64, end - begin);
+            const uint64_t mask = bits == 64 ? ~uint64_t(0) : ((uint64_t(1) << bits) - 1);
+            count += __builtin_popcountll((mWords[begin / 64] >> (begin % 64)) & mask);
+            begin += bits;
+        }
+        return count;
+    }
+
+    //! Survivor counts of all batches, what the runner used to build from the json.
+    std::vector<int> getSurvivorCounts() const
+    {
+        std::vector<int> counts(getNbBatches());
+        for (size_t b = 0; b < counts.size(); ++b)
+        {
+            counts[b] = getSurvivorCount(b);
+        }
+        return counts;
+    }
+
+    //! Positions in batch of the samples that move on, in order: the gather indices of the next stage.
+    void getSurvivors(size_t batch, std::vector<int>& indices) const
+    {
+        assert(batch < getNbBatches());
+        indices.clear();
+        const uint64_t first = uint64_t(batch) * mBatchSize;
+        const int length = getBatchLength(batch);
+        for (int i = 0; i < length; ++i)
+        {
+            if (movesOn(first + i))
+            {
+                indices.push_back(i);
+            }
+        }
+    }
+
+    //! The flags of batch, one byte per sample.
+    void getMask(size_t batch, std::vector<uint8_t>& mask) const
+    {
+        assert(batch < getNbBatches());
+        const uint64_t first = uint64_t(batch) * mBatchSize;
+        mask.resize(getBatchLength(batch));
+        for (size_t i = 0; i < mask.size(); ++i)
+        {
+            mask[i] = movesOn(first + i);
+        }
+    }
+
+private:
+    const uint64_t* mWords{nullptr};
+    uint64_t mNbSamples{0};
+    int mBatchSize{0};
+};
+
+//!
+//! \brief An exit trace in memory, built from moveon json files, that can be written as a binary trace.
+//!
+class ExitTrace
+{
+public:
+    //! \param batchSize Batch size the moveon files were recorded with.
+    explicit ExitTrace(int batchSize)
+        : mBatchSize(batchSize)
+    {
+    }
+
+    //!
+    //! \brief Append the moveon json of the exit after layer exit. Returns false, logging why, if the file cannot be
+    //!        parsed, or does not have as many samples as the exits added before it.
+    //!
+    bool addMoveonJson(int32_t exit, const std::string& path)
+    {
+        if (mExits.size() == ExitTraceHeader::kMAX_EXITS)
+        {
+            sample::gLogError << "Exit traces hold at most " << ExitTraceHeader::kMAX_EXITS << " exits" << std::endl;
+            return false;
+        }
+        FILE* file = std::fopen(path.c_str(), "rb");
+        if (!file)
+        {
+            sample::gLogError << "Could not open " << path << ": " << std::strerror(errno) << std::endl;
+            return false;
+        }
+        char buffer[65536];
+        rapidjson::FileReadStream stream(file, buffer, sizeof(buffer));
+        MoveonHandler handler;
+        rapidjson::Reader reader;
+        const rapidjson::ParseResult result = reader.Parse(stream, handler);
+        std::fclose(file);
+        if (!result)
+        {
+            sample::gLogError << path << " is not a moveon json: " << rapidjson::GetParseError_En(result.Code())
+                              << " at offset " << result.Offset() << std::endl;
+            return false;
+        }
+        return addExit(exit, std::move(handler.words), handler.nbSamples, path);
+    }
+
+    //!
+    //! \brief Append an exit from flags, one per sample.
+    //!
+    bool addExit(int32_t exit, const std::vector<bool>& movesOn)
+    {
+        std::vector<uint64_t> words((movesOn.size() + 63) / 64, 0);
+        for (size_t i = 0; i < movesOn.size(); ++i)
+        {
+            words[i / 64] |= uint64_t(movesOn[i]) << (i % 64);
+        }
+        return addExit(exit, std::move(words), movesOn.size(), "flags");
+    }
+
+    size_t getNbExits() const
+    {
+        return mExits.size();
+    }
+
+    int32_t getExit(size_t e) const
+    {
+        return mExits[e];
+    }
+
+    uint64_t size() const
+    {
+        return mNbSamples;
+    }
+
+    //! \param batchSize Batch size to group samples by, 0 for the one the trace was recorded with.
+    ExitMaskView getMasks(size_t e, int batchSize = 0) const
+    {
+        return ExitMaskView(mMasks[e].data(), mNbSamples, batchSize > 0 ? batchSize : mBatchSize);
+    }
+
+    //!
+    //! \brief Write the trace to path. Returns false, logging why, if it cannot be written.
+    //!
+    bool write(const std::string& path) const
+    {
+        ExitTraceHeader header{};
+        std::memcpy(header.magic, ExitTraceHeader::getMagic(), ExitTraceHeader::kMAGIC_SIZE);
+        header.batchSize = mBatchSize;
+        header.nbExits = static_cast<uint32_t>(mExits.size());
+        header.nbSamples = mNbSamples;
+        header.wordsPerExit = (mNbSamples + 63) / 64;
+        header.masksOffset = sizeof(header);
+        std::copy(mExits.begin(), mExits.end(), header.exits);
+
+        // Written under a temporary name, so that an interrupted conversion never leaves a trace that looks complete.
+        const std::string partial = path + ".partial";
+        std::ofstream out(partial, std::ios::binary);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        for (const auto& words : mMasks)
+        {
+            out.write(reinterpret_cast<const char*>(words.data()), words.size() * sizeof(uint64_t));
+        }
+        out.close();
+        if (!out || std::rename(partial.c_str(), path.c_str()) != 0)
+        {
+            sample::gLogError << "Could not write exit trace " << path << std::endl;
+            std::remove(partial.c_str());
+            return false;
+        }
+        return true;
+    }
+
+private:
+    //! SAX handler for {"key": [flag, ...], ...}; flags are booleans or 0/1, in document order.
+    struct MoveonHandler : rapidjson::BaseReaderHandler<rapidjson::UTF8<>, MoveonHandler>
+    {
+        bool Default()
+        {
+            return false;
+        }
+        bool StartObject()
+        {
+            return ++depth == 1;
+        }
+        bool Key(const char*, rapidjson::SizeType, bool)
+        {
+            return depth == 1;
+        }
+        bool EndObject(rapidjson::SizeType)
+        {
+            --depth;
+            return true;
+        }
+        bool StartArray()
+        {
+            return ++depth == 2;
+        }
+        bool EndArray(rapidjson::SizeType)
+        {
+            --depth;
+            return true;
+        }
+        bool Bool(bool value)
+        {
+            return append(value);
+        }
+        bool Int(int value)
+        {
+            return (value == 0 || value == 1) && append(value != 0);
+        }
+        bool Uint(unsigned value)
+        {
+            return value <= 1 && append(value != 0);
+        }
+        bool append(bool value)
+        {
+            if (depth != 2)
+            {
+                return false;
+            }
+            if (nbSamples % 64 == 0)
+            {
+                words.push_back(0);
+            }
+            words.back() |= uint64_t(value) << (nbSamples % 64);
+            ++nbSamples;
+            return true;
+        }
+
+        int depth{0};
+        std::vector<uint64_t> words;
+        uint64_t nbSamples{0};
+    };
+
+    bool addExit(int32_t exit, std::vector<uint64_t> words, uint64_t nbSamples, const std::string& source)
+    {
+        if (!mExits.empty() && nbSamples != mNbSamples)
+        {
+            sample::gLogError << source << " has " << nbSamples << " samples, the trace " << mNbSamples << std::endl;
+            return false;
+        }
+        mExits.push_back(exit);
+        mMasks.push_back(std::move(words));
+        mNbSamples = nbSamples;
+        return true;
+    }
+
+    int mBatchSize;
+    uint64_t mNbSamples{0};
+    std::vector<int32_t> mExits;
+    std::vector<std::vector<uint64_t>> mMasks;
+};
+
+//!
+//! \brief A binary exit trace mapped read-only.
+//!
+class ExitTraceFile
+{
+public:
+    //!
+    //! \brief Map path. Returns false, logging why, if it is missing or malformed.
+    //!
+    bool open(const std::string& path)
+    {
+        mHeader = ExitTraceHeader{};
+        if (!mFile.open(path))
+        {
+            return false;
+        }
+        ExitTraceHeader header;
+        if (mFile.size() < sizeof(header)
+            || std::memcmp(mFile.data(), ExitTraceHeader::getMagic(), ExitTraceHeader::kMAGIC_SIZE) != 0)
+        {
+            sample::gLogError << path << " is not an exit trace" << std::endl;
+            mFile.close();
+            return false;
+        }
+        std::memcpy(&header, mFile.data(), sizeof(header));
+        if (header.batchSize == 0 || header.nbExits == 0 || header.nbExits > ExitTraceHeader::kMAX_EXITS
+            || header.wordsPerExit != (header.nbSamples + 63) / 64 || header.masksOffset % sizeof(uint64_t) != 0
+            || header.masksOffset + header.nbExits * header.wordsPerExit * sizeof(uint64_t) > mFile.size())
+        {
+            sample::gLogError << "Exit trace " << path << " is truncated or corrupt" << std::endl;
+            mFile.close();
+            return false;
+        }
+        mHeader = header;
+        return true;
+    }
+
+    int getBatchSize() const
+    {
+        return static_cast<int>(mHeader.batchSize);
+    }
+
+    size_t getNbExits() const
+    {
+        return mHeader.nbExits;
+    }
+
+    int32_t getExit(size_t e) const
+    {
+        assert(e < getNbExits());
+        return mHeader.exits[e];
+    }
+
+    uint64_t size() const
+    {
+        return mHeader.nbSamples;
+    }
+
+    //! \param batchSize Batch size to group samples by, 0 for the one the trace was recorded with.
+    ExitMaskView getMasks(size_t e, int batchSize = 0) const
+    {
+        assert(e < getNbExits());
+        const auto* words = reinterpret_cast<const uint64_t*>(mFile.data() + mHeader.masksOffset);
+        return ExitMaskView(words + e * mHeader.wordsPerExit, mHeader.nbSamples,
+            batchSize > 0 ? batchSize : getBatchSize());
+    }
+
+private:
+    MappedFile mFile;
+    ExitTraceHeader mHeader{};
+};
+
+//!
+//! \brief One batch of a replayed trace.
+//!
+struct ReplayBatch
+{
+    size_t index{0}; //!< Batch of the trace.
+    int pass{0};     //!< How many times the trace had been replayed before this batch.
+    //! gather[e] lists the positions, in the batch that reached exit e, of the samples that move on past it: the
+    //! gather indices that compact the input of the stage after exit e. Its size is that stage's batch size.
+    std::vector<std::vector<int>> gather;
+};
+
+//!
+//! \brief Replays the exits of a trace batch by batch, in trace order or in a seeded order, and for one shard of the
+//!        batches, so that a runner compacts its stages exactly as the recorded model would have.
+//!
+//! \details The masks of the exits are applied in order: a sample reaches exit e only if it moved on past every exit
+//!          before it. Only whole batches are replayed. Shards take every nbShards-th batch of the order, so streams
+//!          replaying different shards of one seed never see the same batch.
+//!
+class ExitTraceReplay
+{
+public:
+    //!
+    //! \param exits Masks of the exits in the order samples reach them, grouped by the batch size of the first stage.
+    //!        All cover the same samples.
+    //! \param seed 0 replays the batches in trace order, anything else in an order shuffled by it, again on every
+    //!        pass.
+    //! \param loop Whether to start over once the batches of the shard are exhausted.
+    //!
+    ExitTraceReplay(
+        std::vector<ExitMaskView> exits, uint32_t seed = 0, bool loop = true, int shard = 0, int nbShards = 1)
+        : mExits(std::move(exits))
+        , mSeed(seed)
+        , mLoop(loop)
+        , mShard(shard)
+        , mNbShards(nbShards)
+    {
+        assert(!mExits.empty() && nbShards > 0 && shard >= 0 && shard < nbShards);
+        startPass();
+    }
+
+    //! Batches of one pass over the shard.
+    size_t size() const
+    {
+        return mOrder.size();
+    }
+
+    int getBatchSize() const
+    {
+        return mExits[0].getBatchSize();
+    }
+
+    size_t getNbExits() const
+    {
+        return mExits.size();
+    }
+
+    //!
+    //! \brief The next batch, or false once the shard is exhausted and the replay does not loop.
+    //!
+    bool next(ReplayBatch& batch)
+    {
+        if (mNext == mOrder.size())
+        {
+            if (!mLoop || mOrder.empty())
+            {
+                return false;
+            }
+            ++mPass;
+            startPass();
+        }
+        batch.index = mOrder[mNext++];
+        batch.pass = mPass;
+        batch.gather.resize(mExits.size());
+
+        // Positions, in the whole batch, of the samples still running.
+        const uint64_t first = uint64_t(batch.index) * getBatchSize();
+        mExits[0].getSurvivors(batch.index, batch.gather[0]);
+        mAlive = batch.gather[0];
+        for (size_t e = 1; e < mExits.size(); ++e)
+        {
+            std::vector<int>& gather = batch.gather[e];
+            gather.clear();
+            size_t nbAlive = 0;
+            for (size_t j = 0; j < mAlive.size(); ++j)
+            {
+                if (mExits[e].movesOn(first + mAlive[j]))
+                {
+                    gather.push_back(static_cast<int>(j));
+                    mAlive[nbAlive++] = mAlive[j];
+                }
+            }
+            mAlive.resize(nbAlive);
+        }
+        return true;
+    }
+
+private:
+    void startPass()
+    {
+        const size_t nbWhole = mExits[0].size() / getBatchSize();
+        std::vector<size_t> order(nbWhole);
+        for (size_t b = 0; b < nbWhole; ++b)
+        {
+            order[b] = b;
+        }
+        if (mSeed != 0)
+        {
+            std::mt19937 generator(mSeed + mPass);
+            std::shuffle(order.begin(), order.end(), generator);
+        }
+        mOrder.clear();
+        for (size_t i = mShard; i < order.size(); i += mNbShards)
+        {
+            mOrder.push_back(order[i]);
+        }
+        mNext = 0;
+    }
+
+    std::vector<ExitMaskView> mExits;
+    uint32_t mSeed;
+    bool mLoop;
+    int mShard;
+    int mNbShards;
+    int mPass{0};
+    std::vector<size_t> mOrder;
+    size_t mNext{0};
+    std::vector<int> mAlive;
+};
+
+} // namespace samplesCommon
+
+#endif // TENSORRT_EXIT_TRACE_H
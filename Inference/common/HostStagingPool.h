@@ -0,0 +1,327 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef TENSORRT_HOST_STAGING_POOL_H
+#define TENSORRT_HOST_STAGING_POOL_H
+
+#include "logger.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cuda_runtime_api.h>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+//!
+//! \file HostStagingPool.h
+//!
+//! \brief Pinned host memory for the host side of buffers, kept under a cap and reused across allocations.
+//!
+//! \details Copies between the device and pageable memory go through a driver staging buffer and block the host, so
+//!          cudaMemcpyAsync from a malloc'd host buffer is not asynchronous. Pinning is expensive and pinned memory
+//!          is taken from the whole system, though, and the runners create buffers for every batch. The pool hands
+//!          out pinned blocks up to a cap and keeps freed ones to hand out again, so that a buffer created per batch
+//!          reuses the block of the last batch. Past the cap, or when pinning fails, it falls back to pageable memory
+//!          or fails, as configured. Both kinds of memory come from an IHostAllocator, so that tests can run the pool
+//!          on host-only allocators without a device.
+//!
+
+namespace samplesCommon
+{
+
+//!
+//! \brief Where the pool gets memory from.
+//!
+class IHostAllocator
+{
+public:
+    virtual ~IHostAllocator() = default;
+
+    //! Returns nullptr if size bytes cannot be allocated.
+    virtual void* allocate(size_t size) = 0;
+
+    virtual void free(void* ptr) = 0;
+
+    //! Whether the memory is page-locked, so that copies to and from the device are asynchronous.
+    virtual bool isPinned() const = 0;
+};
+
+class PinnedHostAllocator : public IHostAllocator
+{
+public:
+    void* allocate(size_t size) override
+    {
+        void* ptr{nullptr};
+        if (cudaHostAlloc(&ptr, size, cudaHostAllocDefault) != cudaSuccess)
+        {
+            // Clear the error, so that it does not surface at an unrelated call.
+            cudaGetLastError();
+            return nullptr;
+        }
+        return ptr;
+    }
+
+    void free(void* ptr) override
+    {
+        cudaFreeHost(ptr);
+    }
+
+    bool isPinned() const override
+    {
+        return true;
+    }
+};
+
+//!
+//! \brief malloc and free, the fallback of the pool and, in place of PinnedHostAllocator, the allocator of tests.
+//!
+class PageableHostAllocator : public IHostAllocator
+{
+public:
+    void* allocate(size_t size) override
+    {
+        return std::malloc(size);
+    }
+
+    void free(void* ptr) override
+    {
+        std::free(ptr);
+    }
+
+    bool isPinned() const override
+    {
+        return false;
+    }
+};
+
+//! What the pool does when it cannot hand out pinned memory.
+enum class PinnedFallback
+{
+    kPAGEABLE, //!< Allocate pageable memory instead; copies from it still work but block the host.
+    kFAIL,     //!< Return nullptr, which buffers turn into std::bad_alloc.
+};
+
+//!
+//! \brief Thread-safe pool of pinned host blocks under a cap, with a fallback for what does not fit.
+//!
+class HostStagingPool
+{
+public:
+    static constexpr size_t kDEFAULT_CAPACITY = size_t(512) << 20;
+
+    //! \param pinned Allocator of the pooled blocks, usually a PinnedHostAllocator.
+    //! \param pageable Allocator of the fallback, usually a PageableHostAllocator.
+    HostStagingPool(std::unique_ptr<IHostAllocator> pinned, std::unique_ptr<IHostAllocator> pageable,
+        size_t capacity = kDEFAULT_CAPACITY, PinnedFallback fallback = PinnedFallback::kPAGEABLE)
+        : mPinned(std::move(pinned))
+        , mPageable(std::move(pageable))
+        , mCapacity(capacity)
+        , mFallback(fallback)
+    {
+    }
+
+    HostStagingPool(const HostStagingPool&) = delete;
+    HostStagingPool& operator=(const HostStagingPool&) = delete;
+
+    //! Frees the cached blocks. Blocks still handed out must have been freed already.
+    ~HostStagingPool()
+    {
+        trim();
+    }
+
+    //!
+    //! \brief The pool behind HostBuffer. It is never destroyed, so that buffers destroyed at exit can still free
+    //!        into it.
+    //!
+    static HostStagingPool& getDefault()
+    {
+        static HostStagingPool* pool = new HostStagingPool(std::unique_ptr<IHostAllocator>(new PinnedHostAllocator),
+            std::unique_ptr<IHostAllocator>(new PageableHostAllocator));
+        return *pool;
+    }
+
+    //!
+    //! \brief Cap the pinned bytes held, in use or cached. Lowering it frees cached blocks but not blocks in use.
+    //!
+    void setCapacity(size_t capacity)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mCapacity = capacity;
+        evict(0);
+    }
+
+    void setFallback(PinnedFallback fallback)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mFallback = fallback;
+    }
+
+    //!
+    //! \brief A block of at least size bytes: a cached pinned block if one fits, a new pinned one if the cap allows,
+    //!        and otherwise what the fallback says.
+    //!
+    void* allocate(size_t size)
+    {
+        size = std::max<size_t>(size, 1);
+        std::lock_guard<std::mutex> lock(mMutex);
+        // Take the smallest cached block that fits, unless it would waste more than half of itself.
+        const auto cached = mCached.lower_bound(size);
+        if (cached != mCached.end() && cached->first / 2 <= size)
+        {
+            void* ptr = cached->second;
+            mLive[ptr] = Block{cached->first, true};
+            mCachedBytes -= cached->first;
+            mCached.erase(cached);
+            ++mNbReused;
+            return ptr;
+        }
+
+        evict(size);
+        if (mPinnedBytes + size <= mCapacity)
+        {
+            if (void* ptr = mPinned->allocate(size))
+            {
+                mLive[ptr] = Block{size, true};
+                mPinnedBytes += size;
+                return ptr;
+            }
+        }
+
+        if (mFallback == PinnedFallback::kFAIL)
+        {
+            sample::gLogError << "No pinned host memory for " << size << " bytes, " << mPinnedBytes << " of "
+                              << mCapacity << " in use" << std::endl;
+            return nullptr;
+        }
+        if (mNbFallbacks++ == 0)
+        {
+            sample::gLogWarning << "No pinned host memory for " << size << " bytes, " << mPinnedBytes << " of "
+                                << mCapacity << " in use; falling back to pageable memory, which makes copies to and "
+                                << "from it synchronous" << std::endl;
+        }
+        void* ptr = mPageable->allocate(size);
+        if (ptr)
+        {
+            mLive[ptr] = Block{size, false};
+        }
+        return ptr;
+    }
+
+    //!
+    //! \brief Return ptr, from allocate(), to the pool. Pinned blocks are cached for reuse, pageable ones freed.
+    //!        As with free(), copies still reading or writing ptr must have been synchronized.
+    //!
+    void free(void* ptr)
+    {
+        if (!ptr)
+        {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mMutex);
+        const auto live = mLive.find(ptr);
+        if (live == mLive.end())
+        {
+            sample::gLogError << "Host block " << ptr << " was not allocated by the staging pool or is already free"
+                              << std::endl;
+            return;
+        }
+        const Block block = live->second;
+        mLive.erase(live);
+        if (block.pooled)
+        {
+            mCached.emplace(block.size, ptr);
+            mCachedBytes += block.size;
+        }
+        else
+        {
+            mPageable->free(ptr);
+        }
+    }
+
+    //! Whether ptr, from allocate(), is pinned.
+    bool isPinned(const void* ptr) const
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        const auto live = mLive.find(const_cast<void*>(ptr));
+        return live != mLive.end() && live->second.pooled && mPinned->isPinned();
+    }
+
+    //! Free the cached blocks.
+    void trim()
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        while (!mCached.empty())
+        {
+            releaseCached(std::prev(mCached.end()));
+        }
+    }
+
+    //! Pinned bytes held, in use or cached.
+    size_t getPinnedBytes() const
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mPinnedBytes;
+    }
+
+    size_t getCachedBytes() const
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mCachedBytes;
+    }
+
+    //! Allocations served from the cache.
+    size_t getNbReused() const
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mNbReused;
+    }
+
+    //! Allocations that fell back to pageable memory.
+    size_t getNbFallbacks() const
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mNbFallbacks;
+    }
+
+private:
+    struct Block
+    {
+        size_t size;
+        bool pooled; //!< From mPinned, and cached when freed.
+    };
+
+    //! Free cached blocks, largest first, until size more bytes fit under the cap or the cache is empty.
+    void evict(size_t size)
+    {
+        while (!mCached.empty() && mPinnedBytes + size > mCapacity)
+        {
+            releaseCached(std::prev(mCached.end()));
+        }
+    }
+
+    void releaseCached(std::multimap<size_t, void*>::iterator cached)
+    {
+        mPinned->free(cached->second);
+        mPinnedBytes -= cached->first;
+        mCachedBytes -= cached->first;
+        mCached.erase(cached);
+    }
+
+    std::unique_ptr<IHostAllocator> mPinned;
+    std::unique_ptr<IHostAllocator> mPageable;
+    size_t mCapacity;
+    PinnedFallback mFallback;
+    mutable std::mutex mMutex;
+    std::unordered_map<void*, Block> mLive;  //!< Blocks handed out.
+    std::multimap<size_t, void*> mCached;    //!< Freed pinned blocks by size.
+    size_t mPinnedBytes{0};
+    size_t mCachedBytes{0};
+    size_t mNbReused{0};
+    size_t mNbFallbacks{0};
+};
+
+} // namespace samplesCommon
+
+#endif // TENSORRT_HOST_STAGING_POOL_H
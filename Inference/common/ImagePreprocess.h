@@ -0,0 +1,559 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef TENSORRT_IMAGE_PREPROCESS_H
+#define TENSORRT_IMAGE_PREPROCESS_H
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define TRT_PREPROCESS_X86 1
+#include <immintrin.h>
+#define TRT_PREPROCESS_AVX2 __attribute__((target("avx2,fma,f16c")))
+#else
+#define TRT_PREPROCESS_X86 0
+#endif
+
+//!
+//! \file ImagePreprocess.h
+//!
+//! \brief CPU kernels that turn uint8 images into normalized planar (CHW) network inputs.
+//!
+//! \details Every output value is x * scale[c] + bias[c], i.e. the usual (x / 255 - mean[c]) / std[c] with the
+//!          divisions folded into one multiply-add. Inputs can be interleaved (HWC, e.g. PPM or decoded JPEG) or
+//!          planar (CHW, e.g. CIFAR binaries), and can be cropped and resized (bilinear, half-pixel centers) on the
+//!          way. Outputs are float or IEEE half stored as uint16_t bits, the layout of half_float::half.
+//!
+//!          The kernels are selected at run time: AVX2 with FMA and F16C where the CPU has them, portable scalar
+//!          code otherwise. The scalar code is also the reference the vector code is tested against.
+//!
+
+namespace samplesCommon
+{
+
+enum class PixelLayout
+{
+    kHWC,
+    kCHW
+};
+
+enum class PreprocessIsa
+{
+    kSCALAR,
+    kAVX2
+};
+
+//!
+//! \brief Per-channel affine normalization y = x * scale[c] + bias[c].
+//!
+struct ChannelAffine
+{
+    static constexpr int kMAX_CHANNELS = 4;
+
+    int channels{0};
+    float scale[kMAX_CHANNELS]{};
+    float bias[kMAX_CHANNELS]{};
+
+    //!
+    //! \brief (x * pixelScale - mean[c]) / stddev[c].
+    //!
+    static ChannelAffine fromMeanStd(
+        int channels, const float* mean, const float* stddev, float pixelScale = 1.f / 255.f)
+    {
+        assert(channels > 0 && channels <= kMAX_CHANNELS);
+        ChannelAffine affine;
+        affine.channels = channels;
+        for (int c = 0; c < channels; ++c)
+        {
+            affine.scale[c] = pixelScale / stddev[c];
+            affine.bias[c] = -mean[c] / stddev[c];
+        }
+        return affine;
+    }
+
+    //!
+    //! \brief x * scale + bias for every channel.
+    //!
+    static ChannelAffine uniform(int channels, float scale, float bias)
+    {
+        assert(channels > 0 && channels <= kMAX_CHANNELS);
+        ChannelAffine affine;
+        affine.channels = channels;
+        std::fill_n(affine.scale, channels, scale);
+        std::fill_n(affine.bias, channels, bias);
+        return affine;
+    }
+};
+
+//!
+//! \brief Region of the source image, in pixels.
+//!
+struct ImageRect
+{
+    int x{0};
+    int y{0};
+    int width{0};
+    int height{0};
+};
+
+namespace preprocess
+{
+
+//!
+//! \brief Float to IEEE half with round-to-nearest-even, bit-exact with F16C.
+//!
+inline uint16_t floatToHalf(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    const uint32_t sign = (bits >> 16) & 0x8000u;
+    bits &= 0x7fffffffu;
+    uint16_t half;
+    if (bits >= 0x47800000u) // 65536 and up, infinities and NaNs.
+    {
+        half = bits > 0x7f800000u ? 0x7e00 : 0x7c00;
+    }
+    else if (bits < 0x38800000u) // Below 2^-14 the result is subnormal; let the FPU round it.
+    {
+        float magnitude;
+        std::memcpy(&magnitude, &bits, sizeof(bits));
+        magnitude += 0.5f;
+        std::memcpy(&bits, &magnitude, sizeof(bits));
+        half = static_cast<uint16_t>(bits - 0x3f000000u);
+    }
+    else
+    {
+        const uint32_t odd = (bits >> 13) & 1u;
+        bits += 0xc8000fffu + odd; // Rebias the exponent and round.
+        half = static_cast<uint16_t>(bits >> 13);
+    }
+    return static_cast<uint16_t>(half | sign);
+}
+
+//!
+//! \brief IEEE half to float, exact.
+//!
+inline float halfToFloat(uint16_t half)
+{
+    const uint32_t sign = static_cast<uint32_t>(half & 0x8000u) << 16;
+    const uint32_t exponent = (half >> 10) & 0x1fu;
+    uint32_t bits;
+    if (exponent == 0x1fu) // Infinities and NaNs.
+    {
+        bits = 0x7f800000u | static_cast<uint32_t>(half & 0x3ffu) << 13;
+    }
+    else if (exponent == 0) // Zeros and subnormals, which are normal floats.
+    {
+        const float magnitude = static_cast<float>(half & 0x3ffu) * 5.9604644775390625e-8f; // 2^-24
+        std::memcpy(&bits, &magnitude, sizeof(bits));
+    }
+    else
+    {
+        bits = (static_cast<uint32_t>(half & 0x7fffu) << 13) + 0x38000000u; // Rebias the exponent.
+    }
+    bits |= sign;
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+inline void storeValue(float value, float* dst)
+{
+    *dst = value;
+}
+
+inline void storeValue(float value, uint16_t* dst)
+{
+    *dst = floatToHalf(value);
+}
+
+//!
+//! \brief Kernels working on one run of pixels, so that crops can be handled row by row and full images in one call.
+//!
+template <typename T>
+struct Kernels
+{
+    //! dst[i] = src[i] * scale + bias
+    void (*affine)(const uint8_t* src, size_t n, float scale, float bias, T* dst);
+    //! Deinterleave n RGB pixels into three planes.
+    void (*affine3)(const uint8_t* src, size_t n, const float* scale, const float* bias, T* dst0, T* dst1, T* dst2);
+    //! dst[i] = (row0[i] + weight * (row1[i] - row0[i])) * scale + bias
+    void (*blend)(const float* row0, const float* row1, size_t n, float weight, float scale, float bias, T* dst);
+};
+
+template <typename T>
+void affineScalar(const uint8_t* src, size_t n, float scale, float bias, T* dst)
+{
+    for (size_t i = 0; i < n; ++i)
+    {
+        storeValue(static_cast<float>(src[i]) * scale + bias, dst + i);
+    }
+}
+
+template <typename T>
+void affine3Scalar(const uint8_t* src, size_t n, const float* scale, const float* bias, T* dst0, T* dst1, T* dst2)
+{
+    T* const dst[3] = {dst0, dst1, dst2};
+    for (int c = 0; c < 3; ++c)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            storeValue(static_cast<float>(src[3 * i + c]) * scale[c] + bias[c], dst[c] + i);
+        }
+    }
+}
+
+template <typename T>
+void blendScalar(const float* row0, const float* row1, size_t n, float weight, float scale, float bias, T* dst)
+{
+    for (size_t i = 0; i < n; ++i)
+    {
+        storeValue((row0[i] + weight * (row1[i] - row0[i])) * scale + bias, dst + i);
+    }
+}
+
+#if TRT_PREPROCESS_X86
+
+TRT_PREPROCESS_AVX2 inline void store8(__m256 value, float* dst)
+{
+    _mm256_storeu_ps(dst, value);
+}
+
+TRT_PREPROCESS_AVX2 inline void store8(__m256 value, uint16_t* dst)
+{
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm256_cvtps_ph(value, _MM_FROUND_TO_NEAREST_INT));
+}
+
+//! Eight bytes to eight floats.
+TRT_PREPROCESS_AVX2 inline __m256 widen8(__m128i bytes)
+{
+    return _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(bytes));
+}
+
+template <typename T>
+TRT_PREPROCESS_AVX2 void affineAvx2(const uint8_t* src, size_t n, float scale, float bias, T* dst)
+{
+    const __m256 vScale = _mm256_set1_ps(scale);
+    const __m256 vBias = _mm256_set1_ps(bias);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        store8(_mm256_fmadd_ps(widen8(bytes), vScale, vBias), dst + i);
+        store8(_mm256_fmadd_ps(widen8(_mm_srli_si128(bytes, 8)), vScale, vBias), dst + i + 8);
+    }
+    affineScalar(src + i, n - i, scale, bias, dst + i);
+}
+
+//!
+//! \brief pshufb masks gathering channel c of 16 RGB pixels from the 16-byte chunk q of their 48 bytes.
+//!
+inline const uint8_t* deinterleave3Masks()
+{
+    struct Masks
+    {
+        uint8_t bytes[3][3][16];
+        Masks()
+        {
+            for (int q = 0; q < 3; ++q)
+            {
+                for (int c = 0; c < 3; ++c)
+                {
+                    for (int j = 0; j < 16; ++j)
+                    {
+                        const int src = 3 * j + c;
+                        bytes[q][c][j] = src / 16 == q ? static_cast<uint8_t>(src % 16) : 0x80;
+                    }
+                }
+            }
+        }
+    };
+    static const Masks masks;
+    return &masks.bytes[0][0][0];
+}
+
+template <typename T>
+TRT_PREPROCESS_AVX2 void affine3Avx2(
+    const uint8_t* src, size_t n, const float* scale, const float* bias, T* dst0, T* dst1, T* dst2)
+{
+    const uint8_t* masks = deinterleave3Masks();
+    T* const dst[3] = {dst0, dst1, dst2};
+    __m128i mask[3][3];
+    __m256 vScale[3];
+    __m256 vBias[3];
+    for (int c = 0; c < 3; ++c)
+    {
+        for (int q = 0; q < 3; ++q)
+        {
+            mask[q][c] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(masks + (q * 3 + c) * 16));
+        }
+        vScale[c] = _mm256_set1_ps(scale[c]);
+        vBias[c] = _mm256_set1_ps(bias[c]);
+    }
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        const __m128i* p = reinterpret_cast<const __m128i*>(src + 3 * i);
+        const __m128i a = _mm_loadu_si128(p);
+        const __m128i b = _mm_loadu_si128(p + 1);
+        const __m128i d = _mm_loadu_si128(p + 2);
+        for (int c = 0; c < 3; ++c)
+        {
+            const __m128i plane = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a, mask[0][c]),
+                                                   _mm_shuffle_epi8(b, mask[1][c])),
+                _mm_shuffle_epi8(d, mask[2][c]));
+            store8(_mm256_fmadd_ps(widen8(plane), vScale[c], vBias[c]), dst[c] + i);
+            store8(_mm256_fmadd_ps(widen8(_mm_srli_si128(plane, 8)), vScale[c], vBias[c]), dst[c] + i + 8);
+        }
+    }
+    affine3Scalar(src + 3 * i, n - i, scale, bias, dst0 + i, dst1 + i, dst2 + i);
+}
+
+template <typename T>
+TRT_PREPROCESS_AVX2 void blendAvx2(
+    const float* row0, const float* row1, size_t n, float weight, float scale, float bias, T* dst)
+{
+    const __m256 vWeight = _mm256_set1_ps(weight);
+    const __m256 vScale = _mm256_set1_ps(scale);
+    const __m256 vBias = _mm256_set1_ps(bias);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        const __m256 r0 = _mm256_loadu_ps(row0 + i);
+        const __m256 r1 = _mm256_loadu_ps(row1 + i);
+        const __m256 value = _mm256_fmadd_ps(_mm256_sub_ps(r1, r0), vWeight, r0);
+        store8(_mm256_fmadd_ps(value, vScale, vBias), dst + i);
+    }
+    blendScalar(row0 + i, row1 + i, n - i, weight, scale, bias, dst + i);
+}
+
+#endif // TRT_PREPROCESS_X86
+
+inline bool cpuSupports(PreprocessIsa isa)
+{
+    switch (isa)
+    {
+    case PreprocessIsa::kSCALAR: return true;
+    case PreprocessIsa::kAVX2:
+#if TRT_PREPROCESS_X86
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") && __builtin_cpu_supports("f16c");
+#else
+        return false;
+#endif
+    }
+    return false;
+}
+
+inline PreprocessIsa& selectedIsa()
+{
+    static PreprocessIsa isa = cpuSupports(PreprocessIsa::kAVX2) ? PreprocessIsa::kAVX2 : PreprocessIsa::kSCALAR;
+    return isa;
+}
+
+template <typename T>
+const Kernels<T>& getKernels()
+{
+    static const Kernels<T> scalar{&affineScalar<T>, &affine3Scalar<T>, &blendScalar<T>};
+#if TRT_PREPROCESS_X86
+    static const Kernels<T> avx2{&affineAvx2<T>, &affine3Avx2<T>, &blendAvx2<T>};
+    if (selectedIsa() == PreprocessIsa::kAVX2)
+    {
+        return avx2;
+    }
+#endif
+    return scalar;
+}
+
+//!
+//! \brief Normalize the rows [y, y + height) x [x, x + width) of src into dst, planes of dstWidth * height values.
+//!
+template <typename T>
+void normalizeRect(const uint8_t* src, int srcHeight, int srcWidth, PixelLayout layout,
+    const ChannelAffine& affine, ImageRect rect, T* dst)
+{
+    const Kernels<T>& kernels = getKernels<T>();
+    const int channels = affine.channels;
+    const size_t planeSize = static_cast<size_t>(rect.width) * rect.height;
+    const bool wholeRows = rect.x == 0 && rect.width == srcWidth;
+    // Whole rows are contiguous, so the rect is processed as a single run.
+    const int runs = wholeRows ? 1 : rect.height;
+    const size_t runLength = wholeRows ? planeSize : rect.width;
+    for (int r = 0; r < runs; ++r)
+    {
+        const size_t pixel = static_cast<size_t>(rect.y + r) * srcWidth + rect.x;
+        const size_t out = r * runLength;
+        if (layout == PixelLayout::kCHW || channels == 1)
+        {
+            for (int c = 0; c < channels; ++c)
+            {
+                const uint8_t* plane = src + static_cast<size_t>(c) * srcHeight * srcWidth;
+                kernels.affine(plane + pixel, runLength, affine.scale[c], affine.bias[c], dst + c * planeSize + out);
+            }
+        }
+        else if (channels == 3)
+        {
+            kernels.affine3(src + 3 * pixel, runLength, affine.scale, affine.bias, dst + out, dst + planeSize + out,
+                dst + 2 * planeSize + out);
+        }
+        else
+        {
+            for (int c = 0; c < channels; ++c)
+            {
+                for (size_t i = 0; i < runLength; ++i)
+                {
+                    storeValue(static_cast<float>(src[(pixel + i) * channels + c]) * affine.scale[c] + affine.bias[c],
+                        dst + c * planeSize + out + i);
+                }
+            }
+        }
+    }
+}
+
+//!
+//! \brief Crop, resize with bilinear interpolation and normalize. Source rows are interpolated horizontally once
+//!        into float rows, which the vector kernels then blend vertically and normalize.
+//!
+template <typename T>
+void resizeRect(const uint8_t* src, int srcHeight, int srcWidth, PixelLayout layout, ImageRect crop,
+    int dstHeight, int dstWidth, const ChannelAffine& affine, T* dst)
+{
+    const Kernels<T>& kernels = getKernels<T>();
+    const int channels = affine.channels;
+    const size_t planeSize = static_cast<size_t>(dstHeight) * dstWidth;
+
+    // Half-pixel centers, clamped at the edges of the crop.
+    auto sourceCoord = [](int d, int srcExtent, int dstExtent, int* i0, int* i1, float* weight) {
+        float s = (d + 0.5f) * static_cast<float>(srcExtent) / dstExtent - 0.5f;
+        s = std::min(std::max(s, 0.f), static_cast<float>(srcExtent - 1));
+        *i0 = static_cast<int>(s);
+        *i1 = std::min(*i0 + 1, srcExtent - 1);
+        *weight = s - *i0;
+    };
+    std::vector<int> x0(dstWidth);
+    std::vector<int> x1(dstWidth);
+    std::vector<float> wx(dstWidth);
+    for (int dx = 0; dx < dstWidth; ++dx)
+    {
+        sourceCoord(dx, crop.width, dstWidth, &x0[dx], &x1[dx], &wx[dx]);
+    }
+
+    auto at = [&](int c, int y, int x) {
+        const size_t sy = crop.y + y;
+        const size_t sx = crop.x + x;
+        return static_cast<float>(layout == PixelLayout::kHWC ? src[(sy * srcWidth + sx) * channels + c]
+                                                              : src[(c * srcHeight + sy) * srcWidth + sx]);
+    };
+    // Horizontally interpolated source rows, all channels, for the two rows the current output row blends.
+    std::vector<float> rows[2];
+    int rowY[2] = {-1, -1};
+    auto interpolateRow = [&](int slot, int y) {
+        rows[slot].resize(static_cast<size_t>(channels) * dstWidth);
+        for (int c = 0; c < channels; ++c)
+        {
+            float* row = rows[slot].data() + static_cast<size_t>(c) * dstWidth;
+            for (int dx = 0; dx < dstWidth; ++dx)
+            {
+                const float v0 = at(c, y, x0[dx]);
+                row[dx] = v0 + wx[dx] * (at(c, y, x1[dx]) - v0);
+            }
+        }
+        rowY[slot] = y;
+    };
+
+    for (int dy = 0; dy < dstHeight; ++dy)
+    {
+        int y0, y1;
+        float wy;
+        sourceCoord(dy, crop.height, dstHeight, &y0, &y1, &wy);
+        // Rows move down monotonically, so the previous second row is usually the new first one.
+        if (rowY[0] != y0)
+        {
+            if (rowY[1] == y0)
+            {
+                std::swap(rows[0], rows[1]);
+                std::swap(rowY[0], rowY[1]);
+            }
+            else
+            {
+                interpolateRow(0, y0);
+            }
+        }
+        if (rowY[1] != y1)
+        {
+            interpolateRow(1, y1);
+        }
+        for (int c = 0; c < channels; ++c)
+        {
+            const size_t offset = static_cast<size_t>(c) * dstWidth;
+            kernels.blend(rows[0].data() + offset, rows[1].data() + offset, dstWidth, wy, affine.scale[c],
+                affine.bias[c], dst + c * planeSize + static_cast<size_t>(dy) * dstWidth);
+        }
+    }
+}
+
+} // namespace preprocess
+
+//!
+//! \brief The kernels in use.
+//!
+inline PreprocessIsa getPreprocessIsa()
+{
+    return preprocess::selectedIsa();
+}
+
+//!
+//! \brief Use the kernels of isa, e.g. to compare them with the scalar reference. Not thread-safe with running
+//!        kernels. Returns false, leaving the selection unchanged, if the CPU does not support isa.
+//!
+inline bool setPreprocessIsa(PreprocessIsa isa)
+{
+    if (!preprocess::cpuSupports(isa))
+    {
+        return false;
+    }
+    preprocess::selectedIsa() = isa;
+    return true;
+}
+
+//!
+//! \brief Normalize a height x width image with affine.channels channels into CHW planes at dst.
+//!
+template <typename T>
+void normalizeImage(
+    const uint8_t* src, int height, int width, PixelLayout layout, const ChannelAffine& affine, T* dst)
+{
+    ImageRect all;
+    all.width = width;
+    all.height = height;
+    preprocess::normalizeRect(src, height, width, layout, affine, all, dst);
+}
+
+//!
+//! \brief Crop rect out of a height x width image, resize it to dstHeight x dstWidth and normalize it into CHW
+//!        planes at dst. Without resizing this is an exact crop.
+//!
+template <typename T>
+void resizeNormalizeImage(const uint8_t* src, int height, int width, PixelLayout layout, ImageRect crop,
+    int dstHeight, int dstWidth, const ChannelAffine& affine, T* dst)
+{
+    assert(crop.x >= 0 && crop.y >= 0 && crop.x + crop.width <= width && crop.y + crop.height <= height);
+    assert(crop.width > 0 && crop.height > 0 && dstWidth > 0 && dstHeight > 0);
+    if (crop.width == dstWidth && crop.height == dstHeight)
+    {
+        preprocess::normalizeRect(src, height, width, layout, affine, crop, dst);
+    }
+    else
+    {
+        preprocess::resizeRect(src, height, width, layout, crop, dstHeight, dstWidth, affine, dst);
+    }
+}
+
+} // namespace samplesCommon
+
+#endif // TENSORRT_IMAGE_PREPROCESS_H
@@ -0,0 +1,485 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef TENSORRT_INPUT_PIPELINE_H
+#define TENSORRT_INPUT_PIPELINE_H
+
+#include "BatchStream.h"
+#include <algorithm>
+#include <cassert>
+#include <climits>
+#include <condition_variable>
+#include <cstdlib>
+#include <cuda_runtime_api.h>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+
+namespace samplesCommon
+{
+
+//!
+//! \brief One preallocated host batch of an InputPipeline.
+//!
+struct HostBatch
+{
+    int index{-1};          //!< Position of the batch in the stream.
+    int size{0};            //!< Number of samples the producer filled; the last batch may be short.
+    float* data{nullptr};   //!< batchSize * sampleVolume floats.
+    float* labels{nullptr}; //!< batchSize labels.
+};
+
+//!
+//! \brief Prepares input batches on worker threads, ahead of the thread that runs inference.
+//!
+//! \details Workers decode and normalize batches into a bounded ring of preallocated host slots, pinned when
+//!          CUDA allows it so that copies to the device can be asynchronous, and the consumer receives them in
+//!          stream order. A worker only starts batch b once batch b - nbSlots has been released, so at most
+//!          nbSlots batches are resident and fast workers block instead of running ahead. Slots are released
+//!          either directly or, with release(batch, stream), once the work queued on a CUDA stream has read them.
+//!          Restarting or destroying the pipeline waits for such deferred releases, so the streams passed to
+//!          release() must keep making progress.
+//!
+class InputPipeline
+{
+public:
+    //!
+    //! \brief Fills batch.data and batch.labels with batch number batch.index and sets batch.size. Returns false
+    //!        past the end of the data. Called concurrently from the workers, each with its own batch.
+    //!
+    using Producer = std::function<bool(HostBatch& batch)>;
+
+    InputPipeline(int batchSize, size_t sampleVolume, int nbSlots, int nbWorkers, Producer producer)
+        : mBatchSize(batchSize)
+        , mSampleVolume(sampleVolume)
+        , mNbWorkers(std::max(1, nbWorkers))
+        , mProducer(std::move(producer))
+        , mSlots(std::max(1, nbSlots))
+        , mStates(mSlots.size(), kFREE)
+        , mCallbacks(mSlots.size())
+    {
+        const size_t bytes = getBatchBytes() + mBatchSize * sizeof(float);
+        for (size_t i = 0; i < mSlots.size(); ++i)
+        {
+            void* memory{nullptr};
+            if (mPinned && cudaHostAlloc(&memory, bytes, cudaHostAllocDefault) != cudaSuccess)
+            {
+                // No device, or no pinned memory left: pageable slots still overlap the preparation.
+                cudaGetLastError();
+                mPinned = false;
+            }
+            if (!mPinned)
+            {
+                memory = malloc(bytes);
+                if (!memory)
+                {
+                    throw std::bad_alloc();
+                }
+            }
+            mSlots[i].data = static_cast<float*>(memory);
+            mSlots[i].labels = mSlots[i].data + mBatchSize * mSampleVolume;
+            mCallbacks[i] = {this, &mSlots[i]};
+        }
+    }
+
+    InputPipeline(const InputPipeline&) = delete;
+    InputPipeline& operator=(const InputPipeline&) = delete;
+
+    ~InputPipeline()
+    {
+        stop();
+        waitForDeferredReleases();
+        for (auto& slot : mSlots)
+        {
+            if (mPinned)
+            {
+                cudaFreeHost(slot.data);
+            }
+            else
+            {
+                free(slot.data);
+            }
+        }
+    }
+
+    //!
+    //! \brief Start producing batches firstBatch, firstBatch + 1, ..., stopping after nbBatches batches, or when
+    //!        the producer runs out of data if nbBatches is negative. Batches of an earlier start are dropped,
+    //!        once the releases deferred to a stream have arrived.
+    //!
+    void start(int firstBatch = 0, int nbBatches = -1)
+    {
+        stop();
+        waitForDeferredReleases();
+        mFirstBatch = firstBatch;
+        mEndBatch = nbBatches < 0 ? INT_MAX : firstBatch + nbBatches;
+        mNextClaim = firstBatch;
+        mNextAcquire = firstBatch;
+        mNbReleased = 0;
+        std::fill(mStates.begin(), mStates.end(), kFREE);
+        mStop = false;
+        for (int i = 0; i < mNbWorkers; ++i)
+        {
+            mWorkers.emplace_back(&InputPipeline::work, this);
+        }
+    }
+
+    //!
+    //! \brief Block until the next batch in stream order is ready and return it, or nullptr once the stream ends.
+    //!
+    HostBatch* acquire()
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        const int index = mNextAcquire;
+        const size_t slot = slotOf(index);
+        if (index < mEndBatch && mStates[slot] != kREADY)
+        {
+            ++mNbStalls;
+            mReady.wait(lock, [&] { return mStop || index >= mEndBatch || mStates[slot] == kREADY; });
+        }
+        if (mStop || index >= mEndBatch)
+        {
+            return nullptr;
+        }
+        mStates[slot] = kACQUIRED;
+        ++mNextAcquire;
+        return &mSlots[slot];
+    }
+
+    //!
+    //! \brief Return batch to the ring. Batches must be released in the order they were acquired.
+    //!
+    void release(HostBatch* batch)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            assert(batch->index == mFirstBatch + static_cast<int>(mNbReleased));
+            mStates[slotOf(batch->index)] = kFREE;
+            ++mNbReleased;
+        }
+        mFree.notify_all();
+    }
+
+    //!
+    //! \brief Return batch to the ring once the work queued on stream so far, e.g. the copy of the batch to the
+    //!        device, has completed. Returns false if the callback could not be queued; the stream is then
+    //!        synchronized and the batch released right away.
+    //!
+    bool release(HostBatch* batch, cudaStream_t stream)
+    {
+        Callback* callback = &mCallbacks[slotOf(batch->index)];
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            ++mNbDeferred;
+        }
+        if (cudaLaunchHostFunc(stream, &InputPipeline::releaseCallback, callback) == cudaSuccess)
+        {
+            return true;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            --mNbDeferred;
+        }
+        cudaStreamSynchronize(stream);
+        release(batch);
+        return false;
+    }
+
+    //!
+    //! \brief Stop the workers. Batches that were not consumed are dropped.
+    //!
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mStop = true;
+        }
+        mFree.notify_all();
+        mReady.notify_all();
+        for (auto& worker : mWorkers)
+        {
+            worker.join();
+        }
+        mWorkers.clear();
+    }
+
+    bool isPinned() const
+    {
+        return mPinned;
+    }
+
+    int getNbSlots() const
+    {
+        return static_cast<int>(mSlots.size());
+    }
+
+    int getBatchSize() const
+    {
+        return mBatchSize;
+    }
+
+    size_t getBatchBytes() const
+    {
+        return mBatchSize * mSampleVolume * sizeof(float);
+    }
+
+    //!
+    //! \brief Number of acquire() calls that had to wait for a worker, i.e. that found input preparation to be the
+    //!        bottleneck.
+    //!
+    size_t getNbStalls() const
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mNbStalls;
+    }
+
+private:
+    enum SlotState
+    {
+        kFREE,
+        kFILLING,
+        kREADY,
+        kACQUIRED
+    };
+
+    struct Callback
+    {
+        InputPipeline* pipeline;
+        HostBatch* batch;
+    };
+
+    static void CUDART_CB releaseCallback(void* data)
+    {
+        Callback* callback = static_cast<Callback*>(data);
+        InputPipeline* pipeline = callback->pipeline;
+        pipeline->release(callback->batch);
+        // Notify under the lock: once it is released, a waiting destructor may free the pipeline.
+        std::lock_guard<std::mutex> lock(pipeline->mMutex);
+        --pipeline->mNbDeferred;
+        pipeline->mDeferred.notify_all();
+    }
+
+    //! Block until the callbacks of release(batch, stream) have run, so that none lands in a restarted ring.
+    void waitForDeferredReleases()
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mDeferred.wait(lock, [&] { return mNbDeferred == 0; });
+    }
+
+    size_t slotOf(int index) const
+    {
+        return static_cast<size_t>(index - mFirstBatch) % mSlots.size();
+    }
+
+    void work()
+    {
+        for (;;)
+        {
+            int index;
+            {
+                std::unique_lock<std::mutex> lock(mMutex);
+                // Backpressure: the slot of batch index is free once batch index - nbSlots has been released.
+                mFree.wait(lock, [&] {
+                    return mStop || mNextClaim >= mEndBatch
+                        || mNextClaim - mFirstBatch < static_cast<int>(mNbReleased + mSlots.size());
+                });
+                if (mStop || mNextClaim >= mEndBatch)
+                {
+                    return;
+                }
+                index = mNextClaim++;
+                mStates[slotOf(index)] = kFILLING;
+            }
+
+            HostBatch& batch = mSlots[slotOf(index)];
+            batch.index = index;
+            batch.size = 0;
+            const bool produced = mProducer(batch);
+
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                if (produced)
+                {
+                    mStates[slotOf(index)] = kREADY;
+                }
+                else
+                {
+                    mStates[slotOf(index)] = kFREE;
+                    mEndBatch = std::min(mEndBatch, index);
+                }
+            }
+            mReady.notify_all();
+            if (!produced)
+            {
+                mFree.notify_all();
+            }
+        }
+    }
+
+    int mBatchSize;
+    size_t mSampleVolume;
+    int mNbWorkers;
+    Producer mProducer;
+    bool mPinned{true};
+
+    mutable std::mutex mMutex; //!< Guards the state below
+    std::condition_variable mReady;
+    std::condition_variable mFree;
+    std::condition_variable mDeferred;
+    std::vector<HostBatch> mSlots;
+    std::vector<SlotState> mStates;
+    std::vector<Callback> mCallbacks;
+    std::vector<std::thread> mWorkers;
+    bool mStop{false};
+    int mFirstBatch{0};
+    int mEndBatch{0};
+    int mNextClaim{0};
+    int mNextAcquire{0};
+    size_t mNbReleased{0};
+    size_t mNbStalls{0};
+    size_t mNbDeferred{0}; //!< Releases queued on a stream that have not run yet
+};
+
+//!
+//! \brief Producer that reads an existing IBatchStream on the pipeline's workers. The stream is sequential, so
+//!        batches are read one at a time in order, but still off the thread that runs inference. The stream must
+//!        be positioned at firstBatch, the pipeline started once at firstBatch, and the stream must outlive it.
+//!
+inline InputPipeline::Producer makeBatchStreamProducer(IBatchStream& stream, int firstBatch = 0)
+{
+    struct State
+    {
+        std::mutex mutex;
+        std::condition_variable turn;
+        int next;
+    };
+    std::shared_ptr<State> state{new State};
+    state->next = firstBatch;
+    return [&stream, state](HostBatch& batch) {
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->turn.wait(lock, [&] { return state->next == batch.index; });
+        const bool read = stream.next();
+        if (read)
+        {
+            const size_t volume = samplesCommon::volume(stream.getDims()) / stream.getDims().d[0];
+            std::copy_n(stream.getBatch(), stream.getBatchSize() * volume, batch.data);
+            std::copy_n(stream.getLabels(), stream.getBatchSize(), batch.labels);
+            batch.size = stream.getBatchSize();
+        }
+        ++state->next;
+        state->turn.notify_all();
+        return read;
+    };
+}
+
+//!
+//! \brief IBatchStream view of an InputPipeline, for code such as calibrators that is written against
+//!        IBatchStream. Each next() releases the previous batch and takes the following one from the ring.
+//!
+//! \details Copies share the pipeline and the read position, so that a stream can be passed by value to a
+//!          calibrator and the calibrator goes on where the caller stopped. The last copy to be destroyed returns
+//!          the batch it holds to the ring, and the pipeline is destroyed with its last owner.
+//!
+class PipelinedBatchStream : public IBatchStream
+{
+public:
+    //! \param dims Dimensions of a batch, including the batch size.
+    PipelinedBatchStream(std::shared_ptr<InputPipeline> pipeline, int maxBatches, nvinfer1::Dims dims)
+        : mCursor(std::make_shared<Cursor>(std::move(pipeline)))
+        , mMaxBatches(maxBatches)
+        , mDims(dims)
+    {
+        reset(0);
+    }
+
+    void reset(int firstBatch) override
+    {
+        mCursor->current = nullptr;
+        mCursor->batchCount = 0;
+        mCursor->nextBatch = firstBatch;
+        mCursor->pipeline->start(firstBatch, mMaxBatches - firstBatch);
+    }
+
+    bool next() override
+    {
+        if (mCursor->current)
+        {
+            mCursor->pipeline->release(mCursor->current);
+        }
+        mCursor->current = mCursor->pipeline->acquire();
+        if (!mCursor->current)
+        {
+            return false;
+        }
+        ++mCursor->nextBatch;
+        ++mCursor->batchCount;
+        return true;
+    }
+
+    // Like BatchStream::skip, moves the position without counting the skipped batches as read.
+    void skip(int skipCount) override
+    {
+        const int batchCount = mCursor->batchCount;
+        reset(mCursor->nextBatch + skipCount);
+        mCursor->batchCount = batchCount;
+    }
+
+    float* getBatch() override
+    {
+        return mCursor->current ? mCursor->current->data : nullptr;
+    }
+
+    float* getLabels() override
+    {
+        return mCursor->current ? mCursor->current->labels : nullptr;
+    }
+
+    int getBatchesRead() const override
+    {
+        return mCursor->batchCount;
+    }
+
+    int getBatchSize() const override
+    {
+        return mCursor->pipeline->getBatchSize();
+    }
+
+    nvinfer1::Dims getDims() const override
+    {
+        return mDims;
+    }
+
+private:
+    //! The state the copies of a stream share.
+    struct Cursor
+    {
+        explicit Cursor(std::shared_ptr<InputPipeline> pipeline)
+            : pipeline(std::move(pipeline))
+        {
+        }
+
+        ~Cursor()
+        {
+            if (current)
+            {
+                pipeline->release(current);
+            }
+        }
+
+        std::shared_ptr<InputPipeline> pipeline;
+        HostBatch* current{nullptr};
+        int batchCount{0};
+        int nextBatch{0};
+    };
+
+    std::shared_ptr<Cursor> mCursor;
+    int mMaxBatches{0};
+    nvinfer1::Dims mDims;
+};
+
+} // namespace samplesCommon
+
+#endif // TENSORRT_INPUT_PIPELINE_H
@@ -0,0 +1,473 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef TENSORRT_LOAD_GENERATOR_H
+#define TENSORRT_LOAD_GENERATOR_H
+
+#include "logger.h"
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+//!
+//! \file LoadGenerator.h
+//!
+//! \brief Open-loop load: requests arrive on a schedule of their own, queue, and are batched for an executor.
+//!
+//! \details The runners time batches back to back, which says how fast a batch is but not how long a request waits
+//!          under load. generateArrivals() draws arrival times from Poisson, bursty, step or recorded load, which
+//!          parseArrivalConfig() reads from the options of load_test or of the "load" section of a run_engine config.
+//!          runOpenLoop() releases the requests at those times into a queue, closes a batch when it is full or its
+//!          oldest request has waited for the batching window, and runs batches on one or more IBatchExecutor. Latency
+//!          is counted from the scheduled arrival to the end of the batch, so a slow executor cannot hide queueing by
+//!          delaying arrivals. MockExecutor stands in for the GPU with a linear batch cost; the run_engine profiler
+//!          drives its staged engines through MultiStageExecutor when its config has a "load" section.
+//!
+
+namespace samplesCommon
+{
+
+enum class ArrivalPattern
+{
+    kPOISSON, //!< Exponential gaps at a constant rate.
+    kBURSTY,  //!< Poisson at rate, with bursts at burstRate of exponentially distributed length.
+    kSTEP,    //!< Poisson at a rate that changes at the given times.
+    kTRACE,   //!< Recorded arrival times.
+};
+
+//! From start on, requests arrive at rate per second.
+struct LoadStep
+{
+    double start;
+    double rate;
+};
+
+struct ArrivalConfig
+{
+    ArrivalPattern pattern{ArrivalPattern::kPOISSON};
+    double rate{100.0};            //!< Requests per second, between bursts for kBURSTY.
+    double burstRate{1000.0};      //!< kBURSTY: requests per second during a burst.
+    double meanBurstSeconds{0.05}; //!< kBURSTY: mean length of a burst.
+    double meanIdleSeconds{0.5};   //!< kBURSTY: mean time between bursts.
+    std::vector<LoadStep> steps;   //!< kSTEP: ordered by start; the first rate holds until the first start.
+    std::vector<double> trace;     //!< kTRACE: arrival times in seconds, ascending.
+    uint32_t seed{1};
+};
+
+namespace load
+{
+
+//! Appends Poisson arrivals at rate in [begin, end) and returns end.
+inline double appendPoisson(std::mt19937_64& generator, double rate, double begin, double end, std::vector<double>& out)
+{
+    if (rate <= 0.0)
+    {
+        return end;
+    }
+    std::exponential_distribution<double> gap(rate);
+    // Arrivals are memoryless, so a segment can start afresh at its beginning.
+    for (double t = begin + gap(generator); t < end; t += gap(generator))
+    {
+        out.push_back(t);
+    }
+    return end;
+}
+
+} // namespace load
+
+//!
+//! \brief Arrival times in [0, duration) seconds, ascending. The same config and seed give the same arrivals.
+//!
+inline std::vector<double> generateArrivals(const ArrivalConfig& config, double duration)
+{
+    std::vector<double> arrivals;
+    std::mt19937_64 generator(config.seed);
+    switch (config.pattern)
+    {
+    case ArrivalPattern::kPOISSON: load::appendPoisson(generator, config.rate, 0.0, duration, arrivals); break;
+    case ArrivalPattern::kBURSTY:
+    {
+        std::exponential_distribution<double> idle(1.0 / config.meanIdleSeconds);
+        std::exponential_distribution<double> burst(1.0 / config.meanBurstSeconds);
+        for (double t = 0.0; t < duration;)
+        {
+            t = load::appendPoisson(generator, config.rate, t, std::min(duration, t + idle(generator)), arrivals);
+            t = load::appendPoisson(generator, config.burstRate, t, std::min(duration, t + burst(generator)), arrivals);
+        }
+        break;
+    }
+    case ArrivalPattern::kSTEP:
+    {
+        double t = 0.0;
+        double rate = config.steps.empty() ? config.rate : config.steps.front().rate;
+        for (const LoadStep& step : config.steps)
+        {
+            t = load::appendPoisson(generator, rate, t, std::min(duration, std::max(t, step.start)), arrivals);
+            rate = step.rate;
+        }
+        load::appendPoisson(generator, rate, t, duration, arrivals);
+        break;
+    }
+    case ArrivalPattern::kTRACE:
+        std::copy_if(config.trace.begin(), config.trace.end(), std::back_inserter(arrivals),
+            [duration](double t) { return t >= 0.0 && t < duration; });
+        break;
+    }
+    return arrivals;
+}
+
+//!
+//! \brief Read recorded arrival times, one per line in seconds, '#' starting a comment. Times are shifted so that
+//!        the first arrival is at 0. Returns false, logging why, if the file cannot be read or is not ascending.
+//!
+inline bool readArrivalTrace(const std::string& path, std::vector<double>& arrivals)
+{
+    arrivals.clear();
+    std::ifstream in(path);
+    if (!in)
+    {
+        sample::gLogError << "Could not open arrival trace " << path << std::endl;
+        return false;
+    }
+    std::string line;
+    for (int lineNumber = 1; std::getline(in, line); ++lineNumber)
+    {
+        std::istringstream fields(line.substr(0, line.find('#')));
+        double t;
+        if (!(fields >> t))
+        {
+            continue;
+        }
+        if (!arrivals.empty() && t < arrivals.back())
+        {
+            sample::gLogError << path << ":" << lineNumber << ": arrival times must be ascending" << std::endl;
+            arrivals.clear();
+            return false;
+        }
+        arrivals.push_back(t);
+    }
+    if (!arrivals.empty())
+    {
+        const double first = arrivals.front();
+        for (double& t : arrivals)
+        {
+            t -= first;
+        }
+    }
+    return true;
+}
+
+//!
+//! \brief Parse load steps written as "<start s>:<rate>,...", e.g. "0:100,5:400". Returns false, logging why, if a
+//!        step has no colon, the starts are not ascending, or there is no step.
+//!
+inline bool parseLoadSteps(const std::string& text, std::vector<LoadStep>& steps)
+{
+    steps.clear();
+    std::istringstream in(text);
+    std::string step;
+    while (std::getline(in, step, ','))
+    {
+        const size_t colon = step.find(':');
+        if (colon == std::string::npos)
+        {
+            sample::gLogError << "Load step " << step << " is not <start s>:<rate>" << std::endl;
+            steps.clear();
+            return false;
+        }
+        steps.push_back({std::atof(step.substr(0, colon).c_str()), std::atof(step.substr(colon + 1).c_str())});
+        if (steps.size() > 1 && steps.back().start < steps[steps.size() - 2].start)
+        {
+            sample::gLogError << "Load steps must start in ascending order" << std::endl;
+            steps.clear();
+            return false;
+        }
+    }
+    if (steps.empty())
+    {
+        sample::gLogError << "A step load needs steps, <start s>:<rate>,..." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+//!
+//! \brief Fill config from options named like the flags of load_test: pattern (poisson, bursty, step or trace), rate,
+//!        burst_rate, burst_ms, idle_ms, steps, trace and seed. Options that are missing keep their value in config.
+//!        Returns false, logging why, for an unknown pattern, malformed steps or an unreadable trace.
+//!
+inline bool parseArrivalConfig(const std::map<std::string, std::string>& options, ArrivalConfig& config)
+{
+    const auto option = [&options](const std::string& key) {
+        const auto it = options.find(key);
+        return it == options.end() ? nullptr : &it->second;
+    };
+    const auto number = [&option](const std::string& key, double fallback) {
+        const std::string* value = option(key);
+        return value && !value->empty() ? std::atof(value->c_str()) : fallback;
+    };
+    config.rate = number("rate", config.rate);
+    config.burstRate = number("burst_rate", config.burstRate);
+    config.meanBurstSeconds = number("burst_ms", config.meanBurstSeconds * 1000.0) / 1000.0;
+    config.meanIdleSeconds = number("idle_ms", config.meanIdleSeconds * 1000.0) / 1000.0;
+    config.seed = static_cast<uint32_t>(number("seed", config.seed));
+
+    const std::string* pattern = option("pattern");
+    if (!pattern)
+    {
+        return true;
+    }
+    if (*pattern == "poisson")
+    {
+        config.pattern = ArrivalPattern::kPOISSON;
+    }
+    else if (*pattern == "bursty")
+    {
+        config.pattern = ArrivalPattern::kBURSTY;
+    }
+    else if (*pattern == "step")
+    {
+        config.pattern = ArrivalPattern::kSTEP;
+        const std::string* steps = option("steps");
+        return parseLoadSteps(steps ? *steps : std::string(), config.steps);
+    }
+    else if (*pattern == "trace")
+    {
+        config.pattern = ArrivalPattern::kTRACE;
+        const std::string* trace = option("trace");
+        if (!trace || trace->empty())
+        {
+            sample::gLogError << "A trace load needs a trace file" << std::endl;
+            return false;
+        }
+        return readArrivalTrace(*trace, config.trace);
+    }
+    else
+    {
+        sample::gLogError << "Unknown load pattern " << *pattern << std::endl;
+        return false;
+    }
+    return true;
+}
+
+//!
+//! \brief What the load harness drives: anything that runs a batch of requests, such as a stage runner.
+//!
+class IBatchExecutor
+{
+public:
+    virtual ~IBatchExecutor() = default;
+
+    //! Run a batch of batchSize requests, returning once its results are available.
+    virtual void execute(int batchSize) = 0;
+};
+
+//!
+//! \brief Executor on the CPU that takes baseMs + perSampleMs * batchSize per batch, to exercise the harness and to
+//!        extrapolate measured batch latencies to a load.
+//!
+class MockExecutor : public IBatchExecutor
+{
+public:
+    MockExecutor(double baseMs, double perSampleMs)
+        : mBaseMs(baseMs)
+        , mPerSampleMs(perSampleMs)
+    {
+    }
+
+    void execute(int batchSize) override
+    {
+        std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(mBaseMs + mPerSampleMs * batchSize));
+        ++mNbBatches;
+    }
+
+    size_t getNbBatches() const
+    {
+        return mNbBatches;
+    }
+
+private:
+    double mBaseMs;
+    double mPerSampleMs;
+    size_t mNbBatches{0};
+};
+
+//!
+//! \brief When the harness closes a batch: once it holds maxBatchSize requests, or once its oldest request has waited
+//!        windowMs, whichever comes first. An executor that is still busy delays both.
+//!
+struct BatchingPolicy
+{
+    int maxBatchSize{32};
+    double windowMs{2.0};
+};
+
+struct LoadReport
+{
+    size_t nbRequests{0};
+    size_t nbBatches{0};
+    double seconds{0.0};    //!< From the start of the schedule to the last result.
+    double throughput{0.0}; //!< Requests per second.
+    double meanBatchSize{0.0};
+    double meanQueueMs{0.0}; //!< Arrival to start of batch.
+    double meanLatencyMs{0.0};
+    double p50Ms{0.0};
+    double p90Ms{0.0};
+    double p99Ms{0.0};
+    double p999Ms{0.0};
+    double maxMs{0.0};
+
+    void print(std::ostream& os) const
+    {
+        os << std::fixed << std::setprecision(3) << nbRequests << " requests in " << nbBatches << " batches (mean "
+           << meanBatchSize << ") over " << seconds << " s, " << throughput << " req/s" << std::endl;
+        os << "Latency ms: mean " << meanLatencyMs << ", p50 " << p50Ms << ", p90 " << p90Ms << ", p99 " << p99Ms
+           << ", p99.9 " << p999Ms << ", max " << maxMs << "; queueing mean " << meanQueueMs << std::endl;
+    }
+};
+
+//!
+//! \brief Nearest-rank percentile q in [0, 1] of ascending values.
+//!
+inline double getPercentile(const std::vector<double>& sorted, double q)
+{
+    if (sorted.empty())
+    {
+        return 0.0;
+    }
+    const size_t rank = static_cast<size_t>(std::ceil(q * sorted.size()));
+    return sorted[std::min(sorted.size(), std::max<size_t>(rank, 1)) - 1];
+}
+
+//!
+//! \brief Release requests at arrivals (seconds from now, ascending), batch them by policy, run the batches on the
+//!        executors, one thread each, and report the latencies. Blocks until every request has completed.
+//!
+inline LoadReport runOpenLoop(
+    const std::vector<double>& arrivals, const std::vector<IBatchExecutor*>& executors, const BatchingPolicy& policy)
+{
+    assert(!executors.empty() && policy.maxBatchSize > 0);
+    using Clock = std::chrono::steady_clock;
+    const Clock::time_point start = Clock::now();
+    const auto at = [start](double seconds) {
+        return start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+    };
+    const auto since = [start](Clock::time_point t) { return std::chrono::duration<double>(t - start).count(); };
+
+    std::mutex mutex;
+    std::condition_variable arrived;
+    std::deque<size_t> queue;
+    bool allArrived = false;
+    std::vector<double> dispatched(arrivals.size());
+    std::vector<double> completed(arrivals.size());
+    size_t nbBatches = 0;
+
+    std::vector<std::thread> workers;
+    for (IBatchExecutor* executor : executors)
+    {
+        workers.emplace_back([&, executor]() {
+            std::vector<size_t> batch;
+            while (true)
+            {
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    arrived.wait(lock, [&]() { return !queue.empty() || allArrived; });
+                    if (queue.empty())
+                    {
+                        return;
+                    }
+                    const Clock::time_point deadline
+                        = at(arrivals[queue.front()] + policy.windowMs / 1000.0);
+                    arrived.wait_until(
+                        lock, deadline, [&]() { return static_cast<int>(queue.size()) >= policy.maxBatchSize; });
+                    // Another worker may have taken the requests while this one waited.
+                    if (queue.empty())
+                    {
+                        continue;
+                    }
+                    const size_t size = std::min<size_t>(queue.size(), policy.maxBatchSize);
+                    batch.assign(queue.begin(), queue.begin() + size);
+                    queue.erase(queue.begin(), queue.begin() + size);
+                    ++nbBatches;
+                }
+                const double begin = since(Clock::now());
+                executor->execute(static_cast<int>(batch.size()));
+                const double end = since(Clock::now());
+                for (size_t request : batch)
+                {
+                    dispatched[request] = begin;
+                    completed[request] = end;
+                }
+            }
+        });
+    }
+
+    for (size_t i = 0; i < arrivals.size(); ++i)
+    {
+        std::this_thread::sleep_until(at(arrivals[i]));
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queue.push_back(i);
+        }
+        arrived.notify_all();
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        allArrived = true;
+    }
+    arrived.notify_all();
+    for (auto& worker : workers)
+    {
+        worker.join();
+    }
+
+    LoadReport report;
+    report.nbRequests = arrivals.size();
+    report.nbBatches = nbBatches;
+    if (arrivals.empty())
+    {
+        return report;
+    }
+    std::vector<double> latencies(arrivals.size());
+    double queueing = 0.0;
+    for (size_t i = 0; i < arrivals.size(); ++i)
+    {
+        latencies[i] = (completed[i] - arrivals[i]) * 1000.0;
+        queueing += (dispatched[i] - arrivals[i]) * 1000.0;
+    }
+    report.seconds = *std::max_element(completed.begin(), completed.end());
+    report.throughput = report.nbRequests / report.seconds;
+    report.meanBatchSize = static_cast<double>(report.nbRequests) / report.nbBatches;
+    report.meanQueueMs = queueing / report.nbRequests;
+    std::sort(latencies.begin(), latencies.end());
+    for (double latency : latencies)
+    {
+        report.meanLatencyMs += latency / report.nbRequests;
+    }
+    report.p50Ms = getPercentile(latencies, 0.5);
+    report.p90Ms = getPercentile(latencies, 0.9);
+    report.p99Ms = getPercentile(latencies, 0.99);
+    report.p999Ms = getPercentile(latencies, 0.999);
+    report.maxMs = latencies.back();
+    return report;
+}
+
+} // namespace samplesCommon
+
+#endif // TENSORRT_LOAD_GENERATOR_H
@@ -0,0 +1,501 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef TENSORRT_MAPPED_DATASET_H
+#define TENSORRT_MAPPED_DATASET_H
+
+#include "ImagePreprocess.h"
+#include "logger.h"
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace samplesCommon
+{
+
+//!
+//! \brief Layout of the fixed-size records of a dataset file: labelBytes label bytes followed by the pixels.
+//!
+struct DatasetFormat
+{
+    int labelBytes{0};
+    int channels{0};
+    int height{0};
+    int width{0};
+    PixelLayout layout{PixelLayout::kCHW};
+
+    size_t pixelBytes() const
+    {
+        return static_cast<size_t>(channels) * height * width;
+    }
+
+    size_t recordBytes() const
+    {
+        return labelBytes + pixelBytes();
+    }
+
+    bool operator==(const DatasetFormat& other) const
+    {
+        return labelBytes == other.labelBytes && channels == other.channels && height == other.height
+            && width == other.width && layout == other.layout;
+    }
+
+    bool operator!=(const DatasetFormat& other) const
+    {
+        return !(*this == other);
+    }
+
+    //! data_batch_*.bin and test_batch.bin of CIFAR-10: a label byte and 3x32x32 planar pixels.
+    static DatasetFormat cifar10()
+    {
+        return DatasetFormat{1, 3, 32, 32, PixelLayout::kCHW};
+    }
+
+    //! train.bin and test.bin of CIFAR-100: coarse and fine label bytes and 3x32x32 planar pixels.
+    static DatasetFormat cifar100()
+    {
+        return DatasetFormat{2, 3, 32, 32, PixelLayout::kCHW};
+    }
+};
+
+//!
+//! \brief Optional header of a dataset file, for files whose record layout is not known in advance, such as
+//!        ImageNet crops packed at a fixed resolution. All fields are little-endian; records follow the header.
+//!
+struct DatasetHeader
+{
+    static constexpr size_t kMAGIC_SIZE = 8;
+
+    static const char* getMagic()
+    {
+        return "TRTREC01";
+    }
+
+    char magic[kMAGIC_SIZE];
+    uint32_t labelBytes;
+    uint32_t layout; //!< 0 for HWC, 1 for CHW.
+    uint32_t channels;
+    uint32_t height;
+    uint32_t width;
+    uint32_t reserved;
+    uint64_t count;
+
+    static DatasetHeader make(const DatasetFormat& format, uint64_t count)
+    {
+        DatasetHeader header{};
+        std::memcpy(header.magic, getMagic(), kMAGIC_SIZE);
+        header.labelBytes = format.labelBytes;
+        header.layout = format.layout == PixelLayout::kHWC ? 0 : 1;
+        header.channels = format.channels;
+        header.height = format.height;
+        header.width = format.width;
+        header.count = count;
+        return header;
+    }
+
+    DatasetFormat format() const
+    {
+        return DatasetFormat{static_cast<int>(labelBytes), static_cast<int>(channels), static_cast<int>(height),
+            static_cast<int>(width), layout == 0 ? PixelLayout::kHWC : PixelLayout::kCHW};
+    }
+};
+static_assert(sizeof(DatasetHeader) == 40, "DatasetHeader is a file format");
+
+//!
+//! \brief A record viewed in place in the mapping of its file.
+//!
+struct RecordView
+{
+    const uint8_t* labels{nullptr}; //!< labelBytes label bytes.
+    const uint8_t* pixels{nullptr}; //!< The image, in the layout of the dataset format.
+
+    //! The last label byte, e.g. the class of CIFAR-10 or the fine label of CIFAR-100.
+    int label(const DatasetFormat& format) const
+    {
+        return format.labelBytes > 0 ? labels[format.labelBytes - 1] : -1;
+    }
+};
+
+enum class AccessPattern
+{
+    kSEQUENTIAL,
+    kRANDOM
+};
+
+//!
+//! \brief A whole file mapped read-only.
+//!
+class MappedFile
+{
+public:
+    MappedFile() = default;
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    MappedFile(MappedFile&& other) noexcept
+    {
+        *this = std::move(other);
+    }
+
+    MappedFile& operator=(MappedFile&& other) noexcept
+    {
+        if (this != &other)
+        {
+            close();
+            std::swap(mData, other.mData);
+            std::swap(mSize, other.mSize);
+        }
+        return *this;
+    }
+
+    ~MappedFile()
+    {
+        close();
+    }
+
+    //!
+    //! \brief Map path. Returns false, logging why, if it cannot be opened or mapped, or is empty.
+    //!
+    bool open(const std::string& path)
+    {
+        close();
+        const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) != 0)
+        {
+            sample::gLogError << "Could not open " << path << ": " << std::strerror(errno) << std::endl;
+            if (fd >= 0)
+            {
+                ::close(fd);
+            }
+            return false;
+        }
+        const size_t size = static_cast<size_t>(st.st_size);
+        void* data = size > 0 ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+        const int mapError = errno;
+        ::close(fd);
+        if (data == MAP_FAILED)
+        {
+            sample::gLogError << "Could not map " << path << ": " << (size > 0 ? std::strerror(mapError) : "empty file")
+                              << std::endl;
+            return false;
+        }
+        mData = static_cast<uint8_t*>(data);
+        mSize = size;
+        return true;
+    }
+
+    void close()
+    {
+        if (mData)
+        {
+            munmap(mData, mSize);
+        }
+        mData = nullptr;
+        mSize = 0;
+    }
+
+    const uint8_t* data() const
+    {
+        return mData;
+    }
+
+    size_t size() const
+    {
+        return mSize;
+    }
+
+    //!
+    //! \brief Tell the kernel how the file will be read: read-ahead helps scans and wastes I/O on shuffled reads.
+    //!
+    void advise(AccessPattern pattern) const
+    {
+        if (mData)
+        {
+            madvise(mData, mSize, pattern == AccessPattern::kRANDOM ? MADV_RANDOM : MADV_SEQUENTIAL);
+        }
+    }
+
+    //!
+    //! \brief Start reading bytes [begin, end) in the background.
+    //!
+    void prefetch(size_t begin, size_t end) const
+    {
+        end = std::min(end, mSize);
+        if (begin >= end)
+        {
+            return;
+        }
+        const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        const size_t alignedBegin = begin / pageSize * pageSize;
+        madvise(mData + alignedBegin, end - alignedBegin, MADV_WILLNEED);
+    }
+
+private:
+    uint8_t* mData{nullptr};
+    size_t mSize{0};
+};
+
+class MappedDataset;
+
+//!
+//! \brief A contiguous range of the records of a MappedDataset, e.g. the part one worker or process evaluates.
+//!
+class DatasetShard
+{
+public:
+    DatasetShard(const MappedDataset& dataset, size_t begin, size_t end)
+        : mDataset(&dataset)
+        , mBegin(begin)
+        , mEnd(end)
+    {
+    }
+
+    size_t begin() const
+    {
+        return mBegin;
+    }
+
+    size_t end() const
+    {
+        return mEnd;
+    }
+
+    size_t size() const
+    {
+        return mEnd - mBegin;
+    }
+
+    //! The i-th record of the shard.
+    RecordView record(size_t i) const;
+
+private:
+    const MappedDataset* mDataset;
+    size_t mBegin;
+    size_t mEnd;
+};
+
+//!
+//! \brief Read-only memory mappings of one or more files of fixed-size records, indexed as one dataset.
+//!
+//! \details Records are read where the page cache holds them: opening costs no copy whatever the size of the files,
+//!          and the pages are shared with every other process evaluating the same files. The record layout comes
+//!          from the DatasetHeader of each file, or from the format given to open() for files without one, e.g. the
+//!          CIFAR binaries; either way all files must agree on it.
+//!
+class MappedDataset
+{
+public:
+    MappedDataset() = default;
+
+    MappedDataset(const MappedDataset&) = delete;
+    MappedDataset& operator=(const MappedDataset&) = delete;
+
+    MappedDataset(MappedDataset&& other) noexcept
+    {
+        *this = std::move(other);
+    }
+
+    MappedDataset& operator=(MappedDataset&& other) noexcept
+    {
+        if (this != &other)
+        {
+            close();
+            std::swap(mFiles, other.mFiles);
+            std::swap(mFormat, other.mFormat);
+            std::swap(mSize, other.mSize);
+        }
+        return *this;
+    }
+
+    //!
+    //! \brief Map files, in order, as one dataset. Files without a header use format; pass a default DatasetFormat
+    //!        to require headers. Returns false, logging why and leaving the dataset empty, on failure.
+    //!
+    bool open(const std::vector<std::string>& files, const DatasetFormat& format = DatasetFormat{})
+    {
+        close();
+        for (const auto& path : files)
+        {
+            if (!mapFile(path, format))
+            {
+                close();
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void close()
+    {
+        mFiles.clear();
+        mFormat = DatasetFormat{};
+        mSize = 0;
+    }
+
+    //! Number of records in all files.
+    size_t size() const
+    {
+        return mSize;
+    }
+
+    size_t getNbFiles() const
+    {
+        return mFiles.size();
+    }
+
+    const DatasetFormat& getFormat() const
+    {
+        return mFormat;
+    }
+
+    //! The record at global index, counting through the files in the order they were opened.
+    RecordView record(size_t index) const
+    {
+        assert(index < mSize);
+        // The first file whose records end after index.
+        const auto file = std::upper_bound(mFiles.begin(), mFiles.end(), index,
+            [](size_t i, const File& f) { return i < f.firstRecord + f.count; });
+        const uint8_t* base = file->records + (index - file->firstRecord) * mFormat.recordBytes();
+        return RecordView{base, base + mFormat.labelBytes};
+    }
+
+    int label(size_t index) const
+    {
+        return record(index).label(mFormat);
+    }
+
+    //!
+    //! \brief Shard shardIndex of nbShards near-equal contiguous shards.
+    //!
+    DatasetShard shard(int shardIndex, int nbShards) const
+    {
+        assert(nbShards > 0 && shardIndex >= 0 && shardIndex < nbShards);
+        return DatasetShard(*this, mSize * shardIndex / nbShards, mSize * (shardIndex + 1) / nbShards);
+    }
+
+    //!
+    //! \brief Tell the kernel how the records will be read: read-ahead helps scans and wastes I/O on shuffled reads.
+    //!
+    void advise(AccessPattern pattern) const
+    {
+        for (const auto& file : mFiles)
+        {
+            file.mapping.advise(pattern);
+        }
+    }
+
+    //!
+    //! \brief Start reading records [begin, end) in the background, e.g. the next shard or batch.
+    //!
+    void prefetch(size_t begin, size_t end) const
+    {
+        for (const auto& file : mFiles)
+        {
+            const size_t first = std::max(begin, file.firstRecord);
+            const size_t last = std::min(end, file.firstRecord + file.count);
+            if (first >= last)
+            {
+                continue;
+            }
+            const size_t from = file.records - file.mapping.data() + (first - file.firstRecord) * mFormat.recordBytes();
+            file.mapping.prefetch(from, from + (last - first) * mFormat.recordBytes());
+        }
+    }
+
+private:
+    struct File
+    {
+        MappedFile mapping;
+        const uint8_t* records;
+        size_t firstRecord;
+        size_t count;
+    };
+
+    bool mapFile(const std::string& path, const DatasetFormat& fallback)
+    {
+        MappedFile mapping;
+        if (!mapping.open(path))
+        {
+            return false;
+        }
+        const size_t fileBytes = mapping.size();
+        mFiles.push_back(File{std::move(mapping), nullptr, mSize, 0});
+        File& file = mFiles.back();
+
+        DatasetFormat format = fallback;
+        size_t headerBytes = 0;
+        size_t count = 0;
+        DatasetHeader header;
+        const bool hasHeader = fileBytes >= sizeof(header)
+            && std::memcmp(file.mapping.data(), DatasetHeader::getMagic(), DatasetHeader::kMAGIC_SIZE) == 0;
+        if (hasHeader)
+        {
+            std::memcpy(&header, file.mapping.data(), sizeof(header));
+            format = header.format();
+            headerBytes = sizeof(header);
+            count = header.count;
+        }
+        if (format.recordBytes() == 0 || format.channels <= 0 || format.height <= 0 || format.width <= 0)
+        {
+            sample::gLogError << "Dataset file " << path << " has no header and no record format was given"
+                              << std::endl;
+            return false;
+        }
+        if (mFiles.size() == 1)
+        {
+            mFormat = format;
+        }
+        else if (format != mFormat)
+        {
+            sample::gLogError << "Dataset file " << path << " has a different record format than the files before it"
+                              << std::endl;
+            return false;
+        }
+        const size_t recordBytes = format.recordBytes();
+        const size_t dataBytes = fileBytes - headerBytes;
+        if (!hasHeader)
+        {
+            if (dataBytes % recordBytes != 0)
+            {
+                sample::gLogError << "Dataset file " << path << " is " << fileBytes << " bytes, not a whole number of "
+                                  << recordBytes << "-byte records" << std::endl;
+                return false;
+            }
+            count = dataBytes / recordBytes;
+        }
+        else if (count > dataBytes / recordBytes)
+        {
+            sample::gLogError << "Dataset file " << path << " is truncated: its header counts " << count
+                              << " records" << std::endl;
+            return false;
+        }
+        file.records = file.mapping.data() + headerBytes;
+        file.count = count;
+        mSize += count;
+        return true;
+    }
+
+    std::vector<File> mFiles;
+    DatasetFormat mFormat;
+    size_t mSize{0};
+};
+
+inline RecordView DatasetShard::record(size_t i) const
+{
+    assert(i < size());
+    return mDataset->record(mBegin + i);
+}
+
+} // namespace samplesCommon
+
+#endif // TENSORRT_MAPPED_DATASET_H
@@ -0,0 +1,420 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef TENSORRT_PACKED_SEQUENCES_H
+#define TENSORRT_PACKED_SEQUENCES_H
+
+#include "InputPipeline.h"
+#include "MappedDataset.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+//!
+//! \file PackedSequences.h
+//!
+//! \brief Tokenized BERT inputs packed without padding, and the loader that pads them into batches.
+//!
+//! \details A packed sequence file holds, after a PackedSequenceHeader, an index of count SequenceIndexEntry and three
+//!          int32 token arrays: input ids, segment ids and input mask. Sequence i is the length tokens at
+//!          index[i].offset of each array. Sections start at multiples of kSECTION_ALIGNMENT bytes and all integers
+//!          are little-endian. demo/BERT/pack_sequences.py writes such files from SQuAD or pre-tokenized GLUE data.
+//!
+//!          The loader maps the file, groups the sequences into batches of similar length (SequenceBatchPlan), and
+//!          pads each batch only to its bucket length, straight into the pinned slots of an InputPipeline.
+//!
+
+namespace samplesCommon
+{
+
+struct PackedSequenceHeader
+{
+    static constexpr size_t kMAGIC_SIZE = 8;
+    static constexpr uint64_t kSECTION_ALIGNMENT = 64;
+
+    static const char* getMagic()
+    {
+        return "TRTSEQ01";
+    }
+
+    char magic[kMAGIC_SIZE];
+    uint32_t maxLength; //!< Length of the longest sequence.
+    uint32_t reserved;
+    uint64_t count;
+    uint64_t totalTokens;
+    uint64_t indexOffset; //!< Byte offsets of the sections from the start of the file.
+    uint64_t idsOffset;
+    uint64_t segmentsOffset;
+    uint64_t maskOffset;
+};
+static_assert(sizeof(PackedSequenceHeader) == 64, "PackedSequenceHeader is a file format");
+
+struct SequenceIndexEntry
+{
+    uint64_t offset; //!< First token of the sequence, in tokens.
+    uint32_t length;
+    int32_t label; //!< Class of the sample, or -1.
+};
+static_assert(sizeof(SequenceIndexEntry) == 16, "SequenceIndexEntry is a file format");
+
+//!
+//! \brief A sequence viewed in place in the mapping of its file.
+//!
+struct SequenceView
+{
+    const int32_t* ids{nullptr};
+    const int32_t* segments{nullptr};
+    const int32_t* mask{nullptr};
+    int length{0};
+    int label{-1};
+};
+
+//!
+//! \brief Builds a packed sequence file in memory, e.g. in tools and tests.
+//!
+class PackedSequenceWriter
+{
+public:
+    void add(const int32_t* ids, const int32_t* segments, const int32_t* mask, int length, int label = -1)
+    {
+        mIndex.push_back(SequenceIndexEntry{mIds.size(), static_cast<uint32_t>(length), label});
+        mIds.insert(mIds.end(), ids, ids + length);
+        mSegments.insert(mSegments.end(), segments, segments + length);
+        mMask.insert(mMask.end(), mask, mask + length);
+        mMaxLength = std::max(mMaxLength, length);
+    }
+
+    //!
+    //! \brief Write the file. Returns false, logging why, if it cannot be written.
+    //!
+    bool write(const std::string& path) const
+    {
+        const uint64_t alignment = PackedSequenceHeader::kSECTION_ALIGNMENT;
+        auto align = [alignment](uint64_t offset) { return (offset + alignment - 1) / alignment * alignment; };
+        PackedSequenceHeader header{};
+        std::memcpy(header.magic, PackedSequenceHeader::getMagic(), PackedSequenceHeader::kMAGIC_SIZE);
+        header.maxLength = mMaxLength;
+        header.count = mIndex.size();
+        header.totalTokens = mIds.size();
+        header.indexOffset = align(sizeof(header));
+        header.idsOffset = align(header.indexOffset + mIndex.size() * sizeof(SequenceIndexEntry));
+        header.segmentsOffset = align(header.idsOffset + mIds.size() * sizeof(int32_t));
+        header.maskOffset = align(header.segmentsOffset + mSegments.size() * sizeof(int32_t));
+
+        std::ofstream out(path, std::ios::binary);
+        auto section = [&out](uint64_t offset, const void* data, size_t size) {
+            const std::vector<char> padding(offset - static_cast<uint64_t>(out.tellp()), 0);
+            out.write(padding.data(), padding.size());
+            out.write(static_cast<const char*>(data), size);
+        };
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        section(header.indexOffset, mIndex.data(), mIndex.size() * sizeof(SequenceIndexEntry));
+        section(header.idsOffset, mIds.data(), mIds.size() * sizeof(int32_t));
+        section(header.segmentsOffset, mSegments.data(), mSegments.size() * sizeof(int32_t));
+        section(header.maskOffset, mMask.data(), mMask.size() * sizeof(int32_t));
+        if (!out)
+        {
+            sample::gLogError << "Could not write packed sequences to " << path << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+private:
+    std::vector<SequenceIndexEntry> mIndex;
+    std::vector<int32_t> mIds;
+    std::vector<int32_t> mSegments;
+    std::vector<int32_t> mMask;
+    int mMaxLength{0};
+};
+
+//!
+//! \brief A packed sequence file mapped read-only.
+//!
+class PackedSequenceFile
+{
+public:
+    //!
+    //! \brief Map and validate path. Returns false, logging why, on failure.
+    //!
+    bool open(const std::string& path)
+    {
+        mIndex = nullptr;
+        mCount = 0;
+        if (!mFile.open(path))
+        {
+            return false;
+        }
+        const uint8_t* data = mFile.data();
+        const uint64_t size = mFile.size();
+        if (size < sizeof(mHeader)
+            || std::memcmp(data, PackedSequenceHeader::getMagic(), PackedSequenceHeader::kMAGIC_SIZE) != 0)
+        {
+            sample::gLogError << path << " is not a packed sequence file" << std::endl;
+            mFile.close();
+            return false;
+        }
+        std::memcpy(&mHeader, data, sizeof(mHeader));
+        auto fits = [size](uint64_t offset, uint64_t count, uint64_t elementSize) {
+            return offset % sizeof(int32_t) == 0 && offset <= size && count <= (size - offset) / elementSize;
+        };
+        if (!fits(mHeader.indexOffset, mHeader.count, sizeof(SequenceIndexEntry))
+            || !fits(mHeader.idsOffset, mHeader.totalTokens, sizeof(int32_t))
+            || !fits(mHeader.segmentsOffset, mHeader.totalTokens, sizeof(int32_t))
+            || !fits(mHeader.maskOffset, mHeader.totalTokens, sizeof(int32_t)))
+        {
+            sample::gLogError << "Packed sequence file " << path << " is truncated" << std::endl;
+            mFile.close();
+            return false;
+        }
+        const auto* index = reinterpret_cast<const SequenceIndexEntry*>(data + mHeader.indexOffset);
+        for (uint64_t i = 0; i < mHeader.count; ++i)
+        {
+            if (index[i].length > mHeader.maxLength || index[i].offset > mHeader.totalTokens
+                || index[i].length > mHeader.totalTokens - index[i].offset)
+            {
+                sample::gLogError << "Sequence " << i << " of " << path << " is out of bounds" << std::endl;
+                mFile.close();
+                return false;
+            }
+        }
+        mIndex = index;
+        mCount = mHeader.count;
+        return true;
+    }
+
+    size_t size() const
+    {
+        return mCount;
+    }
+
+    int getMaxLength() const
+    {
+        return static_cast<int>(mHeader.maxLength);
+    }
+
+    int getLength(size_t i) const
+    {
+        assert(i < mCount);
+        return static_cast<int>(mIndex[i].length);
+    }
+
+    SequenceView sequence(size_t i) const
+    {
+        assert(i < mCount);
+        const SequenceIndexEntry& entry = mIndex[i];
+        const uint8_t* data = mFile.data();
+        SequenceView view;
+        view.ids = reinterpret_cast<const int32_t*>(data + mHeader.idsOffset) + entry.offset;
+        view.segments = reinterpret_cast<const int32_t*>(data + mHeader.segmentsOffset) + entry.offset;
+        view.mask = reinterpret_cast<const int32_t*>(data + mHeader.maskOffset) + entry.offset;
+        view.length = static_cast<int>(entry.length);
+        view.label = entry.label;
+        return view;
+    }
+
+    void advise(AccessPattern pattern) const
+    {
+        mFile.advise(pattern);
+    }
+
+private:
+    MappedFile mFile;
+    PackedSequenceHeader mHeader{};
+    const SequenceIndexEntry* mIndex{nullptr};
+    size_t mCount{0};
+};
+
+//!
+//! \brief Sequences padded together, to length tokens each.
+//!
+struct SequenceBatch
+{
+    int length{0};
+    std::vector<uint32_t> samples;
+};
+
+//!
+//! \brief Batches of sequences grouped by length.
+//!
+//! \details Each sequence goes to the shortest bucket that holds it; sequences longer than the longest bucket are
+//!          truncated to it, as the fixed-shape engines would. Within a bucket the file order is kept, so the last
+//!          batch of each bucket may be short. With a seed the batch order is shuffled, so that a run that stops
+//!          early still sees all lengths.
+//!
+class SequenceBatchPlan
+{
+public:
+    SequenceBatchPlan() = default;
+
+    SequenceBatchPlan(const PackedSequenceFile& file, int batchSize, std::vector<int> bucketLengths, unsigned seed = 0)
+    {
+        assert(batchSize > 0 && !bucketLengths.empty());
+        std::sort(bucketLengths.begin(), bucketLengths.end());
+        bucketLengths.erase(std::unique(bucketLengths.begin(), bucketLengths.end()), bucketLengths.end());
+        std::vector<std::vector<uint32_t>> buckets(bucketLengths.size());
+        for (size_t i = 0; i < file.size(); ++i)
+        {
+            const auto bucket = std::lower_bound(bucketLengths.begin(), bucketLengths.end(), file.getLength(i));
+            if (bucket == bucketLengths.end())
+            {
+                ++mNbTruncated;
+                buckets.back().push_back(static_cast<uint32_t>(i));
+            }
+            else
+            {
+                buckets[bucket - bucketLengths.begin()].push_back(static_cast<uint32_t>(i));
+            }
+        }
+        for (size_t b = 0; b < buckets.size(); ++b)
+        {
+            for (size_t first = 0; first < buckets[b].size(); first += batchSize)
+            {
+                SequenceBatch batch;
+                batch.length = bucketLengths[b];
+                const size_t last = std::min(first + batchSize, buckets[b].size());
+                batch.samples.assign(buckets[b].begin() + first, buckets[b].begin() + last);
+                mBatches.push_back(std::move(batch));
+            }
+        }
+        if (seed)
+        {
+            std::shuffle(mBatches.begin(), mBatches.end(), std::mt19937(seed));
+        }
+        mBatchSize = batchSize;
+        mMaxLength = bucketLengths.back();
+    }
+
+    size_t size() const
+    {
+        return mBatches.size();
+    }
+
+    const SequenceBatch& operator[](size_t i) const
+    {
+        return mBatches[i];
+    }
+
+    int getBatchSize() const
+    {
+        return mBatchSize;
+    }
+
+    //! The longest bucket, which bounds the size of every assembled batch.
+    int getMaxLength() const
+    {
+        return mMaxLength;
+    }
+
+    size_t getNbTruncated() const
+    {
+        return mNbTruncated;
+    }
+
+    //! Tokens in all batches, counting padding, e.g. to compare bucket choices.
+    size_t getNbPaddedTokens() const
+    {
+        return std::accumulate(mBatches.begin(), mBatches.end(), size_t(0),
+            [this](size_t sum, const SequenceBatch& batch) { return sum + size_t(batch.length) * mBatchSize; });
+    }
+
+private:
+    std::vector<SequenceBatch> mBatches;
+    int mBatchSize{0};
+    int mMaxLength{0};
+    size_t mNbTruncated{0};
+};
+
+//!
+//! \brief The three [batchSize x length] int32 inputs of an assembled batch.
+//!
+struct SequenceBatchPlanes
+{
+    int32_t* ids;
+    int32_t* segments;
+    int32_t* mask;
+
+    //! Bytes of each plane.
+    static size_t getBytes(int batchSize, int length)
+    {
+        return size_t(batchSize) * length * sizeof(int32_t);
+    }
+};
+
+//!
+//! \brief Pad the sequences of batch into planes of batchSize rows; rows past the batch are all zero.
+//!
+inline void assembleSequenceBatch(
+    const PackedSequenceFile& file, const SequenceBatch& batch, int batchSize, const SequenceBatchPlanes& planes)
+{
+    assert(static_cast<int>(batch.samples.size()) <= batchSize);
+    const size_t rowBytes = size_t(batch.length) * sizeof(int32_t);
+    for (int r = 0; r < batchSize; ++r)
+    {
+        const size_t offset = size_t(r) * batch.length;
+        int copied = 0;
+        if (r < static_cast<int>(batch.samples.size()))
+        {
+            const SequenceView sequence = file.sequence(batch.samples[r]);
+            copied = std::min(sequence.length, batch.length);
+            std::memcpy(planes.ids + offset, sequence.ids, copied * sizeof(int32_t));
+            std::memcpy(planes.segments + offset, sequence.segments, copied * sizeof(int32_t));
+            std::memcpy(planes.mask + offset, sequence.mask, copied * sizeof(int32_t));
+        }
+        const size_t padding = rowBytes - copied * sizeof(int32_t);
+        std::memset(planes.ids + offset + copied, 0, padding);
+        std::memset(planes.segments + offset + copied, 0, padding);
+        std::memset(planes.mask + offset + copied, 0, padding);
+    }
+}
+
+//!
+//! \brief Where the planes of a batch of length tokens live in a HostBatch of an InputPipeline made with
+//!        getSequencePipelineVolume(). The slot memory is only ever accessed as int32 for these batches.
+//!
+inline SequenceBatchPlanes getSequenceBatchPlanes(const HostBatch& batch, int batchSize, int length)
+{
+    int32_t* base = reinterpret_cast<int32_t*>(batch.data);
+    const size_t plane = size_t(batchSize) * length;
+    return SequenceBatchPlanes{base, base + plane, base + 2 * plane};
+}
+
+//! Sample volume of an InputPipeline holding the batches of plan: three planes of the longest bucket.
+inline size_t getSequencePipelineVolume(const SequenceBatchPlan& plan)
+{
+    static_assert(sizeof(int32_t) == sizeof(float), "Sequence planes reuse float slots");
+    return 3 * size_t(plan.getMaxLength());
+}
+
+//!
+//! \brief Producer for an InputPipeline of plan.getBatchSize() samples and getSequencePipelineVolume(plan) volume:
+//!        batch i of the pipeline is batch i of the plan, its labels the labels of its sequences.
+//!
+inline InputPipeline::Producer makePackedSequenceProducer(const PackedSequenceFile& file, const SequenceBatchPlan& plan)
+{
+    return [&file, &plan](HostBatch& batch) {
+        if (batch.index < 0 || static_cast<size_t>(batch.index) >= plan.size())
+        {
+            return false;
+        }
+        const SequenceBatch& sequences = plan[batch.index];
+        assembleSequenceBatch(
+            file, sequences, plan.getBatchSize(), getSequenceBatchPlanes(batch, plan.getBatchSize(), sequences.length));
+        batch.size = static_cast<int>(sequences.samples.size());
+        for (int i = 0; i < plan.getBatchSize(); ++i)
+        {
+            batch.labels[i] = i < batch.size ? float(file.sequence(sequences.samples[i]).label) : -1.f;
+        }
+        return true;
+    };
+}
+
+} // namespace samplesCommon
+
+#endif // TENSORRT_PACKED_SEQUENCES_H
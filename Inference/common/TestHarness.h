@@ -0,0 +1,104 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef TENSORRT_TEST_HARNESS_H
+#define TENSORRT_TEST_HARNESS_H
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+
+//!
+//! \file TestHarness.h
+//!
+//! \brief Checks and fixtures of the tests of common/ and of the ONNX parser.
+//!
+//! \details The tests are plain executables that ctest runs: they check with EXPECT, which reports a failed check and
+//!          carries on, and return finishTests() from main, which is nonzero if any check failed. The header depends
+//!          on nothing else in the tree, so that the parser tests can include it as well.
+//!
+
+namespace testHarness
+{
+
+//! Checks failed so far.
+inline int& getNbFailures()
+{
+    static int nbFailures = 0;
+    return nbFailures;
+}
+
+//!
+//! \brief Report the checks of the suite and return the exit code of the test.
+//!
+inline int finishTests(const std::string& suite)
+{
+    if (getNbFailures())
+    {
+        std::cerr << getNbFailures() << " check(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << "All " << suite << " tests passed" << std::endl;
+    return 0;
+}
+
+//!
+//! \brief A directory under /tmp, removed with whatever the test left in it when the fixture is destroyed.
+//!
+class TempDir
+{
+public:
+    //! Creates /tmp/<prefix>XXXXXX; isValid() tells whether that worked.
+    explicit TempDir(const std::string& prefix)
+    {
+        std::string path = "/tmp/" + prefix + "XXXXXX";
+        if (mkdtemp(&path[0]))
+        {
+            mPath = path;
+        }
+        else
+        {
+            std::cerr << "Could not create a temporary directory" << std::endl;
+        }
+    }
+
+    TempDir(const TempDir&) = delete;
+    TempDir& operator=(const TempDir&) = delete;
+
+    ~TempDir()
+    {
+        if (!mPath.empty())
+        {
+            std::system(("rm -rf '" + mPath + "'").c_str());
+        }
+    }
+
+    bool isValid() const
+    {
+        return !mPath.empty();
+    }
+
+    const std::string& getPath() const
+    {
+        return mPath;
+    }
+
+private:
+    std::string mPath;
+};
+
+} // namespace testHarness
+
+//! Report cond, with where it is checked, if it does not hold, and go on with the test.
+#define EXPECT(cond)                                                                                                   \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        if (!(cond))                                                                                                   \
+        {                                                                                                              \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #cond << std::endl;                         \
+            ++testHarness::getNbFailures();                                                                            \
+        }                                                                                                              \
+    } while (0)
+
+#endif // TENSORRT_TEST_HARNESS_H
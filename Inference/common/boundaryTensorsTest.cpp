@@ -0,0 +1,202 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+// Checks that boundary tensors round-trip through the writer and file in float and half across chunk boundaries,
+// that malformed files are rejected, and that BoundaryTensorStream replays them as whole batches.
+
+#include "BoundaryTensors.h"
+#include "TestHarness.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using std::cerr;
+using std::cout;
+using std::endl;
+
+namespace
+{
+
+using namespace samplesCommon;
+
+std::string gTempDir;
+
+const nvinfer1::Dims kSAMPLE_DIMS{3, {4, 3, 2}};
+constexpr size_t kSAMPLE_VOLUME = 4 * 3 * 2;
+
+//! Element e of sample s is s + e / 8, exact in half for the sample counts used here.
+float value(size_t s, size_t e)
+{
+    return s + e / 8.0F;
+}
+
+std::vector<float> makeSamples(size_t first, size_t count)
+{
+    std::vector<float> samples(count * kSAMPLE_VOLUME);
+    for (size_t s = 0; s < count; ++s)
+    {
+        for (size_t e = 0; e < kSAMPLE_VOLUME; ++e)
+        {
+            samples[s * kSAMPLE_VOLUME + e] = value(first + s, e);
+        }
+    }
+    return samples;
+}
+
+bool isSamples(const float* data, size_t first, size_t count)
+{
+    bool ok = true;
+    for (size_t s = 0; s < count; ++s)
+    {
+        for (size_t e = 0; e < kSAMPLE_VOLUME; ++e)
+        {
+            ok = ok && data[s * kSAMPLE_VOLUME + e] == value(first + s, e);
+        }
+    }
+    return ok;
+}
+
+//! Captures count samples in uneven batches, as a stage runner whose batches do not line up with chunks would.
+std::string writeSamples(const std::string& name, size_t count, nvinfer1::DataType type, int samplesPerChunk)
+{
+    const std::string path = gTempDir + "/" + name;
+    BoundaryTensorWriter writer;
+    EXPECT(writer.open(path, kSAMPLE_DIMS, type, samplesPerChunk));
+    for (size_t first = 0; first < count;)
+    {
+        const size_t batch = std::min<size_t>(count - first, 1 + first % 5);
+        EXPECT(writer.append(makeSamples(first, batch).data(), static_cast<int>(batch)));
+        first += batch;
+    }
+    EXPECT(writer.getNbSamples() == count);
+    EXPECT(writer.close());
+    return path;
+}
+
+void testHalfConversion()
+{
+    bool ok = true;
+    for (uint32_t bits = 0; bits < 0x10000u; ++bits)
+    {
+        const float value = preprocess::halfToFloat(static_cast<uint16_t>(bits));
+        // Every half but NaN survives the trip through float.
+        ok = ok && (std::isnan(value) || preprocess::floatToHalf(value) == bits);
+    }
+    EXPECT(ok);
+    EXPECT(preprocess::halfToFloat(0x3c00) == 1.0F && preprocess::halfToFloat(0xc000) == -2.0F);
+    EXPECT(preprocess::halfToFloat(0x0001) == std::ldexp(1.0F, -24));
+}
+
+void testRoundTrip()
+{
+    for (auto type : {nvinfer1::DataType::kFLOAT, nvinfer1::DataType::kHALF})
+    {
+        for (int samplesPerChunk : {1, 7, 16, 100})
+        {
+            BoundaryTensorFile file;
+            EXPECT(file.open(writeSamples("round.bnd", 37, type, samplesPerChunk)));
+            EXPECT(file.size() == 37 && file.getDataType() == type && file.getSampleVolume() == kSAMPLE_VOLUME);
+            EXPECT(file.getSampleDims().nbDims == 3 && file.getSampleDims().d[2] == 2);
+            std::vector<float> samples(37 * kSAMPLE_VOLUME);
+            file.read(0, 37, samples.data());
+            EXPECT(isSamples(samples.data(), 0, 37));
+            file.read(13, 9, samples.data());
+            EXPECT(isSamples(samples.data(), 13, 9));
+            file.prefetch(30, 20);
+        }
+    }
+
+    BoundaryTensorFile empty;
+    EXPECT(empty.open(writeSamples("empty.bnd", 0, nvinfer1::DataType::kHALF, 8)));
+    EXPECT(empty.size() == 0);
+}
+
+void testRejects()
+{
+    const std::string path = writeSamples("full.bnd", 20, nvinfer1::DataType::kFLOAT, 8);
+    const std::string truncated = gTempDir + "/truncated.bnd";
+    const std::string garbage = gTempDir + "/garbage.bnd";
+    EXPECT(std::system(("head -c 1000 " + path + " > " + truncated).c_str()) == 0);
+    EXPECT(std::system(("head -c 1000 /dev/zero > " + garbage).c_str()) == 0);
+
+    BoundaryTensorFile file;
+    EXPECT(!file.open(truncated));
+    EXPECT(!file.open(garbage));
+    EXPECT(!file.open(gTempDir + "/missing.bnd"));
+    EXPECT(file.size() == 0);
+
+    BoundaryTensorWriter writer;
+    EXPECT(!writer.open(gTempDir + "/int8.bnd", kSAMPLE_DIMS, nvinfer1::DataType::kINT8));
+    EXPECT(!writer.open(gTempDir + "/nodims.bnd", nvinfer1::Dims{0, {}}, nvinfer1::DataType::kFLOAT));
+    EXPECT(!writer.open(gTempDir + "/nodir/b.bnd", kSAMPLE_DIMS, nvinfer1::DataType::kFLOAT));
+
+    // A capture that never finishes leaves nothing behind.
+    {
+        BoundaryTensorWriter abandoned;
+        EXPECT(abandoned.open(gTempDir + "/abandoned.bnd", kSAMPLE_DIMS, nvinfer1::DataType::kFLOAT));
+        EXPECT(abandoned.append(makeSamples(0, 3).data(), 3));
+    }
+    EXPECT(!file.open(gTempDir + "/abandoned.bnd"));
+    EXPECT(std::system(("test -e " + gTempDir + "/abandoned.bnd.partial").c_str()) != 0);
+}
+
+void testStream()
+{
+    auto file = std::make_shared<BoundaryTensorFile>();
+    EXPECT(file->open(writeSamples("stream.bnd", 23, nvinfer1::DataType::kHALF, 4)));
+    const std::shared_ptr<const BoundaryTensorFile> shared = file;
+
+    BoundaryTensorStream stream(shared, 5);
+    const nvinfer1::Dims dims = stream.getDims();
+    EXPECT(dims.nbDims == 4 && dims.d[0] == 5 && dims.d[1] == 4 && dims.d[3] == 2);
+    EXPECT(stream.getBatchSize() == 5);
+
+    // 23 samples make 4 whole batches; the tail of 3 is not returned.
+    stream.reset(0);
+    int nbBatches = 0;
+    bool ok = true;
+    while (stream.next())
+    {
+        ok = ok && isSamples(stream.getBatch(), 5 * nbBatches, 5) && stream.getLabels()[4] == 0.0F;
+        ++nbBatches;
+    }
+    EXPECT(ok && nbBatches == 4 && stream.getBatchesRead() == 4);
+
+    stream.reset(1);
+    stream.skip(1);
+    EXPECT(stream.next() && isSamples(stream.getBatch(), 10, 5));
+    EXPECT(stream.getBatchesRead() == 1);
+
+    BoundaryTensorStream copy(stream);
+    copy.reset(0);
+    EXPECT(copy.next() && isSamples(copy.getBatch(), 0, 5));
+    EXPECT(stream.next() && isSamples(stream.getBatch(), 15, 5) && !stream.next());
+
+    BoundaryTensorStream limited(shared, 5, 2);
+    limited.reset(0);
+    EXPECT(limited.next() && limited.next() && !limited.next());
+}
+
+} // namespace
+
+int main()
+{
+    const testHarness::TempDir tempDir("boundaryTensorsTest");
+    if (!tempDir.isValid())
+    {
+        return 1;
+    }
+    gTempDir = tempDir.getPath();
+
+    testHalfConversion();
+    testRoundTrip();
+    testRejects();
+    testStream();
+
+    return testHarness::finishTests("boundary tensors");
+}
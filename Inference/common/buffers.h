@@ -16,9 +16,11 @@
 #ifndef TENSORRT_BUFFERS_H
 #define TENSORRT_BUFFERS_H
 
+#include "HostStagingPool.h"
 #include "NvInfer.h"
 #include "common.h"
 #include "half.h"
+#include <algorithm>
 #include <cassert>
 #include <cuda_runtime_api.h>
 #include <iostream>
@@ -232,15 +234,17 @@ public:
     }
 };
 
+//!
+//! \brief Host memory from the default HostStagingPool: pinned up to its cap, so that async copies are asynchronous,
+//!        and reused across the buffers created for each batch.
+//!
 class HostAllocator
 {
 public:
     bool operator()(void** ptr, size_t size) const
     {
-        *ptr = malloc(size);
-        // cudaMallocHost(ptr, size);
+        *ptr = HostStagingPool::getDefault().allocate(size);
         return *ptr != nullptr;
-        // return cudaMallocHost(ptr, size) == cudaSuccess;
     }
 };
 
@@ -249,8 +253,7 @@ class HostFree
 public:
     void operator()(void* ptr) const
     {
-        // cudaFreeHost(ptr);
-        free(ptr);
+        HostStagingPool::getDefault().free(ptr);
     }
 };
 
@@ -334,7 +337,8 @@ public:
     : mEngine(std::move(buf.mEngine))
     , mBatchSize(std::move(buf.mBatchSize))
     , mManagedBuffers(std::move(buf.mManagedBuffers))
-    , mDeviceBindings(std::move(buf.mDeviceBindings)){}
+    , mDeviceBindings(std::move(buf.mDeviceBindings))
+    , mStaging(std::move(buf.mStaging)){}
 
     BufferManager(std::shared_ptr<nvinfer1::ICudaEngine> engine, const int batchSize = 0,
         const std::shared_ptr<ManagedBuffer> srcPtr = nullptr, int* copyListPtr = nullptr, size_t length_copy = 0,
@@ -630,6 +634,83 @@ public:
         memcpyBuffers(false, true, true, stream);
     }
 
+    //!
+    //! \brief Give each input binding a second pair of host and device buffers, so that the next batch can be
+    //!        staged and copied in on copyStream while the engine reads the current one.
+    //!
+    //! \details The pair bound for execution is the front, the other the back. A batch goes through
+    //!          getStagedInputHostBuffer(), copyStagedInputToDeviceAsync() and swapStagedInputs(), and the engine is
+    //!          enqueued after the swap. Events order the streams: the copy into a back device buffer waits for the
+    //!          execution that last read it, and writes to a back host buffer wait for the copy that last read it.
+    //!          Only for inputs the host fills; inputs shared with an earlier stage keep their buffers.
+    //!
+    void enableInputDoubleBuffering(cudaStream_t copyStream)
+    {
+        if (mStaging)
+        {
+            return;
+        }
+        mStaging.reset(new InputStaging(copyStream));
+        for (int i = 0; i < mEngine->getNbBindings(); i++)
+        {
+            if (!mEngine->bindingIsInput(i))
+            {
+                continue;
+            }
+            mStaging->bindings.push_back(i);
+            mStaging->slots[0].push_back(mManagedBuffers[i]);
+            mStaging->slots[1].emplace_back(
+                new ManagedBuffer(mManagedBuffers[i]->hostBuffer.size(), mEngine->getBindingDataType(i)));
+        }
+    }
+
+    //!
+    //! \brief Returns the back host buffer of input binding bindingIndex to fill with the next batch, once the copy
+    //!        that last read it is done.
+    //!
+    void* getStagedInputHostBuffer(const int bindingIndex)
+    {
+        assert(mStaging);
+        const int back = 1 - mStaging->front;
+        CUDACHECK(cudaEventSynchronize(mStaging->copied[back]));
+        return mStaging->getSlot(back, bindingIndex)->hostBuffer.data();
+    }
+
+    //!
+    //! \brief Copy the back host buffers to the back device buffers on the copy stream.
+    //!
+    void copyStagedInputToDeviceAsync()
+    {
+        assert(mStaging);
+        const int back = 1 - mStaging->front;
+        CUDACHECK(cudaStreamWaitEvent(mStaging->copyStream, mStaging->consumed[back], 0));
+        for (const auto& buffer : mStaging->slots[back])
+        {
+            CUDACHECK(cudaMemcpyAsync(buffer->deviceBuffer.data(), buffer->hostBuffer.data(),
+                buffer->hostBuffer.nbBytes(), cudaMemcpyHostToDevice, mStaging->copyStream));
+        }
+        CUDACHECK(cudaEventRecord(mStaging->copied[back], mStaging->copyStream));
+    }
+
+    //!
+    //! \brief Bind the staged batch for execution on computeStream, which waits for its copy. The pair bound so far
+    //!        becomes the back, refilled only once the work queued on computeStream until now is done.
+    //!
+    void swapStagedInputs(const cudaStream_t& computeStream)
+    {
+        assert(mStaging);
+        const int front = mStaging->front;
+        CUDACHECK(cudaEventRecord(mStaging->consumed[front], computeStream));
+        CUDACHECK(cudaStreamWaitEvent(computeStream, mStaging->copied[1 - front], 0));
+        mStaging->front = 1 - front;
+        for (size_t k = 0; k < mStaging->bindings.size(); k++)
+        {
+            const int i = mStaging->bindings[k];
+            mManagedBuffers[i] = mStaging->slots[mStaging->front][k];
+            mDeviceBindings[i] = mManagedBuffers[i]->deviceBuffer.data();
+        }
+    }
+
     ~BufferManager() = default;
 
 private:
@@ -661,11 +742,54 @@ private:
         }
     }
 
+    //!
+    //! \brief The second input buffers of enableInputDoubleBuffering() and the events ordering their copies.
+    //!
+    struct InputStaging
+    {
+        explicit InputStaging(cudaStream_t stream)
+            : copyStream(stream)
+        {
+            for (int s = 0; s < 2; s++)
+            {
+                CUDACHECK(cudaEventCreateWithFlags(&copied[s], cudaEventDisableTiming));
+                CUDACHECK(cudaEventCreateWithFlags(&consumed[s], cudaEventDisableTiming));
+            }
+        }
+
+        InputStaging(const InputStaging&) = delete;
+        InputStaging& operator=(const InputStaging&) = delete;
+
+        ~InputStaging()
+        {
+            for (int s = 0; s < 2; s++)
+            {
+                cudaEventDestroy(copied[s]);
+                cudaEventDestroy(consumed[s]);
+            }
+        }
+
+        const std::shared_ptr<ManagedBuffer>& getSlot(int slot, int bindingIndex) const
+        {
+            const auto it = std::find(bindings.begin(), bindings.end(), bindingIndex);
+            assert(it != bindings.end());
+            return slots[slot][it - bindings.begin()];
+        }
+
+        cudaStream_t copyStream;
+        cudaEvent_t copied[2];   //!< Recorded on copyStream after the copy into each slot.
+        cudaEvent_t consumed[2]; //!< Recorded on the compute stream when each slot stops being bound.
+        std::vector<int> bindings;
+        std::vector<std::shared_ptr<ManagedBuffer>> slots[2];
+        int front{0};
+    };
+
     std::shared_ptr<nvinfer1::ICudaEngine> mEngine;              //!< The pointer to the engine
     int mBatchSize;                                              //!< The batch size for legacy networks, 0 otherwise.
     int mCopyMethod;
     std::vector<std::shared_ptr<ManagedBuffer>> mManagedBuffers; //!< The vector of pointers to managed buffers
     std::vector<void*> mDeviceBindings;                          //!< The vector of device buffers needed for engine execution
+    std::unique_ptr<InputStaging> mStaging;                      //!< Set by enableInputDoubleBuffering()
 };
 
 
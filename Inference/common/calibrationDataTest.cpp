@@ -0,0 +1,298 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+// Checks that calibration blobs round-trip the batches of a stream, are reused instead of decoding the stream again,
+// are rewritten when they no longer match it, and that several calibration streams can read one blob at once. Also
+// checks that the copies of a PipelinedBatchStream share its position and return their batch to the ring.
+
+#include "CalibrationData.h"
+#include "TestHarness.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using std::cerr;
+using std::cout;
+using std::endl;
+
+namespace
+{
+
+using namespace samplesCommon;
+
+std::string gTempDir;
+
+//! Element e of batch b is b + e / 1000, label r of batch b is 10 * b + r. Counts the batches it decodes.
+class CountingBatchStream : public IBatchStream
+{
+public:
+    CountingBatchStream(int batchSize, int nbBatches, int height = 3)
+        : mNbBatches(nbBatches)
+        , mDims{4, {batchSize, 2, height, 5}}
+        , mData(volume(mDims))
+        , mLabels(batchSize)
+    {
+    }
+
+    void reset(int firstBatch) override
+    {
+        mNext = firstBatch;
+        mBatchCount = 0;
+    }
+
+    bool next() override
+    {
+        if (mNext >= mNbBatches)
+        {
+            return false;
+        }
+        for (size_t e = 0; e < mData.size(); ++e)
+        {
+            mData[e] = mNext + e / 1000.0F;
+        }
+        for (size_t r = 0; r < mLabels.size(); ++r)
+        {
+            mLabels[r] = static_cast<float>(10 * mNext + r);
+        }
+        ++mNext;
+        ++mBatchCount;
+        ++mNbDecoded;
+        return true;
+    }
+
+    void skip(int skipCount) override
+    {
+        mNext += skipCount;
+    }
+
+    float* getBatch() override
+    {
+        return mData.data();
+    }
+
+    float* getLabels() override
+    {
+        return mLabels.data();
+    }
+
+    int getBatchesRead() const override
+    {
+        return mBatchCount;
+    }
+
+    int getBatchSize() const override
+    {
+        return mDims.d[0];
+    }
+
+    nvinfer1::Dims getDims() const override
+    {
+        return mDims;
+    }
+
+    int mNbDecoded{0};
+
+private:
+    int mNbBatches;
+    int mNext{0};
+    int mBatchCount{0};
+    nvinfer1::Dims mDims;
+    std::vector<float> mData;
+    std::vector<float> mLabels;
+};
+
+bool isBatch(const float* data, const float* labels, size_t volume, int batchSize, int b)
+{
+    bool ok = true;
+    for (size_t e = 0; e < volume; ++e)
+    {
+        ok = ok && data[e] == b + e / 1000.0F;
+    }
+    for (int r = 0; r < batchSize; ++r)
+    {
+        ok = ok && labels[r] == static_cast<float>(10 * b + r);
+    }
+    return ok;
+}
+
+void testRoundTrip()
+{
+    CountingBatchStream stream(4, 10);
+    const std::string path = gTempDir + "/round.cal";
+    EXPECT(CalibrationBlob::write(stream, 2, 5, path));
+    EXPECT(stream.mNbDecoded == 5);
+
+    CalibrationBlob blob;
+    EXPECT(blob.open(path));
+    EXPECT(blob.getNbBatches() == 5 && blob.getBatchSize() == 4 && blob.getBatchVolume() == 4 * 2 * 3 * 5);
+    EXPECT(blob.getDims().nbDims == 4 && blob.getDims().d[3] == 5);
+    bool ok = true;
+    for (int i = 0; i < blob.getNbBatches(); ++i)
+    {
+        ok = ok && isBatch(blob.getBatch(i), blob.getLabels(i), blob.getBatchVolume(), 4, i + 2);
+    }
+    EXPECT(ok);
+    blob.prefetch(1, 3);
+
+    // A short stream writes what it has.
+    EXPECT(CalibrationBlob::write(stream, 8, 5, path));
+    EXPECT(blob.open(path) && blob.getNbBatches() == 2);
+}
+
+void testReuse()
+{
+    const std::string path = gTempDir + "/reuse.cal";
+    CountingBatchStream stream(2, 20);
+    CalibrationBlob blob;
+    EXPECT(blob.openOrWrite(stream, 0, 8, path));
+    EXPECT(stream.mNbDecoded == 8);
+
+    // Later calibrations map the blob and decode nothing, also when they need fewer batches.
+    CalibrationBlob again;
+    EXPECT(again.openOrWrite(stream, 0, 8, path));
+    EXPECT(again.openOrWrite(stream, 0, 3, path));
+    EXPECT(stream.mNbDecoded == 8 && again.getNbBatches() == 8);
+
+    // More batches, or other dims, than the blob holds write it again.
+    EXPECT(again.openOrWrite(stream, 0, 10, path));
+    EXPECT(stream.mNbDecoded == 18 && again.getNbBatches() == 10);
+    CountingBatchStream taller(2, 20, 4);
+    EXPECT(again.openOrWrite(taller, 0, 10, path));
+    EXPECT(taller.mNbDecoded == 10 && again.getDims().d[2] == 4);
+}
+
+void testRejects()
+{
+    CountingBatchStream stream(4, 3);
+    const std::string path = gTempDir + "/full.cal";
+    EXPECT(CalibrationBlob::write(stream, 0, 3, path));
+    const std::string truncated = gTempDir + "/truncated.cal";
+    const std::string garbage = gTempDir + "/garbage.cal";
+    EXPECT(std::system(("head -c 500 " + path + " > " + truncated).c_str()) == 0);
+    EXPECT(std::system(("head -c 500 /dev/zero > " + garbage).c_str()) == 0);
+
+    CalibrationBlob blob;
+    EXPECT(!blob.open(truncated));
+    EXPECT(!blob.open(garbage));
+    EXPECT(!blob.open(gTempDir + "/missing.cal"));
+    EXPECT(blob.getNbBatches() == 0);
+
+    // A corrupt blob is replaced rather than trusted.
+    EXPECT(blob.openOrWrite(stream, 0, 3, truncated));
+    EXPECT(blob.getNbBatches() == 3);
+    EXPECT(!blob.open(gTempDir + "/nodir/blob.cal") && !CalibrationBlob::write(stream, 0, 3, gTempDir + "/nodir/b"));
+}
+
+void testStreams()
+{
+    CountingBatchStream source(3, 12);
+    auto blob = std::make_shared<CalibrationBlob>();
+    EXPECT(blob->openOrWrite(source, 0, 12, gTempDir + "/streams.cal"));
+    const std::shared_ptr<const CalibrationBlob> shared = blob;
+    const size_t volume = shared->getBatchVolume();
+
+    // Several calibrators, e.g. one per split stage, read the same blob concurrently.
+    std::vector<int> nbRead(4, 0);
+    std::vector<char> ok(4, 1);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t)
+    {
+        threads.emplace_back([&, t]() {
+            CalibrationBatchStream stream(shared, 2);
+            stream.reset(t);
+            while (stream.next())
+            {
+                ok[t] = ok[t] && isBatch(stream.getBatch(), stream.getLabels(), volume, 3, t + nbRead[t]);
+                ++nbRead[t];
+            }
+        });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    for (int t = 0; t < 4; ++t)
+    {
+        EXPECT(ok[t] && nbRead[t] == 12 - t);
+    }
+
+    // Skipping, resetting, and copies that read independently of the original.
+    CalibrationBatchStream stream(shared);
+    EXPECT(stream.getBatchSize() == 3 && stream.getDims().nbDims == 4);
+    EXPECT(stream.next() && isBatch(stream.getBatch(), stream.getLabels(), volume, 3, 0));
+    stream.skip(4);
+    EXPECT(stream.next() && isBatch(stream.getBatch(), stream.getLabels(), volume, 3, 5));
+    EXPECT(stream.getBatchesRead() == 2);
+    CalibrationBatchStream copy(stream);
+    copy.reset(10);
+    EXPECT(copy.next() && isBatch(copy.getBatch(), copy.getLabels(), volume, 3, 10));
+    EXPECT(copy.next() && !copy.next() && copy.getBatch() == nullptr);
+    EXPECT(stream.next() && isBatch(stream.getBatch(), stream.getLabels(), volume, 3, 6));
+    stream.reset(0);
+    EXPECT(stream.next() && isBatch(stream.getBatch(), stream.getLabels(), volume, 3, 0));
+    EXPECT(source.mNbDecoded == 12);
+}
+
+//! Reads nbBatches batches from a copy of stream, like a calibrator that took the stream by value.
+bool readCopy(PipelinedBatchStream stream, int nbBatches, int firstBatch, size_t volume)
+{
+    bool ok = true;
+    for (int b = 0; b < nbBatches; ++b)
+    {
+        ok = ok && stream.next() && isBatch(stream.getBatch(), stream.getLabels(), volume, 3, firstBatch + b);
+    }
+    return ok;
+}
+
+void testPipelinedStream()
+{
+    CountingBatchStream source(3, 8);
+    const size_t volume = samplesCommon::volume(source.getDims());
+    auto pipeline = std::make_shared<InputPipeline>(3, volume / 3, 2, 1, makeBatchStreamProducer(source));
+    {
+        PipelinedBatchStream stream(pipeline, 8, source.getDims());
+        EXPECT(stream.next() && isBatch(stream.getBatch(), stream.getLabels(), volume, 3, 0));
+
+        // Copies share the read position: the original goes on after the batches its copy read.
+        EXPECT(readCopy(stream, 3, 1, volume));
+        EXPECT(stream.getBatchesRead() == 4);
+        EXPECT(stream.next() && isBatch(stream.getBatch(), stream.getLabels(), volume, 3, 4));
+    }
+
+    // The last copy returned batch 4; with two slots, batch 6 is only produced once it has.
+    for (int b = 5; b < 8; ++b)
+    {
+        HostBatch* batch = pipeline->acquire();
+        EXPECT(batch && batch->index == b && isBatch(batch->data, batch->labels, volume, 3, b));
+        if (batch)
+        {
+            pipeline->release(batch);
+        }
+    }
+    EXPECT(pipeline->acquire() == nullptr);
+}
+
+} // namespace
+
+int main()
+{
+    const testHarness::TempDir tempDir("calibrationDataTest");
+    if (!tempDir.isValid())
+    {
+        return 1;
+    }
+    gTempDir = tempDir.getPath();
+
+    testRoundTrip();
+    testReuse();
+    testRejects();
+    testStreams();
+    testPipelinedStream();
+
+    return testHarness::finishTests("calibration data");
+}
@@ -290,7 +290,7 @@ inline void readBinaryFile(const std::string& filename, std::vector<uint8_t>& te
     std::ifstream infile(filename, std::ifstream::binary);
     assert(infile.is_open() && "Attempting to read from a file that is not open.");
     infile.seekg(0, std::ios::end);
-    const int length = 10000 * (32 * 32 * 3 + 1);
+    const size_t length = static_cast<size_t>(infile.tellg());
     std::cout << filename << " : " << length << " bytes" << std::endl;
     tempbinary.resize(length);
 
@@ -672,6 +672,15 @@ inline int64_t volume(const nvinfer1::Dims& d)
     return std::accumulate(d.d, d.d + d.nbDims, 1, std::multiplies<int64_t>());
 }
 
+//!
+//! \brief The number of classes an exit head with output dims d scores per sample: its innermost dimension, which
+//!        is 1 once canonicalize_exit_head has reduced the head to the top probability of each sample.
+//!
+inline int exitHeadClasses(const nvinfer1::Dims& d)
+{
+    return d.nbDims > 1 ? d.d[d.nbDims - 1] : 1;
+}
+
 inline uint32_t elementSize(DataType t) noexcept
 {
     switch (t)
@@ -0,0 +1,295 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+// Checks that moveon json files stream into the same bitsets as flags given directly, that binary traces round-trip,
+// that survivor counts, masks and gather indices match the flags for any batch size, that bad input is rejected, and
+// that replays chain the exits into the right gather indices in a reproducible order.
+
+#include "ExitTrace.h"
+#include "TestHarness.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using std::cerr;
+using std::cout;
+using std::endl;
+
+namespace
+{
+
+using namespace samplesCommon;
+
+std::string gTempDir;
+
+//! Sample i moves on past exit e when it is not a multiple of any of 3, 5, ..., 2e + 3, so later exits keep fewer.
+std::vector<bool> makeFlags(size_t nbSamples, int e)
+{
+    std::vector<bool> flags(nbSamples);
+    for (size_t i = 0; i < nbSamples; ++i)
+    {
+        bool movesOn = true;
+        for (int k = 0; k <= e; ++k)
+        {
+            movesOn = movesOn && i % (2 * k + 3) != 0;
+        }
+        flags[i] = movesOn;
+    }
+    return flags;
+}
+
+//! A moveon json as training writes it: one array per batch, as booleans or as 0 and 1.
+std::string writeMoveonJson(const std::string& name, const std::vector<bool>& flags, int batchSize, bool asInts)
+{
+    const std::string path = gTempDir + "/" + name;
+    std::ofstream out(path);
+    out << "{";
+    for (size_t first = 0; first < flags.size(); first += batchSize)
+    {
+        out << (first ? ", " : "") << "\"" << first / batchSize << "\": [";
+        for (size_t i = first; i < std::min(flags.size(), first + batchSize); ++i)
+        {
+            out << (i > first ? ", " : "") << (asInts ? (flags[i] ? "1" : "0") : (flags[i] ? "true" : "false"));
+        }
+        out << "]";
+    }
+    out << "}";
+    return path;
+}
+
+std::string writeText(const std::string& name, const std::string& text)
+{
+    const std::string path = gTempDir + "/" + name;
+    std::ofstream(path) << text;
+    return path;
+}
+
+//! Compares a view against the flags it was built from.
+bool matches(const ExitMaskView& view, const std::vector<bool>& flags)
+{
+    const int batchSize = view.getBatchSize();
+    bool ok = view.size() == flags.size() && view.getNbBatches() == (flags.size() + batchSize - 1) / batchSize;
+    std::vector<int> indices;
+    std::vector<uint8_t> mask;
+    const std::vector<int> counts = view.getSurvivorCounts();
+    for (size_t b = 0; ok && b < view.getNbBatches(); ++b)
+    {
+        std::vector<int> expected;
+        for (size_t i = b * batchSize; i < std::min(flags.size(), (b + 1) * batchSize); ++i)
+        {
+            if (flags[i])
+            {
+                expected.push_back(static_cast<int>(i - b * batchSize));
+            }
+        }
+        view.getSurvivors(b, indices);
+        view.getMask(b, mask);
+        ok = ok && indices == expected && counts[b] == static_cast<int>(expected.size())
+            && view.getSurvivorCount(b) == counts[b];
+        for (size_t i = 0; i < mask.size(); ++i)
+        {
+            ok = ok && mask[i] == flags[b * batchSize + i];
+        }
+    }
+    return ok;
+}
+
+void testJson()
+{
+    const auto flags = makeFlags(1000, 0);
+    ExitTrace trace(64);
+    EXPECT(trace.addMoveonJson(9, writeMoveonJson("bools.json", flags, 64, false)));
+    EXPECT(trace.addMoveonJson(12, writeMoveonJson("ints.json", flags, 16, true)));
+    EXPECT(trace.getNbExits() == 2 && trace.getExit(1) == 12 && trace.size() == 1000);
+    EXPECT(matches(trace.getMasks(0), flags) && matches(trace.getMasks(1), flags));
+
+    // What generate_copy_list computed from the DOM: survivors per batch of the runner's batch size.
+    const std::vector<int> counts = trace.getMasks(0, 10).getSurvivorCounts();
+    EXPECT(counts.size() == 100 && counts[0] == 6 && counts[1] == 7);
+
+    // One array for everything, as the BERT traces are written.
+    ExitTrace flat(4);
+    EXPECT(flat.addMoveonJson(6, writeMoveonJson("flat.json", flags, 1000, false)));
+    EXPECT(matches(flat.getMasks(0), flags));
+}
+
+void testJsonRejects()
+{
+    ExitTrace trace(8);
+    EXPECT(!trace.addMoveonJson(1, gTempDir + "/missing.json"));
+    EXPECT(!trace.addMoveonJson(1, writeText("array.json", "[true, false]")));
+    EXPECT(!trace.addMoveonJson(1, writeText("nested.json", "{\"0\": [[true]]}")));
+    EXPECT(!trace.addMoveonJson(1, writeText("number.json", "{\"0\": [true, 2]}")));
+    EXPECT(!trace.addMoveonJson(1, writeText("string.json", "{\"0\": [\"true\"]}")));
+    EXPECT(!trace.addMoveonJson(1, writeText("cut.json", "{\"0\": [true, fal")));
+    EXPECT(trace.getNbExits() == 0);
+
+    // Every exit of a trace covers the same samples.
+    EXPECT(trace.addMoveonJson(1, writeText("three.json", "{\"0\": [true, false], \"1\": [1]}")));
+    EXPECT(!trace.addMoveonJson(2, writeText("two.json", "{\"0\": [true, false]}")));
+    EXPECT(trace.getNbExits() == 1 && trace.size() == 3);
+}
+
+void testBinary()
+{
+    const size_t nbSamples = 1237;
+    ExitTrace trace(32);
+    for (int e = 0; e < 3; ++e)
+    {
+        EXPECT(trace.addExit(10 + 3 * e, makeFlags(nbSamples, e)));
+    }
+    const std::string path = gTempDir + "/trace.bin";
+    EXPECT(trace.write(path));
+
+    ExitTraceFile file;
+    EXPECT(file.open(path));
+    EXPECT(file.getBatchSize() == 32 && file.getNbExits() == 3 && file.size() == nbSamples);
+    for (int e = 0; e < 3; ++e)
+    {
+        EXPECT(file.getExit(e) == 10 + 3 * e);
+        for (int batchSize : {0, 1, 7, 64, 100, 2000})
+        {
+            EXPECT(matches(file.getMasks(e, batchSize), makeFlags(nbSamples, e)));
+        }
+    }
+
+    ExitTrace empty(4);
+    EXPECT(empty.addExit(3, std::vector<bool>{}));
+    EXPECT(empty.write(gTempDir + "/empty.bin"));
+    EXPECT(file.open(gTempDir + "/empty.bin") && file.size() == 0 && file.getMasks(0).getNbBatches() == 0);
+}
+
+void testBinaryRejects()
+{
+    ExitTrace trace(8);
+    EXPECT(trace.addExit(1, makeFlags(500, 0)));
+    const std::string path = gTempDir + "/full.bin";
+    EXPECT(trace.write(path));
+    const std::string truncated = gTempDir + "/truncated.bin";
+    EXPECT(std::system(("head -c 150 " + path + " > " + truncated).c_str()) == 0);
+
+    ExitTraceFile file;
+    EXPECT(!file.open(truncated));
+    EXPECT(!file.open(writeMoveonJson("legacy.json", makeFlags(10, 0), 4, false)));
+    EXPECT(!file.open(gTempDir + "/missing.bin"));
+    EXPECT(file.size() == 0 && file.getNbExits() == 0);
+    EXPECT(!trace.write(gTempDir + "/nodir/trace.bin"));
+}
+
+void testReplay()
+{
+    const size_t nbSamples = 1000;
+    const int batchSize = 16;
+    ExitTrace trace(batchSize);
+    for (int e = 0; e < 3; ++e)
+    {
+        EXPECT(trace.addExit(e, makeFlags(nbSamples, e)));
+    }
+    std::vector<ExitMaskView> exits;
+    for (int e = 0; e < 3; ++e)
+    {
+        exits.push_back(trace.getMasks(e));
+    }
+
+    // In trace order, each stage gathers exactly the samples of the next exit out of the previous stage's batch.
+    ExitTraceReplay replay(exits, 0, false);
+    EXPECT(replay.size() == nbSamples / batchSize && replay.getNbExits() == 3);
+    ReplayBatch batch;
+    size_t nbBatches = 0;
+    bool ok = true;
+    while (replay.next(batch))
+    {
+        ok = ok && batch.index == nbBatches && batch.pass == 0 && batch.gather.size() == 3;
+        // Walk the stages the way the runner compacts its buffers.
+        std::vector<int> alive(batchSize);
+        for (int i = 0; i < batchSize; ++i)
+        {
+            alive[i] = i;
+        }
+        for (int e = 0; e < 3; ++e)
+        {
+            const auto flags = makeFlags(nbSamples, e);
+            std::vector<int> next;
+            for (int position : batch.gather[e])
+            {
+                ok = ok && position < static_cast<int>(alive.size());
+                next.push_back(alive[position]);
+            }
+            std::vector<int> expected;
+            for (int i = 0; i < batchSize; ++i)
+            {
+                if (flags[batch.index * batchSize + i])
+                {
+                    expected.push_back(i);
+                }
+            }
+            ok = ok && next == expected;
+            alive = next;
+        }
+        ++nbBatches;
+    }
+    EXPECT(ok && nbBatches == replay.size());
+
+    // Seeded orders are reproducible, cover every whole batch once per pass, and are reshuffled when looping.
+    ExitTraceReplay seeded(exits, 5);
+    ExitTraceReplay again(exits, 5);
+    std::vector<size_t> firstPass;
+    std::vector<size_t> secondPass;
+    for (size_t i = 0; i < 2 * seeded.size(); ++i)
+    {
+        ReplayBatch a;
+        ReplayBatch b;
+        EXPECT(seeded.next(a) && again.next(b));
+        EXPECT(a.index == b.index && a.gather == b.gather);
+        (a.pass == 0 ? firstPass : secondPass).push_back(a.index);
+    }
+    EXPECT(firstPass != secondPass);
+    std::sort(firstPass.begin(), firstPass.end());
+    std::sort(secondPass.begin(), secondPass.end());
+    EXPECT(firstPass == secondPass && firstPass.size() == nbSamples / batchSize && firstPass.back() == 61);
+
+    // Shards of one seed partition the batches.
+    std::vector<size_t> all;
+    for (int shard = 0; shard < 3; ++shard)
+    {
+        ExitTraceReplay sharded(exits, 5, false, shard, 3);
+        while (sharded.next(batch))
+        {
+            all.push_back(batch.index);
+        }
+    }
+    std::sort(all.begin(), all.end());
+    EXPECT(all == firstPass);
+
+    // A trace shorter than a batch has nothing to replay.
+    ExitTrace shortTrace(batchSize);
+    EXPECT(shortTrace.addExit(0, makeFlags(10, 0)));
+    ExitTraceReplay empty({shortTrace.getMasks(0)});
+    EXPECT(empty.size() == 0 && !empty.next(batch));
+}
+
+} // namespace
+
+int main()
+{
+    const testHarness::TempDir tempDir("exitTraceTest");
+    if (!tempDir.isValid())
+    {
+        return 1;
+    }
+    gTempDir = tempDir.getPath();
+
+    testJson();
+    testJsonRejects();
+    testBinary();
+    testBinaryRejects();
+    testReplay();
+
+    return testHarness::finishTests("exit trace");
+}
@@ -0,0 +1,217 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+// Checks, on host-only allocators, that the staging pool reuses freed blocks, keeps pinned bytes under its cap by
+// evicting cached blocks, falls back to pageable memory or fails past the cap as configured, rejects blocks it does
+// not own, and stays consistent under concurrent use.
+
+#include "HostStagingPool.h"
+#include "TestHarness.h"
+
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+using std::cerr;
+using std::cout;
+using std::endl;
+
+namespace
+{
+
+using namespace samplesCommon;
+
+//! malloc standing in for pinned or pageable memory, counting what is live and failing past a limit.
+class CountingAllocator : public IHostAllocator
+{
+public:
+    CountingAllocator(bool pinned, size_t limit = ~size_t(0))
+        : mPinned(pinned)
+        , mLimit(limit)
+    {
+    }
+
+    void* allocate(size_t size) override
+    {
+        if (mNbBytes + size > mLimit)
+        {
+            return nullptr;
+        }
+        void* ptr = mAllocator.allocate(size);
+        mSizes.push_back({ptr, size});
+        mNbBytes += size;
+        ++mNbAllocations;
+        return ptr;
+    }
+
+    void free(void* ptr) override
+    {
+        for (auto it = mSizes.begin(); it != mSizes.end(); ++it)
+        {
+            if (it->first == ptr)
+            {
+                mNbBytes -= it->second;
+                mSizes.erase(it);
+                mAllocator.free(ptr);
+                return;
+            }
+        }
+        ++mNbBadFrees;
+    }
+
+    bool isPinned() const override
+    {
+        return mPinned;
+    }
+
+    bool mPinned;
+    size_t mLimit;
+    size_t mNbBytes{0};
+    size_t mNbAllocations{0};
+    size_t mNbBadFrees{0};
+
+private:
+    PageableHostAllocator mAllocator;
+    std::vector<std::pair<void*, size_t>> mSizes;
+};
+
+struct TestPool
+{
+    TestPool(size_t capacity, PinnedFallback fallback, size_t pinnedLimit = ~size_t(0))
+        : pinned(new CountingAllocator(true, pinnedLimit))
+        , pageable(new CountingAllocator(false))
+        , pool(std::unique_ptr<IHostAllocator>(pinned), std::unique_ptr<IHostAllocator>(pageable), capacity, fallback)
+    {
+    }
+
+    CountingAllocator* pinned;
+    CountingAllocator* pageable;
+    HostStagingPool pool;
+};
+
+void testReuse()
+{
+    TestPool t(1 << 20, PinnedFallback::kPAGEABLE);
+    void* a = t.pool.allocate(1000);
+    EXPECT(a && t.pool.isPinned(a));
+    std::memset(a, 1, 1000);
+    t.pool.free(a);
+    EXPECT(t.pool.getCachedBytes() == 1000 && t.pool.getPinnedBytes() == 1000);
+
+    // A buffer of the next batch gets the block back, a much smaller one does not.
+    EXPECT(t.pool.allocate(900) == a);
+    EXPECT(t.pool.getNbReused() == 1 && t.pinned->mNbAllocations == 1);
+    void* small = t.pool.allocate(100);
+    EXPECT(small && small != a && t.pinned->mNbAllocations == 2);
+    t.pool.free(small);
+    void* large = t.pool.allocate(2000);
+    EXPECT(large != small);
+    EXPECT(t.pool.getCachedBytes() == 100);
+
+    void* empty = t.pool.allocate(0);
+    EXPECT(empty != nullptr);
+    t.pool.free(empty);
+    t.pool.free(nullptr);
+    t.pool.free(a);
+    t.pool.free(large);
+    t.pool.trim();
+    EXPECT(t.pool.getCachedBytes() == 0 && t.pool.getPinnedBytes() == 0);
+    EXPECT(t.pinned->mNbBytes == 0 && t.pinned->mNbBadFrees == 0);
+}
+
+void testCap()
+{
+    TestPool t(4096, PinnedFallback::kPAGEABLE);
+    void* a = t.pool.allocate(3000);
+    void* b = t.pool.allocate(1000);
+    EXPECT(t.pool.isPinned(a) && t.pool.isPinned(b));
+    EXPECT(t.pool.getPinnedBytes() == 4000);
+
+    // Past the cap: pageable, freed rather than cached.
+    void* c = t.pool.allocate(1000);
+    EXPECT(c && !t.pool.isPinned(c));
+    EXPECT(t.pool.getNbFallbacks() == 1 && t.pageable->mNbBytes == 1000);
+    t.pool.free(c);
+    EXPECT(t.pageable->mNbBytes == 0 && t.pool.getCachedBytes() == 0);
+
+    // A cached block that does not fit the request is evicted to make room under the cap.
+    t.pool.free(b);
+    void* d = t.pool.allocate(1090);
+    EXPECT(d && t.pool.isPinned(d));
+    EXPECT(t.pool.getCachedBytes() == 0 && t.pool.getPinnedBytes() == 4090);
+    EXPECT(t.pinned->mNbBytes == 4090);
+
+    // Lowering the cap frees cached blocks, not blocks in use.
+    t.pool.free(d);
+    t.pool.setCapacity(3500);
+    EXPECT(t.pool.getPinnedBytes() == 3000 && t.pinned->mNbBytes == 3000);
+    t.pool.free(a);
+    t.pool.trim();
+    EXPECT(t.pinned->mNbBytes == 0 && t.pinned->mNbBadFrees == 0);
+}
+
+void testFallback()
+{
+    // Pinning failing below the cap falls back as well.
+    TestPool t(1 << 20, PinnedFallback::kPAGEABLE, 1000);
+    void* a = t.pool.allocate(800);
+    void* b = t.pool.allocate(800);
+    EXPECT(t.pool.isPinned(a) && b && !t.pool.isPinned(b));
+
+    t.pool.setFallback(PinnedFallback::kFAIL);
+    EXPECT(t.pool.allocate(800) == nullptr);
+    EXPECT(t.pool.getNbFallbacks() == 1);
+    t.pool.free(a);
+    t.pool.free(b);
+
+    // Freeing what the pool does not own, or twice, is reported and ignored.
+    PageableHostAllocator other;
+    void* foreign = other.allocate(16);
+    t.pool.free(foreign);
+    t.pool.free(b);
+    other.free(foreign);
+    EXPECT(t.pinned->mNbBadFrees == 0 && t.pageable->mNbBadFrees == 0);
+    EXPECT(!t.pool.isPinned(foreign));
+}
+
+void testConcurrent()
+{
+    TestPool t(64 << 10, PinnedFallback::kPAGEABLE);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i)
+    {
+        threads.emplace_back([&t, i]() {
+            for (int n = 0; n < 2000; ++n)
+            {
+                const size_t size = 1024 * (1 + (n + i) % 8);
+                auto* data = static_cast<unsigned char*>(t.pool.allocate(size));
+                std::memset(data, i, size);
+                t.pool.free(data);
+            }
+        });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    EXPECT(t.pool.getPinnedBytes() <= (64 << 10));
+    EXPECT(t.pool.getPinnedBytes() == t.pool.getCachedBytes());
+    EXPECT(t.pool.getNbReused() > 0);
+    EXPECT(t.pageable->mNbBytes == 0);
+    t.pool.trim();
+    EXPECT(t.pinned->mNbBytes == 0 && t.pinned->mNbBadFrees == 0);
+}
+
+} // namespace
+
+int main()
+{
+    testReuse();
+    testCap();
+    testFallback();
+    testConcurrent();
+
+    return testHarness::finishTests("host staging pool");
+}
@@ -0,0 +1,283 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+// Checks the image preprocessing kernels against the direct formula, and the vector kernels against the scalar ones,
+// for float and half outputs, both layouts, crops and resizes.
+
+#include "ImagePreprocess.h"
+#include "TestHarness.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using std::cerr;
+using std::cout;
+using std::endl;
+
+namespace
+{
+
+using namespace samplesCommon;
+
+std::vector<uint8_t> randomImage(int height, int width, int channels)
+{
+    static std::mt19937 rng(42);
+    std::vector<uint8_t> image(static_cast<size_t>(height) * width * channels);
+    for (auto& v : image)
+    {
+        v = static_cast<uint8_t>(rng() & 0xff);
+    }
+    return image;
+}
+
+ChannelAffine makeAffine(int channels)
+{
+    const float mean[] = {0.485f, 0.456f, 0.406f, 0.5f};
+    const float stddev[] = {0.229f, 0.224f, 0.225f, 0.25f};
+    return ChannelAffine::fromMeanStd(channels, mean, stddev);
+}
+
+float halfToFloat(uint16_t h)
+{
+    const uint32_t sign = static_cast<uint32_t>(h & 0x8000) << 16;
+    const int exponent = (h >> 10) & 0x1f;
+    const uint32_t mantissa = h & 0x3ff;
+    float magnitude;
+    if (exponent == 0)
+    {
+        magnitude = std::ldexp(static_cast<float>(mantissa), -24);
+    }
+    else if (exponent == 31)
+    {
+        magnitude = mantissa ? NAN : INFINITY;
+    }
+    else
+    {
+        magnitude = std::ldexp(static_cast<float>(mantissa | 0x400), exponent - 25);
+    }
+    return sign ? -magnitude : magnitude;
+}
+
+bool closeEnough(float a, float b)
+{
+    return std::fabs(a - b) <= 1e-5f * std::max(1.f, std::fabs(b));
+}
+
+//! Halves may round differently where the float results differed; near zero that is several units in the last place,
+//! so compare against the half precision of values of magnitude one.
+bool closeEnough(uint16_t a, uint16_t b)
+{
+    const float expected = halfToFloat(b);
+    return std::fabs(halfToFloat(a) - expected) <= std::ldexp(std::max(1.f, std::fabs(expected)), -10);
+}
+
+template <typename T>
+bool allClose(const std::vector<T>& a, const std::vector<T>& b)
+{
+    if (a.size() != b.size())
+    {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); ++i)
+    {
+        if (!closeEnough(a[i], b[i]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void testHalfConversion()
+{
+    EXPECT(preprocess::floatToHalf(0.f) == 0x0000);
+    EXPECT(preprocess::floatToHalf(-0.f) == 0x8000);
+    EXPECT(preprocess::floatToHalf(1.f) == 0x3c00);
+    EXPECT(preprocess::floatToHalf(-2.f) == 0xc000);
+    EXPECT(preprocess::floatToHalf(65504.f) == 0x7bff);
+    EXPECT(preprocess::floatToHalf(1e6f) == 0x7c00);
+    EXPECT(preprocess::floatToHalf(std::ldexp(1.f, -24)) == 0x0001);
+    // 1 + 2^-11 is halfway between 1 and the next half; ties go to even.
+    EXPECT(preprocess::floatToHalf(1.f + std::ldexp(1.f, -11)) == 0x3c00);
+    EXPECT(preprocess::floatToHalf(1.f + 3 * std::ldexp(1.f, -11)) == 0x3c02);
+    for (int i = -1000; i <= 1000; ++i)
+    {
+        const float value = i * 0.013f;
+        EXPECT(std::fabs(halfToFloat(preprocess::floatToHalf(value)) - value) <= std::fabs(value) * std::ldexp(1.f, -11));
+    }
+}
+
+//! The scalar kernels against x * scale[c] + bias[c] written out.
+void testScalarReference()
+{
+    EXPECT(setPreprocessIsa(PreprocessIsa::kSCALAR));
+    const int height = 7;
+    const int width = 13;
+    for (int channels = 1; channels <= 4; ++channels)
+    {
+        const auto affine = makeAffine(channels);
+        const auto image = randomImage(height, width, channels);
+        const size_t plane = static_cast<size_t>(height) * width;
+        std::vector<float> hwc(plane * channels);
+        std::vector<float> chw(plane * channels);
+        normalizeImage(image.data(), height, width, PixelLayout::kHWC, affine, hwc.data());
+        normalizeImage(image.data(), height, width, PixelLayout::kCHW, affine, chw.data());
+        bool hwcOk = true;
+        bool chwOk = true;
+        for (int c = 0; c < channels; ++c)
+        {
+            for (size_t p = 0; p < plane; ++p)
+            {
+                const float fromHwc = static_cast<float>(image[p * channels + c]) * affine.scale[c] + affine.bias[c];
+                const float fromChw = static_cast<float>(image[c * plane + p]) * affine.scale[c] + affine.bias[c];
+                hwcOk = hwcOk && closeEnough(hwc[c * plane + p], fromHwc);
+                chwOk = chwOk && closeEnough(chw[c * plane + p], fromChw);
+            }
+        }
+        EXPECT(hwcOk);
+        EXPECT(chwOk);
+    }
+}
+
+//! Every kernel the CPU supports against the scalar ones, over sizes that exercise the vector tails.
+template <typename T>
+void testIsaAgreement(PreprocessIsa isa)
+{
+    const int sizes[][2] = {{1, 1}, {3, 5}, {32, 32}, {17, 31}, {224, 224}};
+    for (const auto& size : sizes)
+    {
+        for (int channels : {1, 3, 4})
+        {
+            for (auto layout : {PixelLayout::kHWC, PixelLayout::kCHW})
+            {
+                const int height = size[0];
+                const int width = size[1];
+                const auto affine = makeAffine(channels);
+                const auto image = randomImage(height, width, channels);
+                const size_t volume = static_cast<size_t>(height) * width * channels;
+
+                ImageRect crop;
+                crop.x = width / 4;
+                crop.y = height / 3;
+                crop.width = width - crop.x;
+                crop.height = height - crop.y;
+                const int dstHeight = 2 * height + 1;
+                const int dstWidth = width / 2 + 1;
+                const size_t resizedVolume = static_cast<size_t>(dstHeight) * dstWidth * channels;
+
+                std::vector<T> expected(volume);
+                std::vector<T> expectedCrop(static_cast<size_t>(crop.width) * crop.height * channels);
+                std::vector<T> expectedResize(resizedVolume);
+                setPreprocessIsa(PreprocessIsa::kSCALAR);
+                normalizeImage(image.data(), height, width, layout, affine, expected.data());
+                resizeNormalizeImage(image.data(), height, width, layout, crop, crop.height, crop.width, affine,
+                    expectedCrop.data());
+                resizeNormalizeImage(
+                    image.data(), height, width, layout, crop, dstHeight, dstWidth, affine, expectedResize.data());
+
+                std::vector<T> actual(volume);
+                std::vector<T> actualCrop(expectedCrop.size());
+                std::vector<T> actualResize(resizedVolume);
+                EXPECT(setPreprocessIsa(isa));
+                normalizeImage(image.data(), height, width, layout, affine, actual.data());
+                resizeNormalizeImage(image.data(), height, width, layout, crop, crop.height, crop.width, affine,
+                    actualCrop.data());
+                resizeNormalizeImage(
+                    image.data(), height, width, layout, crop, dstHeight, dstWidth, affine, actualResize.data());
+
+                EXPECT(allClose(actual, expected));
+                EXPECT(allClose(actualCrop, expectedCrop));
+                EXPECT(allClose(actualResize, expectedResize));
+            }
+        }
+    }
+}
+
+//! Crops copy pixels, and resizing to the crop's own size or from a constant image changes nothing.
+void testCropAndResize()
+{
+    EXPECT(setPreprocessIsa(PreprocessIsa::kSCALAR));
+    const int height = 9;
+    const int width = 11;
+    const int channels = 3;
+    const auto affine = makeAffine(channels);
+    const auto image = randomImage(height, width, channels);
+    std::vector<float> full(static_cast<size_t>(height) * width * channels);
+    normalizeImage(image.data(), height, width, PixelLayout::kHWC, affine, full.data());
+
+    ImageRect crop;
+    crop.x = 2;
+    crop.y = 3;
+    crop.width = 5;
+    crop.height = 4;
+    std::vector<float> cropped(static_cast<size_t>(crop.width) * crop.height * channels);
+    resizeNormalizeImage(
+        image.data(), height, width, PixelLayout::kHWC, crop, crop.height, crop.width, affine, cropped.data());
+    bool cropOk = true;
+    for (int c = 0; c < channels; ++c)
+    {
+        for (int y = 0; y < crop.height; ++y)
+        {
+            for (int x = 0; x < crop.width; ++x)
+            {
+                cropOk = cropOk
+                    && cropped[(c * crop.height + y) * crop.width + x]
+                        == full[(c * height + crop.y + y) * width + crop.x + x];
+            }
+        }
+    }
+    EXPECT(cropOk);
+
+    const std::vector<uint8_t> flat(static_cast<size_t>(height) * width * channels, 100);
+    ImageRect all;
+    all.width = width;
+    all.height = height;
+    std::vector<float> resized(static_cast<size_t>(20) * 30 * channels);
+    resizeNormalizeImage(flat.data(), height, width, PixelLayout::kHWC, all, 20, 30, affine, resized.data());
+    bool flatOk = true;
+    for (int c = 0; c < channels; ++c)
+    {
+        for (size_t p = 0; p < 20 * 30; ++p)
+        {
+            flatOk = flatOk && closeEnough(resized[c * 600 + p], 100.f * affine.scale[c] + affine.bias[c]);
+        }
+    }
+    EXPECT(flatOk);
+
+    // Downscaling 2x with half-pixel centers averages each 2x2 block.
+    const uint8_t square[] = {0, 4, 8, 12};
+    std::vector<float> one(1);
+    ImageRect whole;
+    whole.width = 2;
+    whole.height = 2;
+    resizeNormalizeImage(square, 2, 2, PixelLayout::kCHW, whole, 1, 1, ChannelAffine::uniform(1, 1.f, 0.f), one.data());
+    EXPECT(one[0] == 6.f);
+}
+
+} // namespace
+
+int main()
+{
+    testHalfConversion();
+    testScalarReference();
+    testCropAndResize();
+    for (auto isa : {PreprocessIsa::kSCALAR, PreprocessIsa::kAVX2})
+    {
+        if (!preprocess::cpuSupports(isa))
+        {
+            cout << "Skipping unsupported kernels " << static_cast<int>(isa) << endl;
+            continue;
+        }
+        testIsaAgreement<float>(isa);
+        testIsaAgreement<uint16_t>(isa);
+    }
+
+    return testHarness::finishTests("image preprocessing");
+}
@@ -0,0 +1,270 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+// Checks that generated arrivals have the rates and shapes of their patterns and are reproducible, that arrival traces
+// are read and validated, that load options parse into arrival configs, and that the open-loop harness batches by size
+// and window, spreads batches over executors, and charges queueing to latency once the executor falls behind.
+
+#include "LoadGenerator.h"
+#include "TestHarness.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using std::cerr;
+using std::cout;
+using std::endl;
+
+namespace
+{
+
+using namespace samplesCommon;
+
+std::string gTempDir;
+
+size_t countIn(const std::vector<double>& arrivals, double begin, double end)
+{
+    return std::count_if(arrivals.begin(), arrivals.end(), [=](double t) { return t >= begin && t < end; });
+}
+
+bool isAscendingWithin(const std::vector<double>& arrivals, double duration)
+{
+    return std::is_sorted(arrivals.begin(), arrivals.end())
+        && (arrivals.empty() || (arrivals.front() >= 0.0 && arrivals.back() < duration));
+}
+
+//! Variance over mean of the counts in windows of the given length; 1 for Poisson arrivals.
+double getDispersion(const std::vector<double>& arrivals, double duration, double window)
+{
+    std::vector<double> counts(static_cast<size_t>(duration / window));
+    for (double t : arrivals)
+    {
+        counts[std::min(counts.size() - 1, static_cast<size_t>(t / window))] += 1.0;
+    }
+    double mean = 0.0;
+    for (double c : counts)
+    {
+        mean += c / counts.size();
+    }
+    double variance = 0.0;
+    for (double c : counts)
+    {
+        variance += (c - mean) * (c - mean) / counts.size();
+    }
+    return variance / mean;
+}
+
+void testPoisson()
+{
+    ArrivalConfig config;
+    config.rate = 1000.0;
+    const std::vector<double> arrivals = generateArrivals(config, 10.0);
+    EXPECT(isAscendingWithin(arrivals, 10.0));
+    EXPECT(arrivals.size() > 9600 && arrivals.size() < 10400);
+    const double dispersion = getDispersion(arrivals, 10.0, 0.01);
+    EXPECT(dispersion > 0.8 && dispersion < 1.2);
+
+    EXPECT(generateArrivals(config, 10.0) == arrivals);
+    config.seed = 2;
+    EXPECT(generateArrivals(config, 10.0) != arrivals);
+    config.rate = 0.0;
+    EXPECT(generateArrivals(config, 10.0).empty());
+}
+
+void testBursty()
+{
+    ArrivalConfig config;
+    config.pattern = ArrivalPattern::kBURSTY;
+    config.rate = 100.0;
+    config.burstRate = 2000.0;
+    config.meanBurstSeconds = 0.05;
+    config.meanIdleSeconds = 0.2;
+    const std::vector<double> arrivals = generateArrivals(config, 20.0);
+    EXPECT(isAscendingWithin(arrivals, 20.0));
+    // A fifth of the time at 2000/s and the rest at 100/s is 480/s on average.
+    const double rate = arrivals.size() / 20.0;
+    EXPECT(rate > 380.0 && rate < 580.0);
+    // Bursts make the counts far more variable than Poisson arrivals at the same mean rate.
+    EXPECT(getDispersion(arrivals, 20.0, 0.01) > 3.0);
+}
+
+void testStep()
+{
+    ArrivalConfig config;
+    config.pattern = ArrivalPattern::kSTEP;
+    config.steps = {{0.0, 200.0}, {1.0, 2000.0}, {2.0, 0.0}, {3.0, 500.0}};
+    const std::vector<double> arrivals = generateArrivals(config, 4.0);
+    EXPECT(isAscendingWithin(arrivals, 4.0));
+    EXPECT(countIn(arrivals, 0.0, 1.0) > 150 && countIn(arrivals, 0.0, 1.0) < 250);
+    EXPECT(countIn(arrivals, 1.0, 2.0) > 1850 && countIn(arrivals, 1.0, 2.0) < 2150);
+    EXPECT(countIn(arrivals, 2.0, 3.0) == 0);
+    EXPECT(countIn(arrivals, 3.0, 4.0) > 420 && countIn(arrivals, 3.0, 4.0) < 580);
+
+    // Steps past the duration are cut off.
+    EXPECT(isAscendingWithin(generateArrivals(config, 1.5), 1.5));
+    EXPECT(countIn(generateArrivals(config, 1.5), 1.0, 1.5) > 850);
+}
+
+void testTrace()
+{
+    const std::string path = gTempDir + "/arrivals.txt";
+    {
+        std::ofstream out(path);
+        out << "# recorded arrivals\n100.5\n100.5 # two at once\n\n100.75\n101.5\n";
+    }
+    std::vector<double> arrivals;
+    EXPECT(readArrivalTrace(path, arrivals));
+    EXPECT((arrivals == std::vector<double>{0.0, 0.0, 0.25, 1.0}));
+
+    ArrivalConfig config;
+    config.pattern = ArrivalPattern::kTRACE;
+    config.trace = arrivals;
+    EXPECT((generateArrivals(config, 1.0) == std::vector<double>{0.0, 0.0, 0.25}));
+
+    const std::string unsorted = gTempDir + "/unsorted.txt";
+    {
+        std::ofstream out(unsorted);
+        out << "1\n3\n2\n";
+    }
+    EXPECT(!readArrivalTrace(unsorted, arrivals));
+    EXPECT(arrivals.empty());
+    EXPECT(!readArrivalTrace(gTempDir + "/missing.txt", arrivals));
+}
+
+void testParse()
+{
+    ArrivalConfig config;
+    EXPECT(parseArrivalConfig({{"rate", "250"}, {"burst_ms", "20"}, {"seed", "7"}}, config));
+    EXPECT(config.pattern == ArrivalPattern::kPOISSON && config.rate == 250.0 && config.seed == 7);
+    EXPECT(config.meanBurstSeconds == 0.02 && config.meanIdleSeconds == 0.5);
+
+    EXPECT(parseArrivalConfig({{"pattern", "step"}, {"steps", "0:100,2.5:400,4:0"}}, config));
+    EXPECT(config.pattern == ArrivalPattern::kSTEP && config.steps.size() == 3);
+    EXPECT(config.steps[1].start == 2.5 && config.steps[1].rate == 400.0 && config.steps[2].rate == 0.0);
+    EXPECT(!parseArrivalConfig({{"pattern", "step"}}, config));
+    EXPECT(!parseArrivalConfig({{"pattern", "step"}, {"steps", "0:100,5"}}, config));
+    EXPECT(!parseArrivalConfig({{"pattern", "step"}, {"steps", "5:100,1:400"}}, config));
+
+    const std::string path = gTempDir + "/parsed.txt";
+    {
+        std::ofstream out(path);
+        out << "2\n2.5\n";
+    }
+    EXPECT(parseArrivalConfig({{"pattern", "trace"}, {"trace", path}}, config));
+    EXPECT(config.pattern == ArrivalPattern::kTRACE && (config.trace == std::vector<double>{0.0, 0.5}));
+    EXPECT(!parseArrivalConfig({{"pattern", "trace"}, {"trace", ""}}, config));
+    EXPECT(!parseArrivalConfig({{"pattern", "uniform"}}, config));
+}
+
+void testPercentile()
+{
+    const std::vector<double> sorted{1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+    EXPECT(getPercentile(sorted, 0.5) == 5);
+    EXPECT(getPercentile(sorted, 0.99) == 10);
+    EXPECT(getPercentile(sorted, 0.0) == 1);
+    EXPECT(getPercentile({}, 0.5) == 0);
+}
+
+//! Counts the batches and requests it is given and records the largest batch.
+class CountingExecutor : public MockExecutor
+{
+public:
+    CountingExecutor(double baseMs, double perSampleMs)
+        : MockExecutor(baseMs, perSampleMs)
+    {
+    }
+
+    void execute(int batchSize) override
+    {
+        mNbRequests += batchSize;
+        mMaxBatchSize = std::max(mMaxBatchSize, batchSize);
+        MockExecutor::execute(batchSize);
+    }
+
+    size_t mNbRequests{0};
+    int mMaxBatchSize{0};
+};
+
+void testWindow()
+{
+    // Lone requests wait out the window, then run alone.
+    CountingExecutor executor(1.0, 0.0);
+    BatchingPolicy policy;
+    policy.maxBatchSize = 8;
+    policy.windowMs = 5.0;
+    const LoadReport report = runOpenLoop({0.0, 0.05, 0.1}, {&executor}, policy);
+    EXPECT(report.nbRequests == 3 && report.nbBatches == 3);
+    EXPECT(executor.mMaxBatchSize == 1);
+    EXPECT(report.p50Ms >= 6.0 && report.maxMs < 40.0);
+    EXPECT(report.meanQueueMs >= 5.0);
+
+    // Requests arriving together fill batches without waiting for the window.
+    CountingExecutor full(1.0, 0.0);
+    policy.windowMs = 1000.0;
+    const LoadReport together = runOpenLoop(std::vector<double>(16, 0.0), {&full}, policy);
+    EXPECT(together.nbBatches == 2 && full.mMaxBatchSize == 8);
+    EXPECT(together.maxMs < 500.0);
+
+    EXPECT(runOpenLoop({}, {&full}, policy).nbRequests == 0);
+}
+
+void testLoad()
+{
+    ArrivalConfig config;
+    config.rate = 2000.0;
+    const std::vector<double> arrivals = generateArrivals(config, 0.3);
+
+    // Two executors of 8 requests per 2.4 ms keep up with 2000 requests per second.
+    CountingExecutor a(2.0, 0.05);
+    CountingExecutor b(2.0, 0.05);
+    BatchingPolicy policy;
+    policy.maxBatchSize = 8;
+    policy.windowMs = 2.0;
+    const LoadReport light = runOpenLoop(arrivals, {&a, &b}, policy);
+    light.print(cout);
+    EXPECT(light.nbRequests == arrivals.size());
+    EXPECT(a.mNbRequests + b.mNbRequests == arrivals.size());
+    EXPECT(a.getNbBatches() > 0 && b.getNbBatches() > 0);
+    EXPECT(a.getNbBatches() + b.getNbBatches() == light.nbBatches);
+    EXPECT(std::max(a.mMaxBatchSize, b.mMaxBatchSize) <= 8);
+    EXPECT(light.meanBatchSize > 1.0);
+    EXPECT(light.p50Ms >= 2.0);
+    EXPECT(light.p50Ms <= light.p90Ms && light.p90Ms <= light.p99Ms && light.p99Ms <= light.p999Ms
+        && light.p999Ms <= light.maxMs);
+
+    // One executor of 8 requests per 8 ms serves 1000 requests per second, so the queue grows through the run.
+    CountingExecutor slow(8.0, 0.0);
+    const LoadReport heavy = runOpenLoop(arrivals, {&slow}, policy);
+    heavy.print(cout);
+    EXPECT(heavy.nbRequests == arrivals.size() && slow.mNbRequests == arrivals.size());
+    EXPECT(heavy.throughput < 1300.0);
+    EXPECT(heavy.p99Ms > 2.0 * light.p99Ms);
+    EXPECT(heavy.p99Ms > 100.0);
+}
+
+} // namespace
+
+int main()
+{
+    const testHarness::TempDir tempDir("loadGeneratorTest");
+    if (!tempDir.isValid())
+    {
+        return 1;
+    }
+    gTempDir = tempDir.getPath();
+
+    testPoisson();
+    testBursty();
+    testStep();
+    testTrace();
+    testParse();
+    testPercentile();
+    testWindow();
+    testLoad();
+
+    return testHarness::finishTests("load generator");
+}
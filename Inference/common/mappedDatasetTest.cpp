@@ -0,0 +1,172 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+// Checks that MappedDataset indexes records across files with and without headers, that shards partition the records,
+// and that malformed or mismatched files are rejected.
+
+#include "MappedDataset.h"
+#include "TestHarness.h"
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using std::cerr;
+using std::cout;
+using std::endl;
+
+namespace
+{
+
+using namespace samplesCommon;
+
+std::string gTempDir;
+
+//! The first pixel of record i holds i, the label byte(s) hold i % 10.
+std::vector<uint8_t> makeRecords(const DatasetFormat& format, size_t first, size_t count)
+{
+    std::vector<uint8_t> bytes(count * format.recordBytes());
+    for (size_t i = 0; i < count; ++i)
+    {
+        uint8_t* record = bytes.data() + i * format.recordBytes();
+        std::fill_n(record, format.labelBytes, static_cast<uint8_t>((first + i) % 10));
+        std::fill_n(record + format.labelBytes, format.pixelBytes(), static_cast<uint8_t>(first + i));
+    }
+    return bytes;
+}
+
+std::string writeFile(const std::string& name, const std::vector<uint8_t>& bytes, const DatasetHeader* header = nullptr)
+{
+    const std::string path = gTempDir + "/" + name;
+    std::ofstream out(path, std::ios::binary);
+    if (header)
+    {
+        out.write(reinterpret_cast<const char*>(header), sizeof(*header));
+    }
+    out.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+    return path;
+}
+
+void testHeaderlessFiles()
+{
+    const auto format = DatasetFormat::cifar10();
+    const auto a = writeFile("a.bin", makeRecords(format, 0, 7));
+    const auto b = writeFile("b.bin", makeRecords(format, 7, 5));
+
+    MappedDataset dataset;
+    EXPECT(dataset.open({a, b}, format));
+    EXPECT(dataset.size() == 12 && dataset.getNbFiles() == 2);
+    EXPECT(dataset.getFormat() == format);
+    bool ok = true;
+    for (size_t i = 0; i < dataset.size(); ++i)
+    {
+        const auto record = dataset.record(i);
+        ok = ok && record.pixels == record.labels + 1 && record.pixels[0] == i && record.pixels[3071] == i
+            && dataset.label(i) == static_cast<int>(i % 10);
+    }
+    EXPECT(ok);
+
+    // The dataset can be moved, e.g. out of a loader function, without remapping.
+    const uint8_t* pixels = dataset.record(9).pixels;
+    MappedDataset moved(std::move(dataset));
+    EXPECT(dataset.size() == 0);
+    EXPECT(moved.size() == 12 && moved.record(9).pixels == pixels);
+
+    // Without a format, headerless files cannot be read.
+    MappedDataset noFormat;
+    EXPECT(!noFormat.open({a}));
+    EXPECT(noFormat.size() == 0);
+}
+
+void testHeaderFiles()
+{
+    DatasetFormat format{2, 3, 4, 5, PixelLayout::kHWC};
+    auto header = DatasetHeader::make(format, 3);
+    // Bytes after the counted records, e.g. padding, are ignored.
+    auto records = makeRecords(format, 0, 3);
+    records.resize(records.size() + 17);
+    const auto path = writeFile("header.bin", records, &header);
+
+    MappedDataset dataset;
+    EXPECT(dataset.open({path}, DatasetFormat::cifar10()));
+    EXPECT(dataset.size() == 3);
+    EXPECT(dataset.getFormat() == format);
+    EXPECT(dataset.record(2).pixels[0] == 2 && dataset.record(2).labels[0] == 2);
+
+    header.count = 4;
+    const auto truncated = writeFile("truncated.bin", makeRecords(format, 0, 3), &header);
+    EXPECT(!dataset.open({truncated}));
+    EXPECT(dataset.size() == 0);
+}
+
+void testRejects()
+{
+    const auto format = DatasetFormat::cifar10();
+    const auto good = writeFile("good.bin", makeRecords(format, 0, 2));
+    auto partial = makeRecords(format, 0, 2);
+    partial.pop_back();
+    const auto bad = writeFile("partial.bin", partial);
+    const auto other = writeFile("other.bin", makeRecords(DatasetFormat::cifar100(), 0, 2));
+    const auto empty = writeFile("empty.bin", {});
+
+    MappedDataset dataset;
+    EXPECT(!dataset.open({good, bad}, format));
+    EXPECT(!dataset.open({good, gTempDir + "/missing.bin"}, format));
+    EXPECT(!dataset.open({empty}, format));
+    // Both files are whole numbers of CIFAR-100 records, but only one was written as such.
+    auto header = DatasetHeader::make(DatasetFormat::cifar100(), 2);
+    const auto other100 = writeFile("other100.bin", makeRecords(DatasetFormat::cifar100(), 0, 2), &header);
+    EXPECT(!dataset.open({good, other100}, format));
+    EXPECT(dataset.size() == 0 && dataset.getNbFiles() == 0);
+    EXPECT(dataset.open({other}, DatasetFormat::cifar100()));
+    EXPECT(dataset.label(1) == 1);
+}
+
+void testShards()
+{
+    const auto format = DatasetFormat::cifar10();
+    const auto a = writeFile("s0.bin", makeRecords(format, 0, 10));
+    const auto b = writeFile("s1.bin", makeRecords(format, 10, 13));
+    MappedDataset dataset;
+    EXPECT(dataset.open({a, b}, format));
+    dataset.advise(AccessPattern::kRANDOM);
+    dataset.prefetch(5, 20);
+
+    for (int nbShards : {1, 3, 7, 23, 30})
+    {
+        size_t next = 0;
+        bool ok = true;
+        for (int s = 0; s < nbShards; ++s)
+        {
+            const auto shard = dataset.shard(s, nbShards);
+            ok = ok && shard.begin() == next && shard.size() <= dataset.size() / nbShards + 1;
+            for (size_t i = 0; i < shard.size(); ++i)
+            {
+                ok = ok && shard.record(i).pixels[0] == shard.begin() + i;
+            }
+            next = shard.end();
+        }
+        EXPECT(ok && next == dataset.size());
+    }
+}
+
+} // namespace
+
+int main()
+{
+    const testHarness::TempDir tempDir("mappedDatasetTest");
+    if (!tempDir.isValid())
+    {
+        return 1;
+    }
+    gTempDir = tempDir.getPath();
+
+    testHeaderlessFiles();
+    testHeaderFiles();
+    testRejects();
+    testShards();
+
+    return testHarness::finishTests("mapped dataset");
+}
@@ -0,0 +1,193 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+// Checks that packed sequence files round-trip through the writer and loader, that malformed files are rejected,
+// and that batch plans bucket, truncate and pad sequences as documented, also through an InputPipeline.
+
+#include "PackedSequences.h"
+#include "TestHarness.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using std::cerr;
+using std::cout;
+using std::endl;
+
+namespace
+{
+
+using namespace samplesCommon;
+
+std::string gTempDir;
+
+//! Sequence i has lengths[i] tokens: ids 1000 * i + t, segments t % 2, mask 1, label i % 3.
+std::string writeSequences(const std::string& name, const std::vector<int>& lengths)
+{
+    PackedSequenceWriter writer;
+    for (size_t i = 0; i < lengths.size(); ++i)
+    {
+        std::vector<int32_t> ids(lengths[i]);
+        std::vector<int32_t> segments(lengths[i]);
+        std::vector<int32_t> mask(lengths[i], 1);
+        for (int t = 0; t < lengths[i]; ++t)
+        {
+            ids[t] = static_cast<int32_t>(1000 * i + t);
+            segments[t] = t % 2;
+        }
+        writer.add(ids.data(), segments.data(), mask.data(), lengths[i], static_cast<int>(i % 3));
+    }
+    const std::string path = gTempDir + "/" + name;
+    EXPECT(writer.write(path));
+    return path;
+}
+
+bool isSequence(const SequenceView& view, size_t i, int length)
+{
+    bool ok = view.length == length && view.label == static_cast<int>(i % 3);
+    for (int t = 0; t < length; ++t)
+    {
+        ok = ok && view.ids[t] == static_cast<int32_t>(1000 * i + t) && view.segments[t] == t % 2 && view.mask[t] == 1;
+    }
+    return ok;
+}
+
+void testRoundTrip()
+{
+    const std::vector<int> lengths{5, 17, 1, 64, 33};
+    PackedSequenceFile file;
+    EXPECT(file.open(writeSequences("round.seq", lengths)));
+    EXPECT(file.size() == lengths.size());
+    EXPECT(file.getMaxLength() == 64);
+    for (size_t i = 0; i < lengths.size(); ++i)
+    {
+        EXPECT(file.getLength(i) == lengths[i]);
+        EXPECT(isSequence(file.sequence(i), i, lengths[i]));
+    }
+
+    PackedSequenceFile empty;
+    EXPECT(empty.open(writeSequences("empty.seq", {})));
+    EXPECT(empty.size() == 0);
+}
+
+void testRejects()
+{
+    const std::string path = writeSequences("full.seq", {8, 8, 8});
+    const std::string truncated = gTempDir + "/truncated.seq";
+    const std::string garbage = gTempDir + "/garbage.seq";
+    EXPECT(std::system(("head -c 300 " + path + " > " + truncated).c_str()) == 0);
+    EXPECT(std::system(("head -c 300 /dev/zero > " + garbage).c_str()) == 0);
+
+    PackedSequenceFile file;
+    EXPECT(!file.open(truncated));
+    EXPECT(!file.open(garbage));
+    EXPECT(!file.open(gTempDir + "/missing.seq"));
+    EXPECT(file.size() == 0);
+}
+
+void testPlan()
+{
+    // Bucket 16 gets 0, 2, 4, 6; bucket 32 gets 1, 3; bucket 64 gets 5 (truncated) and 7.
+    const std::vector<int> lengths{5, 17, 16, 32, 1, 100, 9, 40};
+    PackedSequenceFile file;
+    EXPECT(file.open(writeSequences("plan.seq", lengths)));
+    const SequenceBatchPlan plan(file, 3, {64, 16, 32});
+    EXPECT(plan.size() == 4);
+    EXPECT(plan.getMaxLength() == 64 && plan.getBatchSize() == 3);
+    EXPECT(plan.getNbTruncated() == 1);
+    EXPECT(plan[0].length == 16 && (plan[0].samples == std::vector<uint32_t>{0, 2, 4}));
+    EXPECT(plan[1].length == 16 && (plan[1].samples == std::vector<uint32_t>{6}));
+    EXPECT(plan[2].length == 32 && (plan[2].samples == std::vector<uint32_t>{1, 3}));
+    EXPECT(plan[3].length == 64 && (plan[3].samples == std::vector<uint32_t>{5, 7}));
+    EXPECT(plan.getNbPaddedTokens() == 3 * (16 + 16 + 32 + 64));
+
+    // Shuffling reorders whole batches, reproducibly.
+    const SequenceBatchPlan shuffled(file, 3, {16, 32, 64}, 7);
+    const SequenceBatchPlan again(file, 3, {16, 32, 64}, 7);
+    EXPECT(shuffled.size() == plan.size());
+    bool same = true;
+    size_t nbSamples = 0;
+    for (size_t b = 0; b < shuffled.size(); ++b)
+    {
+        same = same && shuffled[b].samples == again[b].samples;
+        nbSamples += shuffled[b].samples.size();
+    }
+    EXPECT(same && nbSamples == lengths.size());
+
+    // Padding to the bucket, truncation to it, and zero rows past the batch.
+    const int batchSize = plan.getBatchSize();
+    std::vector<int32_t> storage(3 * batchSize * 64, -7);
+    const SequenceBatchPlanes planes{
+        storage.data(), storage.data() + batchSize * 64, storage.data() + 2 * batchSize * 64};
+    assembleSequenceBatch(file, plan[3], batchSize, planes);
+    EXPECT(planes.ids[0] == 5000 && planes.ids[63] == 5063 && planes.mask[63] == 1);
+    EXPECT(planes.ids[64] == 7000 && planes.ids[64 + 39] == 7039 && planes.ids[64 + 40] == 0);
+    EXPECT(planes.mask[64 + 39] == 1 && planes.mask[64 + 40] == 0 && planes.segments[64 + 40] == 0);
+    bool zeroRow = true;
+    for (int t = 128; t < 192; ++t)
+    {
+        zeroRow = zeroRow && planes.ids[t] == 0 && planes.segments[t] == 0 && planes.mask[t] == 0;
+    }
+    EXPECT(zeroRow);
+}
+
+void testPipeline()
+{
+    std::vector<int> lengths;
+    for (int i = 0; i < 50; ++i)
+    {
+        lengths.push_back(1 + (i * 37) % 120);
+    }
+    PackedSequenceFile file;
+    EXPECT(file.open(writeSequences("pipeline.seq", lengths)));
+    const SequenceBatchPlan plan(file, 4, {32, 64, 128}, 3);
+
+    InputPipeline pipeline(
+        plan.getBatchSize(), getSequencePipelineVolume(plan), 2, 3, makePackedSequenceProducer(file, plan));
+    pipeline.start(0, static_cast<int>(plan.size()));
+    size_t nbBatches = 0;
+    bool ok = true;
+    while (HostBatch* batch = pipeline.acquire())
+    {
+        const SequenceBatch& expected = plan[batch->index];
+        ok = ok && batch->index == static_cast<int>(nbBatches)
+            && batch->size == static_cast<int>(expected.samples.size());
+        const auto planes = getSequenceBatchPlanes(*batch, plan.getBatchSize(), expected.length);
+        for (int r = 0; r < batch->size; ++r)
+        {
+            const size_t sample = expected.samples[r];
+            const int length = lengths[sample];
+            ok = ok && batch->labels[r] == float(sample % 3);
+            ok = ok && planes.ids[r * expected.length] == static_cast<int32_t>(1000 * sample);
+            ok = ok && planes.mask[r * expected.length + length - 1] == 1;
+            ok = ok && (length == expected.length || planes.mask[r * expected.length + length] == 0);
+        }
+        pipeline.release(batch);
+        ++nbBatches;
+    }
+    EXPECT(ok);
+    EXPECT(nbBatches == plan.size());
+}
+
+} // namespace
+
+int main()
+{
+    const testHarness::TempDir tempDir("packedSequencesTest");
+    if (!tempDir.isValid())
+    {
+        return 1;
+    }
+    gTempDir = tempDir.getPath();
+
+    testRoundTrip();
+    testRejects();
+    testPlan();
+    testPipeline();
+
+    return testHarness::finishTests("packed sequences");
+}
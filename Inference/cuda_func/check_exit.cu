@@ -1,6 +1,7 @@
 #include "check_exit.cuh"
 #include <thrust/extrema.h>
 #include <thrust/device_ptr.h>
+#include <algorithm>
 #include <iostream>
 #include <curand_kernel.h>
 
@@ -20,33 +21,43 @@ void cls_copy_list(float* exitSrc, int* output_vector, float threshold, int leng
 }
 
 
-__global__ void max_reduction_resnet(float *v, int *v_r) {
-	__shared__ int partial_sum[1000];
+// One block per sample: each thread takes the maximum of a strided slice of the sample's nb_classes scores, then
+// the block reduces them. blockDim.x must be a power of two.
+__global__ void max_reduction_resnet(float *v, int *v_r, int nb_classes) {
+	extern __shared__ float partial_max[];
 
-	// Calculate thread ID
-	int tid = blockIdx.x * blockDim.x + threadIdx.x;
-
-	// Load elements into shared memory
-	partial_sum[threadIdx.x] = v[tid];
+	float *scores = v + blockIdx.x * nb_classes;
+	float max_p = 0;
+	for (int c = threadIdx.x; c < nb_classes; c += blockDim.x) {
+		max_p = fmaxf(max_p, scores[c]);
+	}
+	partial_max[threadIdx.x] = max_p;
 	__syncthreads();
 
 	// Start at 1/2 block stride and divide by two each iteration
 	for (int s = blockDim.x / 2; s > 0; s >>= 1) {
 		// Each thread does work unless it is further than the stride
 		if (threadIdx.x < s) {
-			partial_sum[threadIdx.x] = max(partial_sum[threadIdx.x], partial_sum[threadIdx.x + s]);
+			partial_max[threadIdx.x] = fmaxf(partial_max[threadIdx.x], partial_max[threadIdx.x + s]);
 		}
 		__syncthreads();
 	}
 
-	// Let the thread 0 for this block write it's result to main memory
-	// Result is inexed by this block
-
-	if (threadIdx.x == 0 && partial_sum[0] > 0.8f) {
+	// Let the thread 0 for this block write the result of its sample to main memory
+	if (threadIdx.x == 0 && partial_max[0] > 0.8f) {
 		v_r[blockIdx.x] = 1;
 	}
 }
 
+// The exit head of a ResNet rewritten by the canonicalize_exit_head optimizer pass, which outputs the top
+// probability of each sample instead of the whole softmax.
+__global__ void top_prob_resnet(float *v, int *v_r, int batch_size) {
+	int tid = blockIdx.x * blockDim.x + threadIdx.x;
+	if (tid < batch_size && v[tid] > 0.8f) {
+		v_r[tid] = 1;
+	}
+}
+
 __global__ void max_reduction_posenet(float *v, int *v_r) {
 	// int tid = blockIdx.x * blockDim.x + threadIdx.x;
 	float max_p = 0;
@@ -108,8 +119,22 @@ __global__ void max_reduction_openseg(float *v, int *v_r) {
 	}
 }
 
-void max_reduction_r(float *v, int *v_r, const cudaStream_t& stream = 0) {
-    max_reduction_resnet<<<32, 1000, 0, stream>>> (v, v_r);
+// v holds the batch_size x nb_classes scores of an exit head: its softmax, or the top probability of each sample
+// (nb_classes == 1) if the head went through canonicalize_exit_head.
+void max_reduction_r(float *v, int *v_r, int batch_size, int nb_classes, const cudaStream_t& stream = 0) {
+    if (batch_size <= 0 || nb_classes <= 0) {
+        return;
+    }
+    if (nb_classes == 1) {
+        const int threads = std::min(batch_size, 256);
+        top_prob_resnet<<<(batch_size + threads - 1) / threads, threads, 0, stream>>> (v, v_r, batch_size);
+    } else {
+        int threads = 1;
+        while (threads < nb_classes && threads < 1024) {
+            threads <<= 1;
+        }
+        max_reduction_resnet<<<batch_size, threads, threads * sizeof(float), stream>>> (v, v_r, nb_classes);
+    }
 }
 
 void max_reduction_p(float *v, int *v_r, const cudaStream_t& stream = 0) {
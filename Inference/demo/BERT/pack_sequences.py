@@ -0,0 +1,92 @@
+#!/usr/bin/env python3
+#
+# SPDX-License-Identifier: Apache-2.0
+#
+
+"""
+Packs tokenized BERT inputs into the packed sequence format read by Inference/common/PackedSequences.h, so that
+benchmarks can feed real sequences without tokenizing at run time. Padding is dropped: each sequence is stored with
+its own length and padded again, per batch, by the loader.
+
+Inputs are either a SQuAD json, tokenized here with the vocabulary, or an .npz of already tokenized GLUE-style
+features with input_ids, segment_ids and input_mask arrays of shape [N, max_seq_length] and optional label_ids.
+"""
+
+import argparse
+import struct
+import numpy as np
+
+MAGIC = b'TRTSEQ01'
+ALIGNMENT = 64
+# magic, maxLength, reserved, count, totalTokens, indexOffset, idsOffset, segmentsOffset, maskOffset
+HEADER = struct.Struct('<8sIIQQQQQQ')
+# offset, length, label
+INDEX_ENTRY = np.dtype([('offset', '<u8'), ('length', '<u4'), ('label', '<i4')])
+
+def align(offset):
+    return (offset + ALIGNMENT - 1) // ALIGNMENT * ALIGNMENT
+
+def write_packed_sequences(path, sequences):
+    """ writes sequences, a list of (input_ids, segment_ids, input_mask, label) without padding, to path """
+    index = np.zeros(len(sequences), dtype=INDEX_ENTRY)
+    lengths = np.array([len(s[0]) for s in sequences], dtype=np.int64)
+    index['length'] = lengths
+    index['offset'] = np.concatenate(([0], np.cumsum(lengths)[:-1])) if len(sequences) else []
+    index['label'] = [s[3] for s in sequences]
+    planes = [np.concatenate([np.asarray(s[field], dtype='<i4') for s in sequences]) if len(sequences)
+              else np.zeros(0, dtype='<i4') for field in range(3)]
+    total_tokens = int(lengths.sum())
+
+    index_offset = align(HEADER.size)
+    ids_offset = align(index_offset + index.nbytes)
+    segments_offset = align(ids_offset + planes[0].nbytes)
+    mask_offset = align(segments_offset + planes[1].nbytes)
+    header = HEADER.pack(MAGIC, int(lengths.max()) if len(sequences) else 0, 0, len(sequences), total_tokens,
+                         index_offset, ids_offset, segments_offset, mask_offset)
+    with open(path, 'wb') as out:
+        out.write(header)
+        for offset, data in [(index_offset, index), (ids_offset, planes[0]), (segments_offset, planes[1]),
+                             (mask_offset, planes[2])]:
+            out.write(b'\0' * (offset - out.tell()))
+            out.write(data.tobytes())
+    return total_tokens
+
+def unpad(input_ids, segment_ids, input_mask, label=-1):
+    # BERT inputs are left-aligned, so the mask counts the real tokens
+    length = int(np.count_nonzero(input_mask))
+    return (input_ids[:length], segment_ids[:length], input_mask[:length], int(label))
+
+def squad_sequences(args):
+    import helpers.tokenization as tokenization
+    import helpers.data_processing as dp
+    tokenizer = tokenization.FullTokenizer(vocab_file=args.vocab_file, do_lower_case=True)
+    sequences = []
+    for example in dp.read_squad_json(args.squad_json):
+        features = dp.convert_example_to_features(example.doc_tokens, example.question_text, tokenizer,
+                                                  args.sequence_length, args.doc_stride, args.max_query_length)
+        for feature in features:
+            sequences.append(unpad(feature.input_ids, feature.segment_ids, feature.input_mask))
+    return sequences
+
+def npz_sequences(args):
+    data = np.load(args.npz)
+    labels = data['label_ids'] if 'label_ids' in data else np.full(len(data['input_ids']), -1)
+    return [unpad(*features) for features in zip(data['input_ids'], data['segment_ids'], data['input_mask'], labels)]
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('output', help='packed sequence file to write')
+    source = parser.add_mutually_exclusive_group(required=True)
+    source.add_argument('--squad-json', help='SQuAD json to tokenize')
+    source.add_argument('--npz', help='tokenized features with input_ids, segment_ids, input_mask and label_ids')
+    parser.add_argument('-v', '--vocab-file', help='vocabulary of the SQuAD tokenizer')
+    parser.add_argument('-s', '--sequence-length', type=int, default=384, help='maximum SQuAD sequence length')
+    parser.add_argument('--doc-stride', type=int, default=128, help='stride between SQuAD document chunks')
+    parser.add_argument('--max-query-length', type=int, default=64, help='maximum SQuAD question length')
+    args = parser.parse_args()
+    if args.squad_json and not args.vocab_file:
+        parser.error('--squad-json needs --vocab-file')
+
+    sequences = squad_sequences(args) if args.squad_json else npz_sequences(args)
+    total_tokens = write_packed_sequences(args.output, sequences)
+    print('Packed', len(sequences), 'sequences,', total_tokens, 'tokens, into', args.output)
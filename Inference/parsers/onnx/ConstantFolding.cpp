@@ -0,0 +1,963 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "ConstantFolding.hpp"
+#include "ExternalData.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <numeric>
+
+namespace onnx2trt
+{
+
+namespace
+{
+
+using ::ONNX_NAMESPACE::AttributeProto;
+using ::ONNX_NAMESPACE::NodeProto;
+using ::ONNX_NAMESPACE::TensorProto;
+
+// A decoded constant: the elements in little-endian byte order plus the shape.
+struct Value
+{
+    int32_t dtype{TensorProto::UNDEFINED};
+    std::vector<int64_t> dims;
+    std::string data;
+
+    int64_t count() const
+    {
+        return std::accumulate(dims.begin(), dims.end(), int64_t{1}, std::multiplies<int64_t>());
+    }
+};
+
+size_t elementSize(int32_t dtype)
+{
+    switch (dtype)
+    {
+    case TensorProto::FLOAT:
+    case TensorProto::INT32: return 4;
+    case TensorProto::DOUBLE:
+    case TensorProto::INT64: return 8;
+    case TensorProto::INT8:
+    case TensorProto::UINT8:
+    case TensorProto::BOOL: return 1;
+    default: return 0;
+    }
+}
+
+bool isFloating(int32_t dtype)
+{
+    return dtype == TensorProto::FLOAT || dtype == TensorProto::DOUBLE;
+}
+
+bool isArithmetic(int32_t dtype)
+{
+    return isFloating(dtype) || dtype == TensorProto::INT32 || dtype == TensorProto::INT64;
+}
+
+template <typename T>
+T load(Value const& v, int64_t i)
+{
+    T x;
+    std::memcpy(&x, v.data.data() + i * sizeof(T), sizeof(T));
+    return x;
+}
+
+template <typename T>
+void store(Value& v, int64_t i, T x)
+{
+    std::memcpy(&v.data[i * sizeof(T)], &x, sizeof(T));
+}
+
+double getDouble(Value const& v, int64_t i)
+{
+    switch (v.dtype)
+    {
+    case TensorProto::FLOAT: return load<float>(v, i);
+    case TensorProto::DOUBLE: return load<double>(v, i);
+    case TensorProto::INT32: return load<int32_t>(v, i);
+    case TensorProto::INT64: return static_cast<double>(load<int64_t>(v, i));
+    case TensorProto::INT8: return load<int8_t>(v, i);
+    default: return load<uint8_t>(v, i);
+    }
+}
+
+int64_t getInt(Value const& v, int64_t i)
+{
+    switch (v.dtype)
+    {
+    case TensorProto::FLOAT: return static_cast<int64_t>(load<float>(v, i));
+    case TensorProto::DOUBLE: return static_cast<int64_t>(load<double>(v, i));
+    case TensorProto::INT32: return load<int32_t>(v, i);
+    case TensorProto::INT64: return load<int64_t>(v, i);
+    case TensorProto::INT8: return load<int8_t>(v, i);
+    default: return load<uint8_t>(v, i);
+    }
+}
+
+void setDouble(Value& v, int64_t i, double x)
+{
+    switch (v.dtype)
+    {
+    case TensorProto::FLOAT: store(v, i, static_cast<float>(x)); break;
+    case TensorProto::DOUBLE: store(v, i, x); break;
+    case TensorProto::INT32: store(v, i, static_cast<int32_t>(x)); break;
+    case TensorProto::INT64: store(v, i, static_cast<int64_t>(x)); break;
+    case TensorProto::INT8: store(v, i, static_cast<int8_t>(x)); break;
+    case TensorProto::BOOL: store(v, i, static_cast<uint8_t>(x != 0)); break;
+    default: store(v, i, static_cast<uint8_t>(x)); break;
+    }
+}
+
+void setInt(Value& v, int64_t i, int64_t x)
+{
+    switch (v.dtype)
+    {
+    case TensorProto::FLOAT: store(v, i, static_cast<float>(x)); break;
+    case TensorProto::DOUBLE: store(v, i, static_cast<double>(x)); break;
+    case TensorProto::INT32: store(v, i, static_cast<int32_t>(x)); break;
+    case TensorProto::INT64: store(v, i, x); break;
+    case TensorProto::INT8: store(v, i, static_cast<int8_t>(x)); break;
+    case TensorProto::BOOL: store(v, i, static_cast<uint8_t>(x != 0)); break;
+    default: store(v, i, static_cast<uint8_t>(x)); break;
+    }
+}
+
+Value makeValue(int32_t dtype, std::vector<int64_t> dims)
+{
+    Value v;
+    v.dtype = dtype;
+    v.dims = std::move(dims);
+    v.data.resize(v.count() * elementSize(dtype));
+    return v;
+}
+
+bool decode(TensorProto const& tensor, size_t maxBytes, Value* v)
+{
+    const size_t es = elementSize(tensor.data_type());
+    if (es == 0 || tensor.data_location() == TensorProto::EXTERNAL)
+    {
+        return false;
+    }
+    v->dtype = tensor.data_type();
+    v->dims.assign(tensor.dims().begin(), tensor.dims().end());
+    const int64_t count = v->count();
+    if (count < 0 || count * es > maxBytes)
+    {
+        return false;
+    }
+    if (!tensor.raw_data().empty())
+    {
+        v->data = tensor.raw_data();
+        return v->data.size() == count * es;
+    }
+    v->data.assign(count * es, '\0');
+    switch (v->dtype)
+    {
+    case TensorProto::FLOAT:
+        if (tensor.float_data_size() != count)
+        {
+            return false;
+        }
+        std::memcpy(&v->data[0], tensor.float_data().data(), count * es);
+        return true;
+    case TensorProto::DOUBLE:
+        if (tensor.double_data_size() != count)
+        {
+            return false;
+        }
+        std::memcpy(&v->data[0], tensor.double_data().data(), count * es);
+        return true;
+    case TensorProto::INT64:
+        if (tensor.int64_data_size() != count)
+        {
+            return false;
+        }
+        std::memcpy(&v->data[0], tensor.int64_data().data(), count * es);
+        return true;
+    default:
+        // INT32, INT8, UINT8 and BOOL are all stored in int32_data.
+        if (tensor.int32_data_size() != count)
+        {
+            return false;
+        }
+        for (int64_t i = 0; i < count; ++i)
+        {
+            setInt(*v, i, tensor.int32_data(i));
+        }
+        return true;
+    }
+}
+
+TensorProto encode(Value&& v, std::string const& name)
+{
+    TensorProto tensor;
+    tensor.set_name(name);
+    tensor.set_data_type(v.dtype);
+    for (int64_t d : v.dims)
+    {
+        tensor.add_dims(d);
+    }
+    tensor.set_raw_data(std::move(v.data));
+    return tensor;
+}
+
+AttributeProto const* findAttr(NodeProto const& node, char const* name)
+{
+    for (AttributeProto const& attr : node.attribute())
+    {
+        if (attr.name() == name)
+        {
+            return &attr;
+        }
+    }
+    return nullptr;
+}
+
+int64_t getIntAttr(NodeProto const& node, char const* name, int64_t defaultValue)
+{
+    AttributeProto const* attr = findAttr(node, name);
+    return attr ? attr->i() : defaultValue;
+}
+
+// Reads an INT32/INT64 list that newer opsets pass as input i and older ones as an attribute.
+bool getInts(NodeProto const& node, std::vector<Value> const& in, size_t i, char const* attrName,
+    std::vector<int64_t>* values, bool* present)
+{
+    values->clear();
+    *present = false;
+    if (in.size() > i && in[i].dtype != TensorProto::UNDEFINED)
+    {
+        if (in[i].dtype != TensorProto::INT64 && in[i].dtype != TensorProto::INT32)
+        {
+            return false;
+        }
+        for (int64_t j = 0; j < in[i].count(); ++j)
+        {
+            values->push_back(getInt(in[i], j));
+        }
+        *present = true;
+    }
+    else if (AttributeProto const* attr = findAttr(node, attrName))
+    {
+        values->assign(attr->ints().begin(), attr->ints().end());
+        *present = true;
+    }
+    return true;
+}
+
+bool normalizeAxis(int64_t* axis, int64_t rank)
+{
+    if (*axis < 0)
+    {
+        *axis += rank;
+    }
+    return *axis >= 0 && *axis < rank;
+}
+
+int64_t product(std::vector<int64_t> const& dims, size_t begin, size_t end)
+{
+    return std::accumulate(dims.begin() + begin, dims.begin() + end, int64_t{1}, std::multiplies<int64_t>());
+}
+
+// Calls f(index, offsets) for each element of outDims in row-major order, where offsets[k] is the linear index of
+// the element in input k, whose strides (0 for broadcast dimensions) are given per output dimension.
+template <typename F>
+void forEachElement(std::vector<int64_t> const& outDims, std::vector<std::vector<int64_t>> const& strides, F f)
+{
+    const int64_t count = product(outDims, 0, outDims.size());
+    std::vector<int64_t> index(outDims.size(), 0);
+    std::vector<int64_t> offsets(strides.size(), 0);
+    for (int64_t n = 0; n < count; ++n)
+    {
+        f(n, offsets);
+        for (int64_t d = static_cast<int64_t>(outDims.size()) - 1; d >= 0; --d)
+        {
+            for (size_t k = 0; k < strides.size(); ++k)
+            {
+                offsets[k] += strides[k][d];
+            }
+            if (++index[d] < outDims[d])
+            {
+                break;
+            }
+            for (size_t k = 0; k < strides.size(); ++k)
+            {
+                offsets[k] -= strides[k][d] * outDims[d];
+            }
+            index[d] = 0;
+        }
+    }
+}
+
+bool evalCast(NodeProto const& node, std::vector<Value> const& in, Value* out)
+{
+    const int32_t to = static_cast<int32_t>(getIntAttr(node, "to", TensorProto::UNDEFINED));
+    if (elementSize(to) == 0)
+    {
+        return false;
+    }
+    *out = makeValue(to, in[0].dims);
+    for (int64_t i = 0; i < in[0].count(); ++i)
+    {
+        if (isFloating(in[0].dtype))
+        {
+            setDouble(*out, i, getDouble(in[0], i));
+        }
+        else
+        {
+            setInt(*out, i, getInt(in[0], i));
+        }
+    }
+    return true;
+}
+
+bool evalShape(NodeProto const& node, TensorProto const& input, Value* out)
+{
+    const int64_t rank = input.dims_size();
+    int64_t start = getIntAttr(node, "start", 0);
+    int64_t end = getIntAttr(node, "end", rank);
+    start = std::min(std::max(start < 0 ? start + rank : start, int64_t{0}), rank);
+    end = std::min(std::max(end < 0 ? end + rank : end, int64_t{0}), rank);
+    *out = makeValue(TensorProto::INT64, {std::max(end - start, int64_t{0})});
+    for (int64_t i = start; i < end; ++i)
+    {
+        store(*out, i - start, input.dims(i));
+    }
+    return true;
+}
+
+bool evalUnsqueeze(NodeProto const& node, std::vector<Value> const& in, Value* out)
+{
+    std::vector<int64_t> axes;
+    bool present;
+    if (!getInts(node, in, 1, "axes", &axes, &present) || !present)
+    {
+        return false;
+    }
+    const int64_t outRank = static_cast<int64_t>(in[0].dims.size() + axes.size());
+    std::vector<bool> inserted(outRank, false);
+    for (int64_t axis : axes)
+    {
+        if (!normalizeAxis(&axis, outRank) || inserted[axis])
+        {
+            return false;
+        }
+        inserted[axis] = true;
+    }
+    *out = in[0];
+    out->dims.clear();
+    for (int64_t d = 0, j = 0; d < outRank; ++d)
+    {
+        out->dims.push_back(inserted[d] ? 1 : in[0].dims[j++]);
+    }
+    return true;
+}
+
+bool evalSqueeze(NodeProto const& node, std::vector<Value> const& in, Value* out)
+{
+    std::vector<int64_t> axes;
+    bool present;
+    if (!getInts(node, in, 1, "axes", &axes, &present))
+    {
+        return false;
+    }
+    const int64_t rank = static_cast<int64_t>(in[0].dims.size());
+    std::vector<bool> removed(rank, false);
+    for (int64_t d = 0; d < rank && !present; ++d)
+    {
+        removed[d] = in[0].dims[d] == 1;
+    }
+    for (int64_t axis : axes)
+    {
+        if (!normalizeAxis(&axis, rank) || in[0].dims[axis] != 1)
+        {
+            return false;
+        }
+        removed[axis] = true;
+    }
+    *out = in[0];
+    out->dims.clear();
+    for (int64_t d = 0; d < rank; ++d)
+    {
+        if (!removed[d])
+        {
+            out->dims.push_back(in[0].dims[d]);
+        }
+    }
+    return true;
+}
+
+bool evalReshape(NodeProto const& node, std::vector<Value> const& in, Value* out)
+{
+    if (in.size() < 2 || in[1].dtype != TensorProto::INT64)
+    {
+        return false;
+    }
+    const bool allowZero = getIntAttr(node, "allowzero", 0) != 0;
+    std::vector<int64_t> dims;
+    int64_t inferred = -1;
+    for (int64_t i = 0; i < in[1].count(); ++i)
+    {
+        int64_t d = getInt(in[1], i);
+        if (d == 0 && !allowZero)
+        {
+            if (i >= static_cast<int64_t>(in[0].dims.size()))
+            {
+                return false;
+            }
+            d = in[0].dims[i];
+        }
+        else if (d == -1)
+        {
+            if (inferred != -1)
+            {
+                return false;
+            }
+            inferred = i;
+            d = 1;
+        }
+        else if (d < 0)
+        {
+            return false;
+        }
+        dims.push_back(d);
+    }
+    const int64_t known = product(dims, 0, dims.size());
+    if (inferred != -1)
+    {
+        if (known == 0 || in[0].count() % known != 0)
+        {
+            return false;
+        }
+        dims[inferred] = in[0].count() / known;
+    }
+    if (product(dims, 0, dims.size()) != in[0].count())
+    {
+        return false;
+    }
+    *out = in[0];
+    out->dims = dims;
+    return true;
+}
+
+bool evalConcat(NodeProto const& node, std::vector<Value> const& in, Value* out)
+{
+    const size_t rank = in[0].dims.size();
+    int64_t axis = getIntAttr(node, "axis", 0);
+    if (!normalizeAxis(&axis, rank))
+    {
+        return false;
+    }
+    std::vector<int64_t> dims = in[0].dims;
+    dims[axis] = 0;
+    for (Value const& v : in)
+    {
+        if (v.dtype != in[0].dtype || v.dims.size() != rank)
+        {
+            return false;
+        }
+        for (size_t d = 0; d < rank; ++d)
+        {
+            if (d != static_cast<size_t>(axis) && v.dims[d] != in[0].dims[d])
+            {
+                return false;
+            }
+        }
+        dims[axis] += v.dims[axis];
+    }
+    *out = makeValue(in[0].dtype, dims);
+    out->data.clear();
+    const int64_t outer = product(dims, 0, axis);
+    const int64_t inner = product(dims, axis + 1, rank) * elementSize(in[0].dtype);
+    for (int64_t o = 0; o < outer; ++o)
+    {
+        for (Value const& v : in)
+        {
+            const int64_t chunk = v.dims[axis] * inner;
+            out->data.append(v.data, o * chunk, chunk);
+        }
+    }
+    return true;
+}
+
+bool evalGather(NodeProto const& node, std::vector<Value> const& in, Value* out)
+{
+    if (in.size() != 2 || (in[1].dtype != TensorProto::INT32 && in[1].dtype != TensorProto::INT64))
+    {
+        return false;
+    }
+    Value const& data = in[0];
+    const size_t rank = data.dims.size();
+    int64_t axis = getIntAttr(node, "axis", 0);
+    if (!normalizeAxis(&axis, rank))
+    {
+        return false;
+    }
+    std::vector<int64_t> dims(data.dims.begin(), data.dims.begin() + axis);
+    dims.insert(dims.end(), in[1].dims.begin(), in[1].dims.end());
+    dims.insert(dims.end(), data.dims.begin() + axis + 1, data.dims.end());
+    *out = makeValue(data.dtype, dims);
+
+    const int64_t outer = product(data.dims, 0, axis);
+    const int64_t inner = product(data.dims, axis + 1, rank) * elementSize(data.dtype);
+    const int64_t axisDim = data.dims[axis];
+    const int64_t nbIndices = in[1].count();
+    for (int64_t j = 0; j < nbIndices; ++j)
+    {
+        int64_t index = getInt(in[1], j);
+        if (!normalizeAxis(&index, axisDim))
+        {
+            return false;
+        }
+        for (int64_t o = 0; o < outer; ++o)
+        {
+            std::memcpy(&out->data[(o * nbIndices + j) * inner], &data.data[(o * axisDim + index) * inner], inner);
+        }
+    }
+    return true;
+}
+
+bool evalSlice(NodeProto const& node, std::vector<Value> const& in, Value* out)
+{
+    std::vector<int64_t> starts, ends, axes, steps;
+    bool hasStarts, hasEnds, hasAxes, hasSteps;
+    if (!getInts(node, in, 1, "starts", &starts, &hasStarts) || !getInts(node, in, 2, "ends", &ends, &hasEnds)
+        || !getInts(node, in, 3, "axes", &axes, &hasAxes) || !getInts(node, in, 4, "steps", &steps, &hasSteps)
+        || !hasStarts || !hasEnds || starts.size() != ends.size())
+    {
+        return false;
+    }
+    Value const& data = in[0];
+    const int64_t rank = static_cast<int64_t>(data.dims.size());
+    if (!hasAxes)
+    {
+        axes.resize(starts.size());
+        std::iota(axes.begin(), axes.end(), 0);
+    }
+    if (!hasSteps)
+    {
+        steps.assign(starts.size(), 1);
+    }
+    if (axes.size() != starts.size() || steps.size() != starts.size())
+    {
+        return false;
+    }
+
+    std::vector<int64_t> begin(rank, 0), step(rank, 1), dims = data.dims;
+    for (size_t i = 0; i < starts.size(); ++i)
+    {
+        int64_t axis = axes[i];
+        if (!normalizeAxis(&axis, rank) || steps[i] == 0)
+        {
+            return false;
+        }
+        const int64_t dim = data.dims[axis];
+        int64_t s = starts[i] < 0 ? starts[i] + dim : starts[i];
+        int64_t e = ends[i] < 0 ? ends[i] + dim : ends[i];
+        if (steps[i] > 0)
+        {
+            s = std::min(std::max(s, int64_t{0}), dim);
+            e = std::min(std::max(e, int64_t{0}), dim);
+            dims[axis] = std::max((e - s + steps[i] - 1) / steps[i], int64_t{0});
+        }
+        else
+        {
+            s = std::min(std::max(s, int64_t{0}), dim - 1);
+            e = std::min(std::max(e, int64_t{-1}), dim - 1);
+            dims[axis] = std::max((s - e - steps[i] - 1) / -steps[i], int64_t{0});
+        }
+        begin[axis] = s;
+        step[axis] = steps[i];
+    }
+
+    *out = makeValue(data.dtype, dims);
+    const size_t es = elementSize(data.dtype);
+    std::vector<int64_t> strides(rank);
+    int64_t base = 0;
+    for (int64_t d = rank - 1, stride = 1; d >= 0; --d)
+    {
+        strides[d] = stride * step[d];
+        base += begin[d] * stride;
+        stride *= data.dims[d];
+    }
+    forEachElement(dims, {strides}, [&](int64_t n, std::vector<int64_t> const& offsets) {
+        std::memcpy(&out->data[n * es], &data.data[(base + offsets[0]) * es], es);
+    });
+    return true;
+}
+
+bool evalBinary(NodeProto const& node, std::vector<Value> const& in, Value* out)
+{
+    if (in.size() != 2 || in[0].dtype != in[1].dtype || !isArithmetic(in[0].dtype))
+    {
+        return false;
+    }
+    // Multidirectional (numpy-style) broadcasting.
+    const size_t rank = std::max(in[0].dims.size(), in[1].dims.size());
+    std::vector<int64_t> dims(rank, 1);
+    std::vector<std::vector<int64_t>> strides(2, std::vector<int64_t>(rank, 0));
+    for (size_t k = 0; k < 2; ++k)
+    {
+        const size_t offset = rank - in[k].dims.size();
+        int64_t stride = 1;
+        for (int64_t d = static_cast<int64_t>(in[k].dims.size()) - 1; d >= 0; --d)
+        {
+            const int64_t dim = in[k].dims[d];
+            int64_t& outDim = dims[offset + d];
+            if (dim != 1)
+            {
+                if (outDim != 1 && outDim != dim)
+                {
+                    return false;
+                }
+                outDim = dim;
+                strides[k][offset + d] = stride;
+            }
+            stride *= dim;
+        }
+    }
+
+    const std::string& op = node.op_type();
+    const bool floating = isFloating(in[0].dtype);
+    *out = makeValue(in[0].dtype, dims);
+    bool ok = true;
+    forEachElement(dims, strides, [&](int64_t n, std::vector<int64_t> const& offsets) {
+        if (floating)
+        {
+            const double a = getDouble(in[0], offsets[0]);
+            const double b = getDouble(in[1], offsets[1]);
+            setDouble(*out, n, op == "Add" ? a + b : op == "Sub" ? a - b : op == "Mul" ? a * b : a / b);
+            return;
+        }
+        const int64_t a = getInt(in[0], offsets[0]);
+        const int64_t b = getInt(in[1], offsets[1]);
+        if (op == "Div" && (b == 0 || (a % b != 0 && (a < 0) != (b < 0))))
+        {
+            // Leave division by zero and rounding of negative quotients to the runtime.
+            ok = false;
+            return;
+        }
+        setInt(*out, n, op == "Add" ? a + b : op == "Sub" ? a - b : op == "Mul" ? a * b : a / b);
+    });
+    return ok;
+}
+
+bool evalConstantOfShape(NodeProto const& node, std::vector<Value> const& in, size_t maxBytes, Value* out)
+{
+    if (in[0].dtype != TensorProto::INT64)
+    {
+        return false;
+    }
+    std::vector<int64_t> dims;
+    for (int64_t i = 0; i < in[0].count(); ++i)
+    {
+        dims.push_back(getInt(in[0], i));
+        if (dims.back() < 0)
+        {
+            return false;
+        }
+    }
+    Value value = makeValue(TensorProto::FLOAT, {1});
+    AttributeProto const* attr = findAttr(node, "value");
+    if (attr && (!decode(attr->t(), maxBytes, &value) || value.count() != 1))
+    {
+        return false;
+    }
+    const size_t es = elementSize(value.dtype);
+    if (product(dims, 0, dims.size()) * es > maxBytes)
+    {
+        return false;
+    }
+    *out = makeValue(value.dtype, dims);
+    for (int64_t i = 0; i < out->count(); ++i)
+    {
+        std::memcpy(&out->data[i * es], value.data.data(), es);
+    }
+    return true;
+}
+
+bool evalRange(std::vector<Value> const& in, size_t maxBytes, Value* out)
+{
+    const int32_t dtype = in[0].dtype;
+    if (in.size() != 3 || !isArithmetic(dtype))
+    {
+        return false;
+    }
+    for (Value const& v : in)
+    {
+        if (v.dtype != dtype || v.count() != 1)
+        {
+            return false;
+        }
+    }
+    int64_t n;
+    if (isFloating(dtype))
+    {
+        const double start = getDouble(in[0], 0), limit = getDouble(in[1], 0), delta = getDouble(in[2], 0);
+        if (delta == 0)
+        {
+            return false;
+        }
+        n = std::max(static_cast<int64_t>(std::ceil((limit - start) / delta)), int64_t{0});
+        if (n * elementSize(dtype) > maxBytes)
+        {
+            return false;
+        }
+        *out = makeValue(dtype, {n});
+        for (int64_t i = 0; i < n; ++i)
+        {
+            setDouble(*out, i, start + i * delta);
+        }
+        return true;
+    }
+    const int64_t start = getInt(in[0], 0), limit = getInt(in[1], 0), delta = getInt(in[2], 0);
+    if (delta == 0)
+    {
+        return false;
+    }
+    n = delta > 0 ? (limit - start + delta - 1) / delta : (start - limit - delta - 1) / -delta;
+    n = std::max(n, int64_t{0});
+    if (n * elementSize(dtype) > maxBytes)
+    {
+        return false;
+    }
+    *out = makeValue(dtype, {n});
+    for (int64_t i = 0; i < n; ++i)
+    {
+        setInt(*out, i, start + i * delta);
+    }
+    return true;
+}
+
+bool evaluate(NodeProto const& node, std::vector<Value> const& in, size_t maxBytes, Value* out)
+{
+    const std::string& op = node.op_type();
+    if (op == "Identity")
+    {
+        *out = in[0];
+        return true;
+    }
+    if (op == "Cast")
+    {
+        return evalCast(node, in, out);
+    }
+    if (op == "Unsqueeze")
+    {
+        return evalUnsqueeze(node, in, out);
+    }
+    if (op == "Squeeze")
+    {
+        return evalSqueeze(node, in, out);
+    }
+    if (op == "Reshape")
+    {
+        return evalReshape(node, in, out);
+    }
+    if (op == "Concat")
+    {
+        return evalConcat(node, in, out);
+    }
+    if (op == "Gather")
+    {
+        return evalGather(node, in, out);
+    }
+    if (op == "Slice")
+    {
+        return evalSlice(node, in, out);
+    }
+    if (op == "Add" || op == "Sub" || op == "Mul" || op == "Div")
+    {
+        return evalBinary(node, in, out);
+    }
+    if (op == "ConstantOfShape")
+    {
+        return evalConstantOfShape(node, in, maxBytes, out);
+    }
+    if (op == "Range")
+    {
+        return evalRange(in, maxBytes, out);
+    }
+    return false;
+}
+
+bool isFoldable(std::string const& op)
+{
+    static const std::vector<std::string> kOPS{"Identity", "Cast", "Shape", "Unsqueeze", "Squeeze", "Reshape",
+        "Concat", "Gather", "Slice", "Add", "Sub", "Mul", "Div", "ConstantOfShape", "Range"};
+    return std::find(kOPS.begin(), kOPS.end(), op) != kOPS.end();
+}
+
+void appendKey(std::string* key, std::string const& bytes)
+{
+    const uint64_t size = bytes.size();
+    key->append(reinterpret_cast<char const*>(&size), sizeof(size));
+    key->append(bytes);
+}
+
+void appendKey(std::string* key, int32_t dtype, std::vector<int64_t> const& dims)
+{
+    key->append(reinterpret_cast<char const*>(&dtype), sizeof(dtype));
+    appendKey(key, std::string(reinterpret_cast<char const*>(dims.data()), dims.size() * sizeof(int64_t)));
+}
+
+} // namespace
+
+ConstantFoldingCache& ConstantFoldingCache::global()
+{
+    static ConstantFoldingCache cache;
+    return cache;
+}
+
+bool ConstantFoldingCache::find(std::string const& key, std::vector<::ONNX_NAMESPACE::TensorProto>* outputs)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto it = mEntries.find(key);
+    if (it == mEntries.end())
+    {
+        return false;
+    }
+    *outputs = it->second;
+    return true;
+}
+
+void ConstantFoldingCache::insert(std::string const& key, std::vector<::ONNX_NAMESPACE::TensorProto> const& outputs)
+{
+    size_t bytes = 0;
+    for (auto const& output : outputs)
+    {
+        bytes += output.raw_data().size();
+    }
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mBytes + bytes > mCapacity || !mEntries.emplace(key, outputs).second)
+    {
+        return;
+    }
+    mBytes += bytes;
+}
+
+bool FoldedConstants::foldNode(::ONNX_NAMESPACE::NodeProto const& node,
+    std::unordered_map<std::string, ::ONNX_NAMESPACE::TensorProto const*> const& constants)
+{
+    if (!isFoldable(node.op_type()) || node.output_size() != 1 || node.input_size() == 0)
+    {
+        return false;
+    }
+
+    // The cache key covers everything the result depends on: the op, its attributes and its input values.
+    std::string key = node.op_type();
+    key += '\0';
+    for (AttributeProto const& attr : node.attribute())
+    {
+        appendKey(&key, attr.SerializeAsString());
+    }
+
+    Value out;
+    std::vector<Value> inputs(node.input_size());
+    if (node.op_type() == "Shape")
+    {
+        // Only the dimensions matter, so the (possibly large or external) data is never read.
+        TensorProto const& input = *constants.at(node.input(0));
+        appendKey(&key, input.data_type(), {input.dims().begin(), input.dims().end()});
+        if (!evalShape(node, input, &out))
+        {
+            return false;
+        }
+    }
+    else
+    {
+        for (int i = 0; i < node.input_size(); ++i)
+        {
+            if (node.input(i).empty())
+            {
+                appendKey(&key, TensorProto::UNDEFINED, {});
+                continue;
+            }
+            if (!decode(*constants.at(node.input(i)), mMaxFoldedBytes, &inputs[i]))
+            {
+                return false;
+            }
+            appendKey(&key, inputs[i].dtype, inputs[i].dims);
+            appendKey(&key, inputs[i].data);
+        }
+    }
+    const std::string digest = sha1Hex(key.data(), key.size());
+
+    std::vector<TensorProto> outputs;
+    if (mCache && mCache->find(digest, &outputs))
+    {
+        outputs[0].set_name(node.output(0));
+        ++mNbCacheHits;
+    }
+    else
+    {
+        if (node.op_type() != "Shape" && !evaluate(node, inputs, mMaxFoldedBytes, &out))
+        {
+            return false;
+        }
+        if (out.data.size() > mMaxFoldedBytes)
+        {
+            return false;
+        }
+        outputs.push_back(encode(std::move(out), node.output(0)));
+        if (mCache)
+        {
+            mCache->insert(digest, outputs);
+        }
+    }
+    mOutputs.emplace(&node, std::move(outputs));
+    return true;
+}
+
+void FoldedConstants::fold(::ONNX_NAMESPACE::GraphProto const& graph)
+{
+    std::unordered_map<std::string, TensorProto const*> constants;
+    for (TensorProto const& initializer : graph.initializer())
+    {
+        constants[initializer.name()] = &initializer;
+    }
+
+    // Nodes are normally listed in topological order, in which case the second sweep finds nothing new.
+    std::vector<bool> visited(graph.node_size(), false);
+    for (bool changed = true; changed;)
+    {
+        changed = false;
+        for (int i = 0; i < graph.node_size(); ++i)
+        {
+            NodeProto const& node = graph.node(i);
+            if (visited[i] || !(node.domain().empty() || node.domain() == "ai.onnx"))
+            {
+                continue;
+            }
+            if (node.op_type() == "Constant")
+            {
+                AttributeProto const* value = findAttr(node, "value");
+                if (value && value->type() == AttributeProto::TENSOR && node.output_size() == 1)
+                {
+                    constants[node.output(0)] = &value->t();
+                    changed = true;
+                }
+                visited[i] = true;
+                continue;
+            }
+            const bool ready = std::all_of(node.input().begin(), node.input().end(),
+                [&constants](std::string const& name) { return name.empty() || constants.count(name); });
+            if (!ready)
+            {
+                continue;
+            }
+            visited[i] = true;
+            if (foldNode(node, constants))
+            {
+                constants[node.output(0)] = &mOutputs.at(&node)[0];
+                changed = true;
+            }
+        }
+    }
+}
+
+} // namespace onnx2trt
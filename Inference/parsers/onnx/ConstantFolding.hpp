@@ -0,0 +1,98 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <onnx/onnx_pb.h>
+
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace onnx2trt
+{
+
+//! Folded node outputs keyed by a digest of the node (op, attributes and input values). Split stages of one model
+//! share most of their shape arithmetic, so a process-wide instance lets later stages skip the evaluation.
+class ConstantFoldingCache
+{
+public:
+    //! Once this many bytes of outputs are cached, further results are not inserted.
+    static constexpr size_t kDEFAULT_CAPACITY = 64 << 20;
+
+    explicit ConstantFoldingCache(size_t capacity = kDEFAULT_CAPACITY)
+        : mCapacity(capacity)
+    {
+    }
+
+    //! Shared by all parsers in the process.
+    static ConstantFoldingCache& global();
+
+    bool find(std::string const& key, std::vector<::ONNX_NAMESPACE::TensorProto>* outputs);
+    void insert(std::string const& key, std::vector<::ONNX_NAMESPACE::TensorProto> const& outputs);
+
+    size_t size() const
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mEntries.size();
+    }
+
+private:
+    mutable std::mutex mMutex;
+    std::unordered_map<std::string, std::vector<::ONNX_NAMESPACE::TensorProto>> mEntries;
+    size_t mBytes{0};
+    size_t mCapacity;
+};
+
+//! Nodes of a graph whose inputs are all constant (initializers, Constant nodes or other folded nodes), evaluated on
+//! the host so that the importer can register their outputs as weights instead of adding layers. Covers the shape
+//! arithmetic exporters emit (Shape, Gather, Unsqueeze, Concat, Cast, ...) and simple elementwise math. Only the
+//! top-level graph is folded; nodes that cannot be evaluated are left to their importers.
+class FoldedConstants
+{
+public:
+    //! Nodes whose inputs or outputs exceed this many bytes are not folded.
+    static constexpr size_t kMAX_FOLDED_BYTES = 1 << 20;
+
+    explicit FoldedConstants(ConstantFoldingCache* cache = nullptr, size_t maxFoldedBytes = kMAX_FOLDED_BYTES)
+        : mCache(cache)
+        , mMaxFoldedBytes(maxFoldedBytes)
+    {
+    }
+
+    //! Evaluate every foldable node of graph. graph must outlive this object.
+    void fold(::ONNX_NAMESPACE::GraphProto const& graph);
+
+    //! Returns the outputs of node if it was folded, in node output order, or nullptr if it must be imported.
+    std::vector<::ONNX_NAMESPACE::TensorProto> const* find(::ONNX_NAMESPACE::NodeProto const& node) const
+    {
+        auto it = mOutputs.find(&node);
+        return it == mOutputs.end() ? nullptr : &it->second;
+    }
+
+    //! Number of folded nodes.
+    size_t size() const
+    {
+        return mOutputs.size();
+    }
+
+    //! Number of folded nodes whose outputs came from the cache.
+    size_t getNbCacheHits() const
+    {
+        return mNbCacheHits;
+    }
+
+private:
+    bool foldNode(::ONNX_NAMESPACE::NodeProto const& node,
+        std::unordered_map<std::string, ::ONNX_NAMESPACE::TensorProto const*> const& constants);
+
+    ConstantFoldingCache* mCache;
+    size_t mMaxFoldedBytes;
+    size_t mNbCacheHits{0};
+    std::unordered_map<::ONNX_NAMESPACE::NodeProto const*, std::vector<::ONNX_NAMESPACE::TensorProto>> mOutputs;
+};
+
+} // namespace onnx2trt
@@ -0,0 +1,493 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "CostModel.hpp"
+
+#include <onnx/common/ir.h>
+#include <onnx/common/ir_pb_converter.h>
+#include <onnx/shape_inference/implementation.h>
+
+#include <algorithm>
+#include <exception>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace onnx2trt
+{
+
+namespace
+{
+
+using ::ONNX_NAMESPACE::Node;
+using ::ONNX_NAMESPACE::TensorProto;
+using ::ONNX_NAMESPACE::Value;
+
+size_t getElementSize(int32_t type)
+{
+    switch (type)
+    {
+    case TensorProto::BOOL:
+    case TensorProto::INT8:
+    case TensorProto::UINT8: return 1;
+    case TensorProto::FLOAT16:
+    case TensorProto::BFLOAT16:
+    case TensorProto::INT16:
+    case TensorProto::UINT16: return 2;
+    case TensorProto::FLOAT:
+    case TensorProto::INT32:
+    case TensorProto::UINT32: return 4;
+    case TensorProto::DOUBLE:
+    case TensorProto::INT64:
+    case TensorProto::UINT64:
+    case TensorProto::COMPLEX64: return 8;
+    case TensorProto::COMPLEX128: return 16;
+    default: return 0;
+    }
+}
+
+// Shape information of the analyzed model. IR Values cannot tell a scalar from a tensor whose shape was never
+// inferred, so whether a shape is known is looked up in the proto.
+class Shapes
+{
+public:
+    explicit Shapes(::ONNX_NAMESPACE::GraphProto const& graph)
+    {
+        auto add = [this](::ONNX_NAMESPACE::ValueInfoProto const& info) {
+            auto const& type = info.type().tensor_type();
+            if (!type.has_shape() || getElementSize(type.elem_type()) == 0)
+            {
+                return;
+            }
+            for (auto const& dim : type.shape().dim())
+            {
+                if (!dim.has_dim_value() || dim.dim_value() < 0)
+                {
+                    return;
+                }
+            }
+            mKnown.insert(info.name());
+        };
+        std::for_each(graph.input().begin(), graph.input().end(), add);
+        std::for_each(graph.value_info().begin(), graph.value_info().end(), add);
+        std::for_each(graph.output().begin(), graph.output().end(), add);
+    }
+
+    bool known(Value const* value) const
+    {
+        return mKnown.count(value->uniqueName()) != 0;
+    }
+
+    static int64_t volume(Value const* value)
+    {
+        int64_t v = 1;
+        for (auto const& dim : value->sizes())
+        {
+            v *= dim.dim;
+        }
+        return v;
+    }
+
+    static size_t bytes(Value const* value)
+    {
+        return static_cast<size_t>(volume(value)) * getElementSize(value->elemType());
+    }
+
+private:
+    std::unordered_set<std::string> mKnown;
+};
+
+// Pin the batch and named dimensions of the graph inputs, declare initializers as inputs so that both shape
+// inference and the IR converter can see them, and drop stale shape annotations.
+void prepareModel(::ONNX_NAMESPACE::ModelProto* model, CostModelOptions const& options)
+{
+    ::ONNX_NAMESPACE::GraphProto* graph = model->mutable_graph();
+    std::unordered_set<std::string> declared;
+    for (auto& input : *graph->mutable_input())
+    {
+        declared.insert(input.name());
+        auto* type = input.mutable_type()->mutable_tensor_type();
+        if (!type->has_shape())
+        {
+            continue;
+        }
+        for (int i = 0; i < type->shape().dim_size(); ++i)
+        {
+            auto* dim = type->mutable_shape()->mutable_dim(i);
+            if (dim->has_dim_value())
+            {
+                continue;
+            }
+            auto it = options.dimParams.find(dim->dim_param());
+            if (it != options.dimParams.end())
+            {
+                dim->set_dim_value(it->second);
+            }
+            else if (i == 0)
+            {
+                dim->set_dim_value(1);
+            }
+        }
+    }
+    for (auto const& initializer : graph->initializer())
+    {
+        if (declared.count(initializer.name()))
+        {
+            continue;
+        }
+        auto* input = graph->add_input();
+        input->set_name(initializer.name());
+        auto* type = input->mutable_type()->mutable_tensor_type();
+        type->set_elem_type(initializer.data_type());
+        auto* shape = type->mutable_shape();
+        for (int64_t d : initializer.dims())
+        {
+            shape->add_dim()->set_dim_value(d);
+        }
+    }
+    graph->clear_value_info();
+    for (auto& output : *graph->mutable_output())
+    {
+        output.mutable_type()->mutable_tensor_type()->clear_shape();
+    }
+}
+
+int64_t getProduct(std::vector<::ONNX_NAMESPACE::Dimension> const& dims, size_t begin)
+{
+    int64_t v = 1;
+    for (size_t i = begin; i < dims.size(); ++i)
+    {
+        v *= dims[i].dim;
+    }
+    return v;
+}
+
+bool isElementwise(std::string const& op)
+{
+    static const std::unordered_set<std::string> kOPS{"Abs", "Acos", "Acosh", "Add", "And", "Asin", "Asinh", "Atan",
+        "Atanh", "BitShift", "Ceil", "Celu", "Clip", "Cos", "Cosh", "Div", "Elu", "Equal", "Erf", "Exp", "Floor", "Gelu",
+        "Greater", "GreaterOrEqual", "HardSigmoid", "HardSwish", "IsInf", "IsNaN", "LeakyRelu", "Less", "LessOrEqual",
+        "Log", "Max", "Mean", "Min", "Mod", "Mul", "Neg", "Not", "Or", "PRelu", "Pow", "QuantizeLinear",
+        "DequantizeLinear", "Reciprocal", "Relu", "Resize", "Round", "Selu", "Sigmoid", "Sign", "Sin", "Sinh",
+        "Softplus", "Softsign", "Sqrt", "Sub", "Sum", "Tan", "Tanh", "ThresholdedRelu", "Upsample", "Where", "Xor"};
+    return kOPS.count(op) != 0;
+}
+
+// FLOPs of node for one sample, given that every input and output shape is known.
+double getFlops(Node* node)
+{
+    std::string const op = node->kind().toString();
+    auto inputs = node->inputs();
+    auto outputs = node->outputs();
+    double const out = outputs.empty() ? 0. : static_cast<double>(Shapes::volume(outputs[0]));
+    auto hasInput = [&inputs](size_t i) { return inputs.size() > i && !inputs[i]->uniqueName().empty(); };
+
+    if (op == "Conv")
+    {
+        // Each output element is a dot product over C/group input channels times the kernel window.
+        double const macs = static_cast<double>(getProduct(inputs[1]->sizes(), 1));
+        return out * 2. * macs + (hasInput(2) ? out : 0.);
+    }
+    if (op == "ConvTranspose")
+    {
+        // Each input element is scattered to M/group output channels times the kernel window.
+        double const in = static_cast<double>(Shapes::volume(inputs[0]));
+        double const macs = static_cast<double>(getProduct(inputs[1]->sizes(), 1));
+        return in * 2. * macs + (hasInput(2) ? out : 0.);
+    }
+    if (op == "MatMul" || op == "Gemm")
+    {
+        auto const& a = inputs[0]->sizes();
+        if (a.empty())
+        {
+            return 0.;
+        }
+        int64_t k = a.back().dim;
+        if (op == "Gemm" && node->hasAttribute(::ONNX_NAMESPACE::ktransA) && node->i(::ONNX_NAMESPACE::ktransA))
+        {
+            k = a.front().dim;
+        }
+        return out * 2. * static_cast<double>(k) + (op == "Gemm" && hasInput(2) ? out : 0.);
+    }
+    if (op == "MaxPool" || op == "AveragePool" || op == "LpPool")
+    {
+        if (!node->hasAttribute(::ONNX_NAMESPACE::kkernel_shape))
+        {
+            return out;
+        }
+        double window = 1.;
+        for (int64_t k : node->is(::ONNX_NAMESPACE::kkernel_shape))
+        {
+            window *= static_cast<double>(k);
+        }
+        return out * window;
+    }
+    if (op == "GlobalAveragePool" || op == "GlobalMaxPool" || op == "GlobalLpPool" || op.compare(0, 6, "Reduce") == 0
+        || op == "ArgMax" || op == "ArgMin" || op == "TopK")
+    {
+        return static_cast<double>(Shapes::volume(inputs[0]));
+    }
+    if (op == "BatchNormalization")
+    {
+        // Folds into a per-channel scale and shift at inference time.
+        return 2. * out;
+    }
+    if (op == "Softmax" || op == "LogSoftmax" || op == "InstanceNormalization" || op == "LayerNormalization"
+        || op == "MeanVarianceNormalization" || op == "LpNormalization" || op == "LRN")
+    {
+        // A reduction, a subtraction or division and a transcendental per element, give or take.
+        return 5. * out;
+    }
+    if (isElementwise(op))
+    {
+        return out;
+    }
+    return 0.;
+}
+
+// Marks every value a control-flow body reads from the enclosing graph as used by node index.
+void markCaptured(::ONNX_NAMESPACE::Graph& body, std::unordered_map<std::string, Value*> const& outerValues,
+    size_t index, std::unordered_map<Value const*, size_t>* lastUse)
+{
+    for (Node* node : body.nodes())
+    {
+        if (node->kind() == ::ONNX_NAMESPACE::kCaptured)
+        {
+            auto it = outerValues.find(node->outputs()[0]->uniqueName());
+            if (it != outerValues.end())
+            {
+                (*lastUse)[it->second] = index;
+            }
+        }
+        for (auto name : node->attributeNames())
+        {
+            if (node->kindOf(name) == ::ONNX_NAMESPACE::AttributeKind::g)
+            {
+                markCaptured(*node->g(name), outerValues, index, lastUse);
+            }
+            else if (node->kindOf(name) == ::ONNX_NAMESPACE::AttributeKind::gs)
+            {
+                for (auto const& graph : node->gs(name))
+                {
+                    markCaptured(*graph, outerValues, index, lastUse);
+                }
+            }
+        }
+    }
+}
+
+} // namespace
+
+bool ModelCost::analyze(::ONNX_NAMESPACE::ModelProto const& model, CostModelOptions const& options, std::string* error)
+{
+    mNodes.clear();
+    mCutPoints.clear();
+    mTotalFlops = 0;
+    mTotalParamBytes = 0;
+
+    ::ONNX_NAMESPACE::ModelProto inferred = model;
+    prepareModel(&inferred, options);
+    std::unique_ptr<::ONNX_NAMESPACE::Graph> graph;
+    try
+    {
+        ::ONNX_NAMESPACE::shape_inference::InferShapes(inferred);
+        graph = ::ONNX_NAMESPACE::ImportModelProto(inferred);
+    }
+    catch (std::exception const& e)
+    {
+        *error = std::string("Shape inference failed: ") + e.what();
+        return false;
+    }
+    if (!graph)
+    {
+        *error = "Unsupported IR version " + std::to_string(model.ir_version());
+        return false;
+    }
+    Shapes const shapes(inferred.graph());
+
+    std::unordered_set<std::string> initializers;
+    for (auto const& initializer : inferred.graph().initializer())
+    {
+        initializers.insert(initializer.name());
+    }
+
+    // Leaf constants are stored in the engine as weights. Values computed from constants only are folded at build
+    // time, so they are neither activations nor weights of their own.
+    std::unordered_set<Value const*> leafConstants;
+    std::unordered_set<Value const*> constants;
+    std::unordered_map<std::string, Value*> valuesByName;
+    std::unordered_map<Value const*, size_t> defined;
+    std::unordered_map<Value const*, size_t> lastUse;
+    for (Value* input : graph->inputs())
+    {
+        valuesByName[input->uniqueName()] = input;
+        if (initializers.count(input->uniqueName()))
+        {
+            leafConstants.insert(input);
+            constants.insert(input);
+        }
+    }
+
+    std::vector<Node*> nodes;
+    for (Node* node : graph->nodes())
+    {
+        if (node->kind() == ::ONNX_NAMESPACE::kUndefined)
+        {
+            continue;
+        }
+        size_t const index = nodes.size();
+        nodes.push_back(node);
+        bool allConstant = true;
+        for (Value* input : node->inputs())
+        {
+            if (input->uniqueName().empty())
+            {
+                continue;
+            }
+            lastUse[input] = index;
+            allConstant = allConstant && constants.count(input);
+        }
+        for (auto name : node->attributeNames())
+        {
+            if (node->kindOf(name) == ::ONNX_NAMESPACE::AttributeKind::g)
+            {
+                allConstant = false;
+                markCaptured(*node->g(name), valuesByName, index, &lastUse);
+            }
+            else if (node->kindOf(name) == ::ONNX_NAMESPACE::AttributeKind::gs)
+            {
+                allConstant = false;
+                for (auto const& body : node->gs(name))
+                {
+                    markCaptured(*body, valuesByName, index, &lastUse);
+                }
+            }
+        }
+        bool const isConstant = node->kind() == ::ONNX_NAMESPACE::kConstant;
+        for (Value* output : node->outputs())
+        {
+            valuesByName[output->uniqueName()] = output;
+            defined[output] = index + 1;
+            if (isConstant)
+            {
+                leafConstants.insert(output);
+            }
+            if (allConstant)
+            {
+                constants.insert(output);
+            }
+        }
+    }
+
+    std::unordered_set<Value const*> attributed;
+    for (Node* node : nodes)
+    {
+        NodeCost cost;
+        cost.name = node->name();
+        cost.opType = node->kind().toString();
+        if (cost.name.empty() && !node->outputs().empty())
+        {
+            cost.name = node->outputs()[0]->uniqueName();
+        }
+        for (Value* input : node->inputs())
+        {
+            if (input->uniqueName().empty())
+            {
+                continue;
+            }
+            bool const known = shapes.known(input);
+            cost.shapesKnown = cost.shapesKnown && known;
+            if (known && leafConstants.count(input) && attributed.insert(input).second)
+            {
+                cost.paramBytes += Shapes::bytes(input);
+            }
+        }
+        bool allConstant = true;
+        for (Value* output : node->outputs())
+        {
+            bool const known = shapes.known(output);
+            cost.shapesKnown = cost.shapesKnown && known;
+            allConstant = allConstant && constants.count(output);
+            if (known && !constants.count(output))
+            {
+                cost.activationBytes += Shapes::bytes(output);
+            }
+        }
+        if (cost.shapesKnown && !allConstant)
+        {
+            cost.flops = getFlops(node);
+        }
+        mTotalFlops += cost.flops;
+        mTotalParamBytes += cost.paramBytes;
+        mNodes.push_back(std::move(cost));
+    }
+
+    // Sweep the cuts in order, keeping the set of live non-constant values. Values are ordered by definition so
+    // that the boundary tensors are listed deterministically.
+    using LiveKey = std::pair<size_t, std::string>;
+    std::vector<std::vector<LiveKey>> expiring(nodes.size());
+    std::map<LiveKey, Value const*> live;
+    auto addLive = [&](Value const* value, size_t definedAt) {
+        auto it = lastUse.find(value);
+        if (constants.count(value) || it == lastUse.end() || it->second < definedAt)
+        {
+            return;
+        }
+        LiveKey key(definedAt, value->uniqueName());
+        live.emplace(key, value);
+        expiring[it->second].push_back(std::move(key));
+    };
+    for (Value* input : graph->inputs())
+    {
+        addLive(input, 0);
+    }
+
+    CutPoint cut;
+    for (size_t position = 1; position < nodes.size(); ++position)
+    {
+        NodeCost const& previous = mNodes[position - 1];
+        cut.prefixFlops += previous.flops;
+        cut.prefixParamBytes += previous.paramBytes;
+        cut.prefixActivationBytes += previous.activationBytes;
+        for (Value const* output : nodes[position - 1]->outputs())
+        {
+            addLive(output, defined[output]);
+        }
+        for (LiveKey const& key : expiring[position - 1])
+        {
+            live.erase(key);
+        }
+
+        cut.position = position;
+        cut.boundaryTensors.clear();
+        cut.boundaryBytes = 0;
+        cut.boundaryKnown = true;
+        for (auto const& entry : live)
+        {
+            cut.boundaryTensors.push_back(entry.first.second);
+            if (shapes.known(entry.second))
+            {
+                cut.boundaryBytes += Shapes::bytes(entry.second);
+            }
+            else
+            {
+                cut.boundaryKnown = false;
+            }
+        }
+        mCutPoints.push_back(cut);
+    }
+    return true;
+}
+
+std::vector<CutPoint> ModelCost::getCandidates(size_t maxBoundaryTensors) const
+{
+    std::vector<CutPoint> candidates;
+    std::copy_if(mCutPoints.begin(), mCutPoints.end(), std::back_inserter(candidates),
+        [maxBoundaryTensors](CutPoint const& cut) { return cut.boundaryTensors.size() <= maxBoundaryTensors; });
+    return candidates;
+}
+
+} // namespace onnx2trt
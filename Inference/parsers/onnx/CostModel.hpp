@@ -0,0 +1,103 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <onnx/onnx_pb.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace onnx2trt
+{
+
+struct CostModelOptions
+{
+    //! Values for symbolic dimensions, by dim_param name. A symbolic or missing leading dimension of a graph input
+    //! that is not listed here is taken to be the batch dimension and set to 1.
+    std::map<std::string, int64_t> dimParams;
+};
+
+//! Cost of one node for a single sample. Activation costs grow linearly with the batch size; parameter bytes do not.
+struct NodeCost
+{
+    std::string name;
+    std::string opType;
+    double flops{0};
+    //! Bytes of the initializers and Constant outputs the node reads. A constant shared by several nodes is
+    //! attributed to the first of them, so that the bytes of a stage are the sum over its nodes.
+    size_t paramBytes{0};
+    //! Bytes of the activations the node produces.
+    size_t activationBytes{0};
+    //! False if shape inference could not resolve every input and output, in which case the costs are partial.
+    bool shapesKnown{true};
+};
+
+//! Splitting the graph before node `position` (in topological order) gives a first stage of nodes [0, position) and
+//! a second stage of the rest. Byte and FLOP counts are per sample unless stated otherwise.
+struct CutPoint
+{
+    size_t position{0};
+    //! Non-constant tensors produced by the first stage (or graph inputs) that the second stage reads.
+    std::vector<std::string> boundaryTensors;
+    size_t boundaryBytes{0};
+    bool boundaryKnown{true};
+    double prefixFlops{0};
+    size_t prefixParamBytes{0};
+    size_t prefixActivationBytes{0};
+};
+
+//! Static FLOP and byte estimate of an ONNX model at every position where it could be split into two stages. Shapes
+//! come from ONNX shape inference with the batch dimension pinned to 1, so the analysis runs without a GPU. Multiply-
+//! adds count as two FLOPs; data movement ops (Reshape, Transpose, Concat, ...) count as zero. The bodies of
+//! control-flow nodes are not costed.
+class ModelCost
+{
+public:
+    //! Returns false and sets error if the model cannot be analyzed.
+    bool analyze(::ONNX_NAMESPACE::ModelProto const& model, CostModelOptions const& options, std::string* error);
+
+    std::vector<NodeCost> const& getNodes() const
+    {
+        return mNodes;
+    }
+
+    //! One entry for each position 1 .. getNodes().size() - 1.
+    std::vector<CutPoint> const& getCutPoints() const
+    {
+        return mCutPoints;
+    }
+
+    //! Cut points crossed by at most maxBoundaryTensors tensors. An early exit can only be attached where the whole
+    //! state of the network fits in the tensors handed to the next stage, so these are the placement candidates.
+    std::vector<CutPoint> getCandidates(size_t maxBoundaryTensors) const;
+
+    double getTotalFlops() const
+    {
+        return mTotalFlops;
+    }
+
+    size_t getTotalParamBytes() const
+    {
+        return mTotalParamBytes;
+    }
+
+    //! Bytes moved to compact the survivors of an exit at cut: every surviving sample's boundary tensors are read
+    //! and written once.
+    static double getCompactionBytes(CutPoint const& cut, int64_t nbSurvivors)
+    {
+        return 2.0 * static_cast<double>(cut.boundaryBytes) * static_cast<double>(nbSurvivors);
+    }
+
+private:
+    std::vector<NodeCost> mNodes;
+    std::vector<CutPoint> mCutPoints;
+    double mTotalFlops{0};
+    size_t mTotalParamBytes{0};
+};
+
+} // namespace onnx2trt
@@ -0,0 +1,400 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "ExternalData.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace onnx2trt
+{
+
+namespace
+{
+
+// Minimal SHA1 (FIPS 180-1), only used to check the optional "checksum" entry of external data.
+class Sha1
+{
+public:
+    void update(uint8_t const* data, size_t size)
+    {
+        mLength += size;
+        while (size > 0)
+        {
+            const size_t n = std::min(size, sizeof(mBuffer) - mBufferSize);
+            std::memcpy(mBuffer + mBufferSize, data, n);
+            mBufferSize += n;
+            data += n;
+            size -= n;
+            if (mBufferSize == sizeof(mBuffer))
+            {
+                processBlock(mBuffer);
+                mBufferSize = 0;
+            }
+        }
+    }
+
+    std::string hexDigest()
+    {
+        const uint64_t bitLength = mLength * 8;
+        const uint8_t pad = 0x80;
+        const uint8_t zero = 0;
+        update(&pad, 1);
+        while (mBufferSize != 56)
+        {
+            update(&zero, 1);
+        }
+        uint8_t lengthBytes[8];
+        for (int i = 0; i < 8; ++i)
+        {
+            lengthBytes[i] = static_cast<uint8_t>(bitLength >> (56 - 8 * i));
+        }
+        update(lengthBytes, 8);
+
+        static const char* kHEX = "0123456789abcdef";
+        std::string digest;
+        for (uint32_t h : mState)
+        {
+            for (int shift = 28; shift >= 0; shift -= 4)
+            {
+                digest += kHEX[(h >> shift) & 0xF];
+            }
+        }
+        return digest;
+    }
+
+private:
+    static uint32_t rotl(uint32_t x, int n)
+    {
+        return (x << n) | (x >> (32 - n));
+    }
+
+    void processBlock(uint8_t const* block)
+    {
+        uint32_t w[80];
+        for (int i = 0; i < 16; ++i)
+        {
+            w[i] = (uint32_t(block[4 * i]) << 24) | (uint32_t(block[4 * i + 1]) << 16)
+                | (uint32_t(block[4 * i + 2]) << 8) | uint32_t(block[4 * i + 3]);
+        }
+        for (int i = 16; i < 80; ++i)
+        {
+            w[i] = rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+        }
+        uint32_t a = mState[0], b = mState[1], c = mState[2], d = mState[3], e = mState[4];
+        for (int i = 0; i < 80; ++i)
+        {
+            uint32_t f, k;
+            if (i < 20)
+            {
+                f = (b & c) | (~b & d);
+                k = 0x5A827999;
+            }
+            else if (i < 40)
+            {
+                f = b ^ c ^ d;
+                k = 0x6ED9EBA1;
+            }
+            else if (i < 60)
+            {
+                f = (b & c) | (b & d) | (c & d);
+                k = 0x8F1BBCDC;
+            }
+            else
+            {
+                f = b ^ c ^ d;
+                k = 0xCA62C1D6;
+            }
+            const uint32_t temp = rotl(a, 5) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = rotl(b, 30);
+            b = a;
+            a = temp;
+        }
+        mState[0] += a;
+        mState[1] += b;
+        mState[2] += c;
+        mState[3] += d;
+        mState[4] += e;
+    }
+
+    uint32_t mState[5]{0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+    uint8_t mBuffer[64];
+    size_t mBufferSize{0};
+    uint64_t mLength{0};
+};
+
+// pread() may return fewer bytes than requested, e.g. for reads above 2 GiB on Linux.
+bool preadFully(int fd, char* dst, int64_t size, int64_t offset)
+{
+    while (size > 0)
+    {
+        const ssize_t n = ::pread(fd, dst, static_cast<size_t>(size), static_cast<off_t>(offset));
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            return false;
+        }
+        dst += n;
+        size -= n;
+        offset += n;
+    }
+    return true;
+}
+
+} // namespace
+
+std::string sha1Hex(void const* data, size_t size)
+{
+    Sha1 sha1;
+    sha1.update(static_cast<uint8_t const*>(data), size);
+    return sha1.hexDigest();
+}
+
+bool getExternalDataRange(::ONNX_NAMESPACE::TensorProto const& tensor, std::string const& modelPath,
+    ExternalDataRange* range, std::string* error)
+{
+    std::string location;
+    *range = ExternalDataRange{};
+    for (auto const& entry : tensor.external_data())
+    {
+        const std::string& key = entry.key();
+        if (key == "location")
+        {
+            location = entry.value();
+        }
+        else if (key == "offset")
+        {
+            range->offset = std::atoll(entry.value().c_str());
+        }
+        else if (key == "length")
+        {
+            range->length = std::atoll(entry.value().c_str());
+        }
+        else if (key == "checksum")
+        {
+            range->checksum = entry.value();
+            std::transform(range->checksum.begin(), range->checksum.end(), range->checksum.begin(), ::tolower);
+        }
+        else
+        {
+            *error = "Key value of: " + key + " was not expected!";
+            return false;
+        }
+    }
+
+    // The weight paths in the ONNX model are relative paths to the main ONNX file.
+#ifdef _MSC_VER
+    const size_t slash = modelPath.rfind("\\");
+#else
+    const size_t slash = modelPath.rfind("/");
+#endif
+    range->path = slash != std::string::npos ? modelPath.substr(0, slash + 1) + location : location;
+    return true;
+}
+
+ExternalDataReader::~ExternalDataReader()
+{
+    for (auto& entry : mFiles)
+    {
+        ::close(entry.second.fd);
+    }
+}
+
+ExternalDataReader::File* ExternalDataReader::open(std::string const& path, std::string* error)
+{
+    auto it = mFiles.find(path);
+    if (it != mFiles.end())
+    {
+        return &it->second;
+    }
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        *error = "Failed to open file: " + path;
+        return nullptr;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0)
+    {
+        ::close(fd);
+        *error = "Failed to stat file: " + path;
+        return nullptr;
+    }
+    File& file = mFiles[path];
+    file.fd = fd;
+    file.size = static_cast<int64_t>(st.st_size);
+    return &file;
+}
+
+bool ExternalDataReader::resolve(
+    File const& file, ExternalDataRange const& range, int64_t* begin, int64_t* end, std::string* error) const
+{
+    *begin = range.offset;
+    *end = range.length == 0 ? file.size : range.offset + range.length;
+    if (*begin < 0 || *end > file.size || *begin > *end)
+    {
+        *error = "External data range [" + std::to_string(*begin) + ", " + std::to_string(*end)
+            + ") is outside of file: " + range.path;
+        return false;
+    }
+    return true;
+}
+
+ExternalDataReader::Block const* ExternalDataReader::findBlock(File const& file, int64_t begin, int64_t end) const
+{
+    auto it = file.blocks.upper_bound(begin);
+    if (it == file.blocks.begin())
+    {
+        return nullptr;
+    }
+    Block const* block = std::prev(it)->second;
+    const int64_t blockEnd = block->offset + static_cast<int64_t>(block->data.size());
+    return end <= blockEnd ? block : nullptr;
+}
+
+ExternalDataReader::Block const* ExternalDataReader::readBlock(
+    File& file, std::string const& path, int64_t begin, int64_t end, std::string* error)
+{
+    mStorage.push_back(Block{begin, std::vector<char>(static_cast<size_t>(end - begin))});
+    Block& block = mStorage.back();
+    if (!preadFully(file.fd, block.data.data(), end - begin, begin))
+    {
+        mStorage.pop_back();
+        *error = "Failed to read weights from external file: " + path;
+        return nullptr;
+    }
+    ++mNbReads;
+    // Prefer the larger block if one already starts at the same offset.
+    Block const*& slot = file.blocks[begin];
+    if (!slot || slot->data.size() < block.data.size())
+    {
+        slot = &block;
+    }
+    return &block;
+}
+
+bool ExternalDataReader::prefetch(std::vector<ExternalDataRange> const& ranges, std::string* error)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    // Group the ranges that are not resident yet by file.
+    std::map<std::string, std::vector<std::pair<int64_t, int64_t>>> pending;
+    for (auto const& range : ranges)
+    {
+        File* file = open(range.path, error);
+        if (!file)
+        {
+            return false;
+        }
+        int64_t begin, end;
+        if (!resolve(*file, range, &begin, &end, error))
+        {
+            return false;
+        }
+        if (!findBlock(*file, begin, end))
+        {
+            pending[range.path].emplace_back(begin, end);
+        }
+    }
+
+    for (auto& entry : pending)
+    {
+        File& file = mFiles.at(entry.first);
+        auto& spans = entry.second;
+        std::sort(spans.begin(), spans.end());
+        int64_t begin = spans.front().first;
+        int64_t end = spans.front().second;
+        for (size_t i = 1; i <= spans.size(); ++i)
+        {
+            if (i < spans.size() && spans[i].first <= end + kMAX_COALESCE_GAP)
+            {
+                end = std::max(end, spans[i].second);
+                continue;
+            }
+            if (!readBlock(file, entry.first, begin, end, error))
+            {
+                return false;
+            }
+            if (i < spans.size())
+            {
+                begin = spans[i].first;
+                end = spans[i].second;
+            }
+        }
+    }
+    return true;
+}
+
+bool ExternalDataReader::read(ExternalDataRange const& range, char const** data, size_t* size, std::string* error)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    File* file = open(range.path, error);
+    if (!file)
+    {
+        return false;
+    }
+    int64_t begin, end;
+    if (!resolve(*file, range, &begin, &end, error))
+    {
+        return false;
+    }
+    Block const* block = findBlock(*file, begin, end);
+    if (!block)
+    {
+        block = readBlock(*file, range.path, begin, end, error);
+        if (!block)
+        {
+            return false;
+        }
+    }
+    *data = block->data.data() + (begin - block->offset);
+    *size = static_cast<size_t>(end - begin);
+    return !mVerifyChecksums || range.checksum.empty() || verifyChecksum(*file, range, *data, *size, error);
+}
+
+bool ExternalDataReader::verifyChecksum(
+    File& file, ExternalDataRange const& range, char const* data, size_t size, std::string* error)
+{
+    // The ONNX spec describes the checksum as a digest of the file, but some exporters write one per tensor.
+    // Accept either; the tensor digest is cheap so it is tried first.
+    if (sha1Hex(data, size) == range.checksum)
+    {
+        return true;
+    }
+    if (file.digest.empty())
+    {
+        Sha1 sha1;
+        std::vector<char> chunk(std::min<int64_t>(file.size, 16 << 20));
+        for (int64_t offset = 0; offset < file.size;)
+        {
+            const int64_t n = std::min<int64_t>(chunk.size(), file.size - offset);
+            if (!preadFully(file.fd, chunk.data(), n, offset))
+            {
+                *error = "Failed to read external file for checksum verification: " + range.path;
+                return false;
+            }
+            sha1.update(reinterpret_cast<uint8_t const*>(chunk.data()), static_cast<size_t>(n));
+            offset += n;
+        }
+        file.digest = sha1.hexDigest();
+    }
+    if (file.digest != range.checksum)
+    {
+        *error = "Checksum mismatch for external data in " + range.path + ": expected " + range.checksum
+            + ", got " + file.digest;
+        return false;
+    }
+    return true;
+}
+
+} // namespace onnx2trt
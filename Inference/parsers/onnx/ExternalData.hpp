@@ -0,0 +1,108 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <onnx/onnx_pb.h>
+
+#include <cstdint>
+#include <list>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace onnx2trt
+{
+
+//! Where the payload of an externally stored tensor lives, decoded from TensorProto::external_data.
+struct ExternalDataRange
+{
+    std::string path;     // Data file, resolved relative to the model file.
+    int64_t offset{0};
+    int64_t length{0};    // 0 means "up to the end of the file".
+    std::string checksum; // Optional SHA1 hex digest; empty if the model does not provide one.
+};
+
+//! Decode the external_data entries of tensor. Relative locations are resolved against the directory of
+//! modelPath. Returns false and sets error if an unexpected key is found.
+bool getExternalDataRange(::ONNX_NAMESPACE::TensorProto const& tensor, std::string const& modelPath,
+    ExternalDataRange* range, std::string* error);
+
+//! Lowercase hex SHA1 digest of size bytes at data.
+std::string sha1Hex(void const* data, size_t size);
+
+//! Reads external tensor payloads for one model. Each data file is opened once and kept open for the lifetime of
+//! the reader, payloads are read with pread(), and prefetch() merges neighbouring ranges of a file into a single
+//! read. Returned pointers stay valid until the reader is destroyed, so weights can reference them directly.
+//! prefetch() and read() may be called concurrently.
+class ExternalDataReader
+{
+public:
+    //! Ranges of the same file separated by at most this many bytes are read together.
+    static constexpr int64_t kMAX_COALESCE_GAP = 64 << 10;
+
+    ExternalDataReader() = default;
+    ExternalDataReader(ExternalDataReader const&) = delete;
+    ExternalDataReader& operator=(ExternalDataReader const&) = delete;
+    ~ExternalDataReader();
+
+    //! When enabled (the default), ranges that carry a checksum are verified before their data is returned.
+    void setVerifyChecksums(bool verify)
+    {
+        mVerifyChecksums = verify;
+    }
+
+    //! Read every range up front, coalescing ranges of the same file. Ranges that are already resident are skipped.
+    bool prefetch(std::vector<ExternalDataRange> const& ranges, std::string* error);
+
+    //! Return the payload of range, reading it if it was not prefetched.
+    bool read(ExternalDataRange const& range, char const** data, size_t* size, std::string* error);
+
+    //! Number of data files currently open.
+    size_t getNbOpenFiles() const
+    {
+        return mFiles.size();
+    }
+
+    //! Number of pread() calls issued so far (a read larger than the OS allows in one call counts once).
+    size_t getNbReads() const
+    {
+        return mNbReads;
+    }
+
+private:
+    struct Block
+    {
+        int64_t offset;
+        std::vector<char> data;
+    };
+
+    struct File
+    {
+        int fd{-1};
+        int64_t size{0};
+        std::string digest; // SHA1 of the whole file, computed on first use.
+        // Resident blocks indexed by start offset. Blocks themselves live in mStorage so that pointers handed out
+        // by read() survive the index being updated.
+        std::map<int64_t, Block const*> blocks;
+    };
+
+    File* open(std::string const& path, std::string* error);
+    bool resolve(File const& file, ExternalDataRange const& range, int64_t* begin, int64_t* end,
+        std::string* error) const;
+    Block const* findBlock(File const& file, int64_t begin, int64_t end) const;
+    Block const* readBlock(File& file, std::string const& path, int64_t begin, int64_t end, std::string* error);
+    bool verifyChecksum(File& file, ExternalDataRange const& range, char const* data, size_t size,
+        std::string* error);
+
+    std::mutex mMutex; // Guards everything below.
+    std::unordered_map<std::string, File> mFiles;
+    std::list<Block> mStorage;
+    size_t mNbReads{0};
+    bool mVerifyChecksums{true};
+};
+
+} // namespace onnx2trt
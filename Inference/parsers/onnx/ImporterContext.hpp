@@ -74,18 +74,23 @@ class ImporterContext final : public IImporterContext
     StringMap<nvinfer1::ITensor*> mUserInputs;
     StringMap<nvinfer1::ITensor**> mUserOutputs;
     StringMap<int64_t> mOpsets;
-    StringMap<TensorOrWeights> mTensors; // All tensors in the graph mapped to their names.
+    TensorMap mTensors; // All tensors in the graph mapped to their interned names.
     StringMap<nvinfer1::TensorLocation> mTensorLocations;
     StringMap<float> mTensorRangeMins;
     StringMap<float> mTensorRangeMaxes;
     StringMap<nvinfer1::DataType> mLayerPrecisions;
-    std::set<std::string> mTensorNames; // Keep track of how many times a tensor name shows up, to avoid duplicate naming in TRT.
-    std::set<std::string> mLayerNames; // Keep track of how many times a tensor name shows up, to avoid duplicate naming in TRT.
+    NameTable mTensorNames; // Keep track of how many times a tensor name shows up, to avoid duplicate naming in TRT.
+    NameTable mLayerNames; // Keep track of how many times a tensor name shows up, to avoid duplicate naming in TRT.
     int64_t mSuffixCounter{0}; // increasing suffix counter used to uniquify layer names.
     std::unordered_set<std::string> mUnsupportedShapeTensors; // Container to hold output tensor names of layers that produce shape tensor outputs but do not natively support them.
     StringMap<std::string> mLoopTensors; // Container to map subgraph tensors to their original outer graph names.
     std::string mOnnxFileLocation; // Keep track of the directory of the parsed ONNX file
+    IWeightsCache const* mWeightsCache{nullptr}; // Pre-converted initializers of the model being imported, if any
+    ExternalDataReader mExternalData; // Open external data files and the weight bytes read from them
+    ExternalDataReader* mSharedExternalData{nullptr}; // Used instead of mExternalData when set
+    FoldedConstants const* mFoldedConstants{nullptr}; // Nodes of the model being imported that were evaluated on the host, if any
     std::unique_ptr<ErrorRecorderWrapper> mErrorWrapper; // error recorder to control TRT errors
+    nvinfer1::ILogger::Severity mLogSeverity{nvinfer1::ILogger::Severity::kVERBOSE}; // Least severe message that is formatted and forwarded to mLogger.
 
 public:
     ImporterContext(nvinfer1::INetworkDefinition* network, nvinfer1::ILogger* logger)
@@ -100,7 +105,7 @@ public:
     {
         return mNetwork;
     }
-    StringMap<TensorOrWeights>& tensors() override
+    TensorMap& tensors() override
     {
         return mTensors;
     }
@@ -136,6 +141,31 @@ public:
     {
         return mOnnxFileLocation;
     }
+    IWeightsCache const* weightsCache() const override
+    {
+        return mWeightsCache;
+    }
+    void setWeightsCache(IWeightsCache const* cache)
+    {
+        mWeightsCache = cache;
+    }
+    ExternalDataReader& externalData() override
+    {
+        return mSharedExternalData ? *mSharedExternalData : mExternalData;
+    }
+    FoldedConstants const* foldedConstants() const override
+    {
+        return mFoldedConstants;
+    }
+    void setFoldedConstants(FoldedConstants const* folded)
+    {
+        mFoldedConstants = folded;
+    }
+    //! Read external data through another context's reader, so that files are opened and read only once.
+    void shareExternalData(ExternalDataReader* reader)
+    {
+        mSharedExternalData = reader;
+    }
     // This actually handles weights as well, but is named this way to be consistent with the tensors()
     void registerTensor(TensorOrWeights tensor, const std::string& basename) override
     {
@@ -188,6 +218,21 @@ public:
         return *mLogger;
     }
 
+    bool shouldLog(nvinfer1::ILogger::Severity severity) const override
+    {
+        return severity <= mLogSeverity;
+    }
+
+    void setLogSeverity(nvinfer1::ILogger::Severity severity)
+    {
+        mLogSeverity = severity;
+    }
+
+    nvinfer1::ILogger::Severity getLogSeverity() const
+    {
+        return mLogSeverity;
+    }
+
     ShapedWeights createTempWeights(ShapedWeights::DataType type, nvinfer1::Dims shape, uint8_t value = 0) override
     {
         ShapedWeights weights(type, nullptr, shape);
@@ -274,17 +319,17 @@ public:
         return mErrorWrapper ? mErrorWrapper->getErrorRecorder() : nullptr;
     }
 private:
-    std::string generateUniqueName(std::set<std::string>& namesSet, const std::string& basename)
+    std::string generateUniqueName(NameTable& namesSet, const std::string& basename)
     {
         std::string candidate = basename;
 
-        while (namesSet.find(candidate) != namesSet.end())
+        while (namesSet.count(candidate))
         {
             candidate = basename + "_" + std::to_string(mSuffixCounter);
             ++mSuffixCounter;
         }
 
-        namesSet.insert(candidate);
+        namesSet.intern(candidate);
 
         return candidate;
     }
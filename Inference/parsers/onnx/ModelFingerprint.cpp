@@ -0,0 +1,633 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "ModelFingerprint.hpp"
+#include "ExternalData.hpp"
+#include "toposort.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <map>
+#include <thread>
+
+namespace onnx2trt
+{
+
+namespace
+{
+
+using ::ONNX_NAMESPACE::AttributeProto;
+using ::ONNX_NAMESPACE::GraphProto;
+using ::ONNX_NAMESPACE::NodeProto;
+using ::ONNX_NAMESPACE::TensorProto;
+
+constexpr uint64_t kPRIME1 = 0x9E3779B185EBCA87ULL;
+constexpr uint64_t kPRIME2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr uint64_t kPRIME3 = 0x165667B19E3779F9ULL;
+constexpr uint64_t kPRIME4 = 0x85EBCA77C2B2AE63ULL;
+constexpr uint64_t kPRIME5 = 0x27D4EB2F165667C5ULL;
+
+// Bytes compared from the start, middle and end of a payload to find candidate duplicates.
+constexpr size_t kSAMPLE_BYTES = 64;
+
+enum Storage
+{
+    kEMPTY = 0,
+    kRAW = 1,
+    kFLOAT = 2,
+    kINT32 = 3,
+    kINT64 = 4,
+    kDOUBLE = 5,
+    kUINT64 = 6,
+    kSTRING = 7,
+    kEXTERNAL = 8,     // Read through the ExternalDataReader; hashed like kRAW.
+    kEXTERNAL_REF = 9, // Identified by its range only.
+};
+
+inline uint64_t rotl(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+inline uint64_t read64(unsigned char const* p)
+{
+    uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint64_t mixRound(uint64_t acc, uint64_t input)
+{
+    acc += input * kPRIME2;
+    return rotl(acc, 31) * kPRIME1;
+}
+
+inline uint64_t mergeRound(uint64_t acc, uint64_t lane)
+{
+    acc ^= mixRound(0, lane);
+    return acc * kPRIME1 + kPRIME4;
+}
+
+inline uint64_t avalanche(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= kPRIME2;
+    h ^= h >> 29;
+    h *= kPRIME3;
+    h ^= h >> 32;
+    return h;
+}
+
+// Appends a length-prefixed field, so that no two keys concatenate to the same bytes.
+void appendField(std::string* key, std::string const& field)
+{
+    uint64_t const size = field.size();
+    key->append(reinterpret_cast<char const*>(&size), sizeof(size));
+    key->append(field);
+}
+
+void appendInt(std::string* key, int64_t value)
+{
+    key->append(reinterpret_cast<char const*>(&value), sizeof(value));
+}
+
+void appendDigest(std::string* key, Digest const& digest)
+{
+    key->append(reinterpret_cast<char const*>(&digest.hi), sizeof(digest.hi));
+    key->append(reinterpret_cast<char const*>(&digest.lo), sizeof(digest.lo));
+}
+
+Digest hashKey(std::string const& key)
+{
+    return hashBytes(key.data(), key.size());
+}
+
+void collectTensors(GraphProto const& graph, std::vector<TensorProto const*>* tensors)
+{
+    for (TensorProto const& initializer : graph.initializer())
+    {
+        tensors->push_back(&initializer);
+    }
+    for (NodeProto const& node : graph.node())
+    {
+        for (AttributeProto const& attr : node.attribute())
+        {
+            switch (attr.type())
+            {
+            case AttributeProto::TENSOR: tensors->push_back(&attr.t()); break;
+            case AttributeProto::TENSORS:
+                for (TensorProto const& t : attr.tensors())
+                {
+                    tensors->push_back(&t);
+                }
+                break;
+            case AttributeProto::GRAPH: collectTensors(attr.g(), tensors); break;
+            case AttributeProto::GRAPHS:
+                for (GraphProto const& subgraph : attr.graphs())
+                {
+                    collectTensors(subgraph, tensors);
+                }
+                break;
+            default: break;
+            }
+        }
+    }
+}
+
+template <typename Field>
+bool setPayload(Field const& field, int storage, char const** data, size_t* size, int* kind)
+{
+    if (field.empty())
+    {
+        return false;
+    }
+    *data = reinterpret_cast<char const*>(field.data());
+    *size = field.size() * sizeof(*field.data());
+    *kind = storage;
+    return true;
+}
+
+} // namespace
+
+std::string Digest::hex() const
+{
+    static char const kDigits[] = "0123456789abcdef";
+    std::string out(32, '0');
+    for (int i = 0; i < 16; ++i)
+    {
+        out[15 - i] = kDigits[(hi >> (4 * i)) & 0xF];
+        out[31 - i] = kDigits[(lo >> (4 * i)) & 0xF];
+    }
+    return out;
+}
+
+Digest hashBytes(void const* data, size_t size, uint64_t seed)
+{
+    auto const* p = static_cast<unsigned char const*>(data);
+    auto const* const end = p + size;
+
+    uint64_t v1 = seed + kPRIME1 + kPRIME2;
+    uint64_t v2 = seed + kPRIME2;
+    uint64_t v3 = seed;
+    uint64_t v4 = seed - kPRIME1;
+    for (; end - p >= 32; p += 32)
+    {
+        v1 = mixRound(v1, read64(p));
+        v2 = mixRound(v2, read64(p + 8));
+        v3 = mixRound(v3, read64(p + 16));
+        v4 = mixRound(v4, read64(p + 24));
+    }
+
+    uint64_t lo = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+    lo = mergeRound(mergeRound(mergeRound(mergeRound(lo, v1), v2), v3), v4) + size;
+    uint64_t hi = (v1 ^ rotl(v3, 23)) * kPRIME3 + (v2 ^ rotl(v4, 41)) * kPRIME5 + size * kPRIME4;
+    for (; end - p >= 8; p += 8)
+    {
+        uint64_t const k = mixRound(0, read64(p));
+        lo = rotl(lo ^ k, 27) * kPRIME1 + kPRIME4;
+        hi = rotl(hi ^ rotl(k, 19), 31) * kPRIME2 + kPRIME3;
+    }
+    for (; p < end; ++p)
+    {
+        lo = rotl(lo ^ (*p * kPRIME5), 11) * kPRIME1;
+        hi = rotl(hi ^ (*p * kPRIME1), 17) * kPRIME5;
+    }
+    return Digest{avalanche(hi ^ rotl(lo, 32)), avalanche(lo)};
+}
+
+ModelFingerprint::ModelFingerprint(int nbThreads, ExternalDataReader* externalData, std::string const& modelPath)
+    : mNbThreads(nbThreads > 0 ? nbThreads : std::max(1, static_cast<int>(std::thread::hardware_concurrency())))
+    , mExternalData(externalData)
+    , mModelPath(modelPath)
+{
+}
+
+bool ModelFingerprint::getPayload(TensorProto const& tensor, Payload* payload, std::string* error) const
+{
+    *payload = Payload{};
+    if (tensor.data_location() == TensorProto::EXTERNAL)
+    {
+        if (!mExternalData)
+        {
+            payload->storage = kEXTERNAL_REF;
+            return true;
+        }
+        ExternalDataRange range;
+        if (!getExternalDataRange(tensor, mModelPath, &range, error)
+            || !mExternalData->read(range, &payload->data, &payload->size, error))
+        {
+            return false;
+        }
+        payload->storage = kEXTERNAL;
+        return true;
+    }
+    if (setPayload(tensor.raw_data(), kRAW, &payload->data, &payload->size, &payload->storage)
+        || setPayload(tensor.float_data(), kFLOAT, &payload->data, &payload->size, &payload->storage)
+        || setPayload(tensor.int32_data(), kINT32, &payload->data, &payload->size, &payload->storage)
+        || setPayload(tensor.int64_data(), kINT64, &payload->data, &payload->size, &payload->storage)
+        || setPayload(tensor.double_data(), kDOUBLE, &payload->data, &payload->size, &payload->storage)
+        || setPayload(tensor.uint64_data(), kUINT64, &payload->data, &payload->size, &payload->storage))
+    {
+        return true;
+    }
+    payload->storage = tensor.string_data_size() > 0 ? kSTRING : kEMPTY;
+    return true;
+}
+
+bool ModelFingerprint::hashTensors(std::vector<TensorProto const*> const& tensors, std::string* error)
+{
+    // Read external payloads together so that neighbouring ranges of a file are read once.
+    if (mExternalData)
+    {
+        std::vector<ExternalDataRange> ranges;
+        for (auto const* tensor : tensors)
+        {
+            if (tensor->data_location() == TensorProto::EXTERNAL)
+            {
+                ranges.emplace_back();
+                if (!getExternalDataRange(*tensor, mModelPath, &ranges.back(), error))
+                {
+                    return false;
+                }
+            }
+        }
+        if (!ranges.empty() && !mExternalData->prefetch(ranges, error))
+        {
+            return false;
+        }
+    }
+
+    // Pick one representative per distinct payload; every other tensor points at its representative.
+    std::vector<Payload> payloads(tensors.size());
+    std::vector<size_t> representative(tensors.size());
+    std::vector<size_t> unique;
+    std::unordered_map<uint64_t, std::vector<size_t>> candidates;
+    for (size_t i = 0; i < tensors.size(); ++i)
+    {
+        if (!getPayload(*tensors[i], &payloads[i], error))
+        {
+            return false;
+        }
+        Payload const& payload = payloads[i];
+        representative[i] = i;
+        if (!payload.data)
+        {
+            continue;
+        }
+        std::string sample;
+        appendInt(&sample, payload.size);
+        appendInt(&sample, payload.storage == kEXTERNAL ? kRAW : payload.storage);
+        size_t const n = std::min(kSAMPLE_BYTES, payload.size);
+        sample.append(payload.data, n);
+        sample.append(payload.data + (payload.size - n) / 2, n);
+        sample.append(payload.data + payload.size - n, n);
+        auto& bucket = candidates[hashKey(sample).lo];
+        for (size_t j : bucket)
+        {
+            Payload const& other = payloads[j];
+            if (other.size == payload.size && (other.data == payload.data
+                || std::memcmp(other.data, payload.data, payload.size) == 0))
+            {
+                representative[i] = j;
+                break;
+            }
+        }
+        if (representative[i] == i)
+        {
+            bucket.push_back(i);
+            unique.push_back(i);
+        }
+    }
+
+    // Split the distinct payloads into blocks and hash the blocks on the pool.
+    struct Block
+    {
+        size_t tensor;
+        size_t offset;
+        size_t size;
+    };
+    std::vector<Block> blocks;
+    std::vector<size_t> firstBlock(tensors.size(), 0);
+    std::vector<size_t> nbBlocks(tensors.size(), 0);
+    mNbHashedBytes = 0;
+    for (size_t i : unique)
+    {
+        size_t const size = payloads[i].size;
+        firstBlock[i] = blocks.size();
+        for (size_t offset = 0; offset < size; offset += kPARALLEL_BLOCK_BYTES)
+        {
+            blocks.push_back(Block{i, offset, std::min(kPARALLEL_BLOCK_BYTES, size - offset)});
+        }
+        nbBlocks[i] = blocks.size() - firstBlock[i];
+        mNbHashedBytes += size;
+    }
+    std::vector<Digest> blockDigests(blocks.size());
+    std::atomic<size_t> next{0};
+    auto work = [&]() {
+        for (size_t b = next++; b < blocks.size(); b = next++)
+        {
+            Block const& block = blocks[b];
+            blockDigests[b] = hashBytes(payloads[block.tensor].data + block.offset, block.size);
+        }
+    };
+    int const nbThreads = std::max(1, std::min(mNbThreads, static_cast<int>(blocks.size())));
+    std::vector<std::thread> threads;
+    for (int i = 1; i < nbThreads; ++i)
+    {
+        threads.emplace_back(work);
+    }
+    work();
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    // Combine the blocks of each payload, then add the name-less header of each tensor.
+    std::vector<Digest> payloadDigests(tensors.size());
+    for (size_t i : unique)
+    {
+        if (nbBlocks[i] == 1)
+        {
+            payloadDigests[i] = blockDigests[firstBlock[i]];
+        }
+        else
+        {
+            payloadDigests[i] = hashBytes(&blockDigests[firstBlock[i]], nbBlocks[i] * sizeof(Digest), payloads[i].size);
+        }
+    }
+    mTensors = tensors;
+    mTensorDigests.clear();
+    for (size_t i = 0; i < tensors.size(); ++i)
+    {
+        TensorProto const& tensor = *tensors[i];
+        Payload const& payload = payloads[i];
+        std::string key;
+        appendInt(&key, tensor.data_type());
+        appendInt(&key, tensor.dims_size());
+        for (int64_t d : tensor.dims())
+        {
+            appendInt(&key, d);
+        }
+        if (payload.data)
+        {
+            appendInt(&key, payload.storage == kEXTERNAL ? kRAW : payload.storage);
+            appendDigest(&key, payloadDigests[representative[i]]);
+        }
+        else
+        {
+            appendInt(&key, payload.storage);
+            if (payload.storage == kSTRING)
+            {
+                for (auto const& s : tensor.string_data())
+                {
+                    appendField(&key, s);
+                }
+            }
+            else if (payload.storage == kEXTERNAL_REF)
+            {
+                for (auto const& entry : tensor.external_data())
+                {
+                    appendField(&key, entry.key());
+                    appendField(&key, entry.value());
+                }
+            }
+        }
+        mTensorDigests[&tensor] = hashKey(key);
+    }
+    return true;
+}
+
+Digest ModelFingerprint::hashGraph(GraphProto const& graph, std::unordered_map<std::string, int64_t> const& opsets,
+    std::vector<Digest>* nodeDigests, std::vector<Digest>* coneDigests) const
+{
+    std::unordered_map<std::string, TensorProto const*> initializers;
+    for (auto const& initializer : graph.initializer())
+    {
+        initializers[initializer.name()] = &initializer;
+    }
+    std::unordered_map<std::string, std::string> inputTypes;
+    for (auto const& input : graph.input())
+    {
+        inputTypes[input.name()] = input.type().SerializeAsString();
+    }
+
+    std::vector<size_t> order;
+    if (!toposort(graph.node(), &order))
+    {
+        // Cyclic graphs are invalid, but still get a digest.
+        order.resize(graph.node_size());
+        for (size_t i = 0; i < order.size(); ++i)
+        {
+            order[i] = i;
+        }
+    }
+
+    std::vector<Digest> locals(graph.node_size());
+    std::vector<Digest> cones(graph.node_size());
+    // Cone digest of the producer of each value and the output index.
+    std::unordered_map<std::string, std::pair<Digest, int>> produced;
+    for (size_t const nodeIndex : order)
+    {
+        NodeProto const& node = graph.node(nodeIndex);
+        std::string key;
+        appendField(&key, node.domain());
+        appendField(&key, node.op_type());
+        auto const opset = opsets.find(node.domain());
+        appendInt(&key, opset != opsets.end() ? opset->second : -1);
+        appendInt(&key, node.attribute_size());
+        for (auto const& attr : node.attribute())
+        {
+            appendField(&key, attr.name());
+            appendInt(&key, attr.type());
+            switch (attr.type())
+            {
+            case AttributeProto::TENSOR: appendDigest(&key, getTensorDigest(attr.t())); break;
+            case AttributeProto::TENSORS:
+                for (auto const& t : attr.tensors())
+                {
+                    appendDigest(&key, getTensorDigest(t));
+                }
+                break;
+            case AttributeProto::GRAPH: appendDigest(&key, hashGraph(attr.g(), opsets, nullptr, nullptr)); break;
+            case AttributeProto::GRAPHS:
+                for (auto const& subgraph : attr.graphs())
+                {
+                    appendDigest(&key, hashGraph(subgraph, opsets, nullptr, nullptr));
+                }
+                break;
+            default: appendField(&key, attr.SerializeAsString()); break;
+            }
+        }
+        appendInt(&key, node.input_size());
+        std::string cone;
+        for (auto const& input : node.input())
+        {
+            auto const producer = produced.find(input);
+            if (producer != produced.end())
+            {
+                appendField(&key, "n");
+                appendDigest(&cone, producer->second.first);
+                appendInt(&cone, producer->second.second);
+                continue;
+            }
+            auto const initializer = initializers.find(input);
+            auto const type = inputTypes.find(input);
+            if (input.empty())
+            {
+                appendField(&key, "-");
+            }
+            else if (initializer != initializers.end())
+            {
+                appendField(&key, "w");
+                appendDigest(&key, getTensorDigest(*initializer->second));
+            }
+            else if (type != inputTypes.end())
+            {
+                appendField(&key, "i" + type->second);
+            }
+            else
+            {
+                // A value of an enclosing graph, read by an If/Loop/Scan body.
+                appendField(&key, "o" + input);
+            }
+        }
+        appendInt(&key, node.output_size());
+        locals[nodeIndex] = hashKey(key);
+
+        appendDigest(&cone, locals[nodeIndex]);
+        cones[nodeIndex] = hashKey(cone);
+        for (int i = 0; i < node.output_size(); ++i)
+        {
+            produced[node.output(i)] = std::make_pair(cones[nodeIndex], i);
+        }
+    }
+
+    // The interface by name and type, the outputs by where they come from, and every node, in any order.
+    std::string key;
+    for (auto const& input : graph.input())
+    {
+        appendField(&key, input.name());
+        appendField(&key, input.type().SerializeAsString());
+        auto const initializer = initializers.find(input.name());
+        if (initializer != initializers.end())
+        {
+            appendDigest(&key, getTensorDigest(*initializer->second));
+        }
+    }
+    for (auto const& output : graph.output())
+    {
+        appendField(&key, output.name());
+        appendField(&key, output.type().SerializeAsString());
+        auto const producer = produced.find(output.name());
+        if (producer != produced.end())
+        {
+            appendDigest(&key, producer->second.first);
+            appendInt(&key, producer->second.second);
+        }
+    }
+    std::vector<Digest> sortedCones = cones;
+    std::sort(sortedCones.begin(), sortedCones.end());
+    for (auto const& cone : sortedCones)
+    {
+        appendDigest(&key, cone);
+    }
+
+    if (nodeDigests)
+    {
+        *nodeDigests = std::move(locals);
+    }
+    if (coneDigests)
+    {
+        *coneDigests = std::move(cones);
+    }
+    return hashKey(key);
+}
+
+bool ModelFingerprint::compute(::ONNX_NAMESPACE::ModelProto const& model, std::string* error)
+{
+    mGraph = &model.graph();
+    std::vector<TensorProto const*> tensors;
+    collectTensors(model.graph(), &tensors);
+    if (!hashTensors(tensors, error))
+    {
+        return false;
+    }
+
+    std::unordered_map<std::string, int64_t> opsets;
+    std::map<std::string, int64_t> sortedOpsets;
+    for (auto const& opset : model.opset_import())
+    {
+        opsets[opset.domain()] = opset.version();
+        sortedOpsets[opset.domain()] = opset.version();
+    }
+    Digest const graphDigest = hashGraph(model.graph(), opsets, &mNodeDigests, &mConeDigests);
+
+    std::string key;
+    appendInt(&key, model.ir_version());
+    for (auto const& opset : sortedOpsets)
+    {
+        appendField(&key, opset.first);
+        appendInt(&key, opset.second);
+    }
+    appendDigest(&key, graphDigest);
+    mModelDigest = hashKey(key);
+    return true;
+}
+
+Digest ModelFingerprint::getSliceDigest(std::vector<size_t> const& nodes) const
+{
+    // Outputs of slice nodes are numbered by slice position, values from outside the slice by order of first use.
+    // What graph inputs and initializers hold is already part of the local digests.
+    std::unordered_map<std::string, int64_t> inside;
+    std::unordered_map<std::string, int64_t> boundary;
+    std::string key;
+    for (size_t position = 0; position < nodes.size(); ++position)
+    {
+        NodeProto const& node = mGraph->node(nodes[position]);
+        appendDigest(&key, mNodeDigests[nodes[position]]);
+        for (auto const& input : node.input())
+        {
+            auto const local = inside.find(input);
+            if (local != inside.end())
+            {
+                appendInt(&key, local->second);
+                continue;
+            }
+            auto const outside = boundary.emplace(input, static_cast<int64_t>(boundary.size()));
+            appendInt(&key, -1 - outside.first->second);
+        }
+        for (int i = 0; i < node.output_size(); ++i)
+        {
+            inside[node.output(i)] = static_cast<int64_t>(position) * 65536 + i;
+        }
+    }
+    return hashKey(key);
+}
+
+Digest ModelFingerprint::getTensorDigest(TensorProto const& tensor) const
+{
+    auto const it = mTensorDigests.find(&tensor);
+    return it != mTensorDigests.end() ? it->second : Digest{};
+}
+
+std::vector<std::vector<TensorProto const*>> ModelFingerprint::getDuplicateTensors() const
+{
+    std::map<Digest, std::vector<TensorProto const*>> groups;
+    for (auto const* tensor : mTensors)
+    {
+        groups[getTensorDigest(*tensor)].push_back(tensor);
+    }
+    std::vector<std::vector<TensorProto const*>> duplicates;
+    for (auto& group : groups)
+    {
+        if (group.second.size() > 1)
+        {
+            duplicates.push_back(std::move(group.second));
+        }
+    }
+    return duplicates;
+}
+
+} // namespace onnx2trt
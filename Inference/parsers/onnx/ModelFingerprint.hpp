@@ -0,0 +1,158 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <onnx/onnx_pb.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace onnx2trt
+{
+
+class ExternalDataReader;
+
+//! 128-bit content digest. Not cryptographic: it identifies models and tensors for caching, it does not
+//! authenticate them.
+struct Digest
+{
+    Digest() = default;
+    Digest(uint64_t hi_, uint64_t lo_)
+        : hi(hi_)
+        , lo(lo_)
+    {
+    }
+
+    uint64_t hi{0};
+    uint64_t lo{0};
+
+    bool operator==(Digest const& other) const
+    {
+        return hi == other.hi && lo == other.lo;
+    }
+    bool operator!=(Digest const& other) const
+    {
+        return !(*this == other);
+    }
+    bool operator<(Digest const& other) const
+    {
+        return hi != other.hi ? hi < other.hi : lo < other.lo;
+    }
+
+    //! 32 lowercase hex digits.
+    std::string hex() const;
+};
+
+struct DigestHash
+{
+    size_t operator()(Digest const& digest) const
+    {
+        return static_cast<size_t>(digest.lo);
+    }
+};
+
+//! Digest of size bytes. The input is consumed in 32-byte stripes by four independent 64-bit multiply-rotate
+//! lanes, as in xxHash64, so the lanes pipeline and the loop runs at several GB/s per thread.
+Digest hashBytes(void const* data, size_t size, uint64_t seed = 0);
+
+//! Content fingerprints of an ONNX model, of each node of its main graph, and of any slice of those nodes.
+//!
+//! Each node gets two digests:
+//!   - a local digest of its domain, op, opset and attributes, the contents of the initializers it reads and the
+//!     types of the graph inputs it reads, and how many inputs and outputs it has;
+//!   - a cone digest that also covers, Merkle style, the cone digests of the nodes producing its inputs, i.e. the
+//!     whole subgraph the node depends on.
+//! Names of nodes and internal tensors are not hashed, so a node keeps its digests when the model is renamed or
+//! cut into stages. The model digest covers every node, the names and types of the graph inputs and outputs (which
+//! engines bind by) and the opsets. With the local digests computed once, getSliceDigest() hashes a slice in time
+//! proportional to the slice.
+//!
+//! Weights are hashed with hashBytes() on up to the given number of threads. Payloads of at least
+//! kPARALLEL_BLOCK_BYTES are split into blocks of that size that are hashed independently and then combined, so
+//! one large tensor also spreads over the threads; the digest does not depend on the number of threads. Tensors
+//! with identical payloads are hashed once: candidates are grouped by size and sampled bytes, and compared
+//! with memcmp, which is cheaper than hashing. Values in raw_data and the same values in a typed field such as
+//! float_data count as different payloads. Externally stored payloads are hashed through the given reader, or,
+//! without one, identified by their location, offset, length and checksum.
+//!
+//! The ModelProto must outlive the fingerprint.
+class ModelFingerprint
+{
+public:
+    static constexpr size_t kPARALLEL_BLOCK_BYTES = 1 << 20;
+
+    //! nbThreads <= 0 uses all hardware threads. externalData may be nullptr; modelPath is the path of the model
+    //! file that external data locations are relative to.
+    explicit ModelFingerprint(int nbThreads = 0, ExternalDataReader* externalData = nullptr,
+        std::string const& modelPath = "");
+
+    //! Fingerprint model, replacing any earlier results. Returns false and sets error if external data cannot be
+    //! read.
+    bool compute(::ONNX_NAMESPACE::ModelProto const& model, std::string* error);
+
+    Digest getModelDigest() const
+    {
+        return mModelDigest;
+    }
+
+    //! Digests of graph().node(node).
+    Digest getNodeDigest(size_t node) const
+    {
+        return mNodeDigests[node];
+    }
+    Digest getConeDigest(size_t node) const
+    {
+        return mConeDigests[node];
+    }
+
+    //! Digest of the computation done by the given nodes of the main graph, listed in topological order: their
+    //! local digests and how they are wired to each other. Values read from outside the slice are numbered in order
+    //! of first use, so equal slices of different models, or at different depths of one model, get equal digests.
+    Digest getSliceDigest(std::vector<size_t> const& nodes) const;
+
+    //! Digest of the name-less contents of an initializer or tensor attribute of the model (including those inside
+    //! If/Loop/Scan bodies): data type, shape and payload.
+    Digest getTensorDigest(::ONNX_NAMESPACE::TensorProto const& tensor) const;
+
+    //! Groups of two or more tensors with identical digests, in model order.
+    std::vector<std::vector<::ONNX_NAMESPACE::TensorProto const*>> getDuplicateTensors() const;
+
+    //! Payload bytes that were hashed; less than the total when tensors were deduplicated.
+    size_t getNbHashedBytes() const
+    {
+        return mNbHashedBytes;
+    }
+
+private:
+    struct Payload
+    {
+        char const* data{nullptr};
+        size_t size{0};
+        int storage{0}; // Which TensorProto field holds the data.
+    };
+
+    bool getPayload(::ONNX_NAMESPACE::TensorProto const& tensor, Payload* payload, std::string* error) const;
+    bool hashTensors(std::vector<::ONNX_NAMESPACE::TensorProto const*> const& tensors, std::string* error);
+    Digest hashGraph(::ONNX_NAMESPACE::GraphProto const& graph,
+        std::unordered_map<std::string, int64_t> const& opsets, std::vector<Digest>* nodeDigests,
+        std::vector<Digest>* coneDigests) const;
+
+    int mNbThreads;
+    ExternalDataReader* mExternalData;
+    std::string mModelPath;
+
+    ::ONNX_NAMESPACE::GraphProto const* mGraph{nullptr};
+    Digest mModelDigest;
+    std::vector<Digest> mNodeDigests;
+    std::vector<Digest> mConeDigests;
+    std::vector<::ONNX_NAMESPACE::TensorProto const*> mTensors; // In model order.
+    std::unordered_map<::ONNX_NAMESPACE::TensorProto const*, Digest> mTensorDigests;
+    size_t mNbHashedBytes{0};
+};
+
+} // namespace onnx2trt
@@ -4,6 +4,7 @@
 
 #include "ModelImporter.hpp"
 #include "OnnxAttrs.hpp"
+#include "OnnxModel.hpp"
 #include "onnx2trt_utils.hpp"
 #include "onnx_utils.hpp"
 #include "toposort.hpp"
@@ -95,12 +96,17 @@ static std::string makeErrorExplanation(const std::exception& e, const std::stri
 
 Status parseGraph(IImporterContext* ctx, const ::ONNX_NAMESPACE::GraphProto& graph, bool deserializingINetwork, int* currentNode)
 {
-    // Import initializers.
+    // Import initializers, reusing weights converted by a shared OnnxModel when there is one.
+    IWeightsCache const* weightsCache = ctx->weightsCache();
+    ASSERT(prefetchExternalWeights(ctx, graph) && "Failed to read external weights.", ErrorCode::kINVALID_GRAPH);
     for (const ::ONNX_NAMESPACE::TensorProto& initializer : graph.initializer())
     {
         LOG_VERBOSE("Importing initializer: " << initializer.name());
         ShapedWeights weights;
-        ASSERT(convertOnnxWeights(initializer, &weights, ctx) && "Failed to import initializer.", ErrorCode::kUNSUPPORTED_NODE);
+        if (!weightsCache || !weightsCache->findWeights(initializer, &weights))
+        {
+            ASSERT(convertOnnxWeights(initializer, &weights, ctx) && "Failed to import initializer.", ErrorCode::kUNSUPPORTED_NODE);
+        }
         ctx->registerTensor(TensorOrWeights{std::move(weights)}, initializer.name());
     }
 
@@ -108,6 +114,9 @@ Status parseGraph(IImporterContext* ctx, const ::ONNX_NAMESPACE::GraphProto& gra
     ASSERT(toposort(graph.node(), &topoOrder) && "Failed to sort the model topologically.", ErrorCode::kINVALID_GRAPH);
 
     const string_map<NodeImporter>& opImporters = getBuiltinOpImporterMap();
+    FoldedConstants const* foldedConstants = ctx->foldedConstants();
+    // Per-node input/output summaries are only worth formatting if they will be logged.
+    const bool logVerbose = ctx->shouldLog(nvinfer1::ILogger::Severity::kVERBOSE);
     for (const auto& nodeIndex : topoOrder)
     {
         if (currentNode)
@@ -120,46 +129,73 @@ Status parseGraph(IImporterContext* ctx, const ::ONNX_NAMESPACE::GraphProto& gra
 
         // Assemble node inputs. These may come from outside the subgraph.
         std::vector<TensorOrWeights> nodeInputs;
+        nodeInputs.reserve(node.input().size());
         std::ostringstream ssInputs{};
-        ssInputs << nodeName << " [" << node.op_type() << "] inputs: ";
+        if (logVerbose)
+        {
+            ssInputs << nodeName << " [" << node.op_type() << "] inputs: ";
+        }
         for (const auto& inputName : node.input())
         {
             // Empty input names indicate optional inputs which have not been supplied.
             if (inputName.empty())
             {
                 nodeInputs.emplace_back(nullptr);
-                ssInputs << "[optional input, not set], ";
+                if (logVerbose)
+                {
+                    ssInputs << "[optional input, not set], ";
+                }
             }
             else
             {
                 LOG_VERBOSE("Searching for input: " << inputName);
-                ASSERT( (ctx->tensors().count(inputName)) && "Node input was not registered.", ErrorCode::kINVALID_GRAPH);
-                nodeInputs.push_back(ctx->tensors().at(inputName));
-                ssInputs << "[" << inputName << " -> " << nodeInputs.back().shape() << "[" << nodeInputs.back().getType() << "]" <<"], ";
+                const TensorOrWeights* input = ctx->tensors().find(inputName);
+                ASSERT( (input) && "Node input was not registered.", ErrorCode::kINVALID_GRAPH);
+                nodeInputs.push_back(*input);
+                if (logVerbose)
+                {
+                    ssInputs << "[" << inputName << " -> " << input->shape() << "[" << input->getType() << "]" <<"], ";
+                }
             }
         }
         LOG_VERBOSE(ssInputs.str());
 
-        // Dispatch to appropriate converter.
-        const NodeImporter* importFunc{nullptr};
-        if (opImporters.count(node.op_type()))
+        std::vector<TensorOrWeights> outputs;
+        const std::vector<::ONNX_NAMESPACE::TensorProto>* foldedOutputs
+            = foldedConstants ? foldedConstants->find(node) : nullptr;
+        if (foldedOutputs)
         {
-            importFunc = &opImporters.at(node.op_type());
+            // The node was evaluated on the host, so its outputs are plain weights.
+            LOG_VERBOSE("Using folded constant outputs for node: " << nodeName);
+            for (const auto& folded : *foldedOutputs)
+            {
+                ShapedWeights weights;
+                ASSERT(convertOnnxWeights(folded, &weights, ctx) && "Failed to import folded constant.", ErrorCode::kUNSUPPORTED_NODE);
+                outputs.emplace_back(weights);
+            }
         }
         else
         {
-            LOG_INFO("No importer registered for op: " << node.op_type() << ". Attempting to import as plugin.");
-            importFunc = &opImporters.at("FallbackPluginImporter");
-        }
-        std::vector<TensorOrWeights> outputs;
+            // Dispatch to appropriate converter.
+            const NodeImporter* importFunc{nullptr};
+            if (opImporters.count(node.op_type()))
+            {
+                importFunc = &opImporters.at(node.op_type());
+            }
+            else
+            {
+                LOG_INFO("No importer registered for op: " << node.op_type() << ". Attempting to import as plugin.");
+                importFunc = &opImporters.at("FallbackPluginImporter");
+            }
 
-        try
-        {
-            GET_VALUE((*importFunc)(ctx, node, nodeInputs), &outputs);
-        }
-        catch (const std::exception& e)
-        {
-            return MAKE_ERROR(makeErrorExplanation(e, nodeName), ErrorCode::kINVALID_NODE);
+            try
+            {
+                GET_VALUE((*importFunc)(ctx, node, nodeInputs), &outputs);
+            }
+            catch (const std::exception& e)
+            {
+                return MAKE_ERROR(makeErrorExplanation(e, nodeName), ErrorCode::kINVALID_NODE);
+            }
         }
         if (ctx->hasError())
         {
@@ -205,12 +241,18 @@ Status parseGraph(IImporterContext* ctx, const ::ONNX_NAMESPACE::GraphProto& gra
 
         // Set output names and register outputs with the context.
         std::ostringstream ssOutputs{};
-        ssOutputs << nodeName << " [" << node.op_type() << "] outputs: ";
+        if (logVerbose)
+        {
+            ssOutputs << nodeName << " [" << node.op_type() << "] outputs: ";
+        }
         for (int i = 0; i < node.output().size(); ++i)
         {
             const auto& outputName = node.output(i);
             auto& output = outputs.at(i);
-            ssOutputs << "[" << outputName << " -> " << output.shape() << "[" << output.getType() << "]" << "], ";
+            if (logVerbose)
+            {
+                ssOutputs << "[" << outputName << " -> " << output.shape() << "[" << output.getType() << "]" << "], ";
+            }
             // Note: This condition is to allow ONNX outputs to be ignored
             // Always register output weights (even empty ones) as it may be mapped to an unused input
             if ((output || output.is_weights()) && !outputName.empty())
@@ -248,7 +290,7 @@ Status importInput(ImporterContext* ctx, ::ONNX_NAMESPACE::ValueInfoProto const&
 }
 
 Status importInputs(ImporterContext* ctx, ::ONNX_NAMESPACE::GraphProto const& graph,
-    string_map<TensorOrWeights>* tensors)
+    TensorMap* tensors)
 {
     // The weights come from the Initializer list in onnx graph
     // Initializers are not really network inputs, so they need to be excluded.
@@ -329,6 +371,21 @@ bool ModelImporter::supportsModel(
         _importer_ctx.setOnnxFileLocation(model_path);
     }
 
+    std::vector<size_t> topological_order;
+    bool const sorted = toposort(model.graph().node(), &topological_order);
+
+    // With a verdict for every node there is nothing left to import.
+    std::vector<uint64_t> fingerprints;
+    std::vector<bool> supported;
+    if (_support_cache && sorted)
+    {
+        fingerprints = SupportCache::fingerprintNodes(model, topological_order);
+        if (_support_cache->lookup(fingerprints, &supported))
+        {
+            return partitionSupportedNodes(topological_order, supported, true, sub_graph_collection);
+        }
+    }
+
     bool allSupported{true};
 
     // Parse the graph and see if we hit any parsing errors
@@ -392,15 +449,17 @@ bool ModelImporter::supportsModel(
         return false;
     };
 
-    bool newSubGraph(true);
     // Sort and partition supported subgraphs
-    std::vector<size_t> topological_order;
-    if (!toposort(model.graph().node(), &topological_order))
+    if (!sorted)
     {
         LOG_VERBOSE("Failed to sort model topologically, exiting ...");
         return false;
     }
 
+    // The import stops at the node it fails on, so only the nodes before it were checked.
+    bool const parsed = allSupported;
+    bool checked = parsed || error_node != -1;
+    supported.assign(model.graph().node_size(), false);
     for (int node_idx : topological_order)
     {
         ::ONNX_NAMESPACE::NodeProto const& node = model.graph().node(node_idx);
@@ -415,7 +474,25 @@ bool ModelImporter::supportsModel(
         bool unsupportedShapeType = checkShapeTensorType(node);
         bool unsupportedShapeTensor = ctx->unsupportedShapeTensors().count(node.name()) > 0 ? true : false;
         bool unsuccessfulParse = node_idx == error_node;
-        if (registered && !unsupportedInput && !unsupportedShapeType && !unsupportedShapeTensor && !unsuccessfulParse)
+        supported[node_idx] = registered && !unsupportedInput && !unsupportedShapeType && !unsupportedShapeTensor
+            && !unsuccessfulParse;
+        if (_support_cache && checked)
+        {
+            _support_cache->insert(fingerprints[node_idx], supported[node_idx]);
+        }
+        checked = checked && !unsuccessfulParse;
+    }
+    return partitionSupportedNodes(topological_order, supported, parsed, sub_graph_collection);
+}
+
+bool ModelImporter::partitionSupportedNodes(std::vector<size_t> const& topological_order,
+    std::vector<bool> const& supported, bool parsed, SubGraphCollection_t& sub_graph_collection)
+{
+    bool allSupported{parsed};
+    bool newSubGraph(true);
+    for (size_t node_idx : topological_order)
+    {
+        if (supported[node_idx])
         {
             if (newSubGraph)
             {
@@ -489,6 +566,26 @@ bool ModelImporter::parse(void const* serialized_onnx_model, size_t serialized_o
     return this->parseWithWeightDescriptors(serialized_onnx_model, serialized_onnx_model_size);
 }
 
+bool ModelImporter::parseFromModel(nvonnxparser::IOnnxModel const& model)
+{
+    auto const& onnxModel = static_cast<OnnxModel const&>(model);
+    _current_node = -1;
+    _importer_ctx.setOnnxFileLocation(onnxModel.getFileLocation());
+    // The model owns both the ModelProto and the converted weights, so neither is copied here.
+    _importer_ctx.setWeightsCache(&onnxModel);
+    _importer_ctx.setFoldedConstants(&onnxModel.getFoldedConstants());
+    Status status = this->importModel(onnxModel.getModel());
+    _importer_ctx.setWeightsCache(nullptr);
+    _importer_ctx.setFoldedConstants(nullptr);
+    if (status.is_error())
+    {
+        status.setNode(_current_node);
+        _errors.push_back(status);
+        return false;
+    }
+    return true;
+}
+
 void removeShapeTensorCasts(IImporterContext* ctx)
 {
     // Removes any casts on shape tensors, as TensorRT does not support them.
@@ -556,16 +653,56 @@ Status ModelImporter::importModel(
 
     _current_node = -1;
     CHECK(importInputs(&_importer_ctx, graph, &_importer_ctx.tensors()));
-    CHECK(parseGraph(&_importer_ctx, graph, model.producer_name() == "TensorRT", &_current_node));
+
+    // Unless the weights come pre-converted from an OnnxModel, convert them on a pool of threads first, so that
+    // parseGraph() only has to do the (serial) network construction. The weights of an earlier parse are released
+    // here rather than kept for the lifetime of the parser; see IParser::parse().
+    _prepared_weights.reset();
+    const bool prepareWeights = !_importer_ctx.weightsCache();
+    const int nbPrepareThreads = prepareWeights ? PreparedWeights::getNbThreads(graph) : 1;
+    if (nbPrepareThreads > 1)
+    {
+        _prepared_weights.reset(new PreparedWeights(&ctx->logger(), _importer_ctx.getLogSeverity(),
+            _importer_ctx.getOnnxFileLocation(), &_importer_ctx.externalData()));
+        PreparedWeights& preparedWeights = *_prepared_weights;
+        const int nbFailed = preparedWeights.prepare(graph, nbPrepareThreads);
+        LOG_VERBOSE("Converted " << preparedWeights.size() << " weights on " << nbPrepareThreads << " threads ("
+                                 << nbFailed << " left to the importer)");
+        _importer_ctx.setWeightsCache(&preparedWeights);
+    }
+
+    // Evaluate constant subexpressions (mostly shape arithmetic) on the host so they do not become layers. Networks
+    // deserialized from TensorRT are imported as is to keep the 1:1 layer mapping.
+    const bool deserializingINetwork = model.producer_name() == "TensorRT";
+    const bool foldConstants = !_importer_ctx.foldedConstants() && !deserializingINetwork;
+    _folded_constants.reset();
+    if (foldConstants)
+    {
+        _folded_constants.reset(new FoldedConstants(&ConstantFoldingCache::global()));
+        FoldedConstants& folded = *_folded_constants;
+        folded.fold(graph);
+        LOG_VERBOSE("Folded " << folded.size() << " constant nodes (" << folded.getNbCacheHits() << " from cache)");
+        _importer_ctx.setFoldedConstants(&folded);
+    }
+
+    Status status = parseGraph(&_importer_ctx, graph, deserializingINetwork, &_current_node);
+    if (nbPrepareThreads > 1)
+    {
+        _importer_ctx.setWeightsCache(nullptr);
+    }
+    if (foldConstants)
+    {
+        _importer_ctx.setFoldedConstants(nullptr);
+    }
+    CHECK(status);
 
     _current_node = -1;
     // Mark outputs defined in the ONNX model (unless tensors are user-requested)
     for (::ONNX_NAMESPACE::ValueInfoProto const& output : graph.output())
     {
-        ASSERT((_importer_ctx.tensors().count(output.name())) && "The output tensor was not registered.",
-            ErrorCode::kINVALID_GRAPH);
-        nvinfer1::ITensor* output_tensor_ptr
-            = &convertToTensor(_importer_ctx.tensors().at(output.name()), &_importer_ctx);
+        TensorOrWeights* output_tensor = _importer_ctx.tensors().find(output.name());
+        ASSERT((output_tensor) && "The output tensor was not registered.", ErrorCode::kINVALID_GRAPH);
+        nvinfer1::ITensor* output_tensor_ptr = &convertToTensor(*output_tensor, &_importer_ctx);
         LOG_VERBOSE("Marking " << output_tensor_ptr->getName() << " as output: " << output.name());
         output_tensor_ptr->setName(output.name().c_str());
 
@@ -681,6 +818,18 @@ bool ModelImporter::parseFromFile(const char* onnxModelFile, int32_t verbosity)
     ::ONNX_NAMESPACE::ModelProto onnx_model;
     auto* ctx = &_importer_ctx;
 
+    // The verbosity applies to this call only; later parse*() calls keep the one set by setVerbosity().
+    struct VerbosityScope
+    {
+        ImporterContext& ctx;
+        const nvinfer1::ILogger::Severity previous;
+        ~VerbosityScope()
+        {
+            ctx.setLogSeverity(previous);
+        }
+    } verbosityScope{_importer_ctx, _importer_ctx.getLogSeverity()};
+    setVerbosity(verbosity);
+
     const bool is_binary = ParseFromFile_WAR(&onnx_model, onnxModelFile);
     if (!is_binary && !ParseFromTextFile(&onnx_model, onnxModelFile))
     {
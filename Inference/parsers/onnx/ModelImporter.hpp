@@ -7,6 +7,8 @@
 #include "ImporterContext.hpp"
 #include "NvInferPlugin.h"
 #include "NvOnnxParser.h"
+#include "PreparedWeights.hpp"
+#include "SupportCache.hpp"
 #include "builtin_op_importers.hpp"
 #include "utils.hpp"
 
@@ -24,8 +26,16 @@ protected:
 private:
     ImporterContext _importer_ctx;
     std::list<::ONNX_NAMESPACE::ModelProto> _onnx_models; // Needed for ownership of weights
+    std::unique_ptr<PreparedWeights> _prepared_weights; // Weights converted by the last parse, which its network uses
+    std::unique_ptr<FoldedConstants> _folded_constants; // Constants folded by the last parse, which its network uses
     int _current_node;
     std::vector<Status> _errors;
+    SupportCache* _support_cache{nullptr};
+
+    //! Groups the supported nodes into subgraphs of consecutive nodes in topological order. The model is supported
+    //! if it parsed and every node is supported.
+    static bool partitionSupportedNodes(std::vector<size_t> const& topological_order,
+        std::vector<bool> const& supported, bool parsed, SubGraphCollection_t& sub_graph_collection);
 
 public:
     ModelImporter(nvinfer1::INetworkDefinition* network, nvinfer1::ILogger* logger)
@@ -64,9 +74,19 @@ public:
     {
         _errors.clear();
     }
+    void setVerbosity(int verbosity) override
+    {
+        _importer_ctx.setLogSeverity(static_cast<nvinfer1::ILogger::Severity>(verbosity));
+    }
+    void setSupportCache(nvonnxparser::ISupportCache* cache) override
+    {
+        // createSupportCache() is the only way to make one.
+        _support_cache = static_cast<SupportCache*>(cache);
+    }
 
     //...LG: Move the implementation to .cpp
     bool parseFromFile(const char* onnxModelFile, int verbosity) override;
+    bool parseFromModel(nvonnxparser::IOnnxModel const& model) override;
 };
 
 } // namespace onnx2trt
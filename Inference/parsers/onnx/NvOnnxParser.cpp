@@ -4,6 +4,8 @@
 
 #include "NvOnnxParser.h"
 #include "ModelImporter.hpp"
+#include "OnnxModel.hpp"
+#include "SupportCache.hpp"
 
 extern "C" void* createNvOnnxParser_INTERNAL(void* network_, void* logger_, int version)
 {
@@ -12,6 +14,17 @@ extern "C" void* createNvOnnxParser_INTERNAL(void* network_, void* logger_, int
     return new onnx2trt::ModelImporter(network, logger);
 }
 
+extern "C" void* createNvOnnxModel_INTERNAL(const char* onnxModelFile, void* logger_, int version)
+{
+    auto logger = static_cast<nvinfer1::ILogger*>(logger_);
+    return onnx2trt::OnnxModel::createFromFile(onnxModelFile, logger);
+}
+
+extern "C" void* createNvOnnxSupportCache_INTERNAL(int version)
+{
+    return new onnx2trt::SupportCache();
+}
+
 extern "C" int getNvOnnxParserVersion()
 {
     return NV_ONNX_PARSER_VERSION;
@@ -16,7 +16,7 @@
 //!
 
 #define NV_ONNX_PARSER_MAJOR 0
-#define NV_ONNX_PARSER_MINOR 1
+#define NV_ONNX_PARSER_MINOR 2
 #define NV_ONNX_PARSER_PATCH 0
 
 static const int NV_ONNX_PARSER_VERSION = ((NV_ONNX_PARSER_MAJOR * 10000) + (NV_ONNX_PARSER_MINOR * 100) + NV_ONNX_PARSER_PATCH);
@@ -99,6 +99,73 @@ protected:
     virtual ~IParserError() {}
 };
 
+/** \class IOnnxModel
+ *
+ * \brief an ONNX model that has been decoded once and whose initializers have
+ *        already been converted to TensorRT weights
+ *
+ * The same IOnnxModel can populate any number of network definitions through
+ * IParser::parseFromModel(), e.g. one per optimization profile or batch bucket.
+ * The networks reference weights owned by the model, so the model must outlive
+ * every engine built from them. The model is immutable after creation and may be
+ * shared between parsers.
+ *
+ * \see createOnnxModelFromFile() IParser::parseFromModel()
+ */
+class IOnnxModel
+{
+public:
+    /** \brief number of nodes in the top-level graph
+     */
+    virtual int getNbNodes() const = 0;
+    /** \brief number of initializers that were converted when the model was created
+     */
+    virtual int getNbWeights() const = 0;
+    /** \brief destroy this object
+     */
+    virtual void destroy() = 0;
+
+    virtual ~IOnnxModel() noexcept = default;
+};
+
+/** \class ISupportCache
+ *
+ * \brief the verdicts of IParser::supportsModel() for each node it checked, keyed
+ *        by a fingerprint of the subgraph that produces the node
+ *
+ * A fingerprint covers the node's op, opset and attributes and, recursively, the
+ * nodes, initializers and graph inputs it depends on, but not node or tensor names.
+ * Once every node of a model has a verdict, supportsModel() partitions the model
+ * from the cache without importing it, so after a model changes only the analysis
+ * of the changed graph is repeated. The cache is thread-safe and may be shared by
+ * any number of parsers.
+ *
+ * \see createSupportCache() IParser::setSupportCache()
+ */
+class ISupportCache
+{
+public:
+    /** \brief Add the verdicts stored in a file by save() to this cache.
+     *
+     * \return false if the file cannot be read or was written by another version
+     *         of the parser or of TensorRT; the cache is then left unchanged
+     */
+    virtual bool load(const char* path) = 0;
+    /** \brief Write all verdicts to a file.
+     *
+     * \return false if the file cannot be written
+     */
+    virtual bool save(const char* path) const = 0;
+    /** \brief number of fingerprints with a verdict
+     */
+    virtual int getNbEntries() const = 0;
+    /** \brief destroy this object
+     */
+    virtual void destroy() = 0;
+
+    virtual ~ISupportCache() noexcept = default;
+};
+
 /** \class IParser
  *
  * \brief an object for parsing ONNX models into a TensorRT network definition
@@ -118,6 +185,9 @@ public:
      * \param model_path Absolute path to the model file for loading external weights if required
      * \return true if the model was parsed successfully
      * \see getNbErrors() getError()
+     *
+     * \note Weights the parser converts for the network stay valid until the next
+     *       parse or until the parser is destroyed, so build the engine first.
      */
     virtual bool parse(void const* serialized_onnx_model,
                        size_t serialized_onnx_model_size,
@@ -195,12 +265,47 @@ public:
     virtual void clearErrors() = 0;
 
     virtual ~IParser() noexcept = default;
+
+    // Added after the destructor, so that the vtable of parsers built against 0.1 is a prefix of this one.
+
+    /** \brief Populate the TensorRT network from an already decoded ONNX model.
+     *         Neither the protobuf nor the initializers are decoded again, so this is
+     *         the cheap way to build several networks from the same model file.
+     *
+     * \param model A model created with createOnnxModelFromFile()
+     *
+     * \return true if the model was parsed successfully
+     * \see getNbErrors() getError()
+     */
+    virtual bool parseFromModel(IOnnxModel const& model) = 0;
+
+    /** \brief Set the least severe message the parser will format and pass to its logger.
+     *         Messages above this level are dropped before any string formatting happens.
+     *         Defaults to kVERBOSE, i.e. everything is forwarded and the logger filters.
+     *
+     * \param verbosity An nvinfer1::ILogger::Severity value cast to int
+     *
+     * \see parseFromFile()
+     */
+    virtual void setVerbosity(int verbosity) = 0;
+
+    /** \brief Memoize supportsModel() in a cache created with createSupportCache().
+     *         When the cache has a verdict for every node, supportsModel() neither
+     *         populates the network nor records errors. Pass nullptr to stop using it.
+     *
+     * \param cache The cache to use; must outlive its use by this parser
+     *
+     * \see ISupportCache supportsModel()
+     */
+    virtual void setSupportCache(ISupportCache* cache) = 0;
 };
 
 } // namespace nvonnxparser
 
 extern "C" TENSORRTAPI void* createNvOnnxParser_INTERNAL(void* network, void* logger, int version);
 extern "C" TENSORRTAPI int getNvOnnxParserVersion();
+extern "C" TENSORRTAPI void* createNvOnnxModel_INTERNAL(const char* onnxModelFile, void* logger, int version);
+extern "C" TENSORRTAPI void* createNvOnnxSupportCache_INTERNAL(int version);
 
 namespace nvonnxparser
 {
@@ -226,6 +331,31 @@ inline IParser* createParser(nvinfer1::INetworkDefinition& network, nvinfer1::IL
     return static_cast<IParser*>(createNvOnnxParser_INTERNAL(&network, &logger, NV_ONNX_PARSER_VERSION));
 }
 
+/** \brief Decode an ONNX model file and convert its initializers once
+ *
+ * \param onnxModelFile Path to a binary or text ONNX model; external weights are
+ *        resolved relative to it
+ * \param logger The logger to use
+ * \return a new model object or NULL if the file could not be decoded
+ *
+ * \see IOnnxModel IParser::parseFromModel()
+ */
+inline IOnnxModel* createOnnxModelFromFile(const char* onnxModelFile, nvinfer1::ILogger& logger)
+{
+    return static_cast<IOnnxModel*>(createNvOnnxModel_INTERNAL(onnxModelFile, &logger, NV_ONNX_PARSER_VERSION));
+}
+
+/** \brief Create an empty cache of supportsModel() verdicts
+ *
+ * \return a new cache object
+ *
+ * \see ISupportCache IParser::setSupportCache()
+ */
+inline ISupportCache* createSupportCache()
+{
+    return static_cast<ISupportCache*>(createNvOnnxSupportCache_INTERNAL(NV_ONNX_PARSER_VERSION));
+}
+
 } // namespace
 
 } // namespace nvonnxparser
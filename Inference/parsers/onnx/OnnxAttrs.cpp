@@ -6,21 +6,58 @@
 #include "ShapedWeights.hpp"
 #include "onnx2trt_utils.hpp"
 #include <onnx/onnx_pb.h>
+#include <algorithm>
+
+OnnxAttrs::OnnxAttrs(::ONNX_NAMESPACE::NodeProto const& onnx_node, onnx2trt::IImporterContext* ctx)
+    : mSize{onnx_node.attribute_size()}
+    , mCtx{ctx}
+{
+    ::ONNX_NAMESPACE::AttributeProto const** attrs = mInline;
+    if (mSize > kINLINE_ATTRS)
+    {
+        mOverflow.resize(mSize);
+        attrs = mOverflow.data();
+    }
+    for (int i = 0; i < mSize; ++i)
+    {
+        attrs[i] = &onnx_node.attribute(i);
+    }
+    // Insertion sort: nodes have few attributes, and unlike std::stable_sort it needs no buffer. Being stable, find()
+    // returns the first of repeated names.
+    for (int i = 1; i < mSize; ++i)
+    {
+        auto const* attr = attrs[i];
+        int j = i;
+        for (; j > 0 && attr->name() < attrs[j - 1]->name(); --j)
+        {
+            attrs[j] = attrs[j - 1];
+        }
+        attrs[j] = attr;
+    }
+}
+
+::ONNX_NAMESPACE::AttributeProto const* OnnxAttrs::find(Key key) const
+{
+    ::ONNX_NAMESPACE::AttributeProto const* const* attrs = mOverflow.empty() ? mInline : mOverflow.data();
+    auto const* it = std::lower_bound(attrs, attrs + mSize, key,
+        [](::ONNX_NAMESPACE::AttributeProto const* attr, Key const& k) { return k.compare(attr->name()) > 0; });
+    return it != attrs + mSize && key.compare((*it)->name()) == 0 ? *it : nullptr;
+}
 
 template <>
-float OnnxAttrs::get<float>(const std::string& key) const
+float OnnxAttrs::get<float>(Key key) const
 {
     return this->at(key)->f();
 }
 
 template <>
-int OnnxAttrs::get<int>(const std::string& key) const
+int OnnxAttrs::get<int>(Key key) const
 {
     return this->at(key)->i();
 }
 
 template <>
-bool OnnxAttrs::get<bool>(const std::string& key) const
+bool OnnxAttrs::get<bool>(Key key) const
 {
     int value = this->at(key)->i();
     assert(value == bool(value));
@@ -28,36 +65,37 @@ bool OnnxAttrs::get<bool>(const std::string& key) const
 }
 
 template <>
-std::string OnnxAttrs::get<std::string>(const std::string& key) const
+std::string OnnxAttrs::get<std::string>(Key key) const
 {
     return this->at(key)->s();
 }
 
 template <>
-std::vector<int> OnnxAttrs::get<std::vector<int>>(const std::string& key) const
+std::vector<int> OnnxAttrs::get<std::vector<int>>(Key key) const
 {
-    auto attr = this->at(key)->ints();
+    auto const& attr = this->at(key)->ints();
     return std::vector<int>(attr.begin(), attr.end());
 }
 
 template <>
-std::vector<int64_t> OnnxAttrs::get<std::vector<int64_t>>(const std::string& key) const
+std::vector<int64_t> OnnxAttrs::get<std::vector<int64_t>>(Key key) const
 {
-    auto attr = this->at(key)->ints();
+    auto const& attr = this->at(key)->ints();
     return std::vector<int64_t>(attr.begin(), attr.end());
 }
 
 template <>
-std::vector<float> OnnxAttrs::get<std::vector<float>>(const std::string& key) const
+std::vector<float> OnnxAttrs::get<std::vector<float>>(Key key) const
 {
-    auto attr = this->at(key)->floats();
+    auto const& attr = this->at(key)->floats();
     return std::vector<float>(attr.begin(), attr.end());
 }
 
 template <>
-nvinfer1::Dims OnnxAttrs::get<nvinfer1::Dims>(const std::string& key) const
+nvinfer1::Dims OnnxAttrs::get<nvinfer1::Dims>(Key key) const
 {
-    auto values = this->get<std::vector<int>>(key);
+    auto const& values = this->ints(key);
+    assert(values.size() <= nvinfer1::Dims::MAX_DIMS);
     nvinfer1::Dims dims;
     dims.nbDims = values.size();
     std::copy(values.begin(), values.end(), dims.d);
@@ -66,7 +104,7 @@ nvinfer1::Dims OnnxAttrs::get<nvinfer1::Dims>(const std::string& key) const
 }
 
 template <>
-nvinfer1::DimsHW OnnxAttrs::get<nvinfer1::DimsHW>(const std::string& key) const
+nvinfer1::DimsHW OnnxAttrs::get<nvinfer1::DimsHW>(Key key) const
 {
     nvinfer1::Dims dims = this->get<nvinfer1::Dims>(key);
     assert(dims.nbDims == 2);
@@ -74,9 +112,10 @@ nvinfer1::DimsHW OnnxAttrs::get<nvinfer1::DimsHW>(const std::string& key) const
 }
 
 template <>
-nvinfer1::Permutation OnnxAttrs::get<nvinfer1::Permutation>(const std::string& key) const
+nvinfer1::Permutation OnnxAttrs::get<nvinfer1::Permutation>(Key key) const
 {
-    auto values = this->get<std::vector<int>>(key);
+    auto const& values = this->ints(key);
+    assert(values.size() <= nvinfer1::Dims::MAX_DIMS);
     nvinfer1::Permutation perm;
     std::copy(values.begin(), values.end(), perm.order);
     // Fill unused values with identity permutation
@@ -88,10 +127,15 @@ nvinfer1::Permutation OnnxAttrs::get<nvinfer1::Permutation>(const std::string& k
 }
 
 template <>
-onnx2trt::ShapedWeights OnnxAttrs::get<onnx2trt::ShapedWeights>(const std::string& key) const
+onnx2trt::ShapedWeights OnnxAttrs::get<onnx2trt::ShapedWeights>(Key key) const
 {
     ::ONNX_NAMESPACE::TensorProto const& onnx_weights_tensor = this->at(key)->t();
     onnx2trt::ShapedWeights weights;
+    onnx2trt::IWeightsCache const* weightsCache = mCtx->weightsCache();
+    if (weightsCache && weightsCache->findWeights(onnx_weights_tensor, &weights))
+    {
+        return weights;
+    }
     bool success = convertOnnxWeights(onnx_weights_tensor, &weights, mCtx);
     if (!success)
     {
@@ -101,7 +145,7 @@ onnx2trt::ShapedWeights OnnxAttrs::get<onnx2trt::ShapedWeights>(const std::strin
 }
 
 template <>
-nvinfer1::DataType OnnxAttrs::get<nvinfer1::DataType>(const std::string& key) const
+nvinfer1::DataType OnnxAttrs::get<nvinfer1::DataType>(Key key) const
 {
     ::ONNX_NAMESPACE::TensorProto::DataType onnx_dtype
         = static_cast<::ONNX_NAMESPACE::TensorProto::DataType>(this->at(key)->i());
@@ -114,11 +158,11 @@ nvinfer1::DataType OnnxAttrs::get<nvinfer1::DataType>(const std::string& key) co
 }
 
 template <>
-std::vector<nvinfer1::DataType> OnnxAttrs::get<std::vector<nvinfer1::DataType>>(const std::string& key) const
+std::vector<nvinfer1::DataType> OnnxAttrs::get<std::vector<nvinfer1::DataType>>(Key key) const
 {
-    auto attr = this->at(key)->ints();
-    auto onnx_dtypes = std::vector<int64_t>(attr.begin(), attr.end());
+    auto const& onnx_dtypes = this->at(key)->ints();
     std::vector<nvinfer1::DataType> dtypes{};
+    dtypes.reserve(onnx_dtypes.size());
     for (auto onnx_dtype : onnx_dtypes)
     {
         nvinfer1::DataType dtype{};
@@ -177,7 +221,7 @@ inline nvinfer1::ActivationType activationStringToEnum(const std::string& type)
 }
 
 template <>
-nvinfer1::ActivationType OnnxAttrs::get<nvinfer1::ActivationType>(const std::string& key) const
+nvinfer1::ActivationType OnnxAttrs::get<nvinfer1::ActivationType>(Key key) const
 {
     const std::string type = this->get<std::string>(key);
     return activationStringToEnum(type);
@@ -185,9 +229,9 @@ nvinfer1::ActivationType OnnxAttrs::get<nvinfer1::ActivationType>(const std::str
 
 template <>
 std::vector<nvinfer1::ActivationType> OnnxAttrs::get<std::vector<nvinfer1::ActivationType>>(
-    const std::string& key) const
+    Key key) const
 {
-    const auto strings = this->at(key)->strings();
+    const auto& strings = this->at(key)->strings();
     std::vector<nvinfer1::ActivationType> actTypes;
     for (const auto& str : strings)
     {
@@ -197,13 +241,13 @@ std::vector<nvinfer1::ActivationType> OnnxAttrs::get<std::vector<nvinfer1::Activ
 }
 
 template <>
-const ::ONNX_NAMESPACE::GraphProto& OnnxAttrs::get<const ::ONNX_NAMESPACE::GraphProto&>(const std::string& key) const
+const ::ONNX_NAMESPACE::GraphProto& OnnxAttrs::get<const ::ONNX_NAMESPACE::GraphProto&>(Key key) const
 {
     return this->at(key)->g();
 }
 
 template <>
-nvinfer1::RNNOperation OnnxAttrs::get<nvinfer1::RNNOperation>(const std::string& key) const
+nvinfer1::RNNOperation OnnxAttrs::get<nvinfer1::RNNOperation>(Key key) const
 {
     std::string op = this->get<std::string>(key);
     if (op == std::string("relu"))
@@ -226,7 +270,7 @@ nvinfer1::RNNOperation OnnxAttrs::get<nvinfer1::RNNOperation>(const std::string&
 }
 
 template <>
-nvinfer1::RNNInputMode OnnxAttrs::get<nvinfer1::RNNInputMode>(const std::string& key) const
+nvinfer1::RNNInputMode OnnxAttrs::get<nvinfer1::RNNInputMode>(Key key) const
 {
     std::string mode = this->get<std::string>(key);
     if (mode == std::string("skip"))
@@ -241,7 +285,7 @@ nvinfer1::RNNInputMode OnnxAttrs::get<nvinfer1::RNNInputMode>(const std::string&
 }
 
 template <>
-nvinfer1::RNNDirection OnnxAttrs::get<nvinfer1::RNNDirection>(const std::string& key) const
+nvinfer1::RNNDirection OnnxAttrs::get<nvinfer1::RNNDirection>(Key key) const
 {
     std::string direction = this->get<std::string>(key);
     if (direction == std::string("unidirection"))
@@ -256,14 +300,14 @@ nvinfer1::RNNDirection OnnxAttrs::get<nvinfer1::RNNDirection>(const std::string&
 }
 
 template <>
-std::vector<std::string> OnnxAttrs::get<std::vector<std::string>>(const std::string& key) const
+std::vector<std::string> OnnxAttrs::get<std::vector<std::string>>(Key key) const
 {
-    auto attr = this->at(key)->strings();
+    auto const& attr = this->at(key)->strings();
     return std::vector<std::string>(attr.begin(), attr.end());
 }
 
 template <>
-nvinfer1::ScaleMode OnnxAttrs::get<nvinfer1::ScaleMode>(const std::string& key) const
+nvinfer1::ScaleMode OnnxAttrs::get<nvinfer1::ScaleMode>(Key key) const
 {
     std::string s = this->get<std::string>(key);
     if (s == "uniform")
@@ -282,7 +326,7 @@ nvinfer1::ScaleMode OnnxAttrs::get<nvinfer1::ScaleMode>(const std::string& key)
 }
 
 template <>
-nvinfer1::MatrixOperation OnnxAttrs::get<nvinfer1::MatrixOperation>(const std::string& key) const
+nvinfer1::MatrixOperation OnnxAttrs::get<nvinfer1::MatrixOperation>(Key key) const
 {
     std::string s = this->get<std::string>(key);
     if (s == "none")
@@ -301,7 +345,7 @@ nvinfer1::MatrixOperation OnnxAttrs::get<nvinfer1::MatrixOperation>(const std::s
 }
 
 template <>
-nvinfer1::ResizeMode OnnxAttrs::get<nvinfer1::ResizeMode>(const std::string& key) const
+nvinfer1::ResizeMode OnnxAttrs::get<nvinfer1::ResizeMode>(Key key) const
 {
     const auto& mode = this->get<std::string>(key);
     if (mode == "nearest")
@@ -317,7 +361,7 @@ nvinfer1::ResizeMode OnnxAttrs::get<nvinfer1::ResizeMode>(const std::string& key
 
 template <>
 nvinfer1::ResizeCoordinateTransformation OnnxAttrs::get<nvinfer1::ResizeCoordinateTransformation>(
-    const std::string& key) const
+    Key key) const
 {
     const auto& transformation = this->get<std::string>(key);
     if (transformation == "align_corners")
@@ -336,7 +380,7 @@ nvinfer1::ResizeCoordinateTransformation OnnxAttrs::get<nvinfer1::ResizeCoordina
 }
 
 template <>
-nvinfer1::ResizeSelector OnnxAttrs::get<nvinfer1::ResizeSelector>(const std::string& key) const
+nvinfer1::ResizeSelector OnnxAttrs::get<nvinfer1::ResizeSelector>(Key key) const
 {
     const auto& selector = this->get<std::string>(key);
     if (selector == "formula")
@@ -351,7 +395,7 @@ nvinfer1::ResizeSelector OnnxAttrs::get<nvinfer1::ResizeSelector>(const std::str
 }
 
 template <>
-nvinfer1::ResizeRoundMode OnnxAttrs::get<nvinfer1::ResizeRoundMode>(const std::string& key) const
+nvinfer1::ResizeRoundMode OnnxAttrs::get<nvinfer1::ResizeRoundMode>(Key key) const
 {
     const auto& roundMode = this->get<std::string>(key);
     if (roundMode == "half_up")
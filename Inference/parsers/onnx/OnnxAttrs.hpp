@@ -6,55 +6,106 @@
 
 #include <NvInfer.h>
 #include <onnx/onnx_pb.h>
-#include <unordered_map>
+#include <cstring>
+#include <string>
 #include <vector>
 
 #include "ImporterContext.hpp"
 
+//! Typed access to the attributes of a NodeProto.
+//!
+//! The attributes are indexed once, by name, in a small sorted array that points into the NodeProto, which must
+//! outlive the OnnxAttrs. Looking up an attribute neither copies its name nor allocates.
 class OnnxAttrs
 {
-    template <typename T>
-    using string_map = std::unordered_map<std::string, T>;
-    typedef string_map<::ONNX_NAMESPACE::AttributeProto const*> AttrMap;
-    AttrMap _attrs;
-    onnx2trt::IImporterContext* mCtx;
-
 public:
-    explicit OnnxAttrs(::ONNX_NAMESPACE::NodeProto const& onnx_node, onnx2trt::IImporterContext* ctx)
-        : mCtx{ctx}
+    //! Name of an attribute, referring to a string literal or std::string without copying it.
+    class Key
     {
-        for (auto const& attr : onnx_node.attribute())
+    public:
+        Key(char const* name)
+            : mData(name)
+            , mSize(std::strlen(name))
         {
-            _attrs.insert({attr.name(), &attr});
         }
-    }
 
-    bool count(const std::string& key) const
+        Key(std::string const& name)
+            : mData(name.data())
+            , mSize(name.size())
+        {
+        }
+
+        std::string str() const
+        {
+            return std::string(mData, mSize);
+        }
+
+        //! Three-way comparison with name, like std::string::compare.
+        int compare(std::string const& name) const
+        {
+            return -name.compare(0, std::string::npos, mData, mSize);
+        }
+
+    private:
+        char const* mData;
+        size_t mSize;
+    };
+
+    using Ints = ::google::protobuf::RepeatedField<::google::protobuf::int64>;
+    using Floats = ::google::protobuf::RepeatedField<float>;
+
+    explicit OnnxAttrs(::ONNX_NAMESPACE::NodeProto const& onnx_node, onnx2trt::IImporterContext* ctx);
+
+    bool count(Key key) const
     {
-        return _attrs.count(key);
+        return find(key) != nullptr;
     }
 
-    ::ONNX_NAMESPACE::AttributeProto const* at(std::string key) const
+    ::ONNX_NAMESPACE::AttributeProto const* at(Key key) const
     {
-        if (!_attrs.count(key))
+        auto const* attr = find(key);
+        if (!attr)
         {
-            throw std::out_of_range("Attribute not found: " + key);
+            throw std::out_of_range("Attribute not found: " + key.str());
         }
-        return _attrs.at(key);
+        return attr;
     }
 
-    ::ONNX_NAMESPACE::AttributeProto::AttributeType type(const std::string& key) const
+    ::ONNX_NAMESPACE::AttributeProto::AttributeType type(Key key) const
     {
         return this->at(key)->type();
     }
 
+    //! Values of a repeated int attribute, without copying them.
+    Ints const& ints(Key key) const
+    {
+        return this->at(key)->ints();
+    }
+
+    //! Values of a repeated float attribute, without copying them.
+    Floats const& floats(Key key) const
+    {
+        return this->at(key)->floats();
+    }
 
     template <typename T>
-    T get(const std::string& key) const;
+    T get(Key key) const;
 
     template <typename T>
-    T get(const std::string& key, T const& default_value) const
+    T get(Key key, T const& default_value) const
     {
-        return _attrs.count(key) ? this->get<T>(key) : default_value;
+        return count(key) ? this->get<T>(key) : default_value;
     }
+
+private:
+    //! Attribute with the given name, or nullptr.  The first one if the node repeats the name.
+    ::ONNX_NAMESPACE::AttributeProto const* find(Key key) const;
+
+    //! Attributes sorted by name.  Nodes rarely have more than kINLINE_ATTRS attributes; the
+    //! others keep theirs in mOverflow.
+    static constexpr int kINLINE_ATTRS = 8;
+    ::ONNX_NAMESPACE::AttributeProto const* mInline[kINLINE_ATTRS];
+    std::vector<::ONNX_NAMESPACE::AttributeProto const*> mOverflow;
+    int mSize{0};
+    onnx2trt::IImporterContext* mCtx;
 };
@@ -0,0 +1,57 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "OnnxModel.hpp"
+#include "onnx2trt_utils.hpp"
+#include "onnx_utils.hpp"
+
+namespace onnx2trt
+{
+
+OnnxModel::OnnxModel(nvinfer1::ILogger* logger)
+    : mWeightsContext(nullptr, logger)
+{
+}
+
+OnnxModel* OnnxModel::createFromFile(const char* onnxModelFile, nvinfer1::ILogger* logger)
+{
+    GOOGLE_PROTOBUF_VERIFY_VERSION;
+    std::unique_ptr<OnnxModel> model{new OnnxModel(logger)};
+    auto* ctx = &model->mWeightsContext;
+
+    const bool is_binary = ParseFromFile_WAR(&model->mModel, onnxModelFile);
+    if (!is_binary && !ParseFromTextFile(&model->mModel, onnxModelFile))
+    {
+        LOG_ERROR("Failed to parse ONNX model from file: " << onnxModelFile);
+        return nullptr;
+    }
+
+    // External weights are resolved relative to the model file, exactly as in parseFromFile().
+    model->mFileLocation = onnxModelFile;
+    ctx->setOnnxFileLocation(onnxModelFile);
+
+    ::ONNX_NAMESPACE::GraphProto const& graph = model->mModel.graph();
+    model->mWeights.reset(new PreparedWeights(logger, ctx->getLogSeverity(), onnxModelFile, &ctx->externalData()));
+    if (model->mWeights->prepare(graph, PreparedWeights::getNbThreads(graph)) != 0)
+    {
+        LOG_ERROR("Failed to convert weights of ONNX model: " << onnxModelFile);
+        return nullptr;
+    }
+    if (model->mModel.producer_name() != "TensorRT")
+    {
+        model->mFoldedConstants.fold(graph);
+    }
+    LOG_INFO("Decoded " << onnxModelFile << ": " << model->getNbNodes() << " nodes, " << model->getNbWeights()
+                        << " converted weights (" << model->mWeights->getNbSharedWeights() << " shared, "
+                        << model->mWeights->getNbSharedHits() << " loaded by other models), "
+                        << model->mFoldedConstants.size() << " folded nodes");
+    return model.release();
+}
+
+bool OnnxModel::findWeights(::ONNX_NAMESPACE::TensorProto const& initializer, ShapedWeights* weights) const
+{
+    return mWeights->findWeights(initializer, weights);
+}
+
+} // namespace onnx2trt
@@ -0,0 +1,73 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include "ImporterContext.hpp"
+#include "NvOnnxParser.h"
+#include "PreparedWeights.hpp"
+
+#include <onnx/onnx_pb.h>
+#include <memory>
+#include <string>
+
+namespace onnx2trt
+{
+
+//! An ONNX model decoded once, with every initializer and tensor-valued attribute (including those inside
+//! If/Loop/Scan bodies) converted to TensorRT weights up front. ModelImporter::parseFromModel() imports the
+//! stored ModelProto directly and picks the converted weights up through IWeightsCache, so populating another
+//! network costs neither a protobuf decode nor a weight conversion.
+class OnnxModel final : public nvonnxparser::IOnnxModel, public IWeightsCache
+{
+public:
+    //! Returns nullptr if the file cannot be decoded or one of its weights cannot be converted.
+    static OnnxModel* createFromFile(const char* onnxModelFile, nvinfer1::ILogger* logger);
+
+    ::ONNX_NAMESPACE::ModelProto const& getModel() const
+    {
+        return mModel;
+    }
+
+    std::string const& getFileLocation() const
+    {
+        return mFileLocation;
+    }
+
+    FoldedConstants const& getFoldedConstants() const
+    {
+        return mFoldedConstants;
+    }
+
+    bool findWeights(::ONNX_NAMESPACE::TensorProto const& initializer, ShapedWeights* weights) const override;
+
+    int getNbNodes() const override
+    {
+        return mModel.graph().node_size();
+    }
+
+    int getNbWeights() const override
+    {
+        return static_cast<int>(mWeights->size());
+    }
+
+    void destroy() override
+    {
+        delete this;
+    }
+
+private:
+    explicit OnnxModel(nvinfer1::ILogger* logger);
+
+    ::ONNX_NAMESPACE::ModelProto mModel;
+    std::string mFileLocation;
+    // Network-less context that reads the external data of the model for the lifetime of the model.
+    ImporterContext mWeightsContext;
+    // Converted weights, keyed by the address of the TensorProto inside mModel, which never moves once decoded.
+    std::unique_ptr<PreparedWeights> mWeights;
+    // Host-evaluated nodes of the top-level graph, shared by every network populated from this model.
+    FoldedConstants mFoldedConstants{&ConstantFoldingCache::global()};
+};
+
+} // namespace onnx2trt
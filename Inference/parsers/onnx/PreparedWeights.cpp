@@ -0,0 +1,203 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "PreparedWeights.hpp"
+#include "onnx2trt_utils.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+namespace onnx2trt
+{
+
+namespace
+{
+
+// Below this many tensors per thread, starting the threads costs more than it saves.
+constexpr int kMIN_TENSORS_PER_THREAD = 16;
+
+void collectTensors(
+    ::ONNX_NAMESPACE::GraphProto const& graph, std::vector<::ONNX_NAMESPACE::TensorProto const*>* tensors)
+{
+    for (::ONNX_NAMESPACE::TensorProto const& initializer : graph.initializer())
+    {
+        tensors->push_back(&initializer);
+    }
+    // Constant values and control-flow bodies are imported through node attributes.
+    for (::ONNX_NAMESPACE::NodeProto const& node : graph.node())
+    {
+        for (::ONNX_NAMESPACE::AttributeProto const& attr : node.attribute())
+        {
+            switch (attr.type())
+            {
+            case ::ONNX_NAMESPACE::AttributeProto::TENSOR: tensors->push_back(&attr.t()); break;
+            case ::ONNX_NAMESPACE::AttributeProto::GRAPH: collectTensors(attr.g(), tensors); break;
+            case ::ONNX_NAMESPACE::AttributeProto::GRAPHS:
+                for (::ONNX_NAMESPACE::GraphProto const& subgraph : attr.graphs())
+                {
+                    collectTensors(subgraph, tensors);
+                }
+                break;
+            default: break;
+            }
+        }
+    }
+}
+
+} // namespace
+
+PreparedWeights::PreparedWeights(nvinfer1::ILogger* logger, nvinfer1::ILogger::Severity logSeverity,
+    std::string const& onnxFileLocation, ExternalDataReader* externalData)
+    : mLogger(logger)
+    , mLogSeverity(logSeverity)
+    , mOnnxFileLocation(onnxFileLocation)
+    , mExternalData(externalData)
+{
+}
+
+std::unique_ptr<ImporterContext> PreparedWeights::newWorkerContext(ExternalDataReader* externalData) const
+{
+    std::unique_ptr<ImporterContext> ctx{new ImporterContext(nullptr, mLogger)};
+    ctx->setLogSeverity(mLogSeverity);
+    ctx->setOnnxFileLocation(mOnnxFileLocation);
+    ctx->shareExternalData(externalData);
+    return ctx;
+}
+
+int PreparedWeights::getNbThreads(::ONNX_NAMESPACE::GraphProto const& graph)
+{
+    std::vector<::ONNX_NAMESPACE::TensorProto const*> tensors;
+    collectTensors(graph, &tensors);
+    const int hardwareThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    return std::max(1, std::min(hardwareThreads, static_cast<int>(tensors.size()) / kMIN_TENSORS_PER_THREAD));
+}
+
+int PreparedWeights::prepare(::ONNX_NAMESPACE::GraphProto const& graph, int nbThreads)
+{
+    std::vector<::ONNX_NAMESPACE::TensorProto const*> tensors;
+    collectTensors(graph, &tensors);
+    nbThreads = std::max(1, std::min(nbThreads, static_cast<int>(tensors.size())));
+
+    // Shared tensors that another model has already converted are taken from the cache. The payloads of the others
+    // are read up front, the shared ones into a reader that only lives for this call because the cache keeps its
+    // own copy of what they convert to. Ranges that cannot be decoded are left to the conversion to report.
+    SharedWeightsCache& sharedCache = SharedWeightsCache::global();
+    std::vector<std::string> sharedKeys(tensors.size());
+    std::vector<std::shared_ptr<SharedWeightsCache::Entry const>> shared(tensors.size());
+    std::vector<ExternalDataRange> ranges;
+    std::vector<ExternalDataRange> sharedRanges;
+    for (size_t i = 0; i < tensors.size(); ++i)
+    {
+        if (tensors[i]->data_location() != ::ONNX_NAMESPACE::TensorProto::EXTERNAL)
+        {
+            continue;
+        }
+        const bool isShared = SharedWeightsCache::getKey(*tensors[i], &sharedKeys[i]);
+        if (isShared && (shared[i] = sharedCache.find(sharedKeys[i])))
+        {
+            ++mNbSharedHits;
+            continue;
+        }
+        ExternalDataRange range;
+        std::string error;
+        if (getExternalDataRange(*tensors[i], mOnnxFileLocation, &range, &error))
+        {
+            (isShared ? sharedRanges : ranges).push_back(std::move(range));
+        }
+    }
+    // A range that fails to prefetch is read again, and fails to convert, below.
+    ExternalDataReader sharedReader;
+    std::string error;
+    if (!ranges.empty())
+    {
+        mExternalData->prefetch(ranges, &error);
+    }
+    if (!sharedRanges.empty())
+    {
+        sharedReader.prefetch(sharedRanges, &error);
+    }
+
+    // Workers pull tensors off a shared counter and write into their own slots, so the results do not depend on
+    // how the work was scheduled.
+    std::vector<ShapedWeights> results(tensors.size());
+    std::vector<char> converted(tensors.size(), false);
+    std::atomic<size_t> next{0};
+    auto work = [&](ImporterContext* ctx, ImporterContext* sharedCtx) {
+        for (size_t i = next++; i < tensors.size(); i = next++)
+        {
+            if (shared[i])
+            {
+                converted[i] = true;
+            }
+            else if (sharedKeys[i].empty())
+            {
+                converted[i] = convertOnnxWeights(*tensors[i], &results[i], ctx);
+            }
+            else
+            {
+                ShapedWeights weights;
+                converted[i] = convertOnnxWeights(*tensors[i], &weights, sharedCtx);
+                if (converted[i])
+                {
+                    shared[i] = sharedCache.insert(
+                        sharedKeys[i], weights.type, weights.shape, weights.values, weights.size_bytes());
+                }
+            }
+        }
+    };
+
+    // The contexts converting shared tensors only own temporary buffers, and go away with sharedReader.
+    std::vector<ImporterContext*> contexts;
+    std::vector<std::unique_ptr<ImporterContext>> sharedContexts;
+    for (int i = 0; i < nbThreads; ++i)
+    {
+        mWorkerContexts.push_back(newWorkerContext(mExternalData));
+        contexts.push_back(mWorkerContexts.back().get());
+        sharedContexts.push_back(newWorkerContext(&sharedReader));
+    }
+    std::vector<std::thread> threads;
+    for (int i = 1; i < nbThreads; ++i)
+    {
+        threads.emplace_back(work, contexts[i], sharedContexts[i].get());
+    }
+    work(contexts[0], sharedContexts[0].get());
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    int nbFailed = 0;
+    for (size_t i = 0; i < tensors.size(); ++i)
+    {
+        if (!converted[i])
+        {
+            ++nbFailed;
+        }
+        else if (shared[i])
+        {
+            mWeights.emplace(tensors[i],
+                ShapedWeights(shared[i]->type, const_cast<char*>(shared[i]->data.data()), shared[i]->shape));
+            mSharedWeights.push_back(std::move(shared[i]));
+        }
+        else
+        {
+            mWeights.emplace(tensors[i], results[i]);
+        }
+    }
+    return nbFailed;
+}
+
+bool PreparedWeights::findWeights(::ONNX_NAMESPACE::TensorProto const& tensor, ShapedWeights* weights) const
+{
+    auto it = mWeights.find(&tensor);
+    if (it == mWeights.end())
+    {
+        return false;
+    }
+    *weights = it->second;
+    return true;
+}
+
+} // namespace onnx2trt
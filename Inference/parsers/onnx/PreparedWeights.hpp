@@ -0,0 +1,78 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include "ImporterContext.hpp"
+#include "SharedWeights.hpp"
+
+#include <memory>
+#include <onnx/onnx_pb.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace onnx2trt
+{
+
+//! First phase of a two-phase import: converts every initializer and tensor-valued attribute of a graph, including
+//! those inside If/Loop/Scan bodies, to TensorRT weights on a pool of threads. None of this touches the network, so
+//! the second phase, parseGraph(), can stay serial and picks the results up through IWeightsCache. The network it
+//! builds is identical to a single-threaded import.
+//!
+//! External payloads are prefetched before the threads start. Tensors that SharedWeightsCache can key are taken
+//! from the process-wide cache when another model has already converted them, and otherwise converted into it, so
+//! that stage models sharing a weight file hold one copy of each shared tensor between them.
+class PreparedWeights final : public IWeightsCache
+{
+public:
+    //! Weights are converted relative to onnxFileLocation. External data is read through externalData, which must
+    //! outlive this object.
+    PreparedWeights(nvinfer1::ILogger* logger, nvinfer1::ILogger::Severity logSeverity,
+        std::string const& onnxFileLocation, ExternalDataReader* externalData);
+
+    //! Convert the weights of graph with up to nbThreads threads. Returns the number of tensors that failed to
+    //! convert (or whose external data could not be read); those are left out of the cache so that the importer
+    //! reports them in context.
+    int prepare(::ONNX_NAMESPACE::GraphProto const& graph, int nbThreads);
+
+    bool findWeights(::ONNX_NAMESPACE::TensorProto const& tensor, ShapedWeights* weights) const override;
+
+    size_t size() const
+    {
+        return mWeights.size();
+    }
+
+    //! Number of converted tensors that live in SharedWeightsCache, and how many of those another model had
+    //! already loaded.
+    size_t getNbSharedWeights() const
+    {
+        return mSharedWeights.size();
+    }
+    size_t getNbSharedHits() const
+    {
+        return mNbSharedHits;
+    }
+
+    //! Number of threads worth using for a graph, based on the hardware and the amount of work. Returns 1 if the
+    //! conversion should be done serially.
+    static int getNbThreads(::ONNX_NAMESPACE::GraphProto const& graph);
+
+private:
+    std::unique_ptr<ImporterContext> newWorkerContext(ExternalDataReader* externalData) const;
+
+    nvinfer1::ILogger* mLogger;
+    nvinfer1::ILogger::Severity mLogSeverity;
+    std::string mOnnxFileLocation;
+    ExternalDataReader* mExternalData;
+    // Network-less contexts, one per worker, that own the buffers of the weights their thread converted.
+    std::vector<std::unique_ptr<ImporterContext>> mWorkerContexts;
+    // Keyed by the address of the TensorProto, which must not move while this cache is in use.
+    std::unordered_map<::ONNX_NAMESPACE::TensorProto const*, ShapedWeights> mWeights;
+    // Keeps the shared entries that mWeights points into alive.
+    std::vector<std::shared_ptr<SharedWeightsCache::Entry const>> mSharedWeights;
+    size_t mNbSharedHits{0};
+};
+
+} // namespace onnx2trt
@@ -15,7 +15,7 @@ namespace onnx2trt
 //! and a shape tensor is expected.
 static const bool gTolerateTRT_12408 = true;
 
-ShapeTensor::ShapeTensor(int rank_, std::vector<int64_t>&& values_)
+ShapeTensor::ShapeTensor(int rank_, ShapeValues&& values_)
     : mDepth(0)
     , mAllValuesKnown(true)
     , mRank(rank_)
@@ -49,16 +49,18 @@ ShapeTensor::ShapeTensor(IImporterContext* ctx, TensorOrWeights& t)
         assert(d.nbDims <= 1 && "shape tensor must be 0D or 1D");
         mRank = d.nbDims;
         mSize = d.nbDims == 0 ? 1 : d.d[0];
-        auto status = weightsToVector(weights, &mValues);
+        std::vector<int64_t> values;
+        auto status = weightsToVector(weights, &values);
         if (status.code() != ErrorCode::kSUCCESS)
         {
             throw std::runtime_error("constant " + t.getName() + " is not a valid shape tensor");
         }
+        mValues = ShapeValues(values);
         mAllValuesKnown = true;
     }
 }
 
-static bool hasAllNonNegativeValues(const std::vector<int64_t>& values)
+static bool hasAllNonNegativeValues(const ShapeValues& values)
 {
     return std::all_of(values.begin(), values.end(), [](int x) { return x >= 0; });
 }
@@ -93,8 +95,7 @@ ShapeTensor::ShapeTensor(nvinfer1::ITensor& t, int depth)
         if (dims.nbDims >= 0)
         {
             mSize = dims.nbDims;
-            mValues.resize(dims.nbDims);
-            std::copy_n(dims.d, dims.nbDims, mValues.begin());
+            mValues = ShapeValues(dims.d, dims.d + dims.nbDims);
             mAllValuesKnown = hasAllNonNegativeValues(mValues);
         }
         break;
@@ -127,19 +128,19 @@ ShapeTensor::ShapeTensor(nvinfer1::ITensor& t, int depth)
 
 ShapeTensor shapeVector(int64_t value)
 {
-    return ShapeTensor(1, std::vector<int64_t>({value}));
+    return ShapeTensor(1, ShapeValues{value});
 }
 
 ShapeTensor shapeScalar(int64_t value)
 {
-    return ShapeTensor(0, std::vector<int64_t>({value}));
+    return ShapeTensor(0, ShapeValues{value});
 }
 
 bool ShapeTensor::valueKnown(int k) const
 {
     assert(0 <= k);
     assert(k < mSize);
-    return allValuesKnown() || (mValues.size() == static_cast<size_t>(mSize) && mValues[k] >= 0);
+    return allValuesKnown() || (mValues.size() == mSize && mValues[k] >= 0);
 }
 
 bool ShapeTensor::isAll(int64_t x) const
@@ -177,13 +178,17 @@ nvinfer1::ITensor& ShapeTensor::tensor(IImporterContext* ctx) const
 
 ShapeTensor iotaShapeVector(int32_t n)
 {
-    std::vector<int64_t> values(n);
-    std::iota(values.begin(), values.end(), 0);
+    ShapeValues values(n, 0);
+    std::iota(values.data(), values.data() + n, 0);
     return ShapeTensor(1, std::move(values));
 }
 
 ShapeTensor similar(IImporterContext* ctx, const ShapeTensor& exemplar, int64_t value)
 {
+    if (exemplar.rankKnown() && exemplar.rank() == 1 && exemplar.sizeKnown())
+    {
+        return ShapeTensor(1, ShapeValues(exemplar.size(), value));
+    }
     return fillShapeVector(ctx, value, shapeOf(exemplar));
 }
 
@@ -193,7 +198,7 @@ ShapeTensor fillShapeVector(IImporterContext* ctx, int64_t value, const ShapeTen
     assert(count.size() == 1 && "implementation assumes 1D size of known size");
     if (count.allValuesKnown())
     {
-        return ShapeTensor(1, std::vector<int64_t>(count[0], value));
+        return ShapeTensor(1, ShapeValues(count[0], value));
     }
     else
     {
@@ -209,8 +214,10 @@ using nvinfer1::ElementWiseOperation;
 //! f must implement the operation on a pair of int64_t.
 //! commutes should be true f is commutative.
 //! rightIdentity should be the right identity value for f.
+//! If all values of x and y are known, the result is computed without adding layers.
+template <typename Function>
 static ShapeTensor op(IImporterContext* ctx, const ShapeTensor& x, const ShapeTensor& y, ElementWiseOperation operation,
-    bool commutative, int64_t rightIdentity, const std::function<int64_t(int64_t, int64_t)>&& f)
+    bool commutative, int64_t rightIdentity, Function f)
 {
     assert(!x.rankKnown() || !y.rankKnown() || x.rank() == y.rank());
     if (x.sizeKnown() && y.sizeKnown())
@@ -227,8 +234,8 @@ static ShapeTensor op(IImporterContext* ctx, const ShapeTensor& x, const ShapeTe
     }
     if (x.allValuesKnown() && y.allValuesKnown())
     {
-        std::vector<int64_t> values(std::max(x.size(), y.size()));
-        for (size_t i = 0; i < values.size(); ++i)
+        ShapeValues values(std::max(x.size(), y.size()), 0);
+        for (int32_t i = 0; i < values.size(); ++i)
         {
             // The % simulates broadcast rules.
             values[i] = f(x[i % x.size()], y[i % y.size()]);
@@ -275,6 +282,13 @@ ShapeTensor floorDiv(IImporterContext* ctx, const ShapeTensor& x, const ShapeTen
 
 ShapeTensor broadcast(IImporterContext* ctx, const ShapeTensor& x, const ShapeTensor& y)
 {
+    if (x.allValuesKnown() && y.allValuesKnown())
+    {
+        // Evaluated on the host, so the operation passed to op is never used.
+        return op(ctx, x, y, ElementWiseOperation::kMAX, true, 1, [](int64_t x, int64_t y) {
+            return std::max(x, y) * std::min({x, y, int64_t{1}});
+        });
+    }
     // max(x,y) works unless x or y is 0.
     // min(x,y,1) yields 0 if x or y is 0, and 1 otherwise.
     // So compute max(x,y)*min(x,y,1).
@@ -284,10 +298,20 @@ ShapeTensor broadcast(IImporterContext* ctx, const ShapeTensor& x, const ShapeTe
 ShapeTensor product(IImporterContext* ctx, const ShapeTensor& x, int first, int last, int rank)
 {
     assert(first <= last);
-    ShapeTensor z(rank, std::vector<int64_t>(1, 1));
+    if (x.allValuesKnown())
+    {
+        assert(last <= x.size());
+        int64_t p = 1;
+        for (int i = first; i < last; ++i)
+        {
+            p *= x[i];
+        }
+        return ShapeTensor(rank, ShapeValues{p});
+    }
+    ShapeTensor z(rank, ShapeValues{1});
     for (int i = first; i < last; ++i)
     {
-        z = mul(ctx, z, gather(ctx, x, ShapeTensor(rank, std::vector<int64_t>(1, i))));
+        z = mul(ctx, z, gather(ctx, x, ShapeTensor(rank, ShapeValues{i})));
     }
     return z;
 }
@@ -306,8 +330,8 @@ ShapeTensor concat(IImporterContext* ctx, const ShapeTensor& x, const ShapeTenso
     }
     if (x.allValuesKnown() && y.allValuesKnown())
     {
-        std::vector<int64_t> values(x.size() + y.size());
-        auto p = std::copy(x.begin(), x.end(), values.begin());
+        ShapeValues values(x.size() + y.size(), 0);
+        auto p = std::copy(x.begin(), x.end(), values.data());
         std::copy(y.begin(), y.end(), p);
         return ShapeTensor(1, std::move(values));
     }
@@ -322,8 +346,8 @@ ShapeTensor gather(IImporterContext* ctx, const ShapeTensor& data, const ShapeTe
     if (indices.allValuesKnown()
         && std::all_of(indices.begin(), indices.end(), [&data](int i) { return data.valueKnown(i); }))
     {
-        std::vector<int64_t> z(indices.size());
-        std::transform(indices.begin(), indices.end(), z.begin(), [&data](int64_t i) {
+        ShapeValues z(indices.size(), 0);
+        std::transform(indices.begin(), indices.end(), z.data(), [&data](int64_t i) {
             assert(0 <= i);
             assert(i < data.size());
             return data[i];
@@ -333,6 +357,23 @@ ShapeTensor gather(IImporterContext* ctx, const ShapeTensor& data, const ShapeTe
     return ShapeTensor(*ctx->network()->addGather(data.tensor(ctx), indices.tensor(ctx), 0)->getOutput(0));
 }
 
+ShapeTensor interlace(IImporterContext* ctx, const ShapeTensor& x, const ShapeTensor& y, const ShapeTensor& subscripts)
+{
+    assert(x.rank() == 1 && y.rank() == 1);
+    if (subscripts.allValuesKnown() && x.allValuesKnown() && y.allValuesKnown())
+    {
+        // Pick from x and y directly instead of materializing their concatenation.
+        ShapeValues z(subscripts.size(), 0);
+        std::transform(subscripts.begin(), subscripts.end(), z.data(), [&x, &y](int64_t i) {
+            assert(0 <= i);
+            assert(i < x.size() + y.size());
+            return i < x.size() ? x[i] : y[i - x.size()];
+        });
+        return ShapeTensor(subscripts.rank(), std::move(z));
+    }
+    return gather(ctx, concat(ctx, x, y), subscripts);
+}
+
 ShapeTensor shapeOf(nvinfer1::ITensor& tensor)
 {
     return ShapeTensor(tensor, 1);
@@ -345,7 +386,7 @@ ShapeTensor shapeOf(TensorOrWeights& t)
         return shapeOf(t.tensor());
     }
     const nvinfer1::Dims& d = t.weights().shape;
-    return ShapeTensor(1, std::vector<int64_t>(d.d, d.d + d.nbDims));
+    return ShapeTensor(1, ShapeValues(d.d, d.d + d.nbDims));
 }
 
 ShapeTensor shapeOf(const ShapeTensor& t)
@@ -360,7 +401,7 @@ ShapeTensor shapeOf(const ShapeTensor& t)
     // ShapeTensor is either a scalar or vector.
     // shape of a scalar is an empty tensor.
     // shape of a vector is a one-element tensor containing the length of the vector.
-    return t.rank() == 0 ? ShapeTensor(0, {}) : ShapeTensor(1, {t.size()});
+    return t.rank() == 0 ? ShapeTensor(1, ShapeValues{}) : ShapeTensor(1, ShapeValues{t.size()});
 }
 
 ShapeTensor convertTo1D(IImporterContext* ctx, const ShapeTensor& tensor)
@@ -369,7 +410,7 @@ ShapeTensor convertTo1D(IImporterContext* ctx, const ShapeTensor& tensor)
     assert(tensor.size() == 1);
     if (tensor.valueKnown(0))
     {
-        return shapeScalar(tensor[0]);
+        return shapeVector(tensor[0]);
     }
     return ShapeTensor(*addShuffle(ctx, tensor.tensor(ctx), shapeVector(1))->getOutput(0));
 }
@@ -5,7 +5,10 @@
 #pragma once
 
 #include <NvInfer.h>
+#include <algorithm>
 #include <cassert>
+#include <cstdint>
+#include <initializer_list>
 #include <iosfwd>
 #include <vector>
 
@@ -15,6 +18,151 @@ namespace onnx2trt
 class IImporterContext;
 class TensorOrWeights;
 
+//! Sequence of int64_t that stores up to kINLINE_CAPACITY values inline, so that
+//! the values of a shape tensor describing the dimensions of a tensor never
+//! need a heap allocation.  Longer sequences fall back to a std::vector.
+class ShapeValues
+{
+public:
+    static constexpr int32_t kINLINE_CAPACITY = nvinfer1::Dims::MAX_DIMS;
+
+    using const_iterator = const int64_t*;
+
+    ShapeValues() = default;
+
+    //! Create sequence of n copies of value.
+    ShapeValues(int32_t n, int64_t value)
+    {
+        resize(n);
+        std::fill_n(data(), n, value);
+    }
+
+    ShapeValues(const int64_t* first, const int64_t* last)
+    {
+        assign(first, last);
+    }
+
+    ShapeValues(const int32_t* first, const int32_t* last)
+    {
+        assign(first, last);
+    }
+
+    ShapeValues(std::initializer_list<int64_t> values)
+    {
+        assign(values.begin(), values.end());
+    }
+
+    explicit ShapeValues(const std::vector<int64_t>& values)
+    {
+        assign(values.data(), values.data() + values.size());
+    }
+
+    ShapeValues(const ShapeValues& other) = default;
+    ShapeValues& operator=(const ShapeValues& other) = default;
+
+    ShapeValues(ShapeValues&& other) noexcept
+        : mSize(other.mSize)
+        , mHeap(std::move(other.mHeap))
+    {
+        std::copy_n(other.mInline, kINLINE_CAPACITY, mInline);
+        other.mSize = 0;
+    }
+
+    ShapeValues& operator=(ShapeValues&& other) noexcept
+    {
+        mSize = other.mSize;
+        std::copy_n(other.mInline, kINLINE_CAPACITY, mInline);
+        mHeap = std::move(other.mHeap);
+        other.mSize = 0;
+        return *this;
+    }
+
+    int32_t size() const
+    {
+        return mSize;
+    }
+
+    bool empty() const
+    {
+        return mSize == 0;
+    }
+
+    const int64_t* data() const
+    {
+        return isInline() ? mInline : mHeap.data();
+    }
+
+    int64_t* data()
+    {
+        return isInline() ? mInline : mHeap.data();
+    }
+
+    const_iterator begin() const
+    {
+        return data();
+    }
+
+    const_iterator end() const
+    {
+        return data() + mSize;
+    }
+
+    int64_t operator[](int32_t k) const
+    {
+        return data()[k];
+    }
+
+    int64_t& operator[](int32_t k)
+    {
+        return data()[k];
+    }
+
+    //! Change the number of values.  New values are indeterminate.
+    void resize(int32_t n)
+    {
+        assert(n >= 0);
+        if (n <= kINLINE_CAPACITY)
+        {
+            if (!isInline())
+            {
+                std::copy_n(mHeap.data(), n, mInline);
+                mHeap.clear();
+            }
+        }
+        else
+        {
+            if (isInline())
+            {
+                mHeap.assign(mInline, mInline + mSize);
+            }
+            mHeap.resize(n);
+        }
+        mSize = n;
+    }
+
+    friend bool operator==(const ShapeValues& x, const ShapeValues& y)
+    {
+        return x.size() == y.size() && std::equal(x.begin(), x.end(), y.begin());
+    }
+
+private:
+    bool isInline() const
+    {
+        return mSize <= kINLINE_CAPACITY;
+    }
+
+    template <typename T>
+    void assign(const T* first, const T* last)
+    {
+        resize(static_cast<int32_t>(last - first));
+        std::copy(first, last, data());
+    }
+
+    int32_t mSize{0};
+    int64_t mInline[kINLINE_CAPACITY]{};
+    std::vector<int64_t> mHeap;
+};
+
 //! Represents a 0D or 1D tensor of int64_t.
 class ShapeTensor
 {
@@ -23,7 +171,13 @@ public:
     ShapeTensor() = default;
 
     //! Create ShapeTensor with known rank and values.
-    ShapeTensor(int rank_, std::vector<int64_t>&& values_);
+    ShapeTensor(int rank_, ShapeValues&& values_);
+
+    //! Create ShapeTensor with known rank and values.
+    ShapeTensor(int rank_, std::vector<int64_t>&& values_)
+        : ShapeTensor(rank_, ShapeValues(values_))
+    {
+    }
 
     //! Create ShapeTensor representing value of TensorOrWeights.
     ShapeTensor(IImporterContext* ctx, TensorOrWeights& t);
@@ -67,7 +221,7 @@ public:
     //! True if all element values equal the given value.
     bool isAll(int64_t value) const;
 
-    using const_iterator = std::vector<int64_t>::const_iterator;
+    using const_iterator = ShapeValues::const_iterator;
 
     //! Iterator pointing to beginning of sequence of element values.
     //! Requires that allValuesKnown() is true.
@@ -134,7 +288,7 @@ private:
     //! and mValues.size() == mSize.
     //! When mAllValuesKnown==false, only the non-negative values in mValues
     //! are guaranteed to be correct, and only so if mValues.size() == mSize.
-    std::vector<int64_t> mValues;
+    ShapeValues mValues;
 };
 
 //! Print ShapeTensor.  Unknown values are printed as _.
@@ -192,11 +346,7 @@ ShapeTensor gather(IImporterContext* ctx, const ShapeTensor& data, const ShapeTe
 ShapeTensor concat(IImporterContext* ctx, const ShapeTensor& x, const ShapeTensor& y);
 
 //! Return gather(concat(x,y),subscripts)
-inline ShapeTensor interlace(
-    IImporterContext* ctx, const ShapeTensor& x, const ShapeTensor& y, const ShapeTensor& subscripts)
-{
-    return gather(ctx, concat(ctx, x, y), subscripts);
-}
+ShapeTensor interlace(IImporterContext* ctx, const ShapeTensor& x, const ShapeTensor& y, const ShapeTensor& subscripts);
 
 //! Return shape of a tensor.
 ShapeTensor shapeOf(nvinfer1::ITensor& tensor);
@@ -0,0 +1,123 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "SharedWeights.hpp"
+
+#include <algorithm>
+#include <iterator>
+
+namespace onnx2trt
+{
+
+SharedWeightsCache& SharedWeightsCache::global()
+{
+    static SharedWeightsCache cache;
+    return cache;
+}
+
+bool SharedWeightsCache::getKey(::ONNX_NAMESPACE::TensorProto const& tensor, std::string* key)
+{
+    if (tensor.data_location() != ::ONNX_NAMESPACE::TensorProto::EXTERNAL)
+    {
+        return false;
+    }
+    std::string checksum;
+    std::string offset{"0"};
+    std::string length{"0"};
+    for (auto const& entry : tensor.external_data())
+    {
+        if (entry.key() == "checksum")
+        {
+            checksum = entry.value();
+        }
+        else if (entry.key() == "offset")
+        {
+            offset = entry.value();
+        }
+        else if (entry.key() == "length")
+        {
+            length = entry.value();
+        }
+    }
+    // The checksum may be a digest of the tensor or of the whole file; with the range it identifies the bytes either
+    // way. The location is left out so that stages in different directories still share.
+    if (checksum.empty())
+    {
+        return false;
+    }
+    *key = checksum + "@" + offset + "+" + length + ":" + std::to_string(tensor.data_type());
+    for (int64_t d : tensor.dims())
+    {
+        *key += "," + std::to_string(d);
+    }
+    return true;
+}
+
+std::shared_ptr<SharedWeightsCache::Entry const> SharedWeightsCache::find(std::string const& key)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto it = mEntries.find(key);
+    if (it == mEntries.end())
+    {
+        return nullptr;
+    }
+    std::shared_ptr<Entry const> entry = it->second.lock();
+    if (entry)
+    {
+        ++mNbHits;
+    }
+    return entry;
+}
+
+std::shared_ptr<SharedWeightsCache::Entry const> SharedWeightsCache::insert(
+    std::string const& key, ShapedWeights::DataType type, nvinfer1::Dims shape, void const* data, size_t size)
+{
+    std::shared_ptr<Entry> entry{new Entry{type, shape, std::vector<char>(size)}};
+    std::copy_n(static_cast<char const*>(data), size, entry->data.begin());
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    std::weak_ptr<Entry const>& slot = mEntries[key];
+    std::shared_ptr<Entry const> existing = slot.lock();
+    if (existing)
+    {
+        return existing;
+    }
+    slot = entry;
+    // Sweeping once the map could have doubled keeps the cost per insert constant.
+    if (++mNbInsertsSinceSweep > mEntries.size() / 2)
+    {
+        sweep();
+    }
+    return entry;
+}
+
+void SharedWeightsCache::sweep()
+{
+    for (auto it = mEntries.begin(); it != mEntries.end();)
+    {
+        it = it->second.expired() ? mEntries.erase(it) : std::next(it);
+    }
+    mNbInsertsSinceSweep = 0;
+}
+
+size_t SharedWeightsCache::size() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return std::count_if(mEntries.begin(), mEntries.end(),
+        [](std::pair<std::string const, std::weak_ptr<Entry const>> const& e) { return !e.second.expired(); });
+}
+
+size_t SharedWeightsCache::getNbBytes() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    size_t bytes = 0;
+    for (auto const& e : mEntries)
+    {
+        std::shared_ptr<Entry const> entry = e.second.lock();
+        bytes += entry ? entry->data.size() : 0;
+    }
+    return bytes;
+}
+
+} // namespace onnx2trt
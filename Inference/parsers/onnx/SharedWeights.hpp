@@ -0,0 +1,72 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include "ShapedWeights.hpp"
+
+#include <onnx/onnx_pb.h>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace onnx2trt
+{
+
+//! Converted weights of externally stored tensors, shared by every model of the process that references the same
+//! bytes. Stage models cut from one network and written against a common weight file (see
+//! ModelSplit/share_weights.py) name each shared tensor by the checksum, offset and length of its payload, so the
+//! second stage to load a tensor finds it here without reading or converting it again.
+//!
+//! The cache only holds weak references: an entry lives as long as some PreparedWeights uses it, so weights of
+//! stages that have been built and released do not pin host memory.
+class SharedWeightsCache
+{
+public:
+    struct Entry
+    {
+        ShapedWeights::DataType type;
+        nvinfer1::Dims shape;
+        std::vector<char> data;
+    };
+
+    //! Shared by all parsers in the process.
+    static SharedWeightsCache& global();
+
+    //! Key identifying the converted contents of tensor, which must be stored externally with a checksum. Returns
+    //! false for any other tensor.
+    static bool getKey(::ONNX_NAMESPACE::TensorProto const& tensor, std::string* key);
+
+    //! Returns nullptr if no live entry has this key.
+    std::shared_ptr<Entry const> find(std::string const& key);
+
+    //! Copy size bytes of converted weights into a new entry and return it. If another thread inserted the key
+    //! first, its entry is returned instead.
+    std::shared_ptr<Entry const> insert(std::string const& key, ShapedWeights::DataType type, nvinfer1::Dims shape,
+        void const* data, size_t size);
+
+    //! Number of live entries, and the bytes they hold.
+    size_t size() const;
+    size_t getNbBytes() const;
+
+    size_t getNbHits() const
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mNbHits;
+    }
+
+private:
+    //! Drop the keys of entries that have been released. Called under mMutex.
+    void sweep();
+
+    mutable std::mutex mMutex;
+    std::unordered_map<std::string, std::weak_ptr<Entry const>> mEntries;
+    size_t mNbInsertsSinceSweep{0};
+    size_t mNbHits{0};
+};
+
+} // namespace onnx2trt
@@ -0,0 +1,339 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "SupportCache.hpp"
+
+#include <NvInferVersion.h>
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+namespace onnx2trt
+{
+
+namespace
+{
+
+using ::ONNX_NAMESPACE::AttributeProto;
+using ::ONNX_NAMESPACE::NodeProto;
+using ::ONNX_NAMESPACE::TensorProto;
+using ::ONNX_NAMESPACE::TypeProto;
+
+// Identifies the file format and the parser that wrote the verdicts, which are only valid for that parser.
+std::string cacheFileHeader()
+{
+    std::ostringstream header;
+    header << "onnx2trt-support-cache 2 " << NV_ONNX_PARSER_VERSION << " " << NV_TENSORRT_VERSION;
+    return header.str();
+}
+
+// 64-bit FNV-1a, which unlike std::hash is the same in every build and so can be stored in a file.
+uint64_t hashBytes(std::string const& bytes)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (unsigned char c : bytes)
+    {
+        hash = (hash ^ c) * 1099511628211ULL;
+    }
+    // 0 marks nodes without a fingerprint.
+    return hash ? hash : 1;
+}
+
+// Appends a length-prefixed field, so that no two signatures concatenate to the same key.
+void appendField(std::string* key, std::string const& field)
+{
+    uint64_t const size = field.size();
+    key->append(reinterpret_cast<char const*>(&size), sizeof(size));
+    key->append(field);
+}
+
+void appendFingerprint(std::string* key, uint64_t fingerprint)
+{
+    appendField(key, std::string(reinterpret_cast<char const*>(&fingerprint), sizeof(fingerprint)));
+}
+
+// The tensor without its name, or only its type and shape if it is too large to key by contents.
+std::string tensorSignature(TensorProto const& tensor)
+{
+    if (tensor.ByteSizeLong() <= SupportCache::kMaxKeyedDataBytes)
+    {
+        TensorProto unnamed = tensor;
+        unnamed.clear_name();
+        return "d" + unnamed.SerializeAsString();
+    }
+    TensorProto header;
+    header.set_data_type(tensor.data_type());
+    *header.mutable_dims() = tensor.dims();
+    return "s" + header.SerializeAsString();
+}
+
+bool hasGraphAttribute(NodeProto const& node)
+{
+    for (auto const& attr : node.attribute())
+    {
+        if (attr.type() == AttributeProto::GRAPH || attr.type() == AttributeProto::GRAPHS)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+std::vector<uint64_t> SupportCache::fingerprintNodes(
+    ::ONNX_NAMESPACE::ModelProto const& model, std::vector<size_t> const& topoOrder)
+{
+    auto const& graph = model.graph();
+    std::vector<uint64_t> fingerprints(graph.node_size(), 0);
+
+    std::unordered_map<std::string, int64_t> opsetImports;
+    for (auto const& opsetImport : model.opset_import())
+    {
+        opsetImports[opsetImport.domain()] = opsetImport.version();
+    }
+    std::unordered_map<std::string, TensorProto const*> initializers;
+    for (auto const& initializer : graph.initializer())
+    {
+        initializers[initializer.name()] = &initializer;
+    }
+
+    // The op and input slot of every node reading each value, sorted. Importers look at how a value is consumed,
+    // e.g. the parser rejects nodes that read a value which a consumer turns into a shape tensor of the wrong type,
+    // so graph inputs and node outputs are keyed by their consumers as well.
+    std::unordered_map<std::string, std::vector<std::string>> consumers;
+    for (auto const& node : graph.node())
+    {
+        for (int i = 0; i < node.input_size(); ++i)
+        {
+            if (!node.input(i).empty())
+            {
+                consumers[node.input(i)].push_back(node.domain() + "." + node.op_type() + ":" + std::to_string(i));
+            }
+        }
+    }
+    for (auto& valueConsumers : consumers)
+    {
+        std::sort(valueConsumers.second.begin(), valueConsumers.second.end());
+    }
+    static std::vector<std::string> const kNoConsumers;
+    auto const getConsumers = [&consumers](std::string const& value) -> std::vector<std::string> const& {
+        auto const found = consumers.find(value);
+        return found != consumers.end() ? found->second : kNoConsumers;
+    };
+
+    std::unordered_map<std::string, std::string> inputSignatures;
+    for (auto const& input : graph.input())
+    {
+        if (initializers.count(input.name()))
+        {
+            continue;
+        }
+        std::string signature = "i";
+        appendField(&signature, input.type().SerializeAsString());
+        for (auto const& consumer : getConsumers(input.name()))
+        {
+            appendField(&signature, consumer);
+        }
+        inputSignatures[input.name()] = std::move(signature);
+    }
+    std::unordered_map<std::string, TypeProto const*> outputTypes;
+    for (auto const& output : graph.output())
+    {
+        outputTypes[output.name()] = &output.type();
+    }
+
+    // Fingerprints of the values produced by the nodes visited so far; 0 if the producer has none.
+    std::unordered_map<std::string, uint64_t> valueFingerprints;
+    for (size_t const nodeIndex : topoOrder)
+    {
+        NodeProto const& node = graph.node(nodeIndex);
+        uint64_t fingerprint = 0;
+        if (!hasGraphAttribute(node))
+        {
+            std::string key;
+            appendField(&key, std::to_string(model.ir_version()));
+            appendField(&key, node.domain());
+            appendField(&key, node.op_type());
+            auto const opset = opsetImports.find(node.domain());
+            appendField(&key, opset != opsetImports.end() ? std::to_string(opset->second) : "-");
+            for (auto const& attr : node.attribute())
+            {
+                if (attr.type() == AttributeProto::TENSOR)
+                {
+                    appendField(&key, attr.name());
+                    appendField(&key, tensorSignature(attr.t()));
+                }
+                else
+                {
+                    appendField(&key, attr.SerializeAsString());
+                }
+            }
+            bool keyed = true;
+            for (auto const& input : node.input())
+            {
+                if (input.empty())
+                {
+                    appendField(&key, "-");
+                    continue;
+                }
+                auto const produced = valueFingerprints.find(input);
+                if (produced != valueFingerprints.end())
+                {
+                    keyed = keyed && produced->second != 0;
+                    appendFingerprint(&key, produced->second);
+                    continue;
+                }
+                auto const initializer = initializers.find(input);
+                if (initializer != initializers.end())
+                {
+                    appendField(&key, tensorSignature(*initializer->second));
+                    continue;
+                }
+                auto const graphInput = inputSignatures.find(input);
+                appendField(&key, graphInput != inputSignatures.end() ? graphInput->second : "?");
+            }
+            // Marking graph outputs can fail too, which the parser blames on the producer.
+            appendField(&key, std::to_string(node.output_size()));
+            for (auto const& output : node.output())
+            {
+                auto const type = outputTypes.find(output);
+                appendField(&key, type != outputTypes.end() ? "o" + type->second->SerializeAsString() : "-");
+                auto const& outputConsumers = getConsumers(output);
+                appendField(&key, std::to_string(outputConsumers.size()));
+                for (auto const& consumer : outputConsumers)
+                {
+                    appendField(&key, consumer);
+                }
+            }
+            fingerprint = keyed ? hashBytes(key) : 0;
+        }
+        fingerprints[nodeIndex] = fingerprint;
+        for (int i = 0; i < node.output_size(); ++i)
+        {
+            if (!node.output(i).empty())
+            {
+                std::string key;
+                appendFingerprint(&key, fingerprint);
+                appendField(&key, std::to_string(i));
+                valueFingerprints[node.output(i)] = fingerprint ? hashBytes(key) : 0;
+            }
+        }
+    }
+    return fingerprints;
+}
+
+bool SupportCache::lookup(std::vector<uint64_t> const& fingerprints, std::vector<bool>* supported)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    std::vector<bool> verdicts(fingerprints.size());
+    bool found = !fingerprints.empty();
+    for (size_t i = 0; found && i < fingerprints.size(); ++i)
+    {
+        auto const it = mVerdicts.find(fingerprints[i]);
+        found = it != mVerdicts.end() && it->second != Verdict::kCONFLICTING;
+        verdicts[i] = found && it->second == Verdict::kSUPPORTED;
+    }
+    if (!found)
+    {
+        ++mMisses;
+        return false;
+    }
+    ++mHits;
+    *supported = std::move(verdicts);
+    return true;
+}
+
+void SupportCache::insert(uint64_t fingerprint, bool supported)
+{
+    if (!fingerprint)
+    {
+        return;
+    }
+    Verdict const verdict = supported ? Verdict::kSUPPORTED : Verdict::kUNSUPPORTED;
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto const inserted = mVerdicts.emplace(fingerprint, verdict);
+    if (!inserted.second && inserted.first->second != verdict)
+    {
+        inserted.first->second = Verdict::kCONFLICTING;
+    }
+}
+
+size_t SupportCache::getHits() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mHits;
+}
+
+size_t SupportCache::getMisses() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mMisses;
+}
+
+int SupportCache::getNbEntries() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return static_cast<int>(mVerdicts.size());
+}
+
+// One line per fingerprint, "<hex fingerprint> <verdict>", after a header line.
+bool SupportCache::load(const char* path)
+{
+    std::ifstream file(path);
+    std::string header;
+    if (!file || !std::getline(file, header) || header != cacheFileHeader())
+    {
+        return false;
+    }
+    std::vector<std::pair<uint64_t, Verdict>> entries;
+    uint64_t fingerprint;
+    int verdict;
+    while (file >> std::hex >> fingerprint >> std::dec >> verdict)
+    {
+        if (!fingerprint || verdict < 0 || verdict > static_cast<int>(Verdict::kCONFLICTING))
+        {
+            return false;
+        }
+        entries.emplace_back(fingerprint, static_cast<Verdict>(verdict));
+    }
+    if (!file.eof())
+    {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (auto const& entry : entries)
+    {
+        auto const inserted = mVerdicts.insert(entry);
+        if (!inserted.second && inserted.first->second != entry.second)
+        {
+            inserted.first->second = Verdict::kCONFLICTING;
+        }
+    }
+    return true;
+}
+
+bool SupportCache::save(const char* path) const
+{
+    std::ofstream file(path);
+    if (!file)
+    {
+        return false;
+    }
+    file << cacheFileHeader() << "\n";
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        for (auto const& entry : mVerdicts)
+        {
+            file << std::hex << entry.first << std::dec << " " << static_cast<int>(entry.second) << "\n";
+        }
+    }
+    file.close();
+    return !file.fail();
+}
+
+} // namespace onnx2trt
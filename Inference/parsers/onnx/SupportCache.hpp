@@ -0,0 +1,79 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include "NvOnnxParser.h"
+
+#include <onnx/onnx_pb.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace onnx2trt
+{
+
+//! The verdicts of ModelImporter::supportsModel() for single nodes, keyed by a fingerprint of the subgraph that ends
+//! at the node: the node's domain, op, opset and attributes, the fingerprints of the nodes producing its inputs, the
+//! types and shapes of the initializers and graph inputs it reads, and the op and input slot of every node reading
+//! its outputs. Names are left out, so a node has the same fingerprint in every model that computes its inputs and
+//! consumes its outputs the same way, and a change to one node only changes the fingerprints of the nodes downstream
+//! of it or of its producers.
+//!
+//! The contents of an initializer or tensor attribute are part of the fingerprint when they are small (up to
+//! kMaxKeyedDataBytes), since importers read shape-like inputs. Nodes with graph attributes (If, Loop, Scan) are never
+//! fingerprinted, since their bodies can read any value of the enclosing graph.
+//!
+//! Whether a node is supported can depend on how its outputs are consumed, e.g. when a consumer turns an output into
+//! a shape tensor, hence the consumers in the fingerprint. Should a node still be recorded with different verdicts
+//! by different models, the cache marks its fingerprint as conflicting, which sends every later model with that node
+//! through a full analysis.
+class SupportCache final : public nvonnxparser::ISupportCache
+{
+public:
+    static constexpr size_t kMaxKeyedDataBytes = 1024;
+
+    //! Fingerprint of every node of the main graph of model, indexed like graph().node(), or 0 for nodes that
+    //! cannot be fingerprinted. topoOrder is the order from toposort().
+    static std::vector<uint64_t> fingerprintNodes(
+        ::ONNX_NAMESPACE::ModelProto const& model, std::vector<size_t> const& topoOrder);
+
+    //! Returns true and the verdict of every node if all of fingerprints have one that did not conflict.
+    bool lookup(std::vector<uint64_t> const& fingerprints, std::vector<bool>* supported);
+
+    //! Records the verdict of a full analysis for a node.
+    void insert(uint64_t fingerprint, bool supported);
+
+    //! Calls of lookup() that found every node.
+    size_t getHits() const;
+
+    //! Calls of lookup() that needed a full analysis.
+    size_t getMisses() const;
+
+    bool load(const char* path) override;
+    bool save(const char* path) const override;
+    int getNbEntries() const override;
+    void destroy() override
+    {
+        delete this;
+    }
+
+private:
+    enum class Verdict : uint8_t
+    {
+        kSUPPORTED = 0,
+        kUNSUPPORTED = 1,
+        kCONFLICTING = 2
+    };
+
+    mutable std::mutex mMutex;
+    std::unordered_map<uint64_t, Verdict> mVerdicts;
+    size_t mHits{0};
+    size_t mMisses{0};
+};
+
+} // namespace onnx2trt
@@ -0,0 +1,162 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include "TensorOrWeights.hpp"
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace onnx2trt
+{
+
+//! Interns names to dense integer IDs. IDs are handed out in insertion order starting at 0 and are never reused,
+//! so they can be used directly as indices into side tables.
+class NameTable
+{
+public:
+    static constexpr int32_t kINVALID_ID = -1;
+
+    //! Return the ID of name, assigning a new one if the name has not been seen before.
+    int32_t intern(const std::string& name)
+    {
+        auto it = mIds.find(name);
+        if (it != mIds.end())
+        {
+            return it->second;
+        }
+        const int32_t id = static_cast<int32_t>(mNames.size());
+        it = mIds.emplace(name, id).first;
+        mNames.push_back(&it->first);
+        return id;
+    }
+
+    //! Return the ID of name, or kINVALID_ID if it has not been interned.
+    int32_t find(const std::string& name) const
+    {
+        auto it = mIds.find(name);
+        return it == mIds.end() ? kINVALID_ID : it->second;
+    }
+
+    size_t count(const std::string& name) const
+    {
+        return mIds.count(name);
+    }
+
+    const std::string& name(int32_t id) const
+    {
+        return *mNames.at(id);
+    }
+
+    size_t size() const
+    {
+        return mNames.size();
+    }
+
+    void clear()
+    {
+        mIds.clear();
+        mNames.clear();
+    }
+
+private:
+    std::unordered_map<std::string, int32_t> mIds;
+    // Node-based map keys never move, so the reverse lookup can point into mIds.
+    std::vector<const std::string*> mNames;
+};
+
+//! Maps ONNX tensor names to TensorOrWeights. Each name is hashed once when it is interned; afterwards values
+//! are stored in a vector indexed by the name's ID.
+class TensorMap
+{
+public:
+    //! Return the ID for name, interning it if necessary. The ID stays valid for the lifetime of the map.
+    int32_t id(const std::string& name)
+    {
+        return mNames.intern(name);
+    }
+
+    //! Single-lookup alternative to count() + at(). Returns nullptr if no value is registered for name.
+    TensorOrWeights* find(const std::string& name)
+    {
+        return lookup(mNames.find(name));
+    }
+    const TensorOrWeights* find(const std::string& name) const
+    {
+        const int32_t id = mNames.find(name);
+        return isSet(id) ? &mValues[id] : nullptr;
+    }
+
+    TensorOrWeights* lookup(int32_t id)
+    {
+        return isSet(id) ? &mValues[id] : nullptr;
+    }
+
+    size_t count(const std::string& name) const
+    {
+        return isSet(mNames.find(name)) ? 1 : 0;
+    }
+
+    TensorOrWeights& at(const std::string& name)
+    {
+        TensorOrWeights* value = find(name);
+        if (!value)
+        {
+            throw std::out_of_range("TensorMap::at: no tensor registered for " + name);
+        }
+        return *value;
+    }
+    const TensorOrWeights& at(const std::string& name) const
+    {
+        const TensorOrWeights* value = find(name);
+        if (!value)
+        {
+            throw std::out_of_range("TensorMap::at: no tensor registered for " + name);
+        }
+        return *value;
+    }
+
+    TensorOrWeights& operator[](const std::string& name)
+    {
+        return (*this)[id(name)];
+    }
+    TensorOrWeights& operator[](int32_t id)
+    {
+        if (static_cast<size_t>(id) >= mValues.size())
+        {
+            mValues.resize(mNames.size());
+            mSet.resize(mNames.size(), false);
+        }
+        mSet[id] = true;
+        return mValues[id];
+    }
+
+    const std::string& name(int32_t id) const
+    {
+        return mNames.name(id);
+    }
+
+    void clear()
+    {
+        mNames.clear();
+        mValues.clear();
+        mSet.clear();
+    }
+
+private:
+    bool isSet(int32_t id) const
+    {
+        return id != NameTable::kINVALID_ID && static_cast<size_t>(id) < mSet.size() && mSet[id];
+    }
+
+    NameTable mNames;
+    std::vector<TensorOrWeights> mValues;
+    std::vector<bool> mSet;
+};
+
+} // namespace onnx2trt
@@ -450,7 +450,7 @@ DEFINE_BUILTIN_OP_IMPORTER(Constant)
     OnnxAttrs attrs(node, ctx);
     // Having the trt_outputs_range_min attributes means it's from
     // serialized iNetworkDefinition.
-    if (!attrs.get<std::vector<float>>("trt_outputs_range_min", {}).empty())
+    if (attrs.count("trt_outputs_range_min") && !attrs.floats("trt_outputs_range_min").empty())
     {
         // just create a constant layer here for 1-1 mapping during network deserialization
         auto weights = attrs.get<ShapedWeights>("value");
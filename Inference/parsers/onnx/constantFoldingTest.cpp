@@ -0,0 +1,217 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+// Checks FoldedConstants on a small exporter-style graph: shape arithmetic on initializers must be evaluated, nodes
+// depending on graph inputs or exceeding the size cap must be left alone, and a second stage with the same
+// subexpressions must be served from the cache.
+
+#include "ConstantFolding.hpp"
+#include "TestHarness.h"
+
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using std::cerr;
+using std::cout;
+using std::endl;
+
+namespace
+{
+
+using ::ONNX_NAMESPACE::AttributeProto;
+using ::ONNX_NAMESPACE::GraphProto;
+using ::ONNX_NAMESPACE::NodeProto;
+using ::ONNX_NAMESPACE::TensorProto;
+
+TensorProto makeInt64s(std::string const& name, std::vector<int64_t> const& values, bool scalar = false)
+{
+    TensorProto tensor;
+    tensor.set_name(name);
+    tensor.set_data_type(TensorProto::INT64);
+    if (!scalar)
+    {
+        tensor.add_dims(values.size());
+    }
+    for (int64_t v : values)
+    {
+        tensor.add_int64_data(v);
+    }
+    return tensor;
+}
+
+TensorProto makeFloats(std::string const& name, std::vector<int64_t> const& dims, std::vector<float> const& values)
+{
+    TensorProto tensor;
+    tensor.set_name(name);
+    tensor.set_data_type(TensorProto::FLOAT);
+    for (int64_t d : dims)
+    {
+        tensor.add_dims(d);
+    }
+    tensor.set_raw_data(std::string(reinterpret_cast<char const*>(values.data()), values.size() * sizeof(float)));
+    return tensor;
+}
+
+NodeProto* addNode(GraphProto* graph, std::string const& op, std::vector<std::string> const& inputs,
+    std::string const& output)
+{
+    NodeProto* node = graph->add_node();
+    node->set_op_type(op);
+    for (auto const& input : inputs)
+    {
+        node->add_input(input);
+    }
+    node->add_output(output);
+    return node;
+}
+
+void addIntAttr(NodeProto* node, std::string const& name, int64_t value)
+{
+    AttributeProto* attr = node->add_attribute();
+    attr->set_name(name);
+    attr->set_type(AttributeProto::INT);
+    attr->set_i(value);
+}
+
+GraphProto makeGraph()
+{
+    GraphProto graph;
+    std::vector<float> weights(24);
+    for (size_t i = 0; i < weights.size(); ++i)
+    {
+        weights[i] = static_cast<float>(i);
+    }
+    *graph.add_initializer() = makeFloats("w", {2, 3, 4}, weights);
+    *graph.add_initializer() = makeFloats("two", {}, {2.f});
+    *graph.add_initializer() = makeInt64s("minus_one", {-1});
+    *graph.add_initializer() = makeInt64s("slice_starts", {1});
+    *graph.add_initializer() = makeInt64s("slice_ends", {3});
+    *graph.add_initializer() = makeInt64s("big_shape", {1024, 1024});
+
+    NodeProto* constant = addNode(&graph, "Constant", {}, "zero");
+    AttributeProto* value = constant->add_attribute();
+    value->set_name("value");
+    value->set_type(AttributeProto::TENSOR);
+    *value->mutable_t() = makeInt64s("", {0});
+
+    addNode(&graph, "Shape", {"w"}, "shape");
+    addIntAttr(addNode(&graph, "Gather", {"shape", "zero"}, "batch"), "axis", 0);
+    addIntAttr(addNode(&graph, "Concat", {"batch", "minus_one"}, "new_shape"), "axis", 0);
+    addNode(&graph, "Reshape", {"w", "new_shape"}, "reshaped");
+    addNode(&graph, "Mul", {"reshaped", "two"}, "scaled");
+    addIntAttr(addNode(&graph, "Cast", {"new_shape"}, "new_shape_f"), "to", TensorProto::FLOAT);
+    addNode(&graph, "Slice", {"shape", "slice_starts", "slice_ends"}, "tail");
+    addNode(&graph, "ConstantOfShape", {"big_shape"}, "big");
+    // Depends on a graph input, so it must be imported.
+    addNode(&graph, "Add", {"x", "scaled"}, "y");
+    return graph;
+}
+
+std::vector<int64_t> int64s(TensorProto const& t)
+{
+    std::vector<int64_t> values(t.raw_data().size() / sizeof(int64_t));
+    std::memcpy(values.data(), t.raw_data().data(), t.raw_data().size());
+    return values;
+}
+
+std::vector<float> floats(TensorProto const& t)
+{
+    std::vector<float> values(t.raw_data().size() / sizeof(float));
+    std::memcpy(values.data(), t.raw_data().data(), t.raw_data().size());
+    return values;
+}
+
+TensorProto const* output(onnx2trt::FoldedConstants const& folded, GraphProto const& graph, std::string const& name)
+{
+    for (NodeProto const& node : graph.node())
+    {
+        if (node.output(0) == name)
+        {
+            auto const* outputs = folded.find(node);
+            return outputs ? &outputs->at(0) : nullptr;
+        }
+    }
+    return nullptr;
+}
+
+void testFolding()
+{
+    const GraphProto graph = makeGraph();
+    onnx2trt::ConstantFoldingCache cache;
+    onnx2trt::FoldedConstants folded(&cache);
+    folded.fold(graph);
+
+    // Shape, Gather, Concat, Reshape, Mul, Cast and Slice.
+    EXPECT(folded.size() == 7);
+    EXPECT(folded.getNbCacheHits() == 0);
+
+    TensorProto const* shape = output(folded, graph, "shape");
+    EXPECT(shape && int64s(*shape) == std::vector<int64_t>({2, 3, 4}));
+    TensorProto const* newShape = output(folded, graph, "new_shape");
+    EXPECT(newShape && int64s(*newShape) == std::vector<int64_t>({2, -1}));
+    EXPECT(newShape && newShape->name() == "new_shape");
+
+    TensorProto const* scaled = output(folded, graph, "scaled");
+    EXPECT(scaled && scaled->dims_size() == 2 && scaled->dims(0) == 2 && scaled->dims(1) == 12);
+    EXPECT(scaled && floats(*scaled).at(23) == 46.f);
+
+    TensorProto const* newShapeF = output(folded, graph, "new_shape_f");
+    EXPECT(newShapeF && newShapeF->data_type() == TensorProto::FLOAT
+        && floats(*newShapeF) == std::vector<float>({2.f, -1.f}));
+
+    TensorProto const* tail = output(folded, graph, "tail");
+    EXPECT(tail && int64s(*tail) == std::vector<int64_t>({3, 4}));
+
+    // 4 MiB exceeds the default cap, and y depends on a graph input.
+    EXPECT(!output(folded, graph, "big"));
+    EXPECT(!output(folded, graph, "y"));
+
+    // A second stage of the same model is served from the cache, under its own output names.
+    GraphProto stage = makeGraph();
+    stage.mutable_node(1)->set_output(0, "shape_stage2"); // Shape
+    stage.mutable_node(2)->set_input(0, "shape_stage2"); // Gather
+    stage.mutable_node(7)->set_input(0, "shape_stage2"); // Slice
+    onnx2trt::FoldedConstants folded2(&cache);
+    folded2.fold(stage);
+    EXPECT(folded2.size() == 7);
+    EXPECT(folded2.getNbCacheHits() == 7);
+    TensorProto const* shape2 = output(folded2, stage, "shape_stage2");
+    EXPECT(shape2 && shape2->name() == "shape_stage2" && int64s(*shape2) == std::vector<int64_t>({2, 3, 4}));
+
+    // Raising the cap lets the large fill through.
+    onnx2trt::FoldedConstants uncapped(nullptr, 8 << 20);
+    uncapped.fold(graph);
+    TensorProto const* big = output(uncapped, graph, "big");
+    EXPECT(big && big->raw_data().size() == (4 << 20));
+}
+
+void testIntegerDivision()
+{
+    GraphProto graph;
+    *graph.add_initializer() = makeInt64s("a", {7, -7});
+    *graph.add_initializer() = makeInt64s("b", {2});
+    *graph.add_initializer() = makeInt64s("c", {7, 8});
+    addNode(&graph, "Div", {"a", "b"}, "inexact");
+    addNode(&graph, "Div", {"c", "b"}, "positive");
+    onnx2trt::FoldedConstants folded;
+    folded.fold(graph);
+    // Rounding of negative quotients is left to the runtime.
+    EXPECT(!output(folded, graph, "inexact"));
+    TensorProto const* positive = output(folded, graph, "positive");
+    EXPECT(positive && int64s(*positive) == std::vector<int64_t>({3, 4}));
+}
+
+} // namespace
+
+int main()
+{
+    GOOGLE_PROTOBUF_VERIFY_VERSION;
+
+    testFolding();
+    testIntegerDivision();
+
+    return testHarness::finishTests("constant folding");
+}
@@ -0,0 +1,201 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+// Checks ModelCost on a small residual network with a symbolic batch dimension: per-node FLOPs and bytes must match
+// hand-computed values, and the residual connection must rule out the cut inside the block.
+
+#include "CostModel.hpp"
+#include "TestHarness.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+using std::cerr;
+using std::cout;
+using std::endl;
+
+namespace
+{
+
+using ::ONNX_NAMESPACE::AttributeProto;
+using ::ONNX_NAMESPACE::GraphProto;
+using ::ONNX_NAMESPACE::ModelProto;
+using ::ONNX_NAMESPACE::NodeProto;
+using ::ONNX_NAMESPACE::TensorProto;
+
+void addFloats(GraphProto* graph, std::string const& name, std::vector<int64_t> const& dims)
+{
+    TensorProto* tensor = graph->add_initializer();
+    tensor->set_name(name);
+    tensor->set_data_type(TensorProto::FLOAT);
+    int64_t volume = 1;
+    for (int64_t d : dims)
+    {
+        tensor->add_dims(d);
+        volume *= d;
+    }
+    for (int64_t i = 0; i < volume; ++i)
+    {
+        tensor->add_float_data(0.f);
+    }
+}
+
+NodeProto* addNode(GraphProto* graph, std::string const& op, std::vector<std::string> const& inputs,
+    std::string const& output)
+{
+    NodeProto* node = graph->add_node();
+    node->set_op_type(op);
+    node->set_name(op + "_" + output);
+    for (auto const& input : inputs)
+    {
+        node->add_input(input);
+    }
+    node->add_output(output);
+    return node;
+}
+
+void addInts(NodeProto* node, std::string const& name, std::vector<int64_t> const& values)
+{
+    AttributeProto* attr = node->add_attribute();
+    attr->set_name(name);
+    attr->set_type(AttributeProto::INTS);
+    for (int64_t v : values)
+    {
+        attr->add_ints(v);
+    }
+}
+
+// x[N,3,8,8] -> Conv3x3 -> Relu -> (Conv1x1 + residual) -> GlobalAveragePool -> Reshape -> Gemm -> y[N,10]
+ModelProto makeModel()
+{
+    ModelProto model;
+    model.set_ir_version(7);
+    model.add_opset_import()->set_version(11);
+    GraphProto* graph = model.mutable_graph();
+
+    auto* input = graph->add_input();
+    input->set_name("x");
+    auto* type = input->mutable_type()->mutable_tensor_type();
+    type->set_elem_type(TensorProto::FLOAT);
+    type->mutable_shape()->add_dim()->set_dim_param("N");
+    for (int64_t d : {3, 8, 8})
+    {
+        type->mutable_shape()->add_dim()->set_dim_value(d);
+    }
+    graph->add_output()->set_name("y");
+
+    addFloats(graph, "w", {4, 3, 3, 3});
+    addFloats(graph, "b", {4});
+    addFloats(graph, "w2", {4, 4, 1, 1});
+    addFloats(graph, "wg", {10, 4});
+    addFloats(graph, "bg", {10});
+    TensorProto* shape = graph->add_initializer();
+    shape->set_name("shape");
+    shape->set_data_type(TensorProto::INT64);
+    shape->add_dims(2);
+    shape->add_int64_data(-1);
+    shape->add_int64_data(4);
+
+    NodeProto* conv = addNode(graph, "Conv", {"x", "w", "b"}, "c1");
+    addInts(conv, "kernel_shape", {3, 3});
+    addInts(conv, "pads", {1, 1, 1, 1});
+    addNode(graph, "Relu", {"c1"}, "r1");
+    addInts(addNode(graph, "Conv", {"r1", "w2"}, "c2"), "kernel_shape", {1, 1});
+    addNode(graph, "Add", {"c2", "r1"}, "s");
+    addNode(graph, "GlobalAveragePool", {"s"}, "p");
+    addNode(graph, "Reshape", {"p", "shape"}, "f");
+    NodeProto* gemm = addNode(graph, "Gemm", {"f", "wg", "bg"}, "y");
+    AttributeProto* transB = gemm->add_attribute();
+    transB->set_name("transB");
+    transB->set_type(AttributeProto::INT);
+    transB->set_i(1);
+    return model;
+}
+
+void testCosts()
+{
+    onnx2trt::ModelCost cost;
+    std::string error;
+    EXPECT(cost.analyze(makeModel(), onnx2trt::CostModelOptions{}, &error));
+    EXPECT(error.empty());
+
+    auto const& nodes = cost.getNodes();
+    EXPECT(nodes.size() == 7);
+    if (nodes.size() != 7)
+    {
+        return;
+    }
+    for (auto const& node : nodes)
+    {
+        EXPECT(node.shapesKnown);
+    }
+    // 256 outputs, each a 27-element dot product plus a bias.
+    EXPECT(nodes[0].flops == 256 * 2 * 27 + 256);
+    EXPECT(nodes[0].paramBytes == (108 + 4) * 4);
+    EXPECT(nodes[0].activationBytes == 256 * 4);
+    EXPECT(nodes[1].flops == 256);
+    EXPECT(nodes[2].flops == 256 * 2 * 4);
+    EXPECT(nodes[4].flops == 256);
+    EXPECT(nodes[5].flops == 0);
+    EXPECT(nodes[5].paramBytes == 16);
+    EXPECT(nodes[6].flops == 10 * 2 * 4 + 10);
+    EXPECT(cost.getTotalParamBytes() == (108 + 4 + 16 + 40 + 10) * 4 + 16);
+
+    auto const& cuts = cost.getCutPoints();
+    EXPECT(cuts.size() == 6);
+    if (cuts.size() != 6)
+    {
+        return;
+    }
+    EXPECT(cuts[0].boundaryTensors == std::vector<std::string>({"c1"}));
+    EXPECT(cuts[0].boundaryBytes == 1024);
+    // The residual input is still live next to the block's Conv output.
+    EXPECT(cuts[2].boundaryTensors == std::vector<std::string>({"r1", "c2"}));
+    EXPECT(cuts[2].boundaryBytes == 2048);
+    EXPECT(cuts[4].boundaryBytes == 16);
+    EXPECT(cuts[1].prefixFlops == nodes[0].flops + nodes[1].flops);
+    EXPECT(cuts[1].prefixParamBytes == nodes[0].paramBytes);
+
+    auto const candidates = cost.getCandidates(1);
+    EXPECT(candidates.size() == 5);
+    for (auto const& cut : candidates)
+    {
+        EXPECT(cut.position != 3);
+    }
+    EXPECT(onnx2trt::ModelCost::getCompactionBytes(cuts[0], 8) == 2. * 1024 * 8);
+}
+
+void testNamedDimensions()
+{
+    ModelProto model = makeModel();
+    auto* dims = model.mutable_graph()->mutable_input(0)->mutable_type()->mutable_tensor_type()->mutable_shape();
+    dims->mutable_dim(2)->set_dim_param("H");
+    dims->mutable_dim(3)->set_dim_param("W");
+
+    onnx2trt::ModelCost cost;
+    std::string error;
+    EXPECT(cost.analyze(model, onnx2trt::CostModelOptions{}, &error));
+    // Unknown spatial size: the first Conv cannot be costed.
+    EXPECT(!cost.getNodes().empty() && !cost.getNodes()[0].shapesKnown);
+
+    onnx2trt::CostModelOptions options;
+    options.dimParams["H"] = 16;
+    options.dimParams["W"] = 16;
+    EXPECT(cost.analyze(model, options, &error));
+    EXPECT(!cost.getNodes().empty() && cost.getNodes()[0].shapesKnown);
+    EXPECT(!cost.getNodes().empty() && cost.getNodes()[0].activationBytes == 4 * 16 * 16 * 4);
+}
+
+} // namespace
+
+int main()
+{
+    GOOGLE_PROTOBUF_VERIFY_VERSION;
+
+    testCosts();
+    testNamedDimensions();
+
+    return testHarness::finishTests("cost model");
+}
@@ -0,0 +1,298 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+// Checks that the canonicalize_exit_head optimizer pass turns a Softmax graph output into its top probability and
+// class index, keeps the other outputs where they were, and leaves Softmaxes that are not exit heads alone.
+
+#include "TestHarness.h"
+
+#include <onnx/checker.h>
+#include <onnx/optimizer/optimize.h>
+#include <onnx/shape_inference/implementation.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+using std::cerr;
+using std::cout;
+using std::endl;
+
+namespace
+{
+
+using ::ONNX_NAMESPACE::GraphProto;
+using ::ONNX_NAMESPACE::ModelProto;
+using ::ONNX_NAMESPACE::NodeProto;
+using ::ONNX_NAMESPACE::TensorProto;
+using ::ONNX_NAMESPACE::ValueInfoProto;
+
+constexpr int64_t kFeatures = 8;
+constexpr int64_t kClasses = 10;
+
+void setType(ValueInfoProto* info, std::string const& name, int32_t type, std::vector<std::string> const& dims)
+{
+    info->set_name(name);
+    auto* tensorType = info->mutable_type()->mutable_tensor_type();
+    tensorType->set_elem_type(type);
+    for (auto const& d : dims)
+    {
+        if (d[0] >= '0' && d[0] <= '9')
+        {
+            tensorType->mutable_shape()->add_dim()->set_dim_value(std::stoll(d));
+        }
+        else
+        {
+            tensorType->mutable_shape()->add_dim()->set_dim_param(d);
+        }
+    }
+}
+
+// The ONNX IR only imports initializers that are also graph inputs.
+void addFloats(GraphProto* graph, std::string const& name, std::vector<int64_t> const& dims)
+{
+    std::vector<std::string> inputDims;
+    for (int64_t d : dims)
+    {
+        inputDims.push_back(std::to_string(d));
+    }
+    setType(graph->add_input(), name, TensorProto::FLOAT, inputDims);
+
+    TensorProto* tensor = graph->add_initializer();
+    tensor->set_name(name);
+    tensor->set_data_type(TensorProto::FLOAT);
+    int64_t volume = 1;
+    for (int64_t d : dims)
+    {
+        tensor->add_dims(d);
+        volume *= d;
+    }
+    for (int64_t i = 0; i < volume; ++i)
+    {
+        tensor->add_float_data(0.f);
+    }
+}
+
+NodeProto* addNode(GraphProto* graph, std::string const& op, std::vector<std::string> const& inputs,
+    std::string const& output)
+{
+    NodeProto* node = graph->add_node();
+    node->set_op_type(op);
+    for (auto const& input : inputs)
+    {
+        node->add_input(input);
+    }
+    node->add_output(output);
+    return node;
+}
+
+void setInt(NodeProto* node, std::string const& name, int64_t value)
+{
+    auto* attr = node->add_attribute();
+    attr->set_name(name);
+    attr->set_type(::ONNX_NAMESPACE::AttributeProto::INT);
+    attr->set_i(value);
+}
+
+// x[N,8] -> Gemm -> logits -> Softmax(axis) -> prob
+//                          \-> Relu -> features
+// with graph outputs prob and features, in that order.
+ModelProto makeModel(int64_t opset, int64_t axis = 1)
+{
+    ModelProto model;
+    model.set_ir_version(opset < 10 ? 4 : 6);
+    model.add_opset_import()->set_version(opset);
+    GraphProto* graph = model.mutable_graph();
+    graph->set_name("exit_head");
+    setType(graph->add_input(), "x", TensorProto::FLOAT, {"N", std::to_string(kFeatures)});
+    addFloats(graph, "w", {kClasses, kFeatures});
+    addFloats(graph, "b", {kClasses});
+
+    setInt(addNode(graph, "Gemm", {"x", "w", "b"}, "logits"), "transB", 1);
+    setInt(addNode(graph, "Softmax", {"logits"}, "prob"), "axis", axis);
+    addNode(graph, "Relu", {"logits"}, "features");
+
+    setType(graph->add_output(), "prob", TensorProto::FLOAT, {"N", std::to_string(kClasses)});
+    setType(graph->add_output(), "features", TensorProto::FLOAT, {"N", std::to_string(kClasses)});
+    return model;
+}
+
+// x[N,T,C] -> Softmax -> prob, with the axis left to its default.
+ModelProto makeSequenceModel(int64_t opset)
+{
+    ModelProto model;
+    model.set_ir_version(7);
+    model.add_opset_import()->set_version(opset);
+    GraphProto* graph = model.mutable_graph();
+    graph->set_name("sequence_head");
+    std::vector<std::string> const dims{"N", "4", std::to_string(kClasses)};
+    setType(graph->add_input(), "x", TensorProto::FLOAT, dims);
+    addNode(graph, "Softmax", {"x"}, "prob");
+    setType(graph->add_output(), "prob", TensorProto::FLOAT, dims);
+    return model;
+}
+
+NodeProto const* findNode(ModelProto const& model, std::string const& op)
+{
+    for (auto const& node : model.graph().node())
+    {
+        if (node.op_type() == op)
+        {
+            return &node;
+        }
+    }
+    return nullptr;
+}
+
+std::vector<std::string> getDims(ValueInfoProto const& info)
+{
+    std::vector<std::string> dims;
+    for (auto const& dim : info.type().tensor_type().shape().dim())
+    {
+        dims.push_back(dim.has_dim_value() ? std::to_string(dim.dim_value()) : dim.dim_param());
+    }
+    return dims;
+}
+
+bool isValid(ModelProto model)
+{
+    try
+    {
+        ::ONNX_NAMESPACE::checker::check_model(model);
+        ::ONNX_NAMESPACE::shape_inference::InferShapes(model);
+    }
+    catch (std::exception const& e)
+    {
+        cerr << e.what() << endl;
+        return false;
+    }
+    return true;
+}
+
+ModelProto canonicalize(ModelProto const& model)
+{
+    return ::ONNX_NAMESPACE::optimization::Optimize(model, {"canonicalize_exit_head"});
+}
+
+void expectExitOutputs(ModelProto const& head)
+{
+    auto const& outputs = head.graph().output();
+    EXPECT(outputs.size() == 3);
+    if (outputs.size() != 3)
+    {
+        return;
+    }
+    EXPECT(outputs.Get(0).name() == "prob");
+    EXPECT(outputs.Get(0).type().tensor_type().elem_type() == TensorProto::FLOAT);
+    EXPECT(getDims(outputs.Get(0)) == std::vector<std::string>({"N", "1"}));
+    EXPECT(outputs.Get(1).name() == "features");
+    EXPECT(getDims(outputs.Get(1)) == std::vector<std::string>({"N", std::to_string(kClasses)}));
+    EXPECT(outputs.Get(2).name() == "prob_argmax");
+    EXPECT(outputs.Get(2).type().tensor_type().elem_type() == TensorProto::INT64);
+    EXPECT(getDims(outputs.Get(2)) == std::vector<std::string>({"N", "1"}));
+}
+
+void testOpset11()
+{
+    ModelProto const head = canonicalize(makeModel(11));
+    expectExitOutputs(head);
+    EXPECT(head.graph().node_size() == 5);
+
+    NodeProto const* topk = findNode(head, "TopK");
+    EXPECT(topk != nullptr);
+    if (topk)
+    {
+        EXPECT(topk->input_size() == 2 && topk->input(0) == "prob_probs");
+        EXPECT(topk->output_size() == 2 && topk->output(0) == "prob" && topk->output(1) == "prob_argmax");
+        NodeProto const* k = findNode(head, "Constant");
+        EXPECT(k != nullptr && topk->input_size() == 2 && k->output(0) == topk->input(1));
+        EXPECT(k != nullptr && k->attribute(0).t().int64_data_size() == 1 && k->attribute(0).t().int64_data(0) == 1);
+    }
+    EXPECT(isValid(head));
+}
+
+void testOpset9()
+{
+    ModelProto const head = canonicalize(makeModel(9));
+    expectExitOutputs(head);
+    EXPECT(head.graph().node_size() == 4);
+    EXPECT(findNode(head, "Constant") == nullptr);
+
+    NodeProto const* topk = findNode(head, "TopK");
+    EXPECT(topk != nullptr && topk->input_size() == 1);
+    if (topk)
+    {
+        bool hasK = false;
+        for (auto const& attr : topk->attribute())
+        {
+            if (attr.name() == "k")
+            {
+                hasK = true;
+                EXPECT(attr.i() == 1);
+            }
+        }
+        EXPECT(hasK);
+    }
+    EXPECT(isValid(head));
+}
+
+void testNegativeAxis()
+{
+    ModelProto const head = canonicalize(makeModel(11, -1));
+    expectExitOutputs(head);
+}
+
+void testDefaultAxis()
+{
+    // From opset 13 on, Softmax normalizes over the last axis by default.
+    ModelProto const head = canonicalize(makeSequenceModel(13));
+    NodeProto const* topk = findNode(head, "TopK");
+    EXPECT(topk != nullptr);
+    if (topk)
+    {
+        EXPECT(topk->attribute_size() == 1 && topk->attribute(0).name() == "axis" && topk->attribute(0).i() == 2);
+    }
+    EXPECT(head.graph().output_size() == 2);
+    EXPECT(head.graph().output_size() == 2
+        && getDims(head.graph().output(0)) == std::vector<std::string>({"N", "4", "1"}));
+
+    // Before, over axis 1, which is not the innermost one here.
+    EXPECT(findNode(canonicalize(makeSequenceModel(11)), "TopK") == nullptr);
+}
+
+void testSkipsOtherSoftmaxes()
+{
+    // Softmax over the batch dimension.
+    ModelProto const batch = canonicalize(makeModel(11, 0));
+    EXPECT(findNode(batch, "TopK") == nullptr);
+    EXPECT(batch.graph().output_size() == 2);
+
+    // The probabilities are consumed inside the graph as well.
+    ModelProto shared = makeModel(11);
+    addNode(shared.mutable_graph(), "Relu", {"prob"}, "shared");
+    setType(shared.mutable_graph()->add_output(), "shared", TensorProto::FLOAT, {"N", std::to_string(kClasses)});
+    ModelProto const notHead = canonicalize(shared);
+    EXPECT(findNode(notHead, "TopK") == nullptr);
+    EXPECT(notHead.graph().output_size() == 3);
+
+    // Rank unknown.
+    ModelProto unknown = makeModel(11);
+    unknown.mutable_graph()->mutable_output(0)->mutable_type()->mutable_tensor_type()->clear_shape();
+    EXPECT(findNode(canonicalize(unknown), "TopK") == nullptr);
+}
+
+} // namespace
+
+int main()
+{
+    GOOGLE_PROTOBUF_VERIFY_VERSION;
+
+    testOpset11();
+    testOpset9();
+    testNegativeAxis();
+    testDefaultAxis();
+    testSkipsOtherSoftmaxes();
+
+    return testHarness::finishTests("exit head pass");
+}
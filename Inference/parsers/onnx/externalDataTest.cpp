@@ -0,0 +1,249 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+// Checks ExternalDataReader against models with external data written by this program: payloads must round-trip,
+// neighbouring tensors must be fetched with one read, each data file must be opened once, and checksums must be
+// enforced.
+
+#include "ExternalData.hpp"
+#include "TestHarness.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+using std::cerr;
+using std::cout;
+using std::endl;
+
+namespace
+{
+
+struct TensorSpec
+{
+    std::string name;
+    std::string location;
+    std::vector<float> values;
+    int64_t offset;
+};
+
+void setExternalData(::ONNX_NAMESPACE::TensorProto* tensor, const std::string& key, const std::string& value)
+{
+    auto* entry = tensor->add_external_data();
+    entry->set_key(key);
+    entry->set_value(value);
+}
+
+// Writes the payloads into their data files and returns a model whose initializers reference them.
+::ONNX_NAMESPACE::ModelProto makeModel(const std::string& dir, std::vector<TensorSpec>& specs)
+{
+    ::ONNX_NAMESPACE::ModelProto model;
+    auto* graph = model.mutable_graph();
+    std::map<std::string, int64_t> fileSizes;
+    for (auto& spec : specs)
+    {
+        const bool first = !fileSizes.count(spec.location);
+        std::ofstream file(dir + "/" + spec.location, std::ios::binary | (first ? std::ios::trunc : std::ios::app));
+        const int64_t nbytes = static_cast<int64_t>(spec.values.size() * sizeof(float));
+        spec.offset = fileSizes[spec.location];
+        fileSizes[spec.location] += nbytes;
+        file.write(reinterpret_cast<const char*>(spec.values.data()), nbytes);
+
+        auto* tensor = graph->add_initializer();
+        tensor->set_name(spec.name);
+        tensor->set_data_type(::ONNX_NAMESPACE::TensorProto::FLOAT);
+        tensor->add_dims(static_cast<int64_t>(spec.values.size()));
+        tensor->set_data_location(::ONNX_NAMESPACE::TensorProto::EXTERNAL);
+        setExternalData(tensor, "location", spec.location);
+        setExternalData(tensor, "offset", std::to_string(spec.offset));
+        setExternalData(tensor, "length", std::to_string(spec.values.size() * sizeof(float)));
+    }
+    return model;
+}
+
+std::vector<onnx2trt::ExternalDataRange> getRanges(
+    const ::ONNX_NAMESPACE::ModelProto& model, const std::string& modelPath)
+{
+    std::vector<onnx2trt::ExternalDataRange> ranges;
+    for (const auto& initializer : model.graph().initializer())
+    {
+        onnx2trt::ExternalDataRange range;
+        std::string error;
+        EXPECT(onnx2trt::getExternalDataRange(initializer, modelPath, &range, &error));
+        ranges.push_back(range);
+    }
+    return ranges;
+}
+
+std::vector<float> iota(size_t n, float start)
+{
+    std::vector<float> values(n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        values[i] = start + i;
+    }
+    return values;
+}
+
+void testSha1()
+{
+    EXPECT(onnx2trt::sha1Hex("", 0) == "da39a3ee5e6b4b0d3255bfef95601890afd80709");
+    EXPECT(onnx2trt::sha1Hex("abc", 3) == "a9993e364706816aba3e25717850c26c9cd0d89d");
+    const std::string twoBlocks = "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+    EXPECT(onnx2trt::sha1Hex(twoBlocks.data(), twoBlocks.size()) == "84983e441c3bd26ebaae4aa1f95129e5e54670f1");
+}
+
+void testCoalescedRoundTrip(const std::string& dir)
+{
+    std::vector<TensorSpec> specs{
+        {"a", "weights.bin", iota(100, 0.f), 0},
+        {"b", "weights.bin", iota(7, 1000.f), 0},
+        {"c", "weights.bin", iota(4096, -5.f), 0},
+        {"d", "other.bin", iota(33, 42.f), 0},
+    };
+    auto model = makeModel(dir, specs);
+
+    // Round-trip through the serialized form, as the parser would see it.
+    const std::string modelPath = dir + "/model.onnx";
+    {
+        std::ofstream out(modelPath, std::ios::binary);
+        model.SerializeToOstream(&out);
+    }
+    ::ONNX_NAMESPACE::ModelProto parsed;
+    {
+        std::ifstream in(modelPath, std::ios::binary);
+        EXPECT(parsed.ParseFromIstream(&in));
+    }
+
+    auto ranges = getRanges(parsed, modelPath);
+    EXPECT(ranges.size() == specs.size());
+    EXPECT(ranges[0].path == dir + "/weights.bin");
+
+    onnx2trt::ExternalDataReader reader;
+    std::string error;
+    EXPECT(reader.prefetch(ranges, &error));
+    // One read per data file.
+    EXPECT(reader.getNbReads() == 2);
+    EXPECT(reader.getNbOpenFiles() == 2);
+
+    for (size_t i = 0; i < specs.size(); ++i)
+    {
+        const char* data{nullptr};
+        size_t size{0};
+        EXPECT(reader.read(ranges[i], &data, &size, &error));
+        EXPECT(size == specs[i].values.size() * sizeof(float));
+        EXPECT(data && std::memcmp(data, specs[i].values.data(), size) == 0);
+    }
+    // Everything was resident already.
+    EXPECT(reader.getNbReads() == 2);
+
+    // Prefetching again is a no-op.
+    EXPECT(reader.prefetch(ranges, &error));
+    EXPECT(reader.getNbReads() == 2);
+
+    // Reads without a prefetch reuse the open handle.
+    onnx2trt::ExternalDataReader lazy;
+    for (const auto& range : ranges)
+    {
+        const char* data{nullptr};
+        size_t size{0};
+        EXPECT(lazy.read(range, &data, &size, &error));
+    }
+    EXPECT(lazy.getNbReads() == ranges.size());
+    EXPECT(lazy.getNbOpenFiles() == 2);
+}
+
+void testWholeFileAndErrors(const std::string& dir)
+{
+    std::vector<TensorSpec> specs{{"w", "whole.bin", iota(10, 3.f), 0}};
+    auto model = makeModel(dir, specs);
+    const std::string modelPath = dir + "/model.onnx";
+
+    // A missing length means "up to the end of the file".
+    auto* tensor = model.mutable_graph()->mutable_initializer(0);
+    tensor->mutable_external_data()->RemoveLast();
+    auto ranges = getRanges(model, modelPath);
+    onnx2trt::ExternalDataReader reader;
+    std::string error;
+    const char* data{nullptr};
+    size_t size{0};
+    EXPECT(reader.read(ranges[0], &data, &size, &error));
+    EXPECT(size == 10 * sizeof(float));
+
+    // Ranges past the end of the file are rejected.
+    auto outOfBounds = ranges[0];
+    outOfBounds.length = 11 * sizeof(float);
+    EXPECT(!reader.read(outOfBounds, &data, &size, &error));
+
+    // So are missing files and unknown keys.
+    auto missing = ranges[0];
+    missing.path = dir + "/missing.bin";
+    EXPECT(!reader.read(missing, &data, &size, &error));
+    setExternalData(tensor, "compression", "zstd");
+    onnx2trt::ExternalDataRange range;
+    EXPECT(!onnx2trt::getExternalDataRange(*tensor, modelPath, &range, &error));
+}
+
+void testChecksums(const std::string& dir)
+{
+    std::vector<TensorSpec> specs{
+        {"x", "sum.bin", iota(64, 1.f), 0},
+        {"y", "sum.bin", iota(16, 9.f), 0},
+    };
+    auto model = makeModel(dir, specs);
+    const std::string modelPath = dir + "/model.onnx";
+    auto ranges = getRanges(model, modelPath);
+
+    std::vector<char> fileBytes;
+    for (const auto& spec : specs)
+    {
+        const char* bytes = reinterpret_cast<const char*>(spec.values.data());
+        fileBytes.insert(fileBytes.end(), bytes, bytes + spec.values.size() * sizeof(float));
+    }
+    const std::string fileDigest = onnx2trt::sha1Hex(fileBytes.data(), fileBytes.size());
+    const std::string tensorDigest = onnx2trt::sha1Hex(specs[1].values.data(), specs[1].values.size() * sizeof(float));
+
+    onnx2trt::ExternalDataReader reader;
+    std::string error;
+    const char* data{nullptr};
+    size_t size{0};
+
+    // Both a whole-file digest and a per-tensor digest are accepted.
+    ranges[0].checksum = fileDigest;
+    ranges[1].checksum = tensorDigest;
+    EXPECT(reader.read(ranges[0], &data, &size, &error));
+    EXPECT(reader.read(ranges[1], &data, &size, &error));
+
+    auto corrupt = ranges[1];
+    corrupt.checksum = std::string(40, '0');
+    EXPECT(!reader.read(corrupt, &data, &size, &error));
+    EXPECT(error.find("Checksum mismatch") != std::string::npos);
+
+    reader.setVerifyChecksums(false);
+    EXPECT(reader.read(corrupt, &data, &size, &error));
+}
+
+} // namespace
+
+int main()
+{
+    GOOGLE_PROTOBUF_VERIFY_VERSION;
+
+    const testHarness::TempDir tempDir("externalDataTest");
+    if (!tempDir.isValid())
+    {
+        return 1;
+    }
+
+    testSha1();
+    testCoalescedRoundTrip(tempDir.getPath());
+    testWholeFileAndErrors(tempDir.getPath());
+    testChecksums(tempDir.getPath());
+
+    return testHarness::finishTests("external data");
+}
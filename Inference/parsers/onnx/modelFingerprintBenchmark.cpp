@@ -0,0 +1,154 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <unistd.h> // For ::getopt
+#include <vector>
+#include "ModelFingerprint.hpp"
+
+using std::cout;
+using std::cerr;
+using std::endl;
+
+void print_usage() {
+  cout << "This program measures how long fingerprinting a transformer-sized ONNX model takes, with one thread and" << endl;
+  cout << "with all of them. Every second layer repeats the weights of the one before it." << endl;
+  cout << "Usage: modelFingerprintBenchmark [-m weight megabytes (default 400)] [-l layers (default 24)]" << endl;
+  cout << "                                 [-n iterations (default 3)] [-t threads (default all)]" << endl;
+}
+
+namespace
+{
+
+using ::ONNX_NAMESPACE::GraphProto;
+using ::ONNX_NAMESPACE::ModelProto;
+using ::ONNX_NAMESPACE::NodeProto;
+using ::ONNX_NAMESPACE::TensorProto;
+
+void addWeights(GraphProto* graph, std::string const& name, int64_t rows, int64_t cols, int seed)
+{
+    TensorProto* tensor = graph->add_initializer();
+    tensor->set_name(name);
+    tensor->set_data_type(TensorProto::FLOAT);
+    tensor->add_dims(rows);
+    tensor->add_dims(cols);
+    std::string* raw = tensor->mutable_raw_data();
+    raw->resize(rows * cols * sizeof(float));
+    float* values = reinterpret_cast<float*>(&(*raw)[0]);
+    for (int64_t i = 0; i < rows * cols; ++i)
+    {
+        values[i] = static_cast<float>((i * 31 + seed) % 1021) / 1021.f;
+    }
+}
+
+ModelProto makeModel(int64_t megabytes, int layers)
+{
+    // Four square matrices per layer.
+    int64_t const bytesPerWeight = static_cast<int64_t>(sizeof(float)) * 4 * layers;
+    int64_t width = 64;
+    while ((width + 64) * (width + 64) * bytesPerWeight <= megabytes << 20)
+    {
+        width += 64;
+    }
+    ModelProto model;
+    model.set_ir_version(7);
+    model.add_opset_import()->set_version(13);
+    GraphProto* graph = model.mutable_graph();
+    graph->add_input()->set_name("x");
+    std::string input = "x";
+    for (int l = 0; l < layers; ++l)
+    {
+        for (int m = 0; m < 4; ++m)
+        {
+            std::string const name = "l" + std::to_string(l) + "_w" + std::to_string(m);
+            addWeights(graph, name, width, width, (l / 2) * 4 + m);
+            NodeProto* node = graph->add_node();
+            node->set_op_type("MatMul");
+            node->add_input(input);
+            node->add_input(name);
+            input = name + "_out";
+            node->add_output(input);
+        }
+    }
+    graph->add_output()->set_name(input);
+    return model;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    GOOGLE_PROTOBUF_VERIFY_VERSION;
+
+    int megabytes = 400;
+    int layers = 24;
+    int iterations = 3;
+    int threads = 0;
+    int c;
+    while ((c = getopt (argc, argv, "m:l:n:t:h")) != -1)
+    {
+        switch(c)
+        {
+            case 'm':
+                    megabytes = atoi(optarg);
+                    break;
+            case 'l':
+                    layers = atoi(optarg);
+                    break;
+            case 'n':
+                    iterations = atoi(optarg);
+                    break;
+            case 't':
+                    threads = atoi(optarg);
+                    break;
+            default:
+                    print_usage();
+                    return c == 'h' ? 0 : -1;
+        }
+    }
+    if (megabytes <= 0 || layers <= 0 || iterations <= 0 || threads < 0)
+    {
+        print_usage();
+        return -1;
+    }
+
+    const ModelProto model = makeModel(megabytes, layers);
+    size_t totalBytes = 0;
+    for (auto const& initializer : model.graph().initializer())
+    {
+        totalBytes += initializer.raw_data().size();
+    }
+    cout << "Model:        " << model.graph().node_size() << " nodes, " << (totalBytes >> 20) << " MB of weights" << endl;
+
+    onnx2trt::Digest digest;
+    for (int nbThreads : {1, threads})
+    {
+        onnx2trt::ModelFingerprint fingerprint(nbThreads);
+        std::string error;
+        const auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < iterations; ++i)
+        {
+            if (!fingerprint.compute(model, &error))
+            {
+                cerr << error << endl;
+                return -1;
+            }
+        }
+        const std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+        if (nbThreads != 1 && fingerprint.getModelDigest() != digest)
+        {
+            cerr << "Digest depends on the number of threads" << endl;
+            return -1;
+        }
+        digest = fingerprint.getModelDigest();
+        const double ms = elapsed.count() / iterations;
+        cout << (nbThreads == 1 ? "1 thread:     " : "All threads:  ") << ms << " ms per model, "
+             << totalBytes / ms / 1e6 << " GB/s of weights, " << (fingerprint.getNbHashedBytes() >> 20)
+             << " MB hashed" << endl;
+    }
+    cout << "Digest:       " << digest.hex() << endl;
+    return 0;
+}
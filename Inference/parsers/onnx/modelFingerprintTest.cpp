@@ -0,0 +1,274 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+// Checks that ModelFingerprint ignores internal names, tracks weight contents, gives repeated blocks equal local and
+// slice digests but different cone digests, deduplicates identical weights, and does not depend on the number of
+// threads or on where a payload is stored.
+
+#include "ExternalData.hpp"
+#include "ModelFingerprint.hpp"
+#include "TestHarness.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using std::cerr;
+using std::cout;
+using std::endl;
+
+namespace
+{
+
+using ::ONNX_NAMESPACE::GraphProto;
+using ::ONNX_NAMESPACE::ModelProto;
+using ::ONNX_NAMESPACE::NodeProto;
+using ::ONNX_NAMESPACE::TensorProto;
+using onnx2trt::Digest;
+using onnx2trt::ModelFingerprint;
+
+constexpr int64_t kWidth = 64;
+// Large enough to be hashed in several blocks.
+constexpr int64_t kVocab = 10000;
+
+std::vector<float> makeValues(int64_t count, float seed)
+{
+    std::vector<float> values(count);
+    for (int64_t i = 0; i < count; ++i)
+    {
+        values[i] = seed + static_cast<float>(i % 97) * 0.25f;
+    }
+    return values;
+}
+
+TensorProto* addRaw(GraphProto* graph, std::string const& name, std::vector<int64_t> const& dims, float seed)
+{
+    TensorProto* tensor = graph->add_initializer();
+    tensor->set_name(name);
+    tensor->set_data_type(TensorProto::FLOAT);
+    int64_t volume = 1;
+    for (int64_t d : dims)
+    {
+        tensor->add_dims(d);
+        volume *= d;
+    }
+    std::vector<float> const values = makeValues(volume, seed);
+    tensor->set_raw_data(values.data(), values.size() * sizeof(float));
+    return tensor;
+}
+
+void addNode(GraphProto* graph, std::string const& op, std::vector<std::string> const& inputs,
+    std::string const& output)
+{
+    NodeProto* node = graph->add_node();
+    node->set_op_type(op);
+    node->set_name(output);
+    for (auto const& input : inputs)
+    {
+        node->add_input(input);
+    }
+    node->add_output(output);
+}
+
+void addValueInfo(::ONNX_NAMESPACE::ValueInfoProto* info, std::string const& name, int32_t type)
+{
+    info->set_name(name);
+    auto* tensorType = info->mutable_type()->mutable_tensor_type();
+    tensorType->set_elem_type(type);
+    tensorType->mutable_shape()->add_dim()->set_dim_param("N");
+}
+
+// ids[N] -> Gather(emb) -> 3 x (MatMul(w_i) -> Add(b_i) -> Relu) -> y
+// Blocks 0 and 1 have identical weights; block 2 does not.
+ModelProto makeModel(std::string const& p = "", std::string const& input = "ids")
+{
+    ModelProto model;
+    model.set_ir_version(7);
+    model.add_opset_import()->set_version(13);
+    GraphProto* graph = model.mutable_graph();
+    addValueInfo(graph->add_input(), input, TensorProto::INT64);
+    addRaw(graph, p + "emb", {kVocab, kWidth}, 0.5f);
+    addNode(graph, "Gather", {p + "emb", input}, p + "h0");
+    for (int i = 0; i < 3; ++i)
+    {
+        std::string const s = std::to_string(i);
+        float const seed = i == 2 ? 3.f : 1.f;
+        addRaw(graph, p + "w" + s, {kWidth, kWidth}, seed);
+        addRaw(graph, p + "b" + s, {kWidth}, seed);
+        addNode(graph, "MatMul", {p + "h" + s, p + "w" + s}, p + "m" + s);
+        addNode(graph, "Add", {p + "m" + s, p + "b" + s}, p + "a" + s);
+        addNode(graph, "Relu", {p + "a" + s}, i == 2 ? "y" : p + "h" + std::to_string(i + 1));
+    }
+    addValueInfo(graph->add_output(), "y", TensorProto::FLOAT);
+    return model;
+}
+
+// Node indices of block i.
+std::vector<size_t> block(int i)
+{
+    return {static_cast<size_t>(1 + 3 * i), static_cast<size_t>(2 + 3 * i), static_cast<size_t>(3 + 3 * i)};
+}
+
+ModelFingerprint fingerprint(ModelProto const& model, int nbThreads = 0)
+{
+    ModelFingerprint fp(nbThreads);
+    std::string error;
+    EXPECT(fp.compute(model, &error));
+    return fp;
+}
+
+void testHashBytes()
+{
+    std::vector<char> buffer(300);
+    for (size_t i = 0; i < buffer.size(); ++i)
+    {
+        buffer[i] = static_cast<char>(i * 7);
+    }
+    std::vector<char> shifted(buffer.size() + 3);
+    std::memcpy(shifted.data() + 3, buffer.data(), buffer.size());
+    EXPECT(onnx2trt::hashBytes(buffer.data(), 257) == onnx2trt::hashBytes(shifted.data() + 3, 257));
+    EXPECT(onnx2trt::hashBytes(buffer.data(), 257) != onnx2trt::hashBytes(buffer.data(), 257, 1));
+
+    // Every prefix length, through the stripes, words and bytes, gives a different digest.
+    std::vector<Digest> digests;
+    for (size_t n = 0; n <= 100; ++n)
+    {
+        Digest const d = onnx2trt::hashBytes(buffer.data(), n);
+        for (auto const& other : digests)
+        {
+            EXPECT(d != other);
+        }
+        digests.push_back(d);
+    }
+    EXPECT(digests[0].hex().size() == 32);
+}
+
+void testNamesAndWeights()
+{
+    ModelFingerprint const base = fingerprint(makeModel());
+    ModelFingerprint const renamed = fingerprint(makeModel("stage0/"));
+    EXPECT(base.getModelDigest() == renamed.getModelDigest());
+    for (size_t i = 0; i < 10; ++i)
+    {
+        EXPECT(base.getNodeDigest(i) == renamed.getNodeDigest(i));
+        EXPECT(base.getConeDigest(i) == renamed.getConeDigest(i));
+    }
+
+    // Engines bind inputs by name.
+    EXPECT(fingerprint(makeModel("", "tokens")).getModelDigest() != base.getModelDigest());
+
+    ModelProto edited = makeModel();
+    TensorProto* w2 = edited.mutable_graph()->mutable_initializer(5);
+    EXPECT(w2->name() == "w2");
+    (*w2->mutable_raw_data())[100] ^= 1;
+    ModelFingerprint const e = fingerprint(edited);
+    EXPECT(e.getModelDigest() != base.getModelDigest());
+    EXPECT(e.getNodeDigest(7) != base.getNodeDigest(7));
+    EXPECT(e.getConeDigest(9) != base.getConeDigest(9));
+    EXPECT(e.getNodeDigest(8) == base.getNodeDigest(8));
+    for (size_t i = 0; i < 7; ++i)
+    {
+        EXPECT(e.getConeDigest(i) == base.getConeDigest(i));
+    }
+}
+
+void testBlocks()
+{
+    ModelProto const model = makeModel();
+    ModelFingerprint const fp = fingerprint(model);
+    for (size_t k = 0; k < 3; ++k)
+    {
+        EXPECT(fp.getNodeDigest(block(0)[k]) == fp.getNodeDigest(block(1)[k]));
+        EXPECT(fp.getConeDigest(block(0)[k]) != fp.getConeDigest(block(1)[k]));
+    }
+    EXPECT(fp.getNodeDigest(block(0)[0]) != fp.getNodeDigest(block(2)[0]));
+    EXPECT(fp.getSliceDigest(block(0)) == fp.getSliceDigest(block(1)));
+    EXPECT(fp.getSliceDigest(block(0)) != fp.getSliceDigest(block(2)));
+    // Wiring matters: the same nodes, but not consuming each other.
+    EXPECT(fp.getSliceDigest(block(0)) != fp.getSliceDigest({block(0)[0], block(1)[1], block(0)[2]}));
+
+    auto const duplicates = fp.getDuplicateTensors();
+    EXPECT(duplicates.size() == 2);
+    if (duplicates.size() == 2)
+    {
+        EXPECT(duplicates[0].size() == 2 && duplicates[1].size() == 2);
+    }
+    size_t total = 0;
+    for (auto const& initializer : model.graph().initializer())
+    {
+        total += initializer.raw_data().size();
+    }
+    size_t const shared = (kWidth * kWidth + kWidth) * sizeof(float);
+    EXPECT(fp.getNbHashedBytes() == total - shared);
+}
+
+void testThreads()
+{
+    ModelProto const model = makeModel();
+    ModelFingerprint const serial = fingerprint(model, 1);
+    ModelFingerprint const parallel = fingerprint(model, 8);
+    EXPECT(serial.getModelDigest() == parallel.getModelDigest());
+    TensorProto const& emb = model.graph().initializer(0);
+    EXPECT(emb.raw_data().size() > 2 * ModelFingerprint::kPARALLEL_BLOCK_BYTES);
+    EXPECT(serial.getTensorDigest(emb) == parallel.getTensorDigest(emb));
+    EXPECT(serial.getTensorDigest(emb) != Digest{});
+}
+
+void testExternalData()
+{
+    std::string const modelPath = "modelFingerprintTest.onnx";
+    std::string const dataPath = "modelFingerprintTest.bin";
+    ModelProto inlined = makeModel();
+    ModelProto external = inlined;
+    TensorProto* w0 = external.mutable_graph()->mutable_initializer(1);
+    {
+        std::ofstream data(dataPath, std::ios::binary);
+        data << "pad" << w0->raw_data();
+    }
+    auto addEntry = [&](std::string const& key, std::string const& value) {
+        auto* entry = w0->add_external_data();
+        entry->set_key(key);
+        entry->set_value(value);
+    };
+    addEntry("location", dataPath);
+    addEntry("offset", "3");
+    addEntry("length", std::to_string(w0->raw_data().size()));
+    w0->clear_raw_data();
+    w0->set_data_location(TensorProto::EXTERNAL);
+
+    onnx2trt::ExternalDataReader reader;
+    ModelFingerprint read(0, &reader, modelPath);
+    std::string error;
+    EXPECT(read.compute(external, &error));
+    EXPECT(read.getModelDigest() == fingerprint(inlined).getModelDigest());
+
+    // Without a reader the payload is identified by its range.
+    ModelFingerprint const unread = fingerprint(external);
+    EXPECT(unread.getModelDigest() != read.getModelDigest());
+    EXPECT(unread.getModelDigest() == fingerprint(external).getModelDigest());
+
+    std::remove(dataPath.c_str());
+    onnx2trt::ExternalDataReader missing;
+    ModelFingerprint failed(0, &missing, modelPath);
+    EXPECT(!failed.compute(external, &error));
+    EXPECT(!error.empty());
+}
+
+} // namespace
+
+int main()
+{
+    GOOGLE_PROTOBUF_VERIFY_VERSION;
+
+    testHashBytes();
+    testNamesAndWeights();
+    testBlocks();
+    testThreads();
+    testExternalData();
+
+    return testHarness::finishTests("model fingerprint");
+}
@@ -4,9 +4,12 @@
 
 #pragma once
 
+#include "ConstantFolding.hpp"
+#include "ExternalData.hpp"
 #include "NvOnnxParser.h"
 #include "ShapedWeights.hpp"
 #include "Status.hpp"
+#include "TensorMap.hpp"
 #include "TensorOrWeights.hpp"
 
 #include <NvInfer.h>
@@ -34,11 +37,25 @@ typedef std::function<NodeImportResult(
 template <typename T>
 using StringMap = std::unordered_map<std::string, T>;
 
+//! Source of initializers that were converted to TensorRT weights ahead of time, so that importing the same
+//! model into several networks does not convert them again.
+class IWeightsCache
+{
+public:
+    //! Return true and fill weights if initializer has already been converted.
+    virtual bool findWeights(::ONNX_NAMESPACE::TensorProto const& initializer, ShapedWeights* weights) const = 0;
+
+protected:
+    virtual ~IWeightsCache()
+    {
+    }
+};
+
 class IImporterContext
 {
 public:
     virtual nvinfer1::INetworkDefinition* network() = 0;
-    virtual StringMap<TensorOrWeights>& tensors() = 0;
+    virtual TensorMap& tensors() = 0;
     virtual StringMap<nvinfer1::TensorLocation>& tensorLocations() = 0;
     virtual StringMap<float>& tensorRangeMins() = 0;
     virtual StringMap<float>& tensorRangeMaxes() = 0;
@@ -47,11 +64,15 @@ public:
     virtual StringMap<std::string>& loopTensors() = 0;
     virtual void setOnnxFileLocation(std::string location) = 0;
     virtual std::string getOnnxFileLocation() = 0;
+    virtual IWeightsCache const* weightsCache() const = 0;
+    virtual ExternalDataReader& externalData() = 0;
+    virtual FoldedConstants const* foldedConstants() const = 0;
     virtual void registerTensor(TensorOrWeights tensor, const std::string& basename) = 0;
     virtual void registerLayer(nvinfer1::ILayer* layer, const std::string& basename) = 0;
     virtual ShapedWeights createTempWeights(ShapedWeights::DataType type, nvinfer1::Dims shape, uint8_t value = 0) = 0;
     virtual int64_t getOpsetVersion(const char* domain = "") const = 0;
     virtual nvinfer1::ILogger& logger() = 0;
+    virtual bool shouldLog(nvinfer1::ILogger::Severity severity) const = 0;
     virtual bool hasError() const = 0;
     virtual nvinfer1::IErrorRecorder* getErrorRecorder() const = 0;
 
@@ -4,6 +4,7 @@
 
 #include "onnx2trt_utils.hpp"
 #include "OnnxAttrs.hpp"
+#include <atomic>
 #include <set>
 
 namespace onnx2trt
@@ -356,13 +357,13 @@ bool convertDtype(int32_t onnx_dtype, nvinfer1::DataType* trt_dtype)
 
 int32_t* convertINT64(const int64_t* weightValues, nvinfer1::Dims shape, IImporterContext* ctx)
 {
-    static bool logged = false;
-    if (!logged)
+    // Weights may be converted from several threads at once (see PreparedWeights).
+    static std::atomic<bool> logged{false};
+    if (!logged.exchange(true))
     {
         LOG_WARNING(
             "Your ONNX model has been generated with INT64 weights, while TensorRT does not natively support INT64. "
             "Attempting to cast down to INT32.");
-        logged = true;
     }
 
     const size_t nbWeights = volume(shape);
@@ -571,14 +572,13 @@ int32_t* convertUINT8(const uint8_t* weightValues, nvinfer1::Dims shape, IImport
 
 float* convertDouble(const double* weightValues, nvinfer1::Dims shape, IImporterContext* ctx)
 {
-    static bool logged = false;
-    if (!logged)
+    static std::atomic<bool> logged{false};
+    if (!logged.exchange(true))
     {
         LOG_WARNING(
             "Your ONNX model has been generated with double-typed weights, while TensorRT does not natively support "
             "double. "
             "Attempting to cast down to float.");
-        logged = true;
     }
     const size_t nbWeights = volume(shape);
     float* floatWeights{
@@ -623,88 +623,69 @@ bool convertOnnxWeights(
     // External Data
     if (dataLocation == 1)
     {
-        std::string location{""};
-        int64_t offset{0};
-        int64_t length{0};
-
-        // onnxTensor.external_data() is a String : String map that holds metadata about how to read from an external
-        // file
-        for (auto onnxMapEntry : onnxTensor.external_data())
+        ExternalDataRange range;
+        std::string error;
+        if (!getExternalDataRange(onnxTensor, ctx->getOnnxFileLocation(), &range, &error))
         {
-            auto keyName = onnxMapEntry.key();
-            if (keyName == "location")
-            {
-                location = onnxMapEntry.value();
-            }
-            else if (keyName == "offset")
-            {
-                offset = std::atoll(onnxMapEntry.value().c_str());
-            }
-            else if (keyName == "length")
-            {
-                length = std::atoll(onnxMapEntry.value().c_str());
-            }
-            // Not used at the moment
-            else if (keyName == "checksum")
-            {
-                continue;
-            }
-            else
-            {
-                LOG_ERROR("Key value of: " << keyName << " was not expected!");
-                return false;
-            }
+            LOG_ERROR(error);
+            return false;
         }
 
-        // Buffer to hold the data read from the file
-        std::vector<char> dataBuf;
-        // Will update dataBuf and nbytes by reference.
-        if (!parseExternalWeights(ctx, location, ctx->getOnnxFileLocation(), offset, length, dataBuf, nbytes))
+        // The reader keeps the bytes alive for the lifetime of the importer context, so in the common case the
+        // weights can point straight into its buffer instead of being copied.
+        char const* data{nullptr};
+        if (!ctx->externalData().read(range, &data, &nbytes, &error))
         {
+            LOG_ERROR(error);
             return false;
         }
+        LOG_VERBOSE("Read " << nbytes << " bytes of weights from external file: " << range.path);
+
         shape.nbDims = onnxTensor.dims().size();
         std::copy(onnxTensor.dims().begin(), onnxTensor.dims().end(), shape.d);
+        const int elementSize = getDtypeSize(onnxDtype);
+        if (elementSize <= 0)
+        {
+            LOG_ERROR("Unsupported data type for external weights of " << onnxTensor.name());
+            return false;
+        }
+        if (nbytes != static_cast<size_t>(volume(shape)) * elementSize)
+        {
+            LOG_ERROR("External data for " << onnxTensor.name() << " has " << nbytes << " bytes, expected "
+                                           << static_cast<size_t>(volume(shape)) * elementSize);
+            return false;
+        }
 
-        // For weights parsed from external files, createTempWeights is necessary to keep them in scope
-        ShapedWeights externalWeights;
+        // Tensors packed by exporters are not necessarily aligned to their element size.
+        if (reinterpret_cast<uintptr_t>(data) % elementSize != 0)
+        {
+            void* aligned = ctx->createTempWeights(onnxDtype, shape).values;
+            std::memcpy(aligned, data, nbytes);
+            data = static_cast<char const*>(aligned);
+        }
 
         // Cast non-native TRT types to their corresponding proxy types
         if (onnxDtype == ::ONNX_NAMESPACE::TensorProto::INT64)
         {
-            dataPtr = dataBuf.data();
-            dataPtr = convertINT64(reinterpret_cast<const int64_t*>(dataPtr), shape, ctx);
-            nbytes = nbytes / (sizeof(int64_t) / sizeof(int32_t));
+            dataPtr = convertINT64(reinterpret_cast<const int64_t*>(data), shape, ctx);
             onnxDtype = ::ONNX_NAMESPACE::TensorProto::INT32;
-            externalWeights = ctx->createTempWeights(onnxDtype, shape);
-            std::memcpy(externalWeights.values, dataPtr, nbytes);
         }
         else if (onnxDtype == ::ONNX_NAMESPACE::TensorProto::UINT8)
         {
-            dataPtr = dataBuf.data();
-            dataPtr = convertUINT8(reinterpret_cast<const uint8_t*>(dataPtr), shape, ctx);
-            nbytes = nbytes * (sizeof(int32_t) / sizeof(uint8_t));
+            dataPtr = convertUINT8(reinterpret_cast<const uint8_t*>(data), shape, ctx);
             onnxDtype = ::ONNX_NAMESPACE::TensorProto::INT32;
-            externalWeights = ctx->createTempWeights(onnxDtype, shape);
-            std::memcpy(externalWeights.values, dataPtr, nbytes);
         }
         else if (onnxDtype == ::ONNX_NAMESPACE::TensorProto::DOUBLE)
         {
-            dataPtr = dataBuf.data();
-            dataPtr = convertDouble(reinterpret_cast<const double*>(dataPtr), shape, ctx);
-            nbytes = nbytes / (sizeof(double) / sizeof(float));
+            dataPtr = convertDouble(reinterpret_cast<const double*>(data), shape, ctx);
             onnxDtype = ::ONNX_NAMESPACE::TensorProto::FLOAT;
-            externalWeights = ctx->createTempWeights(onnxDtype, shape);
-            std::memcpy(externalWeights.values, dataPtr, nbytes);
         }
-        // Copy weight values directly to externalWeights
         else
         {
-            externalWeights = ctx->createTempWeights(onnxDtype, shape);
-            std::memcpy(externalWeights.values, dataBuf.data(), nbytes);
+            dataPtr = const_cast<char*>(data);
         }
 
-        *weights = externalWeights;
+        *weights = onnx2trt::ShapedWeights(onnxDtype, dataPtr, shape);
         return true;
     }
     // Weights information is within the TensorProto itself
@@ -1176,14 +1157,14 @@ void getKernelParams(IImporterContext* ctx, ::ONNX_NAMESPACE::NodeProto const& o
     {
         if (attrs.count("pads"))
         {
-            auto onnx_padding = attrs.get<std::vector<int>>("pads");
+            auto const& onnx_padding = attrs.ints("pads");
             int ndim = onnx_padding.size() / 2;
             for (int i = 0; i < nbSpatialDims; ++i)
             {
                 if (i < ndim)
                 {
-                    beg_padding->d[i] = onnx_padding.at(i);
-                    end_padding->d[i] = onnx_padding.at(i + ndim);
+                    beg_padding->d[i] = onnx_padding.Get(i);
+                    end_padding->d[i] = onnx_padding.Get(i + ndim);
                 }
                 else
                 {
@@ -1589,43 +1570,6 @@ nvinfer1::Dims insertDimension(const nvinfer1::Dims& dims, const int axis, const
     return newDims;
 }
 
-bool parseExternalWeights(IImporterContext* ctx, std::string file, std::string path, int64_t offset, int64_t length,
-    std::vector<char>& weightsBuf, size_t& size)
-{
-    // The weight paths in the ONNX model are relative paths to the main ONNX file.
-#ifdef _MSC_VER
-    size_t slash = path.rfind("\\");
-#else
-    size_t slash = path.rfind("/");
-#endif
-    if (slash != std::string::npos)
-    {
-        path.replace(slash + 1, path.size() - (slash + 1), file);
-    }
-    else
-    {
-        path = file;
-    }
-    std::ifstream relPathFile(path, std::ios::binary | std::ios::ate);
-    if (!relPathFile)
-    {
-        LOG_ERROR("Failed to open file: " << path);
-        return false;
-    }
-    std::streamsize fileSize = relPathFile.tellg();
-    relPathFile.seekg(offset, std::ios::beg);
-    int64_t weightsBufSize = length == 0 ? fileSize : length;
-    weightsBuf.resize(weightsBufSize);
-    LOG_VERBOSE("Reading weights from external file: " << path);
-    if (!relPathFile.read(weightsBuf.data(), weightsBuf.size()))
-    {
-        LOG_ERROR("Failed to read weights from external file: " << path);
-        return false;
-    }
-    size = weightsBuf.size();
-    return true;
-}
-
 NodeImportResult poolingHelper(IImporterContext* ctx, ::ONNX_NAMESPACE::NodeProto const& node,
     std::vector<TensorOrWeights>& inputs, nvinfer1::PoolingType type)
 {
@@ -2101,6 +2045,44 @@ NodeImportResult unaryHelper(
     return {{tensorPtr}};
 }
 
+bool prefetchExternalWeights(IImporterContext* ctx, const ::ONNX_NAMESPACE::GraphProto& graph)
+{
+    IWeightsCache const* weightsCache = ctx->weightsCache();
+    std::vector<ExternalDataRange> ranges;
+    for (const ::ONNX_NAMESPACE::TensorProto& initializer : graph.initializer())
+    {
+        ShapedWeights cached;
+        if (initializer.data_location() != ::ONNX_NAMESPACE::TensorProto::EXTERNAL
+            || (weightsCache && weightsCache->findWeights(initializer, &cached)))
+        {
+            continue;
+        }
+        ExternalDataRange range;
+        std::string error;
+        if (!getExternalDataRange(initializer, ctx->getOnnxFileLocation(), &range, &error))
+        {
+            LOG_ERROR(error);
+            return false;
+        }
+        ranges.push_back(std::move(range));
+    }
+    if (ranges.empty())
+    {
+        return true;
+    }
+
+    std::string error;
+    if (!ctx->externalData().prefetch(ranges, &error))
+    {
+        LOG_ERROR(error);
+        return false;
+    }
+    LOG_VERBOSE("Prefetched external data for " << ranges.size() << " initializers with "
+                                                << ctx->externalData().getNbReads() << " reads from "
+                                                << ctx->externalData().getNbOpenFiles() << " files");
+    return true;
+}
+
 NodeImportResult convDeconvMultiInput(
     IImporterContext* ctx, const ::ONNX_NAMESPACE::NodeProto& node, std::vector<TensorOrWeights>& inputs, bool isConv)
 {
@@ -2304,8 +2286,8 @@ void decodeOnnxStartsAndEnds(IImporterContext* ctx, const ShapeTensor& inputDims
 
 ShapeTensor axesToInterlaceSubscripts(const ShapeTensor& axes, int nbDims)
 {
-    std::vector<int64_t> subscripts(nbDims);
-    std::iota(subscripts.begin(), subscripts.end(), 0);
+    ShapeValues subscripts(nbDims, 0);
+    std::iota(subscripts.data(), subscripts.data() + nbDims, 0);
     for (int32_t i = 0; i < axes.size(); ++i)
     {
         subscripts[axes[i]] = nbDims + i;
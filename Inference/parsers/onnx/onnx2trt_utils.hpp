@@ -21,10 +21,13 @@
 #define LOG(msg, severity)                                                                                             \
     do                                                                                                                 \
     {                                                                                                                  \
-        std::stringstream ss{};                                                                                        \
-        if (severity <= nvinfer1::ILogger::Severity::kWARNING) ss << __FILENAME__ << ":" << __LINE__ << ": ";          \
-        ss << msg;                                                                                                     \
-        ctx->logger().log(severity, ss.str().c_str());                                                                 \
+        if (ctx->shouldLog(severity))                                                                                  \
+        {                                                                                                              \
+            std::stringstream ss{};                                                                                    \
+            if (severity <= nvinfer1::ILogger::Severity::kWARNING) ss << __FILENAME__ << ":" << __LINE__ << ": ";      \
+            ss << msg;                                                                                                 \
+            ctx->logger().log(severity, ss.str().c_str());                                                             \
+        }                                                                                                              \
     } while (0)
 
 #define LOG_VERBOSE(msg) LOG(msg, nvinfer1::ILogger::Severity::kVERBOSE)
@@ -189,6 +192,10 @@ nvinfer1::ITensor* createZeroTensor(IImporterContext* ctx, nvinfer1::ITensor* da
 bool convertOnnxWeights(
     const ::ONNX_NAMESPACE::TensorProto& onnxTensor, onnx2trt::ShapedWeights* weights, IImporterContext* ctx);
 
+// Helper function to read the external data of all initializers in a graph up front, so that neighbouring tensors
+// are fetched with a single read. Initializers already held by the context's weights cache are skipped.
+bool prefetchExternalWeights(IImporterContext* ctx, const ::ONNX_NAMESPACE::GraphProto& graph);
+
 // Helper function to convert multi input convolution/deconvolution
 NodeImportResult convDeconvMultiInput(
     IImporterContext* ctx, const ::ONNX_NAMESPACE::NodeProto& node, std::vector<TensorOrWeights>& inputs, bool isConv);
@@ -277,10 +284,6 @@ NodeImportResult lstmLegacyImporter(
 // Helper function to create and fill a Dims object with defined values
 nvinfer1::Dims makeDims(int nbDims, int val);
 
-// Helper function to read weights from an external file
-bool parseExternalWeights(IImporterContext* ctx, std::string file, std::string path, int64_t offset, int64_t length,
-    std::vector<char>& weightsBuf, size_t& size);
-
 // Helper function to map various ONNX pooling ops into TensorRT.
 NodeImportResult poolingHelper(IImporterContext* ctx, ::ONNX_NAMESPACE::NodeProto const& node,
     std::vector<TensorOrWeights>& inputs, nvinfer1::PoolingType type);
@@ -0,0 +1,197 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <unistd.h> // For ::getopt
+#include <vector>
+#include "OnnxAttrs.hpp"
+#include "onnx2trt_utils.hpp"
+
+using std::cout;
+using std::cerr;
+using std::endl;
+
+void print_usage() {
+  cout << "This program measures the attribute decoding that the ONNX importer does for a ResNet-50 style graph of" << endl;
+  cout << "Conv, BatchNormalization, Relu, pooling and Gemm nodes." << endl;
+  cout << "Usage: onnxAttrsBenchmark [-n iterations (default 2000)] [-b bottleneck blocks (default 16)]" << endl;
+}
+
+namespace
+{
+
+using ::ONNX_NAMESPACE::AttributeProto;
+using ::ONNX_NAMESPACE::NodeProto;
+
+void addInts(NodeProto* node, const std::string& name, std::vector<int64_t> const& values)
+{
+    auto* attr = node->add_attribute();
+    attr->set_name(name);
+    attr->set_type(AttributeProto::INTS);
+    for (int64_t v : values)
+    {
+        attr->add_ints(v);
+    }
+}
+
+void addInt(NodeProto* node, const std::string& name, int64_t value)
+{
+    auto* attr = node->add_attribute();
+    attr->set_name(name);
+    attr->set_type(AttributeProto::INT);
+    attr->set_i(value);
+}
+
+void addFloat(NodeProto* node, const std::string& name, float value)
+{
+    auto* attr = node->add_attribute();
+    attr->set_name(name);
+    attr->set_type(AttributeProto::FLOAT);
+    attr->set_f(value);
+}
+
+NodeProto conv(int64_t kernel, int64_t stride)
+{
+    NodeProto node;
+    node.set_op_type("Conv");
+    addInts(&node, "dilations", {1, 1});
+    addInt(&node, "group", 1);
+    addInts(&node, "kernel_shape", {kernel, kernel});
+    addInts(&node, "pads", {kernel / 2, kernel / 2, kernel / 2, kernel / 2});
+    addInts(&node, "strides", {stride, stride});
+    return node;
+}
+
+NodeProto batchNorm()
+{
+    NodeProto node;
+    node.set_op_type("BatchNormalization");
+    addFloat(&node, "epsilon", 1e-5f);
+    addFloat(&node, "momentum", 0.9f);
+    return node;
+}
+
+NodeProto relu()
+{
+    NodeProto node;
+    node.set_op_type("Relu");
+    return node;
+}
+
+std::vector<NodeProto> makeGraph(int nbBlocks)
+{
+    std::vector<NodeProto> nodes{conv(7, 2), batchNorm(), relu()};
+    NodeProto pool;
+    pool.set_op_type("MaxPool");
+    addInts(&pool, "kernel_shape", {3, 3});
+    addInts(&pool, "pads", {1, 1, 1, 1});
+    addInts(&pool, "strides", {2, 2});
+    nodes.push_back(pool);
+    for (int i = 0; i < nbBlocks; ++i)
+    {
+        for (auto const& layer : {conv(1, 1), conv(3, i % 4 == 0 ? 2 : 1), conv(1, 1)})
+        {
+            nodes.push_back(layer);
+            nodes.push_back(batchNorm());
+            nodes.push_back(relu());
+        }
+    }
+    NodeProto gemm;
+    gemm.set_op_type("Gemm");
+    addFloat(&gemm, "alpha", 1.f);
+    addFloat(&gemm, "beta", 1.f);
+    addInt(&gemm, "transB", 1);
+    nodes.push_back(gemm);
+    return nodes;
+}
+
+// The attribute lookups of the importers of these ops; returns a checksum of the decoded values.
+int64_t importAttributes(NodeProto const& node)
+{
+    // No context: none of these lookups needs one.
+    onnx2trt::IImporterContext* const ctx = nullptr;
+    int64_t sum = 0;
+    if (node.op_type() == "Conv" || node.op_type() == "MaxPool")
+    {
+        nvinfer1::Dims kernelSize{2, {1, 1}};
+        nvinfer1::Dims strides{2, {1, 1}};
+        nvinfer1::Dims begPadding{2, {0, 0}};
+        nvinfer1::Dims endPadding{2, {0, 0}};
+        nvinfer1::Dims dilations{2, {1, 1}};
+        nvinfer1::PaddingMode paddingMode;
+        bool excludePadding = true;
+        OnnxAttrs attrs(node, ctx);
+        const bool ceilMode = attrs.get("ceil_mode", 0) != 0;
+        onnx2trt::getKernelParams(ctx, node, &kernelSize, &strides, &begPadding, &endPadding, paddingMode,
+            excludePadding, node.op_type() == "Conv" ? &dilations : nullptr, nullptr, ceilMode);
+        sum += kernelSize.d[0] + strides.d[1] + begPadding.d[0] + endPadding.d[1] + dilations.d[0]
+            + static_cast<int>(paddingMode) + attrs.get("group", 1);
+    }
+    else if (node.op_type() == "BatchNormalization")
+    {
+        OnnxAttrs attrs(node, ctx);
+        sum += static_cast<int64_t>(1 / attrs.get<float>("epsilon", 1e-5f));
+    }
+    else if (node.op_type() == "Gemm")
+    {
+        OnnxAttrs attrs(node, ctx);
+        sum += attrs.get("alpha", 1.f) + attrs.get("beta", 1.f) + attrs.get("transA", false) + attrs.get("transB", false);
+    }
+    else
+    {
+        OnnxAttrs attrs(node, ctx);
+        sum += attrs.count("trt_outputs_range_min");
+    }
+    return sum;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    GOOGLE_PROTOBUF_VERIFY_VERSION;
+
+    int iterations = 2000;
+    int nbBlocks = 16;
+    int c;
+    while ((c = getopt (argc, argv, "n:b:h")) != -1)
+    {
+        switch(c)
+        {
+            case 'n':
+                    iterations = atoi(optarg);
+                    break;
+            case 'b':
+                    nbBlocks = atoi(optarg);
+                    break;
+            default:
+                    print_usage();
+                    return c == 'h' ? 0 : -1;
+        }
+    }
+    if (iterations <= 0 || nbBlocks <= 0)
+    {
+        print_usage();
+        return -1;
+    }
+
+    const std::vector<NodeProto> nodes = makeGraph(nbBlocks);
+    int64_t sum = 0;
+    const auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < iterations; ++i)
+    {
+        for (auto const& node : nodes)
+        {
+            sum += importAttributes(node);
+        }
+    }
+    const std::chrono::duration<double, std::micro> elapsed = std::chrono::high_resolution_clock::now() - start;
+    cout << "Graph:        " << nodes.size() << " nodes" << endl;
+    cout << "Checksum:     " << sum / iterations << endl;
+    cout << "Attributes:   " << elapsed.count() / iterations << " us per graph, "
+         << elapsed.count() * 1000 / iterations / nodes.size() << " ns per node" << endl;
+    return 0;
+}
@@ -0,0 +1,135 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <unistd.h> // For ::getopt
+#include <vector>
+#include "NvOnnxParser.h"
+#include "CostModel.hpp"
+#include "common.hpp"
+
+using std::cout;
+using std::cerr;
+using std::endl;
+
+void print_usage() {
+  cout << "This program estimates FLOPs and bytes of an ONNX model on the CPU and reports the cost of splitting it" << endl;
+  cout << "into two stages at each candidate position, to prune the exit placement search before profiling." << endl;
+  cout << "Usage: onnxCostModel -m onnx_model.pb" << "\n"
+       << "                [-b batch_sizes] (comma-separated, default 1)" << "\n"
+       << "                [-x max_boundary_tensors] (candidate cuts are crossed by at most this many, default 1)" << "\n"
+       << "                [-d name=value] (value of a symbolic dimension, may be repeated)" << "\n"
+       << "                [-a] (report every cut, not only candidates)" << "\n"
+       << "                [-l] (list per-node costs)" << "\n"
+       << "                [-h] (show help)" << endl;
+}
+
+std::vector<int64_t> parse_batch_sizes(std::string const& list) {
+  std::vector<int64_t> batch_sizes;
+  std::stringstream ss(list);
+  std::string item;
+  while (std::getline(ss, item, ',')) {
+    int64_t b = atoll(item.c_str());
+    if (b <= 0) {
+      return {};
+    }
+    batch_sizes.push_back(b);
+  }
+  return batch_sizes;
+}
+
+int main(int argc, char* argv[]) {
+  GOOGLE_PROTOBUF_VERIFY_VERSION;
+
+  std::string onnx_filename;
+  std::vector<int64_t> batch_sizes{1};
+  size_t max_boundary_tensors = 1;
+  bool print_all_cuts = false;
+  bool print_layer_info = false;
+  onnx2trt::CostModelOptions options;
+
+  int arg = 0;
+  while ((arg = ::getopt(argc, argv, "m:b:x:d:alh")) != -1) {
+    switch (arg) {
+    case 'm': onnx_filename = optarg; break;
+    case 'b':
+      batch_sizes = parse_batch_sizes(optarg);
+      if (batch_sizes.empty()) { cerr << "ERROR: Invalid batch sizes: " << optarg << endl; return -1; }
+      break;
+    case 'x': max_boundary_tensors = atoll(optarg); break;
+    case 'd': {
+      std::string const def = optarg;
+      size_t const eq = def.find('=');
+      if (eq == std::string::npos) { cerr << "ERROR: -d flag requires name=value" << endl; return -1; }
+      options.dimParams[def.substr(0, eq)] = atoll(def.c_str() + eq + 1);
+      break;
+    }
+    case 'a': print_all_cuts = true; break;
+    case 'l': print_layer_info = true; break;
+    case 'h': print_usage(); return 0;
+    default: print_usage(); return -1;
+    }
+  }
+
+  if (onnx_filename.empty()) {
+    print_usage();
+    return -1;
+  }
+
+  ::ONNX_NAMESPACE::ModelProto onnx_model;
+  bool is_binary = common::ParseFromFile_WAR(&onnx_model, onnx_filename.c_str());
+  if (!is_binary && !common::ParseFromTextFile(&onnx_model, onnx_filename.c_str())) {
+    cerr << "Failed to parse ONNX model" << endl;
+    return -3;
+  }
+
+  onnx2trt::ModelCost cost;
+  std::string error;
+  if (!cost.analyze(onnx_model, options, &error)) {
+    cerr << "ERROR: " << error << endl;
+    return -4;
+  }
+
+  if (print_layer_info) {
+    cout << "index,name,op,flops_per_sample,param_bytes,activation_bytes_per_sample,shapes_known" << endl;
+    auto const& nodes = cost.getNodes();
+    for (size_t i = 0; i < nodes.size(); ++i) {
+      auto const& n = nodes[i];
+      cout << i << "," << n.name << "," << n.opType << "," << n.flops << "," << n.paramBytes << ","
+           << n.activationBytes << "," << (n.shapesKnown ? 1 : 0) << endl;
+    }
+    cout << endl;
+  }
+
+  // The compaction estimate assumes every sample survives, which bounds the copy cost from above.
+  std::vector<onnx2trt::CutPoint> const cuts = print_all_cuts ? cost.getCutPoints()
+                                                              : cost.getCandidates(max_boundary_tensors);
+  double const total_flops = cost.getTotalFlops();
+  cout << "position,after_node,boundary_tensors,batch_size,boundary_bytes,prefix_flops,suffix_flops,"
+       << "prefix_flops_fraction,prefix_param_bytes,suffix_param_bytes,compaction_bytes" << endl;
+  for (auto const& cut : cuts) {
+    std::string boundary;
+    for (auto const& name : cut.boundaryTensors) {
+      boundary += (boundary.empty() ? "" : ";") + name;
+    }
+    if (!cut.boundaryKnown) {
+      boundary += "(?)";
+    }
+    for (int64_t b : batch_sizes) {
+      double const batch = static_cast<double>(b);
+      cout << cut.position << "," << cost.getNodes()[cut.position - 1].name << "," << boundary << "," << b << ","
+           << cut.boundaryBytes * b << "," << cut.prefixFlops * batch << ","
+           << (total_flops - cut.prefixFlops) * batch << ","
+           << (total_flops > 0 ? cut.prefixFlops / total_flops : 0.) << "," << cut.prefixParamBytes << ","
+           << cost.getTotalParamBytes() - cut.prefixParamBytes << ","
+           << onnx2trt::ModelCost::getCompactionBytes(cut, b) << endl;
+    }
+  }
+  cerr << cuts.size() << " of " << cost.getCutPoints().size() << " cut points reported, "
+       << cost.getNodes().size() << " nodes, " << total_flops << " FLOPs per sample" << endl;
+  return 0;
+}
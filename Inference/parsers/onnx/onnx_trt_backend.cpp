@@ -6,6 +6,7 @@
 #include "onnx/onnxifi.h"
 #include <NvInfer.h>
 #include <atomic>
+#include <cstdlib>
 #include <ctime>
 #include <cuda_runtime.h>
 #include <mutex>
@@ -591,6 +592,53 @@ onnxStatus OnnxifiTryCatch(F&& tryBlock)
         return ONNXIFI_STATUS_INTERNAL_ERROR;
     }
 }
+
+// supportsModel() verdicts shared by every compatibility check of the process. If ONNX_TRT_SUPPORT_CACHE names a
+// file, the verdicts are loaded from it on first use and written back whenever a check adds some.
+class SupportCacheHolder
+{
+public:
+    static SupportCacheHolder& instance()
+    {
+        static SupportCacheHolder holder;
+        return holder;
+    }
+
+    nvonnxparser::ISupportCache* get()
+    {
+        return cache_.get();
+    }
+
+    void persist()
+    {
+        if (!path_)
+        {
+            return;
+        }
+        std::lock_guard<std::mutex> guard(mutex_);
+        const int entries = cache_->getNbEntries();
+        if (entries != saved_entries_ && cache_->save(path_))
+        {
+            saved_entries_ = entries;
+        }
+    }
+
+private:
+    SupportCacheHolder()
+        : cache_(infer_object(nvonnxparser::createSupportCache()))
+        , path_(std::getenv("ONNX_TRT_SUPPORT_CACHE"))
+    {
+        if (path_ && cache_->load(path_))
+        {
+            saved_entries_ = cache_->getNbEntries();
+        }
+    }
+
+    std::shared_ptr<nvonnxparser::ISupportCache> cache_;
+    const char* path_;
+    int saved_entries_{0};
+    std::mutex mutex_;
+};
 } // namespace
 
 ONNXIFI_PUBLIC ONNXIFI_CHECK_RESULT onnxStatus ONNXIFI_ABI onnxGetBackendIDs(
@@ -895,9 +943,16 @@ ONNXIFI_PUBLIC ONNXIFI_CHECK_RESULT onnxStatus ONNXIFI_ABI onnxGetBackendCompati
 
         TRT_Logger trt_logger;
         std::shared_ptr<nvinfer1::IBuilder> trt_builder = infer_object(nvinfer1::createInferBuilder(trt_logger));
-        std::shared_ptr<nvinfer1::INetworkDefinition> trt_network = infer_object(trt_builder->createNetwork());
+        // The parser only imports into explicit batch networks.
+        std::shared_ptr<nvinfer1::INetworkDefinition> trt_network = infer_object(trt_builder->createNetworkV2(
+            1U << static_cast<uint32_t>(nvinfer1::NetworkDefinitionCreationFlag::kEXPLICIT_BATCH)));
         auto parser = infer_object(nvonnxparser::createParser(*trt_network, trt_logger));
-        if (parser->supportsModel(onnxModel, onnxModelSize))
+        SupportCacheHolder& support_cache = SupportCacheHolder::instance();
+        parser->setSupportCache(support_cache.get());
+        SubGraphCollection_t sub_graph_collection;
+        const bool supported = parser->supportsModel(onnxModel, onnxModelSize, sub_graph_collection);
+        support_cache.persist();
+        if (supported)
         {
             return ONNXIFI_STATUS_SUCCESS;
         }
@@ -0,0 +1,254 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <unistd.h> // For ::getopt
+#include <vector>
+#include <onnx/optimizer/optimize.h>
+
+using std::cout;
+using std::cerr;
+using std::endl;
+
+namespace opt = ::ONNX_NAMESPACE::optimization;
+
+void print_usage() {
+  cout << "This program measures how long the fixed-point ONNX optimizer (onnx2trt -F) takes on synthetic deep graphs." << endl;
+  cout << "Usage: optimizerBenchmark [-b blocks (default 2000)] [-d every (default 1)] [-n iterations (default 5)] [-O passes]" << endl;
+  cout << "  -d  Put exporter debris in every d-th block only; the other blocks give the passes nothing to do." << endl;
+  cout << "Times are CPU time of the process, so that other load on the machine does not count." << endl;
+}
+
+// The fixed-point driver as it was before it became incremental: every pass rescans the whole graph, and only
+// partially efficient passes are repeated.
+class RescanPassManager : public opt::GeneralPassManager {
+public:
+  std::shared_ptr<opt::PassManagerAnalysis> run(::ONNX_NAMESPACE::Graph& graph) override {
+    bool fixed_point_optimization_done;
+    do {
+      fixed_point_optimization_done = false;
+      for (std::shared_ptr<opt::Pass> pass : this->passes) {
+        auto analysis = pass->runPass(graph);
+        if (pass->getPassAnalysisType() == opt::PassAnalysisType::Empty) {
+          continue;
+        }
+        auto count_analysis = std::static_pointer_cast<opt::CountBasedPassAnalysis>(analysis);
+        while (count_analysis->fixedPointOptimizationNeeded()) {
+          count_analysis = std::static_pointer_cast<opt::CountBasedPassAnalysis>(pass->runPass(graph));
+          fixed_point_optimization_done = true;
+        }
+      }
+    } while (fixed_point_optimization_done);
+    return std::shared_ptr<opt::PassManagerAnalysis>(new opt::EmptyPassManagerAnalysis());
+  }
+};
+
+// Reference result: the whole pass list is rerun until the node count stops changing.
+class ConvergingPassManager : public opt::GeneralPassManager {
+public:
+  std::shared_ptr<opt::PassManagerAnalysis> run(::ONNX_NAMESPACE::Graph& graph) override {
+    size_t nb_nodes = count_nodes(graph) + 1;
+    while (count_nodes(graph) != nb_nodes) {
+      nb_nodes = count_nodes(graph);
+      opt::GeneralPassManager::run(graph);
+    }
+    return std::shared_ptr<opt::PassManagerAnalysis>(new opt::EmptyPassManagerAnalysis());
+  }
+
+  static size_t count_nodes(::ONNX_NAMESPACE::Graph& graph) {
+    size_t n = 0;
+    for (auto it = graph.begin(); it != graph.end(); ++it) {
+      ++n;
+    }
+    return n;
+  }
+};
+
+::ONNX_NAMESPACE::NodeProto* add_node(::ONNX_NAMESPACE::GraphProto* graph, std::string const& op,
+                                      std::vector<std::string> const& inputs, std::string const& output) {
+  auto* node = graph->add_node();
+  node->set_op_type(op);
+  for (auto const& input : inputs) {
+    node->add_input(input);
+  }
+  node->add_output(output);
+  return node;
+}
+
+void add_perm(::ONNX_NAMESPACE::NodeProto* node, std::vector<int64_t> const& perm) {
+  auto* attr = node->add_attribute();
+  attr->set_name("perm");
+  attr->set_type(::ONNX_NAMESPACE::AttributeProto::INTS);
+  for (int64_t p : perm) {
+    attr->add_ints(p);
+  }
+}
+
+// A chain of blocks shaped like an exported transformer layer: mostly ops no pass touches, plus, in every
+// debris_every-th block, exporter debris (Identity, Dropout with ratio 0, transposes that cancel out, nested Concats)
+// that takes several rewrites to clean up.
+::ONNX_NAMESPACE::ModelProto make_model(int nb_blocks, int debris_every) {
+  ::ONNX_NAMESPACE::ModelProto model;
+  model.set_ir_version(4);
+  model.add_opset_import()->set_version(9);
+  auto* graph = model.mutable_graph();
+  auto* input = graph->add_input();
+  input->set_name("x0");
+  input->mutable_type()->mutable_tensor_type()->set_elem_type(::ONNX_NAMESPACE::TensorProto::FLOAT);
+
+  std::string x = "x0";
+  for (int i = 0; i < nb_blocks; ++i) {
+    std::string const b = "_" + std::to_string(i);
+    add_node(graph, "MatMul", {x, x}, "mm" + b);
+    if (i % debris_every != 0) {
+      add_node(graph, "Softmax", {"mm" + b}, "sm" + b);
+      add_node(graph, "Relu", {"sm" + b}, "relu" + b);
+      add_node(graph, "Mul", {"relu" + b, x}, "mul" + b);
+      add_node(graph, "Add", {"mul" + b, x}, "add" + b);
+      add_node(graph, "Tanh", {"add" + b}, "x" + std::to_string(i + 1));
+      x = "x" + std::to_string(i + 1);
+      continue;
+    }
+    add_node(graph, "Identity", {"mm" + b}, "id" + b);
+    add_perm(add_node(graph, "Transpose", {"id" + b}, "t1" + b), {0, 2, 1});
+    add_perm(add_node(graph, "Transpose", {"t1" + b}, "t2" + b), {0, 2, 1});
+    add_node(graph, "Softmax", {"t2" + b}, "sm" + b);
+    auto* dropout = add_node(graph, "Dropout", {"sm" + b}, "do" + b);
+    auto* ratio = dropout->add_attribute();
+    ratio->set_name("ratio");
+    ratio->set_type(::ONNX_NAMESPACE::AttributeProto::FLOAT);
+    ratio->set_f(0.f);
+    auto* inner = add_node(graph, "Concat", {"do" + b, x}, "c1" + b);
+    auto* outer = add_node(graph, "Concat", {"c1" + b, x}, "c2" + b);
+    for (auto* concat : {inner, outer}) {
+      auto* axis = concat->add_attribute();
+      axis->set_name("axis");
+      axis->set_type(::ONNX_NAMESPACE::AttributeProto::INT);
+      axis->set_i(0);
+    }
+    add_node(graph, "Relu", {"c2" + b}, "relu" + b);
+    add_node(graph, "Mul", {"relu" + b, x}, "mul" + b);
+    add_node(graph, "Add", {"mul" + b, x}, "add" + b);
+    add_node(graph, "Tanh", {"add" + b}, "x" + std::to_string(i + 1));
+    x = "x" + std::to_string(i + 1);
+  }
+  graph->add_output()->set_name(x);
+  return model;
+}
+
+struct RunResult {
+  std::vector<double> times_ms;
+  size_t nb_nodes = 0;
+
+  double min_ms() const {
+    return *std::min_element(times_ms.begin(), times_ms.end());
+  }
+  double median_ms() const {
+    std::vector<double> sorted = times_ms;
+    std::sort(sorted.begin(), sorted.end());
+    return sorted[sorted.size() / 2];
+  }
+};
+
+void time_manager(opt::PassManager& manager, ::ONNX_NAMESPACE::ModelProto const& model, RunResult& result) {
+  std::shared_ptr<::ONNX_NAMESPACE::Graph> graph(::ONNX_NAMESPACE::ImportModelProto(model));
+  const std::clock_t start = std::clock();
+  manager.run(*graph);
+  const std::clock_t end = std::clock();
+  result.times_ms.push_back(1000.0 * (end - start) / CLOCKS_PER_SEC);
+  result.nb_nodes = ConvergingPassManager::count_nodes(*graph);
+}
+
+int main(int argc, char* argv[]) {
+    GOOGLE_PROTOBUF_VERIFY_VERSION;
+
+    int nb_blocks = 2000;
+    int debris_every = 1;
+    int iterations = 5;
+    std::string passes_string = "eliminate_identity;eliminate_nop_transpose;eliminate_nop_dropout;"
+                                "fuse_consecutive_transposes;fuse_consecutive_concats;eliminate_unused_initializer";
+    int c;
+    while ((c = getopt(argc, argv, "b:d:n:O:h")) != -1)
+    {
+        switch (c)
+        {
+            case 'b':
+                    nb_blocks = atoi(optarg);
+                    break;
+            case 'd':
+                    debris_every = atoi(optarg);
+                    break;
+            case 'n':
+                    iterations = atoi(optarg);
+                    break;
+            case 'O':
+                    passes_string = optarg;
+                    break;
+            default:
+                    print_usage();
+                    return c == 'h' ? 0 : -1;
+        }
+    }
+    if (nb_blocks <= 0 || debris_every <= 0 || iterations <= 0)
+    {
+        print_usage();
+        return -1;
+    }
+
+    std::vector<std::string> pass_names;
+    std::stringstream ss(passes_string);
+    std::string pass_name;
+    while (std::getline(ss, pass_name, ';'))
+    {
+        pass_names.push_back(pass_name);
+    }
+
+    RescanPassManager rescan;
+    ConvergingPassManager converging;
+    opt::FixedPointPassManager incremental;
+    for (auto const& name : pass_names)
+    {
+        auto pass = opt::Optimizer::passes.find(name);
+        rescan.add(pass);
+        converging.add(pass);
+        incremental.add(pass);
+    }
+
+    const auto model = make_model(nb_blocks, debris_every);
+    cout << "Graph:        " << model.graph().node_size() << " nodes in " << nb_blocks << " blocks, debris in 1 of every "
+         << debris_every << endl;
+    cout << "Passes:       " << passes_string << endl;
+
+    // The drivers take turns so that none of them consistently runs on a fresher heap than the others.
+    RunResult reference, old_result, new_result;
+    for (int i = 0; i < iterations; ++i)
+    {
+        time_manager(converging, model, reference);
+        time_manager(rescan, model, old_result);
+        time_manager(incremental, model, new_result);
+    }
+
+    std::shared_ptr<::ONNX_NAMESPACE::Graph> graph(::ONNX_NAMESPACE::ImportModelProto(model));
+    auto analysis = std::static_pointer_cast<opt::FixedPointPassManagerAnalysis>(incremental.run(*graph));
+
+    cout << "Rescanning:   min " << old_result.min_ms() << " ms, median " << old_result.median_ms() << " ms -> "
+         << old_result.nb_nodes << " nodes" << endl;
+    cout << "Incremental:  min " << new_result.min_ms() << " ms, median " << new_result.median_ms() << " ms -> "
+         << new_result.nb_nodes << " nodes (" << analysis->num_node_visits << " node visits, "
+         << analysis->num_transforms << " rewrites, " << analysis->num_rounds << " whole-graph rounds)" << endl;
+    cout << "Converging:   min " << reference.min_ms() << " ms, median " << reference.median_ms() << " ms -> "
+         << reference.nb_nodes << " nodes (every pass rerun until the graph stops changing)" << endl;
+
+    if (new_result.nb_nodes != reference.nb_nodes)
+    {
+        cerr << "ERROR: The incremental optimizer did not reach the fixed point" << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,129 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <fstream>
+#include <unistd.h> // For ::getopt
+#include <string>
+#include <vector>
+#include "NvOnnxParser.h"
+#include "NvInferPlugin.h"
+#include "onnx_utils.hpp"
+#include "common.hpp"
+
+using std::cout;
+using std::cerr;
+using std::endl;
+
+void print_usage() {
+  cout << "This program measures how long the ONNX parser takes to populate a TensorRT network." << endl;
+  cout << "Usage: parseBenchmark -m onnx_model.pb" << endl;
+  cout << "Optional arguments: -n iterations (default 10), -w warmup iterations (default 1), -v (increase verbosity)" << endl;
+}
+
+int main(int argc, char* argv[]) {
+
+    GOOGLE_PROTOBUF_VERIFY_VERSION;
+
+    std::string onnx_filename;
+    int c;
+    int iterations = 10;
+    int warmup = 1;
+    int verbosity = (int)nvinfer1::ILogger::Severity::kWARNING;
+    while ((c = getopt (argc, argv, "m:n:w:v")) != -1)
+    {
+        switch(c)
+        {
+            case 'm':
+                    onnx_filename = optarg;
+                    break;
+            case 'n':
+                    iterations = atoi(optarg);
+                    break;
+            case 'w':
+                    warmup = atoi(optarg);
+                    break;
+            case 'v':
+                    ++verbosity;
+                    break;
+        }
+    }
+
+    if (onnx_filename.empty() || iterations <= 0)
+    {
+        print_usage();
+        return -1;
+    }
+
+    common::TRT_Logger trt_logger((nvinfer1::ILogger::Severity)verbosity);
+    initLibNvInferPlugins(&trt_logger, "");
+
+    std::ifstream onnx_file(onnx_filename.c_str(),
+                            std::ios::binary | std::ios::ate);
+    std::streamsize file_size = onnx_file.tellg();
+    if (!onnx_file || file_size < 0)
+    {
+        cerr << "ERROR: Could not open " << onnx_filename << endl;
+        return -1;
+    }
+    onnx_file.seekg(0, std::ios::beg);
+    std::vector<char> onnx_buf(file_size);
+
+    if( !onnx_file.read(onnx_buf.data(), onnx_buf.size()) ) {
+        cerr << "ERROR: Failed to read from file " << onnx_filename << endl;
+        return -1;
+    }
+
+    ::ONNX_NAMESPACE::ModelProto onnx_model;
+    if (!common::ParseFromFile_WAR(&onnx_model, onnx_filename.c_str()))
+    {
+        cout << "Failure while parsing ONNX file" << endl;
+        return -1;
+    }
+    const int nb_nodes = onnx_model.graph().node_size();
+
+    auto trt_builder = common::infer_object(nvinfer1::createInferBuilder(trt_logger));
+    const auto explicitBatch = 1U << static_cast<uint32_t>(nvinfer1::NetworkDefinitionCreationFlag::kEXPLICIT_BATCH);
+
+    std::vector<double> times_ms;
+    int nb_layers = 0;
+    for (int i = 0; i < warmup + iterations; ++i)
+    {
+        // Every iteration starts from an empty network so that only the import itself is measured.
+        auto trt_network = common::infer_object(trt_builder->createNetworkV2(explicitBatch));
+        auto trt_parser  = common::infer_object(nvonnxparser::createParser(*trt_network, trt_logger));
+        trt_parser->setVerbosity(verbosity);
+
+        auto start = std::chrono::high_resolution_clock::now();
+        const bool parsed = trt_parser->parse(onnx_buf.data(), onnx_buf.size());
+        auto end = std::chrono::high_resolution_clock::now();
+        if (!parsed)
+        {
+            cerr << "ERROR: Failed to parse " << onnx_filename << endl;
+            return -1;
+        }
+        if (i >= warmup)
+        {
+            times_ms.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+        }
+        nb_layers = trt_network->getNbLayers();
+    }
+
+    std::sort(times_ms.begin(), times_ms.end());
+    double total_ms = 0;
+    for (double t : times_ms)
+    {
+        total_ms += t;
+    }
+    const double mean_ms = total_ms / times_ms.size();
+
+    cout << "Model:       " << onnx_filename << " (" << nb_nodes << " nodes -> " << nb_layers << " layers)" << endl;
+    cout << "Iterations:  " << iterations << endl;
+    cout << "Parse time:  min " << times_ms.front() << " ms, median " << times_ms[times_ms.size() / 2]
+         << " ms, mean " << mean_ms << " ms, max " << times_ms.back() << " ms" << endl;
+    cout << "Throughput:  " << nb_nodes / (mean_ms / 1000.) << " nodes/s" << endl;
+    return 0;
+}
@@ -0,0 +1,146 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <numeric>
+#include <string>
+#include <unistd.h> // For ::getopt
+#include <vector>
+#include "ShapeTensor.hpp"
+#include "onnx2trt_utils.hpp"
+
+using std::cout;
+using std::cerr;
+using std::endl;
+
+using onnx2trt::ShapeTensor;
+
+void print_usage() {
+  cout << "This program measures the shape arithmetic that the ONNX importer does for Slice, Flatten, Unsqueeze" << endl;
+  cout << "and broadcasting when all dimensions are known, as in the static-shape parts of transformer graphs." << endl;
+  cout << "Usage: shapeTensorBenchmark [-n iterations (default 200000)] [-r rank (default 4)]" << endl;
+}
+
+namespace
+{
+
+// No network is given to the importer helpers: with all values known they must not add layers.
+onnx2trt::IImporterContext* const kNoContext = nullptr;
+
+ShapeTensor makeDims(int rank)
+{
+    std::vector<int64_t> dims(rank);
+    for (int i = 0; i < rank; ++i)
+    {
+        dims[i] = 8 << (i % 4);
+    }
+    return ShapeTensor(1, std::move(dims));
+}
+
+// Mirrors the Slice importer for starts=[1,-1], ends=[-1,INT_MAX], steps=[1,-2], axes=[-1,1].
+ShapeTensor slice(const ShapeTensor& dims)
+{
+    const int rank = dims.size();
+    ShapeTensor starts(1, std::vector<int64_t>{1, -1});
+    ShapeTensor ends(1, std::vector<int64_t>{-1, std::numeric_limits<int32_t>::max()});
+    ShapeTensor steps(1, std::vector<int64_t>{1, -2});
+    const ShapeTensor axes(1, std::vector<int64_t>{rank - 1, 1});
+
+    const ShapeTensor subscripts{onnx2trt::axesToInterlaceSubscripts(axes, rank)};
+    starts = interlace(kNoContext, similar(kNoContext, dims, 0), starts, subscripts);
+    ends = interlace(kNoContext, dims, ends, subscripts);
+    steps = interlace(kNoContext, similar(kNoContext, dims, 1), steps, subscripts);
+    onnx2trt::decodeOnnxStartsAndEnds(kNoContext, dims, steps, starts, ends);
+    return onnx2trt::computeSliceSizes(kNoContext, starts, ends, steps, dims);
+}
+
+// Mirrors Flatten: [prod(dims[0:axis]), prod(dims[axis:])].
+ShapeTensor flatten(const ShapeTensor& dims)
+{
+    const int axis = dims.size() / 2;
+    return concat(kNoContext, product(kNoContext, dims, 0, axis, 1), product(kNoContext, dims, axis, dims.size(), 1));
+}
+
+// Mirrors Unsqueeze of axis 0 and broadcasting the result against [1, dims[0], 1, ...].
+ShapeTensor unsqueezeAndBroadcast(const ShapeTensor& dims)
+{
+    const int rank = dims.size() + 1;
+    std::vector<int64_t> subscripts(dims.size());
+    std::iota(subscripts.begin(), subscripts.end(), 0);
+    subscripts.insert(subscripts.begin(), dims.size());
+    const ShapeTensor unsqueezed
+        = interlace(kNoContext, dims, onnx2trt::shapeVector(1), ShapeTensor(1, std::move(subscripts)));
+    std::vector<int64_t> other(rank, 1);
+    other[1] = dims[0];
+    return broadcast(kNoContext, unsqueezed, ShapeTensor(1, std::move(other)));
+}
+
+int64_t checksum(const ShapeTensor& x)
+{
+    int64_t sum = x.size();
+    for (int64_t v : x)
+    {
+        sum = sum * 31 + v;
+    }
+    return sum;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    int iterations = 200000;
+    int rank = 4;
+    int c;
+    while ((c = getopt (argc, argv, "n:r:h")) != -1)
+    {
+        switch(c)
+        {
+            case 'n':
+                    iterations = atoi(optarg);
+                    break;
+            case 'r':
+                    rank = atoi(optarg);
+                    break;
+            default:
+                    print_usage();
+                    return c == 'h' ? 0 : -1;
+        }
+    }
+    if (iterations <= 0 || rank < 2 || rank >= nvinfer1::Dims::MAX_DIMS)
+    {
+        print_usage();
+        return -1;
+    }
+
+    const ShapeTensor dims = makeDims(rank);
+    cout << "Dimensions:   " << dims << endl;
+    cout << "Slice:        " << slice(dims) << endl;
+    cout << "Flatten:      " << flatten(dims) << endl;
+    cout << "Unsqueeze:    " << unsqueezeAndBroadcast(dims) << endl;
+
+    struct Case
+    {
+        const char* name;
+        ShapeTensor (*run)(const ShapeTensor&);
+    };
+    const Case cases[] = {{"Slice", slice}, {"Flatten", flatten}, {"Unsqueeze", unsqueezeAndBroadcast}};
+
+    int64_t sum = 0;
+    for (const auto& test : cases)
+    {
+        const auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < iterations; ++i)
+        {
+            sum += checksum(test.run(dims));
+        }
+        const std::chrono::duration<double, std::nano> elapsed = std::chrono::high_resolution_clock::now() - start;
+        cout << test.name << ":" << std::string(13 - std::string(test.name).size(), ' ') << elapsed.count() / iterations
+             << " ns per import" << endl;
+    }
+    // Keep the results alive.
+    return sum == 0 ? 1 : 0;
+}
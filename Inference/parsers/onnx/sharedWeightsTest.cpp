@@ -0,0 +1,152 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+// Checks that SharedWeightsCache keys tensors by checksum, range, type and shape but not by name or location, that
+// concurrent inserts of one key end up sharing an entry, and that entries go away with their last user.
+
+#include "SharedWeights.hpp"
+#include "TestHarness.h"
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using std::cerr;
+using std::cout;
+using std::endl;
+
+namespace
+{
+
+using ::ONNX_NAMESPACE::TensorProto;
+using onnx2trt::SharedWeightsCache;
+
+TensorProto makeExternal(std::string const& name, std::string const& location, std::string const& offset,
+    std::string const& checksum, std::vector<int64_t> const& dims = {64, 64})
+{
+    TensorProto tensor;
+    tensor.set_name(name);
+    tensor.set_data_type(TensorProto::FLOAT);
+    for (int64_t d : dims)
+    {
+        tensor.add_dims(d);
+    }
+    tensor.set_data_location(TensorProto::EXTERNAL);
+    auto addEntry = [&](std::string const& key, std::string const& value) {
+        auto* entry = tensor.add_external_data();
+        entry->set_key(key);
+        entry->set_value(value);
+    };
+    addEntry("location", location);
+    addEntry("offset", offset);
+    addEntry("length", "16384");
+    if (!checksum.empty())
+    {
+        addEntry("checksum", checksum);
+    }
+    return tensor;
+}
+
+std::string keyOf(TensorProto const& tensor)
+{
+    std::string key;
+    EXPECT(SharedWeightsCache::getKey(tensor, &key));
+    return key;
+}
+
+void testKeys()
+{
+    std::string const sha = "0123456789abcdef0123456789abcdef01234567";
+    std::string const base = keyOf(makeExternal("stage0/w", "bert.weights", "4096", sha));
+    EXPECT(keyOf(makeExternal("stage1/w", "../shared/bert.weights", "4096", sha)) == base);
+    EXPECT(keyOf(makeExternal("w", "bert.weights", "8192", sha)) != base);
+    EXPECT(keyOf(makeExternal("w", "bert.weights", "4096", sha, {4096})) != base);
+    TensorProto half = makeExternal("w", "bert.weights", "4096", sha);
+    half.set_data_type(TensorProto::FLOAT16);
+    EXPECT(keyOf(half) != base);
+
+    // Without a checksum nothing says two files hold the same bytes, and inline tensors are not shared.
+    std::string key;
+    EXPECT(!SharedWeightsCache::getKey(makeExternal("w", "bert.weights", "4096", ""), &key));
+    TensorProto inlined;
+    inlined.set_data_type(TensorProto::FLOAT);
+    inlined.add_dims(1);
+    inlined.add_float_data(1.f);
+    EXPECT(!SharedWeightsCache::getKey(inlined, &key));
+}
+
+void testLifetime()
+{
+    SharedWeightsCache cache;
+    nvinfer1::Dims shape;
+    shape.nbDims = 1;
+    shape.d[0] = 4;
+    std::vector<float> const values{1.f, 2.f, 3.f, 4.f};
+
+    EXPECT(!cache.find("a"));
+    auto a = cache.insert("a", TensorProto::FLOAT, shape, values.data(), sizeof(float) * values.size());
+    EXPECT(a && a->data.size() == sizeof(float) * values.size());
+    EXPECT(reinterpret_cast<float const*>(a->data.data())[2] == 3.f);
+    EXPECT(cache.find("a") == a);
+    EXPECT(cache.getNbHits() == 1);
+    EXPECT(cache.size() == 1 && cache.getNbBytes() == 16);
+
+    // The first insert wins; later ones get its entry.
+    std::vector<float> const other{5.f, 6.f, 7.f, 8.f};
+    EXPECT(cache.insert("a", TensorProto::FLOAT, shape, other.data(), 16) == a);
+
+    a.reset();
+    EXPECT(!cache.find("a"));
+    EXPECT(cache.size() == 0 && cache.getNbBytes() == 0);
+    auto again = cache.insert("a", TensorProto::FLOAT, shape, other.data(), 16);
+    EXPECT(reinterpret_cast<float const*>(again->data.data())[0] == 5.f);
+
+    // Released keys are swept as the cache keeps being used.
+    for (int i = 0; i < 100; ++i)
+    {
+        cache.insert(std::to_string(i), TensorProto::FLOAT, shape, values.data(), 16);
+    }
+    EXPECT(cache.size() == 1);
+}
+
+void testConcurrentInserts()
+{
+    SharedWeightsCache cache;
+    nvinfer1::Dims shape;
+    shape.nbDims = 1;
+    shape.d[0] = 1024;
+    std::vector<float> const values(1024, 0.5f);
+    std::vector<std::shared_ptr<SharedWeightsCache::Entry const>> entries(8);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < entries.size(); ++t)
+    {
+        threads.emplace_back([&, t]() {
+            entries[t] = cache.insert("w", TensorProto::FLOAT, shape, values.data(), sizeof(float) * values.size());
+        });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    for (auto const& entry : entries)
+    {
+        EXPECT(entry == entries[0]);
+    }
+    EXPECT(cache.size() == 1);
+}
+
+} // namespace
+
+int main()
+{
+    GOOGLE_PROTOBUF_VERIFY_VERSION;
+
+    testKeys();
+    testLifetime();
+    testConcurrentInserts();
+
+    return testHarness::finishTests("shared weights");
+}
@@ -0,0 +1,317 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+// Checks that SupportCache gives a node the same fingerprint whatever the names in its model, that an edit only
+// changes the fingerprints downstream of it, and that verdicts survive a save and load but not a conflict.
+
+#include "SupportCache.hpp"
+#include "TestHarness.h"
+#include "toposort.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using std::cerr;
+using std::cout;
+using std::endl;
+
+namespace
+{
+
+using ::ONNX_NAMESPACE::GraphProto;
+using ::ONNX_NAMESPACE::ModelProto;
+using ::ONNX_NAMESPACE::NodeProto;
+using ::ONNX_NAMESPACE::TensorProto;
+using onnx2trt::SupportCache;
+
+void addInput(GraphProto* graph, std::string const& name, std::string const& batch)
+{
+    auto* input = graph->add_input();
+    input->set_name(name);
+    auto* type = input->mutable_type()->mutable_tensor_type();
+    type->set_elem_type(TensorProto::FLOAT);
+    type->mutable_shape()->add_dim()->set_dim_param(batch);
+    type->mutable_shape()->add_dim()->set_dim_value(16);
+}
+
+void addFloats(GraphProto* graph, std::string const& name, std::vector<int64_t> const& dims, float value)
+{
+    TensorProto* tensor = graph->add_initializer();
+    tensor->set_name(name);
+    tensor->set_data_type(TensorProto::FLOAT);
+    int64_t volume = 1;
+    for (int64_t d : dims)
+    {
+        tensor->add_dims(d);
+        volume *= d;
+    }
+    for (int64_t i = 0; i < volume; ++i)
+    {
+        tensor->add_float_data(value);
+    }
+}
+
+void addInts(GraphProto* graph, std::string const& name, std::vector<int64_t> const& values)
+{
+    TensorProto* tensor = graph->add_initializer();
+    tensor->set_name(name);
+    tensor->set_data_type(TensorProto::INT64);
+    tensor->add_dims(values.size());
+    for (int64_t v : values)
+    {
+        tensor->add_int64_data(v);
+    }
+}
+
+NodeProto* addNode(GraphProto* graph, std::string const& op, std::vector<std::string> const& inputs,
+    std::string const& output)
+{
+    NodeProto* node = graph->add_node();
+    node->set_op_type(op);
+    node->set_name(output + "_node");
+    for (auto const& input : inputs)
+    {
+        node->add_input(input);
+    }
+    node->add_output(output);
+    return node;
+}
+
+struct Options
+{
+    std::string prefix;
+    float weight{1.f};
+    float alpha{0.1f};
+    std::vector<int64_t> reshape{-1, 4, 16};
+};
+
+// x[N,16] -> MatMul(w[16,64]) -> LeakyRelu(alpha) -> Reshape(shape) -> y
+//                             \-> Sigmoid -> z
+// Node order in the graph: Sigmoid, MatMul, Reshape, LeakyRelu.
+ModelProto makeModel(Options const& options)
+{
+    std::string const& p = options.prefix;
+    ModelProto model;
+    model.set_ir_version(7);
+    model.add_opset_import()->set_version(13);
+    GraphProto* graph = model.mutable_graph();
+    addInput(graph, p + "x", "N");
+    addFloats(graph, p + "w", {16, 64}, options.weight);
+    addInts(graph, p + "shape", options.reshape);
+    addNode(graph, "Sigmoid", {p + "m"}, p + "z");
+    addNode(graph, "MatMul", {p + "x", p + "w"}, p + "m");
+    addNode(graph, "Reshape", {p + "r", p + "shape"}, p + "y");
+    auto* attr = addNode(graph, "LeakyRelu", {p + "m"}, p + "r")->add_attribute();
+    attr->set_name("alpha");
+    attr->set_type(::ONNX_NAMESPACE::AttributeProto::FLOAT);
+    attr->set_f(options.alpha);
+    graph->add_output()->set_name(p + "y");
+    graph->add_output()->set_name(p + "z");
+    return model;
+}
+
+enum Node
+{
+    kSIGMOID = 0,
+    kMATMUL = 1,
+    kRESHAPE = 2,
+    kLEAKY_RELU = 3
+};
+
+std::vector<uint64_t> fingerprint(ModelProto const& model)
+{
+    std::vector<size_t> order;
+    EXPECT(toposort(model.graph().node(), &order));
+    return SupportCache::fingerprintNodes(model, order);
+}
+
+void testNamesDoNotMatter()
+{
+    Options renamed;
+    renamed.prefix = "other/";
+    std::vector<uint64_t> const a = fingerprint(makeModel(Options{}));
+    std::vector<uint64_t> const b = fingerprint(makeModel(renamed));
+    EXPECT(a.size() == 4);
+    EXPECT(a == b);
+    for (uint64_t f : a)
+    {
+        EXPECT(f != 0);
+    }
+    // All four nodes are different subgraphs.
+    EXPECT(a[kSIGMOID] != a[kMATMUL] && a[kMATMUL] != a[kRESHAPE] && a[kRESHAPE] != a[kLEAKY_RELU]
+        && a[kSIGMOID] != a[kLEAKY_RELU]);
+}
+
+void testEditsOnlyChangeDownstream()
+{
+    std::vector<uint64_t> const base = fingerprint(makeModel(Options{}));
+
+    Options alpha;
+    alpha.alpha = 0.2f;
+    std::vector<uint64_t> const a = fingerprint(makeModel(alpha));
+    EXPECT(a[kMATMUL] == base[kMATMUL]);
+    EXPECT(a[kSIGMOID] == base[kSIGMOID]);
+    EXPECT(a[kLEAKY_RELU] != base[kLEAKY_RELU]);
+    EXPECT(a[kRESHAPE] != base[kRESHAPE]);
+
+    // The small shape initializer is keyed by contents.
+    Options reshape;
+    reshape.reshape = {-1, 8, 8};
+    std::vector<uint64_t> const r = fingerprint(makeModel(reshape));
+    EXPECT(r[kLEAKY_RELU] == base[kLEAKY_RELU]);
+    EXPECT(r[kRESHAPE] != base[kRESHAPE]);
+
+    // The weights are too large to key by contents; their values do not change what the parser supports.
+    Options weight;
+    weight.weight = 2.f;
+    EXPECT(fingerprint(makeModel(weight)) == base);
+
+    // A graph input of another type changes everything that reads it.
+    ModelProto half = makeModel(Options{});
+    half.mutable_graph()->mutable_input(0)->mutable_type()->mutable_tensor_type()->set_elem_type(TensorProto::FLOAT16);
+    std::vector<uint64_t> const h = fingerprint(half);
+    for (int i = 0; i < 4; ++i)
+    {
+        EXPECT(h[i] != base[i]);
+    }
+}
+
+void testConsumersAreKeyed()
+{
+    std::vector<uint64_t> const base = fingerprint(makeModel(Options{}));
+
+    // A consumer of another op changes the fingerprint of the producer, and so of everything downstream of it.
+    ModelProto relu = makeModel(Options{});
+    relu.mutable_graph()->mutable_node(kSIGMOID)->set_op_type("Relu");
+    std::vector<uint64_t> const r = fingerprint(relu);
+    EXPECT(r[kMATMUL] != base[kMATMUL]);
+    EXPECT(r[kSIGMOID] != base[kSIGMOID]);
+    EXPECT(r[kLEAKY_RELU] != base[kLEAKY_RELU]);
+    EXPECT(r[kRESHAPE] != base[kRESHAPE]);
+
+    // So does a consumer reading the output at another input slot.
+    std::vector<std::vector<uint64_t>> slots;
+    for (bool const first : {true, false})
+    {
+        ModelProto add = makeModel(Options{});
+        NodeProto* node = add.mutable_graph()->mutable_node(kSIGMOID);
+        node->set_op_type("Add");
+        node->clear_input();
+        node->add_input(first ? "m" : "x");
+        node->add_input(first ? "x" : "m");
+        slots.push_back(fingerprint(add));
+    }
+    EXPECT(slots[0][kMATMUL] != slots[1][kMATMUL]);
+    EXPECT(slots[0][kSIGMOID] != slots[1][kSIGMOID]);
+
+    // The attributes of a consumer are not part of the fingerprint of its producer.
+    Options alpha;
+    alpha.alpha = 0.2f;
+    EXPECT(fingerprint(makeModel(alpha))[kMATMUL] == base[kMATMUL]);
+}
+
+void testGraphAttributesAreNotFingerprinted()
+{
+    ModelProto model = makeModel(Options{});
+    auto* attr = model.mutable_graph()->mutable_node(kLEAKY_RELU)->add_attribute();
+    attr->set_name("body");
+    attr->set_type(::ONNX_NAMESPACE::AttributeProto::GRAPH);
+    attr->mutable_g()->set_name("body");
+    std::vector<uint64_t> const f = fingerprint(model);
+    EXPECT(f[kMATMUL] != 0 && f[kSIGMOID] != 0);
+    EXPECT(f[kLEAKY_RELU] == 0);
+    EXPECT(f[kRESHAPE] == 0);
+
+    SupportCache cache;
+    for (uint64_t fp : f)
+    {
+        cache.insert(fp, true);
+    }
+    std::vector<bool> supported;
+    EXPECT(!cache.lookup(f, &supported));
+    EXPECT(cache.getNbEntries() == 2);
+}
+
+void testLookup()
+{
+    std::vector<uint64_t> const base = fingerprint(makeModel(Options{}));
+    SupportCache cache;
+    std::vector<bool> supported;
+    EXPECT(!cache.lookup(base, &supported));
+    EXPECT(!cache.lookup({}, &supported));
+
+    // A full analysis that stopped at the LeakyRelu did not check the Reshape.
+    cache.insert(base[kMATMUL], true);
+    cache.insert(base[kSIGMOID], true);
+    cache.insert(base[kLEAKY_RELU], false);
+    EXPECT(!cache.lookup(base, &supported));
+
+    cache.insert(base[kRESHAPE], true);
+    EXPECT(cache.lookup(base, &supported));
+    EXPECT(supported == std::vector<bool>({true, true, true, false}));
+    EXPECT(cache.getHits() == 1);
+    EXPECT(cache.getMisses() == 3);
+
+    // Another model needs the Reshape's output as a shape tensor, and rejects the LeakyRelu for it.
+    cache.insert(base[kLEAKY_RELU], true);
+    EXPECT(!cache.lookup(base, &supported));
+    cache.insert(base[kLEAKY_RELU], false);
+    EXPECT(!cache.lookup(base, &supported));
+    EXPECT(cache.getNbEntries() == 4);
+}
+
+void testSaveAndLoad()
+{
+    std::vector<uint64_t> const base = fingerprint(makeModel(Options{}));
+    std::string const path = "supportCacheTest.cache";
+    SupportCache cache;
+    for (int i = 0; i < 4; ++i)
+    {
+        cache.insert(base[i], i != kRESHAPE);
+    }
+    EXPECT(cache.save(path.c_str()));
+
+    SupportCache loaded;
+    EXPECT(loaded.load(path.c_str()));
+    EXPECT(loaded.getNbEntries() == 4);
+    std::vector<bool> supported;
+    EXPECT(loaded.lookup(base, &supported));
+    EXPECT(supported == std::vector<bool>({true, true, false, true}));
+
+    // Loading merges: disagreeing verdicts conflict.
+    SupportCache other;
+    other.insert(base[kRESHAPE], true);
+    EXPECT(other.load(path.c_str()));
+    EXPECT(!other.lookup(base, &supported));
+
+    // Files of another parser version are rejected as a whole.
+    {
+        std::ofstream file(path);
+        file << "onnx2trt-support-cache 1 0 0\n" << std::hex << base[kRESHAPE] << " 0\n";
+    }
+    SupportCache stale;
+    EXPECT(!stale.load(path.c_str()));
+    EXPECT(stale.getNbEntries() == 0);
+    EXPECT(!stale.load("does/not/exist.cache"));
+    std::remove(path.c_str());
+}
+
+} // namespace
+
+int main()
+{
+    GOOGLE_PROTOBUF_VERIFY_VERSION;
+
+    testNamesDoNotMatter();
+    testEditsOnlyChangeDownstream();
+    testConsumersAreKeyed();
+    testGraphAttributesAreNotFingerprinted();
+    testLookup();
+    testSaveAndLoad();
+
+    return testHarness::finishTests("support cache");
+}
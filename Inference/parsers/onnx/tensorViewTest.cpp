@@ -0,0 +1,207 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+// Checks that the ONNX IR borrows raw weights from the source model instead of copying them, copies them only when
+// they are modified, and exports them unchanged.
+
+#include "TestHarness.h"
+
+#include <onnx/common/ir_pb_converter.h>
+#include <onnx/optimizer/optimize.h>
+
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+using std::cerr;
+using std::cout;
+using std::endl;
+
+namespace
+{
+
+using ::ONNX_NAMESPACE::GraphProto;
+using ::ONNX_NAMESPACE::ModelProto;
+using ::ONNX_NAMESPACE::NodeProto;
+using ::ONNX_NAMESPACE::Tensor;
+using ::ONNX_NAMESPACE::TensorProto;
+
+constexpr int kVolume = 1024;
+
+void setRawFloats(TensorProto* tensor, std::string const& name, float scale)
+{
+    tensor->set_name(name);
+    tensor->set_data_type(TensorProto::FLOAT);
+    tensor->add_dims(kVolume);
+    std::vector<float> values(kVolume);
+    for (int i = 0; i < kVolume; ++i)
+    {
+        values[i] = scale * i;
+    }
+    tensor->set_raw_data(values.data(), values.size() * sizeof(float));
+}
+
+// x -> Add(w) -> Identity -> Add(Constant c) -> y
+ModelProto makeModel()
+{
+    ModelProto model;
+    model.set_ir_version(4);
+    model.add_opset_import()->set_version(9);
+    GraphProto* graph = model.mutable_graph();
+
+    auto* input = graph->add_input();
+    input->set_name("x");
+    auto* type = input->mutable_type()->mutable_tensor_type();
+    type->set_elem_type(TensorProto::FLOAT);
+    type->mutable_shape()->add_dim()->set_dim_value(kVolume);
+    auto* weights = graph->add_input();
+    weights->set_name("w");
+    weights->mutable_type()->CopyFrom(input->type());
+    graph->add_output()->set_name("y");
+
+    setRawFloats(graph->add_initializer(), "w", 1.f);
+
+    NodeProto* constant = graph->add_node();
+    constant->set_op_type("Constant");
+    constant->add_output("c");
+    auto* value = constant->add_attribute();
+    value->set_name("value");
+    value->set_type(::ONNX_NAMESPACE::AttributeProto::TENSOR);
+    setRawFloats(value->mutable_t(), "", 2.f);
+
+    NodeProto* add = graph->add_node();
+    add->set_op_type("Add");
+    add->add_input("x");
+    add->add_input("w");
+    add->add_output("a");
+    NodeProto* identity = graph->add_node();
+    identity->set_op_type("Identity");
+    identity->add_input("a");
+    identity->add_output("i");
+    NodeProto* add2 = graph->add_node();
+    add2->set_op_type("Add");
+    add2->add_input("i");
+    add2->add_input("c");
+    add2->add_output("y");
+    return model;
+}
+
+void testBorrowedImport()
+{
+    auto model = std::make_shared<ModelProto>(makeModel());
+    std::string const weights = model->graph().initializer(0).raw_data();
+    char const* const weightsInModel = model->graph().initializer(0).raw_data().data();
+    char const* const constantInModel = model->graph().node(0).attribute(0).t().raw_data().data();
+
+    std::shared_ptr<::ONNX_NAMESPACE::Graph> graph(::ONNX_NAMESPACE::ImportModelProto(model));
+    EXPECT(graph != nullptr);
+    if (!graph)
+    {
+        return;
+    }
+    // The graph keeps the model alive on its own.
+    std::weak_ptr<ModelProto> weakModel = model;
+    model.reset();
+    EXPECT(!weakModel.expired());
+
+    EXPECT(graph->initializers().size() == 1);
+    Tensor const& w = graph->initializers()[0];
+    EXPECT(w.is_raw_data() && w.is_raw_data_view());
+    EXPECT(w.raw_data() == weightsInModel);
+    EXPECT(w.raw_size() == weights.size());
+    EXPECT(w.data<float>()[3] == 3.f);
+    ::ONNX_NAMESPACE::Node* constant = nullptr;
+    for (auto* node : graph->nodes())
+    {
+        if (node->kind() == ::ONNX_NAMESPACE::kConstant)
+        {
+            constant = node;
+        }
+    }
+    EXPECT(constant != nullptr);
+    if (!constant)
+    {
+        return;
+    }
+    Tensor const& c = constant->t(::ONNX_NAMESPACE::kvalue);
+    EXPECT(c.is_raw_data_view() && c.raw_data() == constantInModel);
+
+    // Copies share the payload until one of them writes to it.
+    Tensor copy = w;
+    EXPECT(copy.raw_data() == weightsInModel);
+    copy.data<float>()[3] = 42.f;
+    EXPECT(!copy.is_raw_data_view());
+    EXPECT(copy.raw_data() != weightsInModel);
+    EXPECT(copy.data<float>()[3] == 42.f);
+    EXPECT(w.data<float>()[3] == 3.f);
+    EXPECT(std::memcmp(weightsInModel, weights.data(), weights.size()) == 0);
+
+    // Reading through const accessors leaves the payload borrowed; raw() takes ownership explicitly.
+    EXPECT(w.is_raw_data_view() && w.raw_data() == weightsInModel);
+    Tensor owned = w;
+    EXPECT(owned.raw() == weights);
+    EXPECT(!owned.is_raw_data_view() && owned.raw_data() != weightsInModel);
+
+    Tensor folded = w;
+    folded.add(c);
+    EXPECT(folded.data<float>()[3] == 9.f);
+    EXPECT(w.data<float>()[3] == 3.f);
+
+    ModelProto exported;
+    ::ONNX_NAMESPACE::ExportModelProto(&exported, graph);
+    EXPECT(exported.graph().initializer_size() == 1);
+    EXPECT(exported.graph().initializer_size() == 1 && exported.graph().initializer(0).raw_data() == weights);
+
+    graph.reset();
+    EXPECT(weakModel.expired());
+}
+
+void testOwnedImport()
+{
+    ModelProto const model = makeModel();
+    std::unique_ptr<::ONNX_NAMESPACE::Graph> graph = ::ONNX_NAMESPACE::ImportModelProto(model);
+    EXPECT(graph != nullptr && graph->initializers().size() == 1);
+    if (graph && graph->initializers().size() == 1)
+    {
+        Tensor const& w = graph->initializers()[0];
+        EXPECT(w.is_raw_data() && !w.is_raw_data_view());
+        EXPECT(w.raw_data() != model.graph().initializer(0).raw_data().data());
+        EXPECT(std::string(w.raw_data(), w.raw_size()) == model.graph().initializer(0).raw_data());
+    }
+}
+
+void testOptimize()
+{
+    ModelProto const model = makeModel();
+    ModelProto const optimized = ::ONNX_NAMESPACE::optimization::Optimize(model, {"eliminate_identity"});
+    EXPECT(optimized.graph().node_size() == 3);
+    EXPECT(optimized.graph().initializer_size() == 1);
+    EXPECT(optimized.graph().initializer_size() == 1
+        && optimized.graph().initializer(0).raw_data() == model.graph().initializer(0).raw_data());
+    bool foundConstant = false;
+    for (auto const& node : optimized.graph().node())
+    {
+        if (node.op_type() == "Constant")
+        {
+            foundConstant = true;
+            EXPECT(node.attribute(0).t().raw_data() == model.graph().node(0).attribute(0).t().raw_data());
+        }
+    }
+    EXPECT(foundConstant);
+}
+
+} // namespace
+
+int main()
+{
+    GOOGLE_PROTOBUF_VERIFY_VERSION;
+
+    testBorrowedImport();
+    testOwnedImport();
+    testOptimize();
+
+    return testHarness::finishTests("tensor view");
+}
@@ -165,7 +165,9 @@ namespace ONNX_NAMESPACE {
   _(Greater)                      \
   _(Less)                         \
   _(scales)                       \
-  _(Upsample)
+  _(Upsample)                     \
+  _(TopK)                         \
+  _(k)
  
 enum BuiltinSymbol {
 #define DEFINE_SYMBOL(s) k##s,
@@ -47,6 +47,17 @@ struct Node;
 struct Value;
 
 
+// Receives notifications of structural changes to a graph: a node was
+// inserted, its inputs changed, the uses of its outputs changed, or it was
+// destroyed. Attribute changes are not reported. Incremental pass drivers use
+// this to find the nodes a rewrite may have affected.
+struct GraphObserver {
+  virtual ~GraphObserver() = default;
+  virtual void nodeChanged(Node* n) = 0;
+  virtual void nodeDestroyed(Node* n) = 0;
+};
+
+
 class ResourceGuard final {
   std::function<void()> destructor_;
   bool released_;
@@ -552,6 +563,8 @@ public:
     ONNX_ASSERT(graph_ == node->owningGraph());
     node->uses_.emplace_back(this, inputs_.size());
     inputs_.push_back(node);
+    notifyChanged(this);
+    notifyChanged(node->node());
     return node;
   }
 
@@ -566,6 +579,7 @@ public:
     Value * old = dropInput(i);
     inputs_[i] = newValue;
     newValue->uses_.emplace_back(this, i);
+    notifyChanged(newValue->node());
     return old;
   }
 
@@ -626,6 +640,7 @@ public:
     this->prev() = n;
     this->next() = next;
     next->prev() = this;
+    notifyChanged(this);
     return this;
   }
 
@@ -744,9 +759,14 @@ private:
     auto use_it = findUseForInput(i);
     input_node->uses_.erase(use_it);
     inputs_[i] = nullptr;
+    notifyChanged(this);
+    notifyChanged(input_node->node());
     return input_node;
   }
 
+  // Forwards to the observer of the owning graph, if any.
+  void notifyChanged(Node* n);
+
   bool inGraphList() const {
     ONNX_ASSERT(next() != nullptr || prev() == nullptr);
     return next() != nullptr;
@@ -866,6 +886,8 @@ private:
 
   std::vector <OpSetID> opset_versions_;
 
+  GraphObserver* observer_ = nullptr;
+
 public:
   Graph()
   : next_unique_(0)
@@ -978,6 +1000,15 @@ public:
   Node * return_node() {
     return output_;
   }
+
+  // Set the observer notified of structural changes, or nullptr to stop
+  // notifications. The graph does not take ownership.
+  void setObserver(GraphObserver* observer) {
+    observer_ = observer;
+  }
+  GraphObserver* observer() const {
+    return observer_;
+  }
   const Node * return_node() const {
     return output_;
   }
@@ -1134,6 +1165,11 @@ inline void Value::replaceAllUsesWith(Value * newValue) {
   for(auto u : uses()) {
     u.user->inputs_[u.offset] = newValue;
     newValue->uses_.push_back(u);
+    u.user->notifyChanged(u.user);
+  }
+  if (!uses_.empty()) {
+    node()->notifyChanged(node());
+    node()->notifyChanged(newValue->node());
   }
   uses_.clear();
 }
@@ -1187,9 +1223,18 @@ inline void Node::destroy() {
     eraseOutput(outputs().size() - 1);
   removeAllInputs();
   removeFromList();
+  if (graph_->observer_) {
+    graph_->observer_->nodeDestroyed(this);
+  }
   graph_->freeNode(this);
 }
 
+inline void Node::notifyChanged(Node* n) {
+  if (graph_->observer_) {
+    graph_->observer_->nodeChanged(n);
+  }
+}
+
 /************* All nodes not required to be defined before Graph **************/
 
 inline graph_node_list_iterator Node::iterator() {
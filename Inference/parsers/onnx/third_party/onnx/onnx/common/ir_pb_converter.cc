@@ -6,9 +6,17 @@
 namespace ONNX_NAMESPACE {
 
 // Part 1: convert ONNX Protobuf to IR
-std::unique_ptr<Graph> graphProtoToGraph(const GraphProto& gp, bool nested);
+//
+// When data_owner is set, it keeps the protobuf alive and raw tensor payloads
+// are borrowed from it instead of being copied.
+std::unique_ptr<Graph> graphProtoToGraph(
+    const GraphProto& gp,
+    bool nested,
+    const std::shared_ptr<const void>& data_owner);
 
-Tensor tensorProtoToTensor(const ONNX_NAMESPACE::TensorProto& tp) {
+Tensor tensorProtoToTensor(
+    const ONNX_NAMESPACE::TensorProto& tp,
+    const std::shared_ptr<const void>& data_owner) {
   Tensor ret;
 
   ret.sizes().reserve(tp.dims_size());
@@ -77,7 +85,12 @@ Tensor tensorProtoToTensor(const ONNX_NAMESPACE::TensorProto& tp) {
   // The only way to know if we should be using raw_data or
   // <type>_data is to look at which of them is size zero.
   if (tp.has_raw_data()) {
-    ret.set_raw_data(tp.raw_data());
+    if (data_owner) {
+      ret.set_raw_data_view(
+          tp.raw_data().data(), tp.raw_data().size(), data_owner);
+    } else {
+      ret.set_raw_data(tp.raw_data());
+    }
   }
 
   if (tp.has_name()) {
@@ -89,7 +102,10 @@ Tensor tensorProtoToTensor(const ONNX_NAMESPACE::TensorProto& tp) {
   return ret;
 }
 
-void convertAttribute(const ONNX_NAMESPACE::AttributeProto& ap, Node* n) {
+void convertAttribute(
+    const ONNX_NAMESPACE::AttributeProto& ap,
+    Node* n,
+    const std::shared_ptr<const void>& data_owner) {
   Symbol sym = Symbol(ap.name());
   switch (ap.type()) {
     case ONNX_NAMESPACE::AttributeProto_AttributeType_FLOAT:
@@ -129,25 +145,25 @@ void convertAttribute(const ONNX_NAMESPACE::AttributeProto& ap, Node* n) {
       break;
     }
     case ONNX_NAMESPACE::AttributeProto_AttributeType_TENSOR:
-      n->t_(sym, tensorProtoToTensor(ap.t()));
+      n->t_(sym, tensorProtoToTensor(ap.t(), data_owner));
       break;
     case ONNX_NAMESPACE::AttributeProto_AttributeType_TENSORS: {
       std::vector<Tensor> tensors;
       tensors.reserve(ap.tensors_size());
       for (int i = 0; i < ap.tensors_size(); i++) {
-        tensors.push_back(tensorProtoToTensor(ap.tensors(i)));
+        tensors.push_back(tensorProtoToTensor(ap.tensors(i), data_owner));
       }
       n->ts_(sym, std::move(tensors));
       break;
     }
     case ONNX_NAMESPACE::AttributeProto_AttributeType_GRAPH:
-      n->g_(sym, graphProtoToGraph(ap.g(), true));
+      n->g_(sym, graphProtoToGraph(ap.g(), true, data_owner));
       break;
     case ONNX_NAMESPACE::AttributeProto_AttributeType_GRAPHS: {
       std::vector<std::shared_ptr<Graph>> graphs;
       graphs.reserve(ap.graphs_size());
       for (int i = 0; i < ap.graphs_size(); i++) {
-        graphs.push_back(graphProtoToGraph(ap.graphs(i), true));
+        graphs.push_back(graphProtoToGraph(ap.graphs(i), true, data_owner));
       }
       n->gs_(sym, std::move(graphs));
       break;
@@ -162,9 +178,12 @@ void convertAttribute(const ONNX_NAMESPACE::AttributeProto& ap, Node* n) {
   }
 }
 
-void convertAttributes(ONNX_NAMESPACE::NodeProto& np, Node* n) {
+void convertAttributes(
+    const ONNX_NAMESPACE::NodeProto& np,
+    Node* n,
+    const std::shared_ptr<const void>& data_owner) {
   for (int i = 0; i < np.attribute_size(); i++) {
-    convertAttribute(np.attribute(i), n);
+    convertAttribute(np.attribute(i), n, data_owner);
   }
 }
 
@@ -184,7 +203,8 @@ std::vector<Dimension> tensorShapeProtoToDimensions(
 
 std::unique_ptr<Graph> graphProtoToGraph(
     const ONNX_NAMESPACE::GraphProto& gp,
-    bool nested) {
+    bool nested,
+    const std::shared_ptr<const void>& data_owner) {
   std::unique_ptr<Graph> g(new Graph());
 
   if (gp.has_name()) {
@@ -228,7 +248,7 @@ std::unique_ptr<Graph> graphProtoToGraph(
   }
 
   for (int i = 0; i < gp.input_size(); i++) {
-    auto vip = gp.input(i);
+    const auto& vip = gp.input(i);
     auto v = g->addInput();
     v->setElemType(vip.type().tensor_type().elem_type());
     v->setSizes(tensorShapeProtoToDimensions(vip.type().tensor_type().shape()));
@@ -237,7 +257,7 @@ std::unique_ptr<Graph> graphProtoToGraph(
   }
 
   for (int i = 0; i < gp.node_size(); i++) {
-    auto np = gp.node(i);
+    const auto& np = gp.node(i);
     auto* n =
         g->create(Symbol(np.op_type()), /* num_outputs = */ np.output_size());
     g->appendNode(n);
@@ -248,7 +268,7 @@ std::unique_ptr<Graph> graphProtoToGraph(
       out->setUniqueName(np.output(j));
       value_by_name_of[np.output(j)] = out;
     }
-    convertAttributes(np, n);
+    convertAttributes(np, n, data_owner);
     std::vector<std::string> inputs;
     inputs.reserve(np.input_size());
     for (int j = 0; j < np.input_size(); j++) {
@@ -315,21 +335,26 @@ std::unique_ptr<Graph> graphProtoToGraph(
   }
 
   for (int i = 0; i < gp.initializer_size(); i++) {
-    auto init = tensorProtoToTensor(gp.initializer(i));
-    g->addInitializer(init, init.name());
+    auto init = tensorProtoToTensor(gp.initializer(i), data_owner);
+    std::string name = init.name();
+    g->addInitializer(std::move(init), std::move(name));
   }
 
   return g;
 }
 
-std::unique_ptr<Graph> ImportModelProto(const ModelProto& mp) {
+namespace {
+
+std::unique_ptr<Graph> importModelProto(
+    const ModelProto& mp,
+    const std::shared_ptr<const void>& data_owner) {
   if (!mp.has_ir_version()) {
     return nullptr;
   } else if (mp.ir_version() == 1) {
     return nullptr;
   }
 
-  std::unique_ptr<Graph> g(graphProtoToGraph(mp.graph(), false));
+  std::unique_ptr<Graph> g(graphProtoToGraph(mp.graph(), false, data_owner));
   for (int i = 0; i < mp.opset_import_size(); i++) {
     OpSetID new_opset_version(
         mp.opset_import(i).domain(), mp.opset_import(i).version());
@@ -338,6 +363,16 @@ std::unique_ptr<Graph> ImportModelProto(const ModelProto& mp) {
   return g;
 }
 
+} // namespace
+
+std::unique_ptr<Graph> ImportModelProto(const ModelProto& mp) {
+  return importModelProto(mp, nullptr);
+}
+
+std::unique_ptr<Graph> ImportModelProto(std::shared_ptr<const ModelProto> mp) {
+  return importModelProto(*mp, mp);
+}
+
 // Part 2: convert IR to ONNX Protobuf
 std::string value_name(Value* n) {
   return n->uniqueName();
@@ -409,8 +444,9 @@ void encodeTensor(ONNX_NAMESPACE::TensorProto* p, const Tensor& tensor) {
     case ONNX_NAMESPACE::TensorProto_DataType_UNDEFINED:
       fail_convert("Unknown tensor data type");
   }
-  if (!tensor.raw().empty()) {
-    p->set_raw_data(tensor.raw());
+  if (tensor.raw_size() != 0) {
+    // Assign in place; set_raw_data(ptr, size) goes through a temporary.
+    p->mutable_raw_data()->assign(tensor.raw_data(), tensor.raw_size());
   }
 }
 
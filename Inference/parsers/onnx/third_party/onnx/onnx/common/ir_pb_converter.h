@@ -37,6 +37,10 @@ void ExportModelProto(ModelProto* p_m, const std::shared_ptr<Graph>& g);
 
 std::unique_ptr<Graph> ImportModelProto(const ModelProto& mp);
 
+// Same as above, but raw tensor payloads are borrowed from *mp instead of
+// being copied; the graph's tensors keep mp alive.
+std::unique_ptr<Graph> ImportModelProto(std::shared_ptr<const ModelProto> mp);
+
 ModelProto PrepareOutput(const ModelProto& mp_in);
 
 void assertNonNull(std::shared_ptr<Graph> g);
@@ -5,6 +5,7 @@
 
 #include <cmath>
 #include <functional>
+#include <memory>
 #include <numeric>
 #include "onnx/common/assertions.h"
 #include "onnx/onnx_pb.h"
@@ -29,7 +30,14 @@ private:
   std::vector<std::string> string_data_;
 
   bool is_raw_data_;
+  // The raw payload is either owned in raw_data_, or borrowed from memory
+  // kept alive by raw_view_owner_ (see set_raw_data_view). A borrowed payload
+  // is copied into raw_data_ by own_raw_data(), which non-const accessors
+  // call; const accessors never change which one is used.
   std::string raw_data_;
+  const char* raw_view_;
+  size_t raw_view_size_;
+  std::shared_ptr<const void> raw_view_owner_;
 
   template <typename F, typename T>
   void bin_func(const F& f, T* ptr, const T* a_ptr);
@@ -48,6 +56,8 @@ private:
   , has_name_(false)
   , elem_type_(ONNX_NAMESPACE::TensorProto_DataType_UNDEFINED)
   , is_raw_data_(false)
+  , raw_view_(nullptr)
+  , raw_view_size_(0)
   {}
 
   const std::vector<int64_t>& sizes() const {
@@ -121,13 +131,59 @@ private:
     return uint64_data_;
   }
 
-  const std::string& raw() const {
+  // Copies a borrowed payload into the tensor, so that it can be modified
+  // and no longer keeps the owner alive. Pointers from raw_data() taken
+  // before are invalidated.
+  void own_raw_data() {
+    if (raw_view_ != nullptr) {
+      raw_data_.assign(raw_view_, raw_view_size_);
+      raw_view_ = nullptr;
+      raw_view_size_ = 0;
+      raw_view_owner_.reset();
+    }
+  }
+
+  // The payload as an owned string, copying a borrowed one first (see
+  // own_raw_data()). There is no const overload: read a const tensor in
+  // place with raw_data() and raw_size().
+  const std::string& raw() {
+    own_raw_data();
     return raw_data_;
   }
 
+  const char* raw_data() const {
+    return raw_view_ != nullptr ? raw_view_ : raw_data_.data();
+  }
+
+  size_t raw_size() const {
+    return raw_view_ != nullptr ? raw_view_size_ : raw_data_.size();
+  }
+
   void set_raw_data(std::string raw_data) {
     is_raw_data_ = true;
     raw_data_ = std::move(raw_data);
+    raw_view_ = nullptr;
+    raw_view_size_ = 0;
+    raw_view_owner_.reset();
+  }
+
+  // Uses size bytes at data as the raw payload without copying them. owner
+  // keeps the memory alive (e.g. the source ModelProto, or a mapped file) and
+  // is shared by copies of the tensor. The bytes must not change while
+  // borrowed; non-const data() copies them first.
+  void set_raw_data_view(
+      const char* data,
+      size_t size,
+      std::shared_ptr<const void> owner) {
+    is_raw_data_ = true;
+    std::string().swap(raw_data_);
+    raw_view_ = data;
+    raw_view_size_ = size;
+    raw_view_owner_ = std::move(owner);
+  }
+
+  bool is_raw_data_view() const {
+    return raw_view_ != nullptr;
   }
 
   template <typename T>
@@ -217,6 +273,7 @@ private:
   template <>                                     \
   inline type* Tensor::data<type>() {             \
     if (is_raw_data_) {                           \
+      own_raw_data();                             \
       return (type*)&raw_data_.data()[0];         \
     } else {                                      \
       return field.data();                        \
@@ -226,7 +283,7 @@ private:
   template <>                                     \
   inline const type* Tensor::data<type>() const { \
     if (is_raw_data_) {                           \
-      return (type*)(raw_data_.data());           \
+      return (const type*)(raw_data());           \
     } else {                                      \
       return field.data();                        \
     }                                             \
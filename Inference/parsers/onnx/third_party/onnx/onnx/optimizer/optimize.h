@@ -23,7 +23,11 @@ struct Optimizer {
   ~Optimizer();
 
   ModelProto optimize(const ModelProto& mp_in) {
-    std::shared_ptr<Graph> g(ImportModelProto(mp_in));
+    // The graph does not outlive this call, so its tensors can borrow the
+    // weights of mp_in rather than copy them.
+    std::shared_ptr<const ModelProto> borrowed_in(
+        &mp_in, [](const ModelProto*) {});
+    std::shared_ptr<Graph> g(ImportModelProto(borrowed_in));
 
     if (g.get() == nullptr) {
       std::cerr << "Warning: onnx optimizer is unable to parse input model. "
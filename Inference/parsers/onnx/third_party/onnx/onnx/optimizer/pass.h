@@ -4,6 +4,7 @@
 #pragma once
 
 #include <string>
+#include <vector>
 #include "onnx/common/ir.h"
 #include "onnx/onnx_pb.h"
 
@@ -189,6 +190,12 @@ class PredicateBasedPass : public Pass {
   // internally delete node instead set the correct destroy_current type.
   virtual bool
   runTransform(Node* node, Graph& graph, NodeDestroyType& destroy_current) = 0;
+  // The kinds of node patternMatchPredicate can accept. Incremental pass
+  // managers only offer nodes of these kinds to the pass. An empty list means
+  // any node may match, and the pass is run over the whole graph instead.
+  virtual std::vector<NodeKind> getMatchedKinds() const {
+    return {};
+  }
 
   std::shared_ptr<PostPassAnalysis> runPass(Graph& graph) override;
   PassAnalysisType getPassAnalysisType() const override;
@@ -1,5 +1,10 @@
 #include "onnx/optimizer/pass_manager.h"
 
+#include <deque>
+#include <iterator>
+#include <unordered_map>
+#include <unordered_set>
+
 namespace ONNX_NAMESPACE {
 namespace optimization {
 
@@ -20,28 +25,254 @@ std::shared_ptr<PassManagerAnalysis> GeneralPassManager::run(Graph& graph) {
   return std::shared_ptr<PassManagerAnalysis>(new EmptyPassManagerAnalysis());
 }
 
-std::shared_ptr<PassManagerAnalysis> FixedPointPassManager::run(Graph& graph) {
-  bool fixed_point_optimization_done;
+namespace {
+
+using PassesByKind =
+    std::unordered_map<NodeKind, std::vector<PredicateBasedPass*>>;
+
+bool hasSubgraphs(Node* n) {
+  if (!n->hasAttributes()) {
+    return false;
+  }
+  for (auto name : n->attributeNames()) {
+    auto kind = n->kindOf(name);
+    if (kind == AttributeKind::g || kind == AttributeKind::gs) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Tracks the nodes of one graph that need to be offered to the incremental
+// passes. Nodes no pass matches are never queued, unless they hold subgraphs.
+// Installs itself as the graph's observer for its lifetime.
+class NodeWorklist final : public GraphObserver {
+ public:
+  NodeWorklist(Graph& graph, const PassesByKind& passes_by_kind)
+      : graph_(graph),
+        passes_by_kind_(passes_by_kind),
+        previous_observer_(graph.observer()) {
+    graph_.setObserver(this);
+  }
+  ~NodeWorklist() override {
+    graph_.setObserver(previous_observer_);
+  }
+
+  void nodeChanged(Node* n) override {
+    // A rewrite reports the same node several times; keep the first slot.
+    if (touched_slots_.emplace(n, touched_.size()).second) {
+      touched_.push_back(n);
+    }
+    ++num_mutations_;
+  }
+  void nodeDestroyed(Node* n) override {
+    // Blank the slot rather than erasing it, so that destroying is O(1) and
+    // the remaining touched nodes keep their order.
+    auto slot = touched_slots_.find(n);
+    if (slot != touched_slots_.end()) {
+      touched_[slot->second] = nullptr;
+      touched_slots_.erase(slot);
+    }
+    queued_.erase(n);
+    ++num_mutations_;
+  }
 
-  do {
-    fixed_point_optimization_done = false;
-    for (std::shared_ptr<Pass> pass : this->passes) {
-      std::shared_ptr<PostPassAnalysis> analysis = pass->runPass(graph);
-      if (pass->getPassAnalysisType() == PassAnalysisType::Empty) {
+  void pushAll() {
+    queued_.reserve(std::distance(graph_.begin(), graph_.end()));
+    for (Node* n : graph_.nodes()) {
+      push(n);
+    }
+  }
+
+  // Queues the nodes touched since the last call, and the consumers of their
+  // outputs, since predicates look at the producers of a node's inputs.
+  void flushTouched() {
+    if (touched_.empty()) {
+      return;
+    }
+    for (Node* n : touched_) {
+      if (!n || n->owningGraph() != &graph_) {
         continue;
       }
-      std::shared_ptr<CountBasedPassAnalysis> count_analysis =
-          std::static_pointer_cast<CountBasedPassAnalysis>(analysis);
+      push(n);
+      for (Value* output : n->outputs()) {
+        for (const Use& use : output->uses()) {
+          push(use.user);
+        }
+      }
+    }
+    touched_.clear();
+    touched_slots_.clear();
+  }
 
-      while (count_analysis->fixedPointOptimizationNeeded()) {
-        count_analysis = std::static_pointer_cast<CountBasedPassAnalysis>(
-            pass->runPass(graph));
-        fixed_point_optimization_done = true;
+  Node* pop() {
+    while (!queue_.empty()) {
+      Node* n = queue_.front();
+      queue_.pop_front();
+      // Entries of destroyed nodes were dropped from queued_.
+      if (queued_.erase(n)) {
+        return n;
       }
     }
-  } while (fixed_point_optimization_done);
+    return nullptr;
+  }
 
-  return std::shared_ptr<PassManagerAnalysis>(new EmptyPassManagerAnalysis());
+  bool empty() const {
+    return queued_.empty();
+  }
+
+  unsigned int numMutations() const {
+    return num_mutations_;
+  }
+
+ private:
+  void push(Node* n) {
+    if (!passes_by_kind_.count(n->kind()) && !hasSubgraphs(n)) {
+      return;
+    }
+    if (queued_.insert(n).second) {
+      queue_.push_back(n);
+    }
+  }
+
+  Graph& graph_;
+  const PassesByKind& passes_by_kind_;
+  GraphObserver* previous_observer_;
+  std::deque<Node*> queue_;
+  std::unordered_set<Node*> queued_;
+  std::vector<Node*> touched_; // In the order first touched; null if destroyed.
+  std::unordered_map<Node*, size_t> touched_slots_;
+  unsigned int num_mutations_ = 0;
+};
+
+// Offers queued nodes to the passes matching their kind until the worklist is
+// empty. Returns true if the graph changed.
+bool drainWorklist(
+    Graph& graph,
+    NodeWorklist& worklist,
+    const PassesByKind& passes_by_kind,
+    FixedPointPassManagerAnalysis& analysis) {
+  const unsigned int initial_mutations = worklist.numMutations();
+  bool changed = false;
+  while (Node* n = worklist.pop()) {
+    ++analysis.num_node_visits;
+    // Control-flow bodies are separate graphs with their own worklists.
+    for (auto name : n->hasAttributes() ? n->attributeNames()
+                                        : std::vector<Symbol>()) {
+      auto kind = n->kindOf(name);
+      std::vector<std::shared_ptr<Graph>> bodies;
+      if (kind == AttributeKind::g) {
+        bodies.push_back(n->g(name));
+      } else if (kind == AttributeKind::gs) {
+        bodies = n->gs(name);
+      }
+      for (auto& body : bodies) {
+        NodeWorklist body_worklist(*body, passes_by_kind);
+        body_worklist.pushAll();
+        changed |= drainWorklist(*body, body_worklist, passes_by_kind, analysis);
+      }
+    }
+
+    auto it = passes_by_kind.find(n->kind());
+    if (it == passes_by_kind.end()) {
+      continue;
+    }
+    for (PredicateBasedPass* pass : it->second) {
+      if (!pass->patternMatchPredicate(n)) {
+        continue;
+      }
+      NodeDestroyType destroy_type = NodeDestroyType::DestroyZero;
+      const bool transformed = pass->runTransform(n, graph, destroy_type);
+      if (transformed) {
+        ++analysis.num_transforms;
+        // Attribute changes are not observed; revisit the node explicitly.
+        worklist.nodeChanged(n);
+      }
+      // Destroy through an iterator, as PredicateBasedPass does: the second
+      // destruction takes the node preceding the current one.
+      if (destroy_type != NodeDestroyType::DestroyZero) {
+        auto node_it = n->iterator();
+        node_it.destroyCurrent();
+        if (destroy_type == NodeDestroyType::DestroyTwo) {
+          node_it.destroyCurrent();
+        }
+        break;
+      }
+    }
+    worklist.flushTouched();
+  }
+  return changed || worklist.numMutations() != initial_mutations;
+}
+
+} // namespace
+
+std::shared_ptr<PassManagerAnalysis> FixedPointPassManager::run(Graph& graph) {
+  std::shared_ptr<FixedPointPassManagerAnalysis> analysis(
+      new FixedPointPassManagerAnalysis());
+
+  std::vector<PredicateBasedPass*> incremental_passes;
+  std::vector<std::shared_ptr<Pass>> whole_graph_passes;
+  PassesByKind passes_by_kind;
+  for (const std::shared_ptr<Pass>& pass : this->passes) {
+    auto* predicate_pass = dynamic_cast<PredicateBasedPass*>(pass.get());
+    const std::vector<NodeKind> kinds = predicate_pass
+        ? predicate_pass->getMatchedKinds()
+        : std::vector<NodeKind>();
+    if (kinds.empty()) {
+      whole_graph_passes.push_back(pass);
+      continue;
+    }
+    incremental_passes.push_back(predicate_pass);
+    for (NodeKind kind : kinds) {
+      passes_by_kind[kind].push_back(predicate_pass);
+    }
+  }
+
+  for (PredicateBasedPass* pass : incremental_passes) {
+    pass->initializePass(graph);
+  }
+  {
+    NodeWorklist worklist(graph, passes_by_kind);
+    worklist.pushAll();
+    while (true) {
+      const bool changed =
+          drainWorklist(graph, worklist, passes_by_kind, *analysis);
+      if (analysis->num_rounds > 0 && !changed) {
+        break;
+      }
+      if (whole_graph_passes.empty()) {
+        break;
+      }
+      ++analysis->num_rounds;
+      for (const std::shared_ptr<Pass>& pass : whole_graph_passes) {
+        std::shared_ptr<PostPassAnalysis> pass_analysis = pass->runPass(graph);
+        if (pass->getPassAnalysisType() == PassAnalysisType::Empty) {
+          continue;
+        }
+        std::shared_ptr<CountBasedPassAnalysis> count_analysis =
+            std::static_pointer_cast<CountBasedPassAnalysis>(pass_analysis);
+        bool graph_changed = count_analysis->graphChanged();
+        while (count_analysis->fixedPointOptimizationNeeded()) {
+          count_analysis = std::static_pointer_cast<CountBasedPassAnalysis>(
+              pass->runPass(graph));
+        }
+        if (graph_changed) {
+          // Changes to attributes or initializers are not observed, so every
+          // node has to be looked at again.
+          worklist.pushAll();
+        }
+      }
+      worklist.flushTouched();
+      if (worklist.empty()) {
+        break;
+      }
+    }
+  }
+  for (PredicateBasedPass* pass : incremental_passes) {
+    pass->finalizePass(graph);
+  }
+
+  return analysis;
 }
 } // namespace optimization
 } // namespace ONNX_NAMESPACE
@@ -41,9 +41,24 @@ class GeneralPassManager : public PassManager {
   std::vector<std::shared_ptr<Pass>> passes;
 };
 
-// Exhibits the same behavior as GeneralPassManager but will instead check
-// whether or not fixed point optimization is needed.
+// Counters describing the work done by a FixedPointPassManager run.
+struct FixedPointPassManagerAnalysis : PassManagerAnalysis {
+  // Nodes offered to the incremental passes, including revisits.
+  unsigned int num_node_visits = 0;
+  // Rewrites performed by the incremental passes.
+  unsigned int num_transforms = 0;
+  // Times the whole-graph passes were run.
+  unsigned int num_rounds = 0;
+};
+
+// Runs the passes until the graph stops changing. Predicate based passes that
+// declare the node kinds they match are driven from a worklist: every node is
+// offered to them once, and afterwards only the nodes a rewrite touched (and
+// the consumers of their outputs) are revisited. The remaining passes are run
+// over the whole graph once the worklist is empty, and again whenever the
+// incremental passes changed something since.
 class FixedPointPassManager : public GeneralPassManager {
+ public:
   std::shared_ptr<PassManagerAnalysis> run(Graph& graph) override;
 };
 
@@ -6,6 +6,7 @@
 #include "onnx/common/ir.h"
 #include "onnx/common/ir_pb_converter.h"
 #include "onnx/common/stl_backports.h"
+#include "onnx/optimizer/passes/canonicalize_exit_head.h"
 #include "onnx/optimizer/passes/eliminate_deadend.h"
 #include "onnx/optimizer/passes/eliminate_identity.h"
 #include "onnx/optimizer/passes/eliminate_nop_dropout.h"
@@ -42,6 +43,7 @@ struct GlobalPassRegistry {
   GlobalPassRegistry() {
     // Register the optimization passes to the optimizer.
     registerPass<NopEmptyPass>();
+    registerPass<CanonicalizeExitHead>();
     registerPass<EliminateDeadEnd>();
     registerPass<EliminateNopDropout>();
     registerPass<EliminateIdentity>();
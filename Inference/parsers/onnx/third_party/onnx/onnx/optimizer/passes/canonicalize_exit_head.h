@@ -0,0 +1,118 @@
+// ATTENTION: The code in this file is highly EXPERIMENTAL.
+// Adventurous users should note that the APIs will probably change.
+
+#pragma once
+
+#include "onnx/optimizer/pass.h"
+
+namespace ONNX_NAMESPACE {
+namespace optimization {
+
+// Rewrites a classifier head whose Softmax output is a graph output so that
+// the graph returns only what an exit decision needs: the top probability of
+// each sample, under the original output name, and its class index as a new
+// graph output appended after the existing ones.
+//
+//   X -> Softmax -> Y            X -> Softmax -> TopK(k=1) -> Y      [N, 1]
+//                          =>                          \--> Y_argmax [N, 1]
+//
+// The Softmax is kept because the top probability depends on all the logits.
+// Existing outputs keep their positions, so bindings by index stay valid.
+struct CanonicalizeExitHead final : public PredicateBasedPass {
+  explicit CanonicalizeExitHead()
+      : PredicateBasedPass(
+            PassType::Fuse,
+            PassEfficiency::Complete,
+            PassOptimizationType::ComputeMemory) {}
+
+  std::string getPassName() const override {
+    return "canonicalize_exit_head";
+  }
+
+  std::vector<NodeKind> getMatchedKinds() const override {
+    return {kSoftmax};
+  }
+
+  // The normalized axis, or -1 if the Softmax does not normalize over the
+  // innermost dimension of an output with known rank. The axis defaults to 1
+  // before opset 13 and to -1 from then on.
+  static int64_t innermost_axis(Node* softmax) {
+    if (!softmax->output()->has_sizes()) {
+      return -1;
+    }
+    const int64_t rank =
+        static_cast<int64_t>(softmax->output()->sizes().size());
+    const int64_t default_axis =
+        default_opset_version(*softmax->owningGraph()) >= 13 ? -1 : 1;
+    int64_t axis =
+        softmax->hasAttribute(kaxis) ? softmax->i(kaxis) : default_axis;
+    if (axis < 0) {
+      axis += rank;
+    }
+    return rank > 0 && axis == rank - 1 ? axis : -1;
+  }
+
+  static int64_t default_opset_version(Graph& graph) {
+    for (const auto& opset : graph.opset_versions_mutable()) {
+      if (opset.domain() == "" || opset.domain() == "ai.onnx") {
+        return opset.version();
+      }
+    }
+    return 0;
+  }
+
+  bool patternMatchPredicate(Node* node) override {
+    if (node->kind() != kSoftmax || innermost_axis(node) < 0) {
+      return false;
+    }
+    const auto& uses = node->output()->uses();
+    return uses.size() == 1 &&
+        uses[0].user == node->owningGraph()->return_node();
+  }
+
+  bool runTransform(Node* softmax, Graph& graph, NodeDestroyType&) override {
+    Value* probs = softmax->output();
+    const int64_t axis = innermost_axis(softmax);
+    const std::string name = probs->uniqueName();
+
+    Node* topk = graph.create(kTopK, 2);
+    topk->addInput(probs);
+    topk->i_(kaxis, axis);
+    if (default_opset_version(graph) < 10) {
+      topk->i_(kk, 1);
+    } else {
+      // The importer only accepts K as a constant.
+      Node* k = graph.create(kConstant, 1);
+      Tensor t;
+      t.sizes().push_back(static_cast<int64_t>(1));
+      t.int64s().push_back(1);
+      t.elem_type() = TensorProto_DataType_INT64;
+      k->t_(kvalue, t);
+      std::vector<Dimension> k_sizes = {1};
+      k->output()->setSizes(k_sizes);
+      k->output()->setElemType(TensorProto_DataType_INT64);
+      k->insertAfter(softmax);
+      topk->addInput(k->output());
+    }
+    topk->insertAfter(topk->inputs().back()->node());
+
+    std::vector<Dimension> sizes = probs->sizes();
+    sizes[axis] = Dimension(static_cast<int64_t>(1));
+    Value* values = topk->outputs()[0];
+    values->setSizes(sizes);
+    values->setElemType(probs->elemType());
+    Value* indices = topk->outputs()[1];
+    indices->setSizes(sizes);
+    indices->setElemType(TensorProto_DataType_INT64);
+
+    probs->setUniqueName(name + "_probs");
+    values->setUniqueName(name);
+    indices->setUniqueName(name + "_argmax");
+    graph.return_node()->replaceInputWith(probs, values);
+    graph.registerOutput(indices);
+    return true;
+  }
+};
+
+} // namespace optimization
+} // namespace ONNX_NAMESPACE
@@ -19,6 +19,10 @@ struct EliminateIdentity final : public PredicateBasedPass {
     return "eliminate_identity";
   }
 
+  std::vector<NodeKind> getMatchedKinds() const override {
+    return {kIdentity};
+  }
+
   bool patternMatchPredicate(Node* node) override {
     return node->kind() == kIdentity;
   }
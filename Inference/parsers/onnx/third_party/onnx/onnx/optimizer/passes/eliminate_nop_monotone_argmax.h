@@ -39,6 +39,10 @@ struct EliminateNopMonotoneArgmax final : public PredicateBasedPass {
     return false;
   }
 
+  std::vector<NodeKind> getMatchedKinds() const override {
+    return {kArgMax};
+  }
+
   bool patternMatchPredicate(Node* node) override {
     if (node->kind() == kArgMax) {
       if (node->hasAttribute(kaxis)) {
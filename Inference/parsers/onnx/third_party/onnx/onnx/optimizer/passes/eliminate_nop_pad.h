@@ -56,6 +56,10 @@ struct EliminateNopPad final : public PredicateBasedPass {
     return false;
   }
 
+  std::vector<NodeKind> getMatchedKinds() const override {
+    return {kPad};
+  }
+
   bool patternMatchPredicate(Node* node) override {
     return node->kind() == kPad;
   }
@@ -27,6 +27,10 @@ struct ExtractConstantToInitializer final : public PredicateBasedPass {
     return "extract_constant_to_initializer";
   }
 
+  std::vector<NodeKind> getMatchedKinds() const override {
+    return {kConstant};
+  }
+
   bool patternMatchPredicate(Node* node) override {
     return node->kind() == kConstant;
   }
@@ -30,6 +30,9 @@ struct FuseAddBiasIntoConv final : public PredicateBasedPass {
   std::string getPassName() const override {
     return "fuse_add_bias_into_conv";
   }
+  std::vector<NodeKind> getMatchedKinds() const override {
+    return {kAdd};
+  }
   bool patternMatchPredicate(Node* node) override {
     return node->kind() == kAdd && node->inputs()[0]->node()->kind() == kConv &&
         node->inputs()[0]->node()->inputs().size() == 2;
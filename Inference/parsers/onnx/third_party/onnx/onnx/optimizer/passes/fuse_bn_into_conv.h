@@ -159,6 +159,10 @@ struct FuseBNIntoConv final : public PredicateBasedPass {
     return true;
   }
 
+  std::vector<NodeKind> getMatchedKinds() const override {
+    return {kBatchNormalization};
+  }
+
   bool patternMatchPredicate(Node* node) override {
     return node->kind() == kBatchNormalization &&
         node->inputs()[0]->node()->kind() == kConv;
@@ -19,6 +19,10 @@ struct FuseConsecutiveLogSoftmax final : public PredicateBasedPass {
     return "fuse_consecutive_log_softmax";
   }
 
+  std::vector<NodeKind> getMatchedKinds() const override {
+    return {kLog};
+  }
+
   bool patternMatchPredicate(Node* node) override {
     return node->kind() == kLog && node->input()->node()->kind() == kSoftmax &&
         node->input()->uses().size() == 1;
@@ -29,6 +29,9 @@ struct FuseConsecutiveReduceUnsqueeze final : public PredicateBasedPass {
   std::string getPassName() const override {
     return "fuse_consecutive_reduce_unsqueeze";
   }
+  std::vector<NodeKind> getMatchedKinds() const override {
+    return {kUnsqueeze};
+  }
   bool patternMatchPredicate(Node* node) override {
     // check that the current node is of type Unsqueeze and has defined axes
     bool cur_node_check =
@@ -58,6 +58,10 @@ struct FuseConsecutiveSqueezes final : public PredicateBasedPass {
     return ret;
   }
 
+  std::vector<NodeKind> getMatchedKinds() const override {
+    return {kSqueeze};
+  }
+
   bool patternMatchPredicate(Node* node) override {
     return node->kind() == kSqueeze &&
         node->input()->node()->kind() == kSqueeze;
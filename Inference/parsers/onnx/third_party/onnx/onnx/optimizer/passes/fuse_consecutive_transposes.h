@@ -36,6 +36,10 @@ struct FuseConsecutiveTransposes final : public PredicateBasedPass {
     return ret;
   }
 
+  std::vector<NodeKind> getMatchedKinds() const override {
+    return {kTranspose};
+  }
+
   bool patternMatchPredicate(Node* node) override {
     return node->kind() == kTranspose &&
         node->input()->node()->kind() == kTranspose;
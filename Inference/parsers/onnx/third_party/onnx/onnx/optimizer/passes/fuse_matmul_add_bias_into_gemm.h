@@ -31,6 +31,9 @@ struct FuseMatMulAddBiasIntoGemm final : public PredicateBasedPass {
   std::string getPassName() const override {
     return "fuse_matmul_add_bias_into_gemm";
   }
+  std::vector<NodeKind> getMatchedKinds() const override {
+    return {kAdd};
+  }
   bool patternMatchPredicate(Node* node) override {
     return node->kind() == kAdd &&
         node->inputs()[0]->node()->kind() == kMatMul;
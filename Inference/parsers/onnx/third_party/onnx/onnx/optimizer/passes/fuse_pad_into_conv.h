@@ -29,6 +29,9 @@ struct FusePadIntoConv final : public PredicateBasedPass {
   std::string getPassName() const override {
     return "fuse_pad_into_conv";
   }
+  std::vector<NodeKind> getMatchedKinds() const override {
+    return {kConv};
+  }
   bool patternMatchPredicate(Node* node) override {
     return node->kind() == kConv && node->inputs()[0]->node()->kind() == kPad;
   }
@@ -23,10 +23,10 @@ class Reshape_5_4 final : public Adapter {
         const std::vector<int64_t>& int64s = node_ptr->t(kvalue).int64s();
         if (int64s.empty()) {
           // Also handle raw data
-          std::string raw_data = node_ptr->t(kvalue).raw();
-          ONNX_ASSERTM(raw_data.size() != 0 && raw_data.size() % 8 == 0,
+          const Tensor& value = node_ptr->t(kvalue);
+          ONNX_ASSERTM(value.raw_size() != 0 && value.raw_size() % 8 == 0,
               "Raw Data must be non-empty and size must be a multiple of 8");
-          int64_t* raw = (int64_t*) raw_data.c_str();
+          const int64_t* raw = (const int64_t*) value.raw_data();
           node->is_(
               kshape,
               std::vector<int64_t>(
@@ -24,11 +24,11 @@ struct Upsample_9_8 final : public Adapter {
           {
             std::vector<float> value = initializers[i].floats();
             if (initializers[i].is_raw_data()){
-              const std::string& bytes = initializers[i].raw();
+              const char* bytes = initializers[i].raw_data();
               value.insert(
                   value.end(),
-                  reinterpret_cast<const float*>(bytes.c_str()),
-                  reinterpret_cast<const float*>(bytes.c_str() + bytes.size()));
+                  reinterpret_cast<const float*>(bytes),
+                  reinterpret_cast<const float*>(bytes + initializers[i].raw_size()));
             }            
             std::vector<double> d_values;
             for (size_t j = 0; j < value.size(); j++)
@@ -57,11 +57,11 @@ struct Upsample_9_8 final : public Adapter {
         {
           std::vector<float> value = op->t(kvalue).floats();
           if (op->t(kvalue).is_raw_data()){
-            const std::string& bytes = op->t(kvalue).raw();
+            const char* bytes = op->t(kvalue).raw_data();
             value.insert(
                 value.end(),
-                reinterpret_cast<const float*>(bytes.c_str()),
-                reinterpret_cast<const float*>(bytes.c_str() + bytes.size()));
+                reinterpret_cast<const float*>(bytes),
+                reinterpret_cast<const float*>(bytes + op->t(kvalue).raw_size()));
           }
           std::vector<double> d_values;
           for (size_t j = 0; j < value.size(); j++)
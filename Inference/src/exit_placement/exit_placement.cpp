@@ -646,7 +646,8 @@ std::vector<float> Profiler::execute(const bool separate_or_not, const size_t& n
         int *copy_list;
         int size = (int) batch_size_s1_*sizeof(int);
         cudaMalloc(&copy_list, size);
-        max_reduction_r(exitPtr_device, copy_list, stream_1);
+        max_reduction_r(exitPtr_device, copy_list, batch_size_s1_,
+                        samplesCommon::exitHeadClasses(mEngine_s1->getBindingDimensions(2)), stream_1);
 
         int next_batch_size = batch_size_s2_;
         int *fake_copy_list;
@@ -696,7 +697,8 @@ std::vector<float> Profiler::execute(const bool separate_or_not, const size_t& n
 
             exitPtr = buffer_s1.getImmediateBuffer(2);
             exitPtr_device = static_cast<float*>(exitPtr->deviceBuffer.data());
-            max_reduction_r(exitPtr_device, copy_list, stream_1);
+            max_reduction_r(exitPtr_device, copy_list, batch_size_s1_,
+                            samplesCommon::exitHeadClasses(mEngine_s1->getBindingDimensions(2)), stream_1);
 
 
             std::shared_ptr<samplesCommon::ManagedBuffer> manBuf_ptr = buffer_s1.getImmediateBuffer(1);
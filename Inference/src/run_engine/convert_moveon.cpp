@@ -0,0 +1,49 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+// Converts the moveon json files of the exits of a model into one binary exit trace, which run_engine maps instead of
+// parsing the json on every run.
+//
+//   convert_moveon <output trace> <batch size> <exit layer>:<moveon json> [<exit layer>:<moveon json> ...]
+//
+// Exits are listed in the order the samples reach them, e.g. 9:moveon_l9.json 12:moveon_l12.json.
+
+#include "ExitTrace.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+int main(int argc, char** argv)
+{
+    if (argc < 4) {
+        std::cerr << "Usage: " << argv[0]
+                  << " <output trace> <batch size> <exit layer>:<moveon json> [<exit layer>:<moveon json> ...]"
+                  << std::endl;
+        return 1;
+    }
+    const int batch_size = std::atoi(argv[2]);
+    if (batch_size <= 0) {
+        std::cerr << "Invalid batch size " << argv[2] << std::endl;
+        return 1;
+    }
+    samplesCommon::ExitTrace trace(batch_size);
+    for (int i = 3; i < argc; i++) {
+        const std::string arg = argv[i];
+        const size_t colon = arg.find(':');
+        if (colon == std::string::npos || colon == 0) {
+            std::cerr << "Expected <exit layer>:<moveon json>, got " << arg << std::endl;
+            return 1;
+        }
+        if (!trace.addMoveonJson(std::atoi(arg.substr(0, colon).c_str()), arg.substr(colon + 1))) {
+            return 1;
+        }
+    }
+    if (!trace.write(argv[1])) {
+        return 1;
+    }
+    std::cout << "Wrote " << trace.getNbExits() << " exits of " << trace.size() << " samples to " << argv[1]
+              << std::endl;
+    return 0;
+}
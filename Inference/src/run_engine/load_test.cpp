@@ -0,0 +1,67 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+// Runs an open-loop load against a mock executor on the CPU and prints the latency percentiles, to see what p99 a
+// stage with a measured batch latency of base_ms + per_sample_ms * batch size would give at a request rate. To run a
+// load on the built engines instead, give the run_engine config a "load" section with the same options, e.g.
+// {"pattern": "step", "steps": "0:100,5:400", "duration": 10, "max_batch": 32}.
+//
+//   load_test [--pattern=poisson|bursty|step|trace] [--rate=100] [--duration=10] [--max_batch=32] [--window_ms=2]
+//             [--base_ms=2] [--per_sample_ms=0.1] [--workers=1] [--seed=1]
+//             [--burst_rate=1000] [--burst_ms=50] [--idle_ms=500]   bursty
+//             [--steps=0:100,5:400,10:100]                          step, <start s>:<rate>
+//             [--trace=arrivals.txt]                                trace, one arrival time in seconds per line
+
+#include "LoadGenerator.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+int main(int argc, char** argv)
+{
+    std::map<std::string, std::string> args{{"pattern", "poisson"}, {"rate", "100"}, {"duration", "10"},
+        {"max_batch", "32"}, {"window_ms", "2"}, {"base_ms", "2"}, {"per_sample_ms", "0.1"}, {"workers", "1"},
+        {"seed", "1"}, {"burst_rate", "1000"}, {"burst_ms", "50"}, {"idle_ms", "500"}, {"steps", ""}, {"trace", ""}};
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        const size_t equals = arg.find('=');
+        if (arg.compare(0, 2, "--") != 0 || equals == std::string::npos || !args.count(arg.substr(2, equals - 2))) {
+            std::cerr << "Unknown option " << arg << ", see the top of load_test.cpp" << std::endl;
+            return 1;
+        }
+        args[arg.substr(2, equals - 2)] = arg.substr(equals + 1);
+    }
+    const auto number = [&args](const std::string& key) { return std::atof(args[key].c_str()); };
+
+    samplesCommon::ArrivalConfig config;
+    if (!samplesCommon::parseArrivalConfig(args, config)) {
+        return 1;
+    }
+    const std::string& pattern = args["pattern"];
+
+    samplesCommon::BatchingPolicy policy;
+    policy.maxBatchSize = std::atoi(args["max_batch"].c_str());
+    policy.windowMs = number("window_ms");
+    const int workers = std::atoi(args["workers"].c_str());
+    if (policy.maxBatchSize <= 0 || workers <= 0) {
+        std::cerr << "--max_batch and --workers must be positive" << std::endl;
+        return 1;
+    }
+    std::vector<std::unique_ptr<samplesCommon::MockExecutor>> executors;
+    std::vector<samplesCommon::IBatchExecutor*> executor_ptrs;
+    for (int i = 0; i < workers; i++) {
+        executors.emplace_back(new samplesCommon::MockExecutor(number("base_ms"), number("per_sample_ms")));
+        executor_ptrs.push_back(executors.back().get());
+    }
+
+    const std::vector<double> arrivals = samplesCommon::generateArrivals(config, number("duration"));
+    std::cout << "Replaying " << arrivals.size() << " " << pattern << " arrivals over " << number("duration")
+              << " s on " << workers << " mock executor(s)" << std::endl;
+    samplesCommon::runOpenLoop(arrivals, executor_ptrs, policy).print(std::cout);
+    return 0;
+}
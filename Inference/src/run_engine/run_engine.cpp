@@ -55,10 +55,25 @@ const size_t& batch_size_s1, const size_t& batch_size_s2,
 bool Profiler::build(std::vector<std::string> model_name, int batch_size, int engine_per_stage)
 {
     int stage_num = model_name.size();
+    engine_per_stage_ = engine_per_stage;
     // mEngine_list = std::vector<std::shared_ptr<nvinfer1::ICudaEngine>>;
     // mContext_list = std::vector<std::shared_ptr<nvinfer1::IExecutionContext>>;
+    samplesCommon::OnnxSampleParams params;
+    params.dataDirs.emplace_back("/home/slzhang/projects/ETBA/Inference/src/run_engine/models");
+    TRTUniquePtr<nvonnxparser::IOnnxModel> previous_model;
     for (int i = 0; i < stage_num; i++){
         std::cout << "Building engines for stage " << i << std::endl;
+        // Decode the stage model and convert its weights once, all batch buckets of the stage reuse them.
+        // The engines are built inside the loop below, so the model only has to live until the stage is done.
+        auto onnx_model = TRTUniquePtr<nvonnxparser::IOnnxModel>(nvonnxparser::createOnnxModelFromFile(
+            locateFile(model_name[i] + ".onnx", params.dataDirs).c_str(), sample::gLogger.getTRTLogger()));
+        if (!onnx_model) {
+            std::cout << "Failed to load model " << model_name[i];
+            return false;
+        }
+        // Stages written against a shared weight file (ModelSplit/share_weights.py) pick up the layers they have
+        // in common with the previous stage while it is still loaded, so only release it now.
+        previous_model.reset();
         for (int j = 1; j <= engine_per_stage; j++){
 
             auto builder = TRTUniquePtr<nvinfer1::IBuilder>(nvinfer1::createInferBuilder(sample::gLogger.getTRTLogger()));
@@ -85,7 +100,7 @@ bool Profiler::build(std::vector<std::string> model_name, int batch_size, int en
                 return false;
             }
 
-            auto constructed = construct(builder, network, config, parser, model_name[i], 1, batch_size*j/engine_per_stage, batch_size*j/engine_per_stage);
+            auto constructed = construct(builder, network, config, parser, *onnx_model, model_name[i], 1, batch_size*j/engine_per_stage, batch_size*j/engine_per_stage);
             if (!constructed) {
                 std::cout << "Failed to construct network";
                 return false;
@@ -95,6 +110,7 @@ bool Profiler::build(std::vector<std::string> model_name, int batch_size, int en
             mContext_list.push_back(std::shared_ptr<nvinfer1::IExecutionContext>(mEngine_list[i*engine_per_stage+j-1]->createExecutionContext(), samplesCommon::InferDeleter()));
             std::cout << "Building engine for batch size: " << batch_size*j/engine_per_stage << std::endl;
         }
+        previous_model = std::move(onnx_model);
     }
     return true;
 }
@@ -104,14 +120,12 @@ bool Profiler::construct(
     TRTUniquePtr<nvinfer1::IBuilder>& builder,
     TRTUniquePtr<nvinfer1::INetworkDefinition>& network,
     TRTUniquePtr<nvinfer1::IBuilderConfig>& config,
-    TRTUniquePtr<nvonnxparser::IParser>& parser, std::string model_name, int min_bs, int opt_bs, int max_bs)
+    TRTUniquePtr<nvonnxparser::IParser>& parser, const nvonnxparser::IOnnxModel& onnx_model,
+    std::string model_name, int min_bs, int opt_bs, int max_bs)
 {
     auto profile = builder->createOptimizationProfile();
-    samplesCommon::OnnxSampleParams params;
-    params.dataDirs.emplace_back("/home/slzhang/projects/ETBA/Inference/src/run_engine/models");
-    //data_dir.push_back("samples/VGG16/");
-    auto parsed = parser->parseFromFile(locateFile(model_name + ".onnx", params.dataDirs).c_str(),
-    static_cast<int>(sample::gLogger.getReportableSeverity()));
+    parser->setVerbosity(static_cast<int>(sample::gLogger.getReportableSeverity()));
+    auto parsed = parser->parseFromModel(onnx_model);
     if (!parsed) {
         return false;
     }
@@ -210,42 +224,224 @@ bool Profiler::construct(
 
 
 
-std::vector<int> generate_copy_list(std::string movon_dict_path, int batch_size)
+bool is_moveon_json(const std::string& path)
 {
-    FILE* config_fp = fopen(movon_dict_path.c_str(), "r");
-    if(!config_fp){
-        std::cout<<"failed to open config.json"<<endl;
-    }
-    char read_buffer[65536];
-
-    rapidjson::FileReadStream config_fs(
-        config_fp, read_buffer, sizeof(read_buffer));
-    rapidjson::Document config_doc;
-    config_doc.ParseStream(config_fs);
+    return path.size() >= 5 && path.substr(path.size() - 5) == ".json";
+}
 
-    int num = config_doc.MemberEnd() - config_doc.MemberBegin();
+std::vector<int> generate_copy_list(std::string movon_dict_path, int batch_size, int exit_idx)
+{
+    // Survivors per batch of batch_size samples. Binary exit traces (convert_moveon) are mapped, legacy moveon json
+    // is streamed through the SAX reader; a trace with a single exit serves any exit_idx, like a json file does.
     std::vector<int> record_batch_size;
-    int idx = -1;
-    int total_cnt = 0;
-    for (auto& m : config_doc.GetObject()){
-        string name = to_string(idx);
-        rapidjson::Value& array = m.value;
-        size_t len = array.Size();
-        for(size_t i = 0; i < len; i++)
-        {
-            if (total_cnt%batch_size == 0) {
-                record_batch_size.push_back(0);
-                idx += 1;
+    if (is_moveon_json(movon_dict_path)) {
+        samplesCommon::ExitTrace trace(batch_size);
+        if (trace.addMoveonJson(exit_idx, movon_dict_path)) {
+            record_batch_size = trace.getMasks(0, batch_size).getSurvivorCounts();
+        }
+    }
+    else {
+        samplesCommon::ExitTraceFile trace;
+        if (trace.open(movon_dict_path)) {
+            const size_t exit = trace.getNbExits() == 1 ? 0 : exit_idx;
+            if (exit < trace.getNbExits()) {
+                record_batch_size = trace.getMasks(exit, batch_size).getSurvivorCounts();
+            }
+            else {
+                std::cout << movon_dict_path << " has no exit " << exit_idx << std::endl;
             }
-            record_batch_size[idx] += array[i].GetBool();
-            // record_batch_size[idx] += array[i].GetUint();
-            total_cnt += 1;
-            
         }
     }
     return record_batch_size;
 }
 
+bool Profiler::load_trace_replay(const std::vector<std::string>& paths, const uint32_t seed, const bool loop,
+                                 const int shard, const int nb_shards)
+{
+    if (shard < 0 || nb_shards <= 0 || shard >= nb_shards) {
+        std::cout << "Invalid replay shard " << shard << " of " << nb_shards << std::endl;
+        return false;
+    }
+    std::vector<samplesCommon::ExitMaskView> exits;
+    for (size_t i = 0; i < paths.size(); i++) {
+        if (is_moveon_json(paths[i])) {
+            exit_traces_.emplace_back(new samplesCommon::ExitTrace(batch_size_s1_));
+            if (!exit_traces_.back()->addMoveonJson(i, paths[i])) {
+                return false;
+            }
+            exits.push_back(exit_traces_.back()->getMasks(0, batch_size_s1_));
+        }
+        else {
+            exit_trace_files_.emplace_back(new samplesCommon::ExitTraceFile);
+            samplesCommon::ExitTraceFile& trace = *exit_trace_files_.back();
+            if (!trace.open(paths[i])) {
+                return false;
+            }
+            const size_t exit = trace.getNbExits() == 1 ? 0 : i;
+            if (exit >= trace.getNbExits()) {
+                std::cout << paths[i] << " has no exit " << i << std::endl;
+                return false;
+            }
+            exits.push_back(trace.getMasks(exit, batch_size_s1_));
+        }
+        if (exits.back().size() != exits[0].size()) {
+            std::cout << paths[i] << " covers " << exits.back().size() << " samples, " << paths[0] << " "
+                      << exits[0].size() << std::endl;
+            return false;
+        }
+    }
+    trace_replay_.reset(new samplesCommon::ExitTraceReplay(exits, seed, loop, shard, nb_shards));
+    std::cout << "Replaying " << trace_replay_->size() << " batches of " << exits.size() << " exits (shard " << shard
+              << "/" << nb_shards << ", seed " << seed << ")" << std::endl;
+    return trace_replay_->size() > 0;
+}
+
+bool Profiler::load_bert_data(const std::string& path)
+{
+    if (!bert_data_.open(path)) {
+        return false;
+    }
+    bert_data_.advise(samplesCommon::AccessPattern::kSEQUENTIAL);
+    std::cout << "Loaded " << bert_data_.size() << " BERT sequences from " << path << std::endl;
+    return true;
+}
+
+bool Profiler::feed_bert_inputs(const std::vector<void*>& bindings, const int batch_size, const int sequence_length,
+                                cudaStream_t stream)
+{
+    if (bert_data_.size() == 0) {
+        return false;
+    }
+    if (!bert_pipeline_) {
+        // The engines are built for one sequence length, so every sequence goes to that bucket.
+        bert_plan_.reset(new samplesCommon::SequenceBatchPlan(bert_data_, batch_size, {sequence_length}));
+        bert_pipeline_.reset(new samplesCommon::InputPipeline(batch_size,
+            samplesCommon::getSequencePipelineVolume(*bert_plan_), 3, 2,
+            samplesCommon::makePackedSequenceProducer(bert_data_, *bert_plan_)));
+        bert_pipeline_->start(0, bert_plan_->size());
+        if (bert_plan_->getNbTruncated() > 0) {
+            std::cout << bert_plan_->getNbTruncated() << " BERT sequences are longer than " << sequence_length
+                      << " tokens and are truncated" << std::endl;
+        }
+    }
+    samplesCommon::HostBatch* batch = bert_pipeline_->acquire();
+    if (!batch) {
+        // Loop over the data for as many batches as the benchmark runs. The copies of the last batches must have
+        // read their slots before the ring restarts.
+        CUDACHECK(cudaStreamSynchronize(stream));
+        bert_pipeline_->start(0, bert_plan_->size());
+        batch = bert_pipeline_->acquire();
+        if (!batch) {
+            std::cout << "No BERT batch could be prepared" << std::endl;
+            return false;
+        }
+    }
+    // Bindings 0, 1 and 2 are input_ids, segment_ids and input_mask, in the order of the packed planes.
+    const auto planes = samplesCommon::getSequenceBatchPlanes(*batch, batch_size, sequence_length);
+    const size_t bytes = samplesCommon::SequenceBatchPlanes::getBytes(batch_size, sequence_length);
+    CUDACHECK(cudaMemcpyAsync(bindings[0], planes.ids, bytes, cudaMemcpyHostToDevice, stream));
+    CUDACHECK(cudaMemcpyAsync(bindings[1], planes.segments, bytes, cudaMemcpyHostToDevice, stream));
+    CUDACHECK(cudaMemcpyAsync(bindings[2], planes.mask, bytes, cudaMemcpyHostToDevice, stream));
+    bert_pipeline_->release(batch, stream);
+    return true;
+}
+
+bool Profiler::capture_boundary(const int stage, const std::string& blob_path, const std::string& output_path,
+                                const bool fp16)
+{
+    if (stage <= 0 || stage * engine_per_stage_ > static_cast<int>(mEngine_list.size())) {
+        std::cout << "Stage " << stage << " has no built stage before it to capture from" << std::endl;
+        return false;
+    }
+    samplesCommon::CalibrationBlob blob;
+    if (!blob.open(blob_path)) {
+        return false;
+    }
+    const int batch_size = blob.getBatchSize();
+    if (batch_size > static_cast<int>(batch_size_s1_)) {
+        std::cout << "Calibration batches of " << batch_size << " exceed the engine batch size " << batch_size_s1_
+                  << std::endl;
+        return false;
+    }
+
+    // The largest engine of each stage runs the whole batch, and each stage reads the boundary buffer of the one
+    // before. No sample exits: the calibrator of the stage should see the activations of the whole set.
+    std::vector<samplesCommon::BufferManager> buffers;
+    buffers.reserve(stage);
+    std::vector<int> engine_idx;
+    for (int s = 0; s < stage; s++) {
+        const int idx = s * engine_per_stage_ + engine_per_stage_ - 1;
+        auto dims = mEngine_list[idx]->getBindingDimensions(0);
+        dims.d[0] = batch_size;
+        mContext_list[idx]->setBindingDimensions(0, dims);
+        const size_t input_volume = samplesCommon::volume(dims);
+        const size_t expected_volume = s == 0 ? blob.getBatchVolume()
+            : samplesCommon::volume(mContext_list[engine_idx.back()]->getBindingDimensions(1));
+        if (input_volume != expected_volume) {
+            std::cout << "Input of stage " << s << " does not match what feeds it: " << input_volume << " vs "
+                      << expected_volume << " values" << std::endl;
+            return false;
+        }
+        buffers.emplace_back(mEngine_list[idx], batch_size, s == 0 ? nullptr : buffers.back().getImmediateBuffer(1));
+        engine_idx.push_back(idx);
+    }
+    if (mEngine_list[engine_idx.back()]->getBindingDataType(1) != nvinfer1::DataType::kFLOAT) {
+        std::cout << "Boundary tensors of stage " << stage - 1 << " are not float" << std::endl;
+        return false;
+    }
+    const nvinfer1::Dims boundary_dims = mContext_list[engine_idx.back()]->getBindingDimensions(1);
+    nvinfer1::Dims sample_dims{};
+    sample_dims.nbDims = boundary_dims.nbDims - 1;
+    std::copy(boundary_dims.d + 1, boundary_dims.d + boundary_dims.nbDims, sample_dims.d);
+
+    samplesCommon::BoundaryTensorWriter writer;
+    if (!writer.open(output_path, sample_dims, fp16 ? nvinfer1::DataType::kHALF : nvinfer1::DataType::kFLOAT)) {
+        return false;
+    }
+    blob.prefetch(0, blob.getNbBatches());
+    std::shared_ptr<samplesCommon::ManagedBuffer> boundary = buffers.back().getImmediateBuffer(1);
+    // The blob is mapped pageable memory: stage each batch into the pinned back buffer of stage 0 and copy it in on
+    // its own stream, so that the next batch goes in while the stages run on the current one.
+    cudaStream_t copy_stream;
+    CUDACHECK(cudaStreamCreateWithFlags(&copy_stream, cudaStreamNonBlocking));
+    buffers[0].enableInputDoubleBuffering(copy_stream);
+    const size_t batch_bytes = blob.getBatchVolume() * sizeof(float);
+    bool captured = true;
+    if (blob.getNbBatches() > 0) {
+        std::memcpy(buffers[0].getStagedInputHostBuffer(0), blob.getBatch(0), batch_bytes);
+        buffers[0].copyStagedInputToDeviceAsync();
+    }
+    for (int b = 0; captured && b < blob.getNbBatches(); b++) {
+        buffers[0].swapStagedInputs(stream_0);
+        for (int s = 0; captured && s < stage; s++) {
+            if (!mContext_list[engine_idx[s]]->enqueueV2(buffers[s].getDeviceBindings().data(), stream_0, nullptr)) {
+                std::cout << "Error when inferring stage " << s << std::endl;
+                captured = false;
+            }
+        }
+        CUDACHECK(cudaMemcpyAsync(boundary->hostBuffer.data(), boundary->deviceBuffer.data(),
+                                  boundary->deviceBuffer.nbBytes(), cudaMemcpyDeviceToHost, stream_0));
+        if (b + 1 < blob.getNbBatches()) {
+            std::memcpy(buffers[0].getStagedInputHostBuffer(0), blob.getBatch(b + 1), batch_bytes);
+            buffers[0].copyStagedInputToDeviceAsync();
+        }
+        CUDACHECK(cudaStreamSynchronize(stream_0));
+        captured = captured && writer.append(static_cast<const float*>(boundary->hostBuffer.data()), batch_size);
+    }
+    // The copies of the last batches must be done before their buffers go back to the pool.
+    CUDACHECK(cudaStreamSynchronize(copy_stream));
+    CUDACHECK(cudaStreamDestroy(copy_stream));
+    if (!captured) {
+        return false;
+    }
+    if (!writer.close()) {
+        return false;
+    }
+    std::cout << "Captured " << writer.getNbSamples() << " boundary tensors " << sample_dims << " of stage "
+              << stage - 1 << " into " << output_path << std::endl;
+    return true;
+}
+
 std::vector<float> Profiler::bert_execute(const bool separate_or_not, const size_t& num_test,
                  const std::vector<int> record_batch_size, const int copy_method, const bool overload, std::string model_name)
 {
@@ -297,7 +493,8 @@ std::vector<float> Profiler::bert_execute(const bool separate_or_not, const size
     int *copy_list;
     int size = (int) batch_size_s1_*sizeof(int);
     cudaMalloc(&copy_list, size);
-    max_reduction_r(exitPtr_device, copy_list, stream_1);
+    max_reduction_r(exitPtr_device, copy_list, batch_size_s1_,
+                    samplesCommon::exitHeadClasses(mEngine_list[engine_idx_1]->getBindingDimensions(4)), stream_1);
 
     /* Engine2 Initilaize */
     int engine_idx_2 = (next_batch_size-1)/(batch_size_s1_/4)+4;
@@ -333,6 +530,8 @@ std::vector<float> Profiler::bert_execute(const bool separate_or_not, const size
         mContext_list[engine_idx_1]->setBindingDimensions(0, input_dims_s1);
         mContext_list[engine_idx_1]->setBindingDimensions(1, input_dims_s1);
         mContext_list[engine_idx_1]->setBindingDimensions(2, input_dims_s1);
+        // Real inputs are copied before the batch timing starts, like the zeros were before.
+        feed_bert_inputs(buffer_s1.getDeviceBindings(), batch_size_s1_, sequence_length, stream_1);
         CUDACHECK(cudaEventRecord(batch_start[i], stream_1));
         status_s1 = mContext_list[engine_idx_1]->enqueueV2(buffer_s1.getDeviceBindings().data(), stream_1, nullptr);
         if (!status_s1) {
@@ -417,6 +616,7 @@ std::vector<float> Profiler::bert_execute(const bool separate_or_not, const size
     CUDACHECK(cudaDeviceSynchronize());
     CUDACHECK(cudaEventElapsedTime(&elapsed_time, infer_start, s2_end));
     metrics.push_back(elapsed_time);
+    metrics.push_back(batch_num_);
     return metrics;
 }
 
@@ -460,7 +660,8 @@ std::vector<float> Profiler::execute_2stage(const bool separate_or_not, const si
     int *copy_list;
     int size = (int) batch_size_s1_*sizeof(int);
     cudaMalloc(&copy_list, size);
-    max_reduction_r(exitPtr_device, copy_list, stream_1);
+    max_reduction_r(exitPtr_device, copy_list, batch_size_s1_,
+                    samplesCommon::exitHeadClasses(mEngine_list[engine_idx_1]->getBindingDimensions(2)), stream_1);
 
     int engine_idx_2 = (next_batch_size-1)/(batch_size_s1_/4)+4;
     input_dims[engine_idx_2].d[0] = next_batch_size;
@@ -503,7 +704,8 @@ std::vector<float> Profiler::execute_2stage(const bool separate_or_not, const si
         exitPtr_device = static_cast<float*>(exitPtr->deviceBuffer.data());
 
         // CUDACHECK(cudaEventRecord(tmp_event_1[i], stream_1));
-        max_reduction_r(exitPtr_device, copy_list, stream_1);
+        max_reduction_r(exitPtr_device, copy_list, batch_size_s1_,
+                        samplesCommon::exitHeadClasses(mEngine_list[engine_idx_1]->getBindingDimensions(2)), stream_1);
         // CUDACHECK(cudaEventRecord(tmp_event_2[i], stream_1));
 
         next_batch_size = record_batch_size[std::rand()%(record_batch_size.size())];
@@ -593,6 +795,7 @@ std::vector<float> Profiler::execute_2stage(const bool separate_or_not, const si
     CUDACHECK(cudaDeviceSynchronize());
     CUDACHECK(cudaEventElapsedTime(&elapsed_time, infer_start, s2_end));
     metrics.push_back(elapsed_time);
+    metrics.push_back(batch_num_);
     return metrics;
 }
 
@@ -650,7 +853,8 @@ std::vector<float> Profiler::bert_execute_multi_stage(const bool separate_or_not
     int *copy_list;
     int size = (int) batch_size_s1_*sizeof(int);
     cudaMalloc(&copy_list, size);
-    max_reduction_r(exitPtr_device, copy_list, stream_1);
+    max_reduction_r(exitPtr_device, copy_list, batch_size_s1_,
+                    samplesCommon::exitHeadClasses(mEngine_list[engine_idx_1]->getBindingDimensions(4)), stream_1);
 
     /* Engine2 Initilaize */
     int engine_idx_2 = (next_batch_size-1)/(batch_size_s1_/4)+4;
@@ -670,7 +874,8 @@ std::vector<float> Profiler::bert_execute_multi_stage(const bool separate_or_not
     // Max_reduction
     exitPtr = buffer_s2.getImmediateBuffer(3);
     exitPtr_device = static_cast<float*>(exitPtr->deviceBuffer.data());
-    max_reduction_r(exitPtr_device, copy_list, stream_1);
+    max_reduction_r(exitPtr_device, copy_list, next_batch_size,
+                    samplesCommon::exitHeadClasses(mEngine_list[engine_idx_2]->getBindingDimensions(3)), stream_1);
 
 
     /* Engine3 Initialize */
@@ -709,6 +914,7 @@ std::vector<float> Profiler::bert_execute_multi_stage(const bool separate_or_not
         mContext_list[engine_idx_1]->setBindingDimensions(0, input_dims_s1);
         mContext_list[engine_idx_1]->setBindingDimensions(1, input_dims_s1);
         mContext_list[engine_idx_1]->setBindingDimensions(2, input_dims_s1);
+        feed_bert_inputs(buffer_s1.getDeviceBindings(), batch_size_s1_, sequence_length, stream_2);
         CUDACHECK(cudaEventRecord(batch_start[i], stream_2));
         status_s1 = mContext_list[engine_idx_1]->enqueueV2(buffer_s1.getDeviceBindings().data(), stream_2, nullptr);
         if (!status_s1) {
@@ -854,6 +1060,7 @@ std::vector<float> Profiler::bert_execute_multi_stage(const bool separate_or_not
     CUDACHECK(cudaDeviceSynchronize());
     CUDACHECK(cudaEventElapsedTime(&elapsed_time, infer_start, s2_end));
     metrics.push_back(elapsed_time);
+    metrics.push_back(batch_num_);
     return metrics;
 }
 
@@ -882,6 +1089,19 @@ std::vector<float> Profiler::execute_multi_stage(const bool separate_or_not, con
     }
     cudaMemcpy(fake_copy_list, fake_copy_list_host, (int) next_batch_size*sizeof(int), cudaMemcpyHostToDevice);
 
+    // With a trace replay, stages 2 and 3 gather the samples the recorded exits let through, one list per stage.
+    int* gather_list_1 = fake_copy_list;
+    int* gather_list_2 = fake_copy_list;
+    samplesCommon::ReplayBatch replay_batch;
+    if (trace_replay_) {
+        if (trace_replay_->getNbExits() < 2) {
+            std::cout << "A three stage replay needs the traces of two exits" << std::endl;
+            return metrics;
+        }
+        CUDACHECK(cudaMalloc(&gather_list_1, batch_size_s1_ * sizeof(int)));
+        CUDACHECK(cudaMalloc(&gather_list_2, batch_size_s1_ * sizeof(int)));
+    }
+
     /* Engine1 Initilaize */
     int engine_idx_1 = 3;
     input_dims[engine_idx_1].d[0] = batch_size_s1_;
@@ -900,7 +1120,8 @@ std::vector<float> Profiler::execute_multi_stage(const bool separate_or_not, con
     int *copy_list;
     int size = (int) batch_size_s1_*sizeof(int);
     cudaMalloc(&copy_list, size);
-    max_reduction_r(exitPtr_device, copy_list, stream_1);
+    max_reduction_r(exitPtr_device, copy_list, batch_size_s1_,
+                    samplesCommon::exitHeadClasses(mEngine_list[engine_idx_1]->getBindingDimensions(2)), stream_1);
 
     /* Engine2 Initilaize */
     int engine_idx_2 = (next_batch_size-1)/(batch_size_s1_/4)+4;
@@ -919,7 +1140,8 @@ std::vector<float> Profiler::execute_multi_stage(const bool separate_or_not, con
     // Max_reduction
     exitPtr = buffer_s2.getImmediateBuffer(2);
     exitPtr_device = static_cast<float*>(exitPtr->deviceBuffer.data());
-    max_reduction_r(exitPtr_device, copy_list, stream_1);
+    max_reduction_r(exitPtr_device, copy_list, next_batch_size,
+                    samplesCommon::exitHeadClasses(mEngine_list[engine_idx_2]->getBindingDimensions(2)), stream_1);
 
 
     /* Engine3 Initialize */
@@ -942,10 +1164,20 @@ std::vector<float> Profiler::execute_multi_stage(const bool separate_or_not, con
     CUDACHECK(cudaDeviceSynchronize());
     CUDACHECK(cudaEventRecord(infer_start, stream_2));
     std::cout << "Begin recording..." << std::endl;
-    for (int i = 0; i < batch_num_; i++){
+    int nb_batches = 0;
+    for (int i = 0; i < batch_num_; i++, nb_batches++){
         // buffer_s1.copyInputToDeviceAsync(stream_2);
         // CUDACHECK(cudaDeviceSynchronize());
 
+        // A replay that does not loop can end early; stop before timing a batch it has no exits for.
+        if (trace_replay_) {
+            if (!trace_replay_->next(replay_batch)) {
+                std::cout << "Trace replay ended after " << i << " batches" << std::endl;
+                break;
+            }
+            next_batch_size_1 = replay_batch.gather[0].size();
+        }
+
         engine_idx_1 = 3;
         mContext_list[engine_idx_1]->setBindingDimensions(0, input_dims[engine_idx_1]);
         CUDACHECK(cudaEventRecord(batch_start[i], stream_2));
@@ -956,9 +1188,12 @@ std::vector<float> Profiler::execute_multi_stage(const bool separate_or_not, con
 
         exitPtr = buffer_s1.getImmediateBuffer(2);
         exitPtr_device = static_cast<float*>(exitPtr->deviceBuffer.data());
-        max_reduction_r(exitPtr_device, copy_list, stream_2);
+        max_reduction_r(exitPtr_device, copy_list, batch_size_s1_,
+                        samplesCommon::exitHeadClasses(mEngine_list[engine_idx_1]->getBindingDimensions(2)), stream_2);
 
-        next_batch_size_1 = record_batch_size[0][std::rand()%(record_batch_size[0].size())];
+        if (!trace_replay_) {
+            next_batch_size_1 = record_batch_size[0][std::rand()%(record_batch_size[0].size())];
+        }
 
         // CUDACHECK(cudaDeviceSynchronize());
         if (next_batch_size_1 == 0) {
@@ -980,7 +1215,12 @@ std::vector<float> Profiler::execute_multi_stage(const bool separate_or_not, con
         dims.d[0] = 1;
         size_t singleVol = samplesCommon::volume(dims);
 
-        buffercopy(dstPtr_, srcPtr_, singleVol*next_batch_size_1, fake_copy_list, singleVol, stream_2);
+        if (trace_replay_) {
+            // Pageable source: the copy returns once the indices are staged, so the next batch may overwrite them.
+            CUDACHECK(cudaMemcpyAsync(gather_list_1, replay_batch.gather[0].data(), next_batch_size_1 * sizeof(int),
+                                      cudaMemcpyHostToDevice, stream_2));
+        }
+        buffercopy(dstPtr_, srcPtr_, singleVol*next_batch_size_1, gather_list_1, singleVol, stream_2);
 
         input_dims[engine_idx_2].d[0] = next_batch_size_1;
         mContext_list[engine_idx_2]->setBindingDimensions(0, input_dims[engine_idx_2]);
@@ -991,9 +1231,11 @@ std::vector<float> Profiler::execute_multi_stage(const bool separate_or_not, con
 
         exitPtr = buffer_s2.getImmediateBuffer(2);
         exitPtr_device = static_cast<float*>(exitPtr->deviceBuffer.data());
-        max_reduction_r(exitPtr_device, copy_list, stream_1);
+        max_reduction_r(exitPtr_device, copy_list, next_batch_size_1,
+                        samplesCommon::exitHeadClasses(mEngine_list[engine_idx_2]->getBindingDimensions(2)), stream_1);
 
-        next_batch_size_2 = record_batch_size[1][std::rand()%(record_batch_size[1].size())];
+        next_batch_size_2 = trace_replay_ ? replay_batch.gather[1].size()
+            : record_batch_size[1][std::rand()%(record_batch_size[1].size())];
         // CUDACHECK(cudaDeviceSynchronize());
         if (next_batch_size_2 == 0) {
             CUDACHECK(cudaEventRecord(batch_end[i], stream_1));
@@ -1010,7 +1252,11 @@ std::vector<float> Profiler::execute_multi_stage(const bool separate_or_not, con
         dstPtr_ = static_cast<float*>(new_manBuf->deviceBuffer.data());
         srcPtr_ = static_cast<float*>(manBuf_ptr->deviceBuffer.data());
 
-        buffercopy(dstPtr_, srcPtr_, singleVol*next_batch_size_2, fake_copy_list, singleVol, stream_1);
+        if (trace_replay_) {
+            CUDACHECK(cudaMemcpyAsync(gather_list_2, replay_batch.gather[1].data(), next_batch_size_2 * sizeof(int),
+                                      cudaMemcpyHostToDevice, stream_1));
+        }
+        buffercopy(dstPtr_, srcPtr_, singleVol*next_batch_size_2, gather_list_2, singleVol, stream_1);
 
         input_dims[engine_idx_3].d[0] = next_batch_size_2;
         mContext_list[engine_idx_3]->setBindingDimensions(0, input_dims[engine_idx_3]);
@@ -1041,7 +1287,7 @@ std::vector<float> Profiler::execute_multi_stage(const bool separate_or_not, con
         }
     }
     std::cout << "Violation rate: " << violation/batch_time_record.size() << std::endl;
-    float avg_batch_time = sum_batch_time / (batch_num_-warmup_num);
+    float avg_batch_time = sum_batch_time / std::max<size_t>(batch_time_record.size(), 1);
     std::cout << "Average query time: " << avg_batch_time << " ms" << std::endl;
 
     CUDACHECK(cudaDeviceSynchronize());
@@ -1049,12 +1295,155 @@ std::vector<float> Profiler::execute_multi_stage(const bool separate_or_not, con
     CUDACHECK(cudaDeviceSynchronize());
     CUDACHECK(cudaEventElapsedTime(&elapsed_time, infer_start, s2_end));
     metrics.push_back(elapsed_time);
+    metrics.push_back(nb_batches);
+    if (trace_replay_) {
+        CUDACHECK(cudaFree(gather_list_1));
+        CUDACHECK(cudaFree(gather_list_2));
+    }
     return metrics;
 }
 
 
 
 
+MultiStageExecutor::MultiStageExecutor(Profiler& profiler, const std::vector<std::vector<int>>& record_batch_size,
+                                       const int copy_method)
+: profiler_(profiler), record_batch_size_(record_batch_size)
+{
+    const size_t batch_size = profiler_.batch_size_s1_;
+    CUDACHECK(cudaMalloc(&copy_list_, batch_size * sizeof(int)));
+    // The samples that go on are gathered from the front of the batch, which holds the live rows of a short batch.
+    std::vector<int> gather_list_host(batch_size);
+    std::iota(gather_list_host.begin(), gather_list_host.end(), 0);
+    CUDACHECK(cudaMalloc(&gather_list_, batch_size * sizeof(int)));
+    CUDACHECK(cudaMemcpy(gather_list_, gather_list_host.data(), batch_size * sizeof(int), cudaMemcpyHostToDevice));
+
+    // Sized for full batches, by the last engine of each stage, like in execute_multi_stage.
+    for (int stage = 0; stage < 3; stage++) {
+        const int engine_idx = 4 * stage + 3;
+        profiler_.input_dims[engine_idx].d[0] = batch_size;
+        profiler_.mContext_list[engine_idx]->setBindingDimensions(0, profiler_.input_dims[engine_idx]);
+    }
+    buffer_s1_.reset(new samplesCommon::BufferManager(profiler_.mEngine_list[3], batch_size));
+    buffer_s2_.reset(new samplesCommon::BufferManager(profiler_.mEngine_list[7], batch_size,
+                     buffer_s1_->getImmediateBuffer(1), gather_list_, batch_size, copy_method));
+    buffer_s3_.reset(new samplesCommon::BufferManager(profiler_.mEngine_list[11], batch_size,
+                     buffer_s2_->getImmediateBuffer(1), gather_list_, batch_size, copy_method));
+    buffer_s1_->copyInputToDeviceAsync(profiler_.stream_1);
+    CUDACHECK(cudaDeviceSynchronize());
+}
+
+MultiStageExecutor::~MultiStageExecutor()
+{
+    cudaStreamSynchronize(profiler_.stream_1);
+    cudaFree(copy_list_);
+    cudaFree(gather_list_);
+}
+
+void MultiStageExecutor::execute(int batchSize)
+{
+    const int full_batch = profiler_.batch_size_s1_;
+    const cudaStream_t stream = profiler_.stream_1;
+    const int batch_size = std::min(std::max(batchSize, 1), full_batch);
+    // With a trace replay, a batch takes the exits of the front samples of the next trace batch. Once a replay that
+    // does not loop has run out, the exits are drawn from the recorded batch sizes again.
+    const bool replay = profiler_.trace_replay_ && !replay_ended_;
+    if (replay && !profiler_.trace_replay_->next(replay_batch_)) {
+        std::cout << "Trace replay ended, drawing the exits from the recorded batch sizes" << std::endl;
+        replay_ended_ = true;
+    }
+    int next_batch_size = batch_size;
+    std::vector<samplesCommon::BufferManager*> buffers{buffer_s1_.get(), buffer_s2_.get(), buffer_s3_.get()};
+    for (int stage = 0; stage < 3 && next_batch_size > 0; stage++) {
+        // Engine 4 * stage + k is built for up to full_batch * (k + 1) / 4 samples; take the smallest that fits. Unlike
+        // dividing by full_batch / 4, this also holds for full batches smaller than 4 or that 4 does not divide.
+        const int engine_idx = (4 * next_batch_size + full_batch - 1) / full_batch - 1 + 4 * stage;
+        if (stage > 0) {
+            std::shared_ptr<samplesCommon::ManagedBuffer> src = buffers[stage - 1]->getImmediateBuffer(1);
+            std::shared_ptr<samplesCommon::ManagedBuffer> dst = buffers[stage]->getImmediateBuffer(0);
+            auto dims = profiler_.mEngine_list[engine_idx]->getBindingDimensions(0);
+            dims.d[0] = 1;
+            const size_t singleVol = samplesCommon::volume(dims);
+            buffercopy(static_cast<float*>(dst->deviceBuffer.data()), static_cast<float*>(src->deviceBuffer.data()),
+                       singleVol * next_batch_size, gather_list_, singleVol, stream);
+        }
+        profiler_.input_dims[engine_idx].d[0] = next_batch_size;
+        profiler_.mContext_list[engine_idx]->setBindingDimensions(0, profiler_.input_dims[engine_idx]);
+        if (!profiler_.mContext_list[engine_idx]->enqueueV2(buffers[stage]->getDeviceBindings().data(), stream,
+                                                            nullptr)) {
+            std::cout << "Error when inferring S" << stage + 1 << " model" << std::endl;
+            break;
+        }
+        if (stage == 2) {
+            break;
+        }
+        std::shared_ptr<samplesCommon::ManagedBuffer> exitPtr = buffers[stage]->getImmediateBuffer(2);
+        max_reduction_r(static_cast<float*>(exitPtr->deviceBuffer.data()), copy_list_, next_batch_size,
+                        samplesCommon::exitHeadClasses(profiler_.mEngine_list[engine_idx]->getBindingDimensions(2)),
+                        stream);
+        if (replay && !replay_ended_ && stage < static_cast<int>(replay_batch_.gather.size())) {
+            // The samples of this batch are the front of the trace batch, and compaction keeps their order, so those
+            // that go on are the gather indices that fall inside this stage's batch.
+            const std::vector<int>& gather = replay_batch_.gather[stage];
+            next_batch_size = static_cast<int>(
+                std::lower_bound(gather.begin(), gather.end(), next_batch_size) - gather.begin());
+        }
+        else {
+            // The recorded exits count the samples of a full batch that go on; scale them to this one.
+            const std::vector<int>& record = record_batch_size_[stage];
+            const int recorded = record[std::rand() % record.size()];
+            next_batch_size = std::min(next_batch_size,
+                static_cast<int>(std::lround(static_cast<double>(recorded) * batch_size / full_batch)));
+        }
+    }
+    CUDACHECK(cudaStreamSynchronize(stream));
+}
+
+// Load mode: the stages of execute_multi_stage under an open-loop arrival pattern, batched as requests arrive,
+// instead of back-to-back full batches. Prints the latency percentiles of the requests.
+int run_load(Profiler& inst, const rapidjson::Value& load, const std::vector<std::vector<int>>& record_batch_size,
+             const int copy_method, const int max_batch_size)
+{
+    // The options of load_test, as JSON strings and numbers.
+    std::map<std::string, std::string> options{{"pattern", "poisson"}};
+    for (auto member = load.MemberBegin(); member != load.MemberEnd(); ++member) {
+        std::ostringstream value;
+        if (member->value.IsString()) {
+            value << member->value.GetString();
+        } else if (member->value.IsNumber()) {
+            value << std::setprecision(17) << member->value.GetDouble();
+        } else {
+            std::cout << "Load option " << member->name.GetString() << " must be a string or a number" << std::endl;
+            return -1;
+        }
+        options[member->name.GetString()] = value.str();
+    }
+    const auto number = [&options](const char* key, double fallback) {
+        return options.count(key) ? std::atof(options[key].c_str()) : fallback;
+    };
+    samplesCommon::ArrivalConfig config;
+    if (!samplesCommon::parseArrivalConfig(options, config)) {
+        return -1;
+    }
+    const std::string& pattern = options["pattern"];
+
+    samplesCommon::BatchingPolicy policy;
+    policy.maxBatchSize = std::min(static_cast<int>(number("max_batch", max_batch_size)), max_batch_size);
+    policy.windowMs = number("window_ms", policy.windowMs);
+    if (policy.maxBatchSize <= 0) {
+        std::cout << "The batches of a load must hold at least one request" << std::endl;
+        return -1;
+    }
+
+    const double duration = number("duration", 10.0);
+    const std::vector<double> arrivals = samplesCommon::generateArrivals(config, duration);
+    MultiStageExecutor executor(inst, record_batch_size, copy_method);
+    std::cout << "Replaying " << arrivals.size() << " " << pattern << " arrivals over " << duration
+              << " s on the staged engines" << std::endl;
+    samplesCommon::runOpenLoop(arrivals, {&executor}, policy).print(std::cout);
+    return 0;
+}
+
 bool model_generation(std::string model_name, const int start_point, const int end_point)
 {
     PyRun_SimpleString("import sys");
@@ -1119,7 +1508,11 @@ int main(int argc, char** argv)
                             nvinfer1::ILogger::Severity::kERROR);
 
     std::string movon_dict_path_1 = config_doc["moveon_dict_path_1"].GetString();
-    std::vector<int> record_batch_size = generate_copy_list(movon_dict_path_1, infer_batch_size_s1);
+    std::vector<int> record_batch_size = generate_copy_list(movon_dict_path_1, infer_batch_size_s1, 0);
+    if (record_batch_size.empty()) {
+        std::cout << "failed to load " << movon_dict_path_1 << endl;
+        return -1;
+    }
     std::vector<std::string> model_name_list;
     model_name_list.push_back(config_doc["model_1"].GetString());
     model_name_list.push_back(config_doc["model_2"].GetString());
@@ -1128,15 +1521,58 @@ int main(int argc, char** argv)
     if (stage_num > 2) {
         multi_record_batch_size.push_back(record_batch_size);
         std::string movon_dict_path_2 = config_doc["moveon_dict_path_2"].GetString();
-        std::vector<int> record_batch_size_2 = generate_copy_list(movon_dict_path_2, infer_batch_size_s1);
+        std::vector<int> record_batch_size_2 = generate_copy_list(movon_dict_path_2, infer_batch_size_s1, 1);
+        if (record_batch_size_2.empty()) {
+            std::cout << "failed to load " << movon_dict_path_2 << endl;
+            return -1;
+        }
         multi_record_batch_size.push_back(record_batch_size_2);
         model_name_list.push_back(config_doc["model_3"].GetString());
     }
 
+    // Optional replay of the recorded exit masks, in order, instead of sampling each stage's batch size on its own.
+    if (config_doc.HasMember("trace_replay")) {
+        const rapidjson::Value& replay = config_doc["trace_replay"];
+        std::vector<std::string> trace_paths{movon_dict_path_1};
+        if (stage_num > 2) {
+            trace_paths.push_back(config_doc["moveon_dict_path_2"].GetString());
+        }
+        if (!inst.load_trace_replay(trace_paths, replay.HasMember("seed") ? replay["seed"].GetUint() : 0,
+                                    !replay.HasMember("loop") || replay["loop"].GetBool(),
+                                    replay.HasMember("shard") ? replay["shard"].GetInt() : 0,
+                                    replay.HasMember("nb_shards") ? replay["nb_shards"].GetInt() : 1)) {
+            return -1;
+        }
+    }
+
+    // Optional packed BERT inputs; without them the BERT engines run on zeros.
+    if (model_name == "bert" && config_doc.HasMember("bert_data")) {
+        if (!inst.load_bert_data(config_doc["bert_data"].GetString())) {
+            return -1;
+        }
+    }
+
     std::cout << "Building engines ..." << std::endl;
     inst.build(model_name_list, infer_batch_size_s1, 4);
     std::cout << "Building finished!" << std::endl;
 
+    // Capture mode: record the inputs of a later stage for its INT8 calibrator instead of benchmarking.
+    if (config_doc.HasMember("capture_boundary")) {
+        const rapidjson::Value& capture = config_doc["capture_boundary"];
+        const bool fp16 = capture.HasMember("fp16") && capture["fp16"].GetBool();
+        return inst.capture_boundary(capture["stage"].GetInt(), capture["calibration_blob"].GetString(),
+                                     capture["output"].GetString(), fp16) ? 0 : -1;
+    }
+
+    if (config_doc.HasMember("load")) {
+        if (model_name == "bert" || stage_num < 3) {
+            std::cout << "Load mode runs the three stage pipeline of execute_multi_stage" << std::endl;
+            return -1;
+        }
+        return run_load(inst, config_doc["load"], multi_record_batch_size, config_doc["copy_method"].GetUint(),
+                        infer_batch_size_s1);
+    }
+
     std::vector<float> metrics;
     if (model_name == "bert"){
         if (stage_num == 2){
@@ -1163,8 +1599,13 @@ int main(int argc, char** argv)
         }           
     }
 
-    std::cout << "Batch size: " << infer_batch_size_s2 << "/" << infer_batch_size_s1 << "  Elapsed time: " << metrics[0]/inst.batch_num_ << std::endl;
-    elapsed_time.push_back(metrics[0]/inst.batch_num_);
+    if (metrics.size() < 2 || metrics[1] == 0) {
+        std::cout << "No batch was run" << std::endl;
+        return -1;
+    }
+    // metrics[1] is the number of batches run, fewer than batch_num_ if a trace replay ended early.
+    std::cout << "Batch size: " << infer_batch_size_s2 << "/" << infer_batch_size_s1 << "  Elapsed time: " << metrics[0]/metrics[1] << std::endl;
+    elapsed_time.push_back(metrics[0]/metrics[1]);
     
     outFile.open("/home/slzhang/projects/ETBA/Inference/src/run_engine/config_" + model_name + "_" +
                     to_string(config_doc["bs_s1"].GetUint()) + ".csv", ios::app);
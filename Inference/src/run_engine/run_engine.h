@@ -3,6 +3,11 @@
 // #include "bertbuffers.h"
 #include "common.h"
 #include "logger.h"
+#include "BoundaryTensors.h"
+#include "CalibrationData.h"
+#include "ExitTrace.h"
+#include "LoadGenerator.h"
+#include "PackedSequences.h"
 
 #include "parserOnnxConfig.h"
 #include "NvCaffeParser.h"
@@ -19,6 +24,10 @@
 #include <chrono>
 #include <random>
 #include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <iomanip>
+#include <map>
 // #include <torch/torch.h>
 #include "../cuda_func/check_exit.cuh"
 
@@ -50,6 +59,7 @@ public:
     // void generate_copy_list();
     std::vector<float> infer(const bool separate_or_not, const size_t& num_test,
                              const int batch_idx, const int copy_method, const bool overload, std::string model_name);
+    // The execute functions return the elapsed time in ms and the number of batches run.
     std::vector<float> execute_2stage(const bool separate_or_not, const size_t& num_test,
                              const std::vector<int> record_batch_size, const int copy_method, const bool overload, std::string model_name);
     std::vector<float> execute_multi_stage(const bool separate_or_not, const size_t& num_test,
@@ -58,11 +68,23 @@ public:
                              const std::vector<int> record_batch_size, const int copy_method, const bool overload, std::string model_name);
     std::vector<float> bert_execute_multi_stage(const bool separate_or_not, const size_t& num_test,
                              const std::vector<std::vector<int>> record_batch_size, const int copy_method, const bool overload, std::string model_name);
+    // Feed the BERT engines the sequences of a packed sequence file instead of zeros.
+    bool load_bert_data(const std::string& path);
+    // Run stages [0, stage) on a calibration blob and write the boundary tensors that stage consumes, to calibrate it.
+    bool capture_boundary(const int stage, const std::string& blob_path, const std::string& output_path,
+                          const bool fp16);
+    // Compact the stages of execute_multi_stage by the recorded exit masks, one path per exit, instead of sampling
+    // batch sizes. Each path is a moveon json or a binary exit trace.
+    bool load_trace_replay(const std::vector<std::string>& paths, const uint32_t seed, const bool loop,
+                           const int shard, const int nb_shards);
 
 private:
+    friend class MultiStageExecutor;
+
     nvinfer1::DataType model_dtype_;
     bool fp16_{false};
     bool int8_{false};
+    int engine_per_stage_{4};
 
     cudaStream_t stream_0;
     cudaStream_t stream_1;
@@ -104,6 +126,16 @@ private:
     std::shared_ptr<nvinfer1::IExecutionContext> mContext_s1;
     std::shared_ptr<nvinfer1::IExecutionContext> mContext_s2;
     // samplesCommon::BufferManager mBufferManager;
+    // Declared in this order so that the pipeline stops before the plan and file it reads go away.
+    samplesCommon::PackedSequenceFile bert_data_;
+    std::unique_ptr<samplesCommon::SequenceBatchPlan> bert_plan_;
+    std::unique_ptr<samplesCommon::InputPipeline> bert_pipeline_;
+    // Declared before the replay that reads their masks.
+    std::vector<std::unique_ptr<samplesCommon::ExitTrace>> exit_traces_;
+    std::vector<std::unique_ptr<samplesCommon::ExitTraceFile>> exit_trace_files_;
+    std::unique_ptr<samplesCommon::ExitTraceReplay> trace_replay_;
+    bool feed_bert_inputs(const std::vector<void*>& bindings, const int batch_size, const int sequence_length,
+                          cudaStream_t stream);
     bool construct_s0(
         TRTUniquePtr<nvinfer1::IBuilder>& builder,
         TRTUniquePtr<nvinfer1::INetworkDefinition>& network,
@@ -123,5 +155,31 @@ private:
         TRTUniquePtr<nvinfer1::IBuilder>& builder,
         TRTUniquePtr<nvinfer1::INetworkDefinition>& network,
         TRTUniquePtr<nvinfer1::IBuilderConfig>& config,
-        TRTUniquePtr<nvonnxparser::IParser>& parser, std::string model_name, int min_bs, int opt_bs, int max_bs);
+        TRTUniquePtr<nvonnxparser::IParser>& parser, const nvonnxparser::IOnnxModel& onnx_model,
+        std::string model_name, int min_bs, int opt_bs, int max_bs);
+};
+
+// The three stages of execute_multi_stage, one batch per execute(), for the open-loop load harness of
+// LoadGenerator.h. Stage 1 runs on the batch as the harness closed it; stages 2 and 3 on the samples that the
+// recorded exits let through, scaled from the engine batch size to the batch. Batches must not exceed bs_s1, and the
+// executor uses the profiler's engines and streams, so the harness must drive it from a single worker.
+class MultiStageExecutor : public samplesCommon::IBatchExecutor
+{
+public:
+    MultiStageExecutor(Profiler& profiler, const std::vector<std::vector<int>>& record_batch_size,
+                       const int copy_method);
+    ~MultiStageExecutor();
+
+    void execute(int batchSize) override;
+
+private:
+    Profiler& profiler_;
+    std::vector<std::vector<int>> record_batch_size_;
+    int* copy_list_{nullptr};
+    int* gather_list_{nullptr};
+    std::unique_ptr<samplesCommon::BufferManager> buffer_s1_;
+    std::unique_ptr<samplesCommon::BufferManager> buffer_s2_;
+    std::unique_ptr<samplesCommon::BufferManager> buffer_s3_;
+    samplesCommon::ReplayBatch replay_batch_;
+    bool replay_ended_{false};
 };
\ No newline at end of file
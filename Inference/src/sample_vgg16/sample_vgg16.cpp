@@ -140,8 +140,14 @@ bool Profiler::build()
         ee_contexts_.emplace_back(std::shared_ptr<nvinfer1::IExecutionContext>(
             tmp_engine->createExecutionContext(), samplesCommon::InferDeleter()));
     }
-    readData();
+    if (!readData()) {
+        return false;
+    }
     std::cout << "Read data successfully" << std::endl;
+    // Prepare the input batches on worker threads so that infer() only has to copy them to the device.
+    input_pipeline_.reset(new samplesCommon::InputPipeline(max_batch_size_, cifar_dataset_.getFormat().pixelBytes(),
+        input_slots_, input_workers_, [this](samplesCommon::HostBatch& batch) { return processInput(batch); }));
+    input_pipeline_->start(0, batch_num_);
     return true;
 }
 
@@ -268,12 +274,16 @@ bool Profiler::infer(const size_t& num_test, const size_t& batch_size, const int
             sub_buffer_manager_.emplace_back(std::move(tmp_buffer));
             sub_batch_size[i+1] = sub_batch_size[i];
 
-            if (!processInput(sub_buffer_manager_[i], 0))
+            samplesCommon::HostBatch* batch = input_pipeline_->acquire();
+            if (!batch || batch->index != batch_idx)
             {
+                std::cout << "Input batch " << batch_idx << " is not available" << std::endl;
                 return false;
             }
-            // Memcpy from host input buffers to device input buffers
-            sub_buffer_manager_[i].copyInputToDevice();
+            // Copy straight from the pipeline's slot, which goes back to the workers once the copy is done.
+            CUDACHECK(cudaMemcpyAsync(sub_buffer_manager_[i].getDeviceBuffer(sub_input_tensor_names_[0]),
+                batch->data, input_pipeline_->getBatchBytes(), cudaMemcpyHostToDevice, stream_[0]));
+            input_pipeline_->release(batch, stream_[0]);
 
             auto status1 = sub_contexts_[i]->enqueueV2(sub_buffer_manager_[i].getDeviceBindings().data(), stream_[0], nullptr);
             if (!status1) {
@@ -327,7 +337,9 @@ bool Profiler::infer(const size_t& num_test, const size_t& batch_size, const int
                 return false;
             }
 
-            ee_buffer_manager_[map_i].copyOutputToHost();
+            // Wait for the exit only: a synchronous copy would also wait for the main branch on stream_[0].
+            ee_buffer_manager_[map_i].copyOutputToHostAsync(stream_[1]);
+            CUDACHECK(cudaStreamSynchronize(stream_[1]));
 
             auto controlled = controller(i, map_i);
             if (!controlled) {
@@ -381,7 +393,8 @@ bool Profiler::infer(const size_t& num_test, const size_t& batch_size, const int
                 std::cout << "Error when inference " << i << "-th sub model" << std::endl;
                 return false;
             }
-            sub_buffer_manager_[i].copyOutputToHost();
+            sub_buffer_manager_[i].copyOutputToHostAsync(stream_[0]);
+            CUDACHECK(cudaStreamSynchronize(stream_[0]));
 
             std::vector<int> final_list;
             for (size_t i = 0; i < max_batch_size_; i++){
@@ -476,20 +489,14 @@ bool Profiler::controller(const int stage_idx, const int ee_idx)
 
 float Profiler::verifyOutput(const samplesCommon::BufferManager& buffer, const std::vector<int> check_list, const int batch_idx = 0)
 {
-    const int inputC = 3;
-    const int inputH = 32;
-    const int inputW = 32;
     //const int batchSize = mParams.batchSize;
-    const int volImg = inputC * inputH * inputW;
-    const int imageSize = volImg + 1;
-    int i = 0;
     float* output = static_cast<float*>(buffer.getOutputHostBuffer());
     int maxposition{0};
     int count{0};
     for (size_t i = 0; i < check_list.size(); i++) {
         maxposition = std::max_element(output+10*i, output+10*i + 10) - (output+10*i);
-        //std::cout << "maxposition: " << maxposition << " correctposition: " << int(cifarbinary[(i+32) * imageSize]) << endl;
-        if (maxposition == int(cifarbinary[(check_list[i] + max_batch_size_ * batch_idx) * imageSize])) {
+        //std::cout << "maxposition: " << maxposition << " correctposition: " << cifar_dataset_.label(i+32) << endl;
+        if (maxposition == cifar_dataset_.label(check_list[i] + max_batch_size_ * batch_idx)) {
             ++count;
         }
     }
@@ -505,41 +512,43 @@ bool Profiler::readData()
 {
     samplesCommon::OnnxSampleParams params;
     params.dataDirs.emplace_back("data/cifar10");
-    // 5 batchbinary files
+    // The 5 batch binary files, mapped in order as one dataset of 50000 records
+    std::vector<std::string> files;
     for (int index = 0; index < 5; ++index) {
-        // Read cifar10 original binary file
-        readBinaryFile(locateFile("data_batch_" + std::to_string(index + 1) + ".bin", params.dataDirs), cifarbinary);
+        files.emplace_back(locateFile("data_batch_" + std::to_string(index + 1) + ".bin", params.dataDirs));
     }
+    if (!cifar_dataset_.open(files, samplesCommon::DatasetFormat::cifar10())) {
+        return false;
+    }
+    cifar_dataset_.advise(samplesCommon::AccessPattern::kSEQUENTIAL);
+    std::cout << "Mapped " << cifar_dataset_.size() << " records" << std::endl;
     return true;
 }
 
-bool Profiler::processInput(const samplesCommon::BufferManager& buffer, const int batch_idx = 0)
+bool Profiler::processInput(samplesCommon::HostBatch& batch)
 {
-    std::cout << "Pre processing begin." << std::endl;
     const int inputC = 3;
-    const int inputH = 32;
-    const int inputW = 32;
-    //const int batchSize = mParams.batchSize;
-    const int volImg = inputC * inputH * inputW;
-    const int imageSize = volImg + 1;
-    const int outputSize = 10;
-    float* hostDataBuffer = static_cast<float*>(buffer.getHostBuffer(sub_input_tensor_names_[0]));
-      
-        for (int i = 0; i < max_batch_size_; ++i) {
-            for (int j = 0; j < 32 * 32 * 3; ++j) {
-                //RGB format
-                if (j < 32*32) {
-                    hostDataBuffer[i*volImg+j] = (float(cifarbinary[(i + max_batch_size_ * batch_idx) * imageSize + j])/255.0-0.485)/0.229;
-                }
-                else if (j < 32*32*2) {
-                    hostDataBuffer[i*volImg+j] = (float(cifarbinary[(i + max_batch_size_ * batch_idx) * imageSize + j])/255.0-0.456)/0.224;
-                }
-                else {
-                    hostDataBuffer[i*volImg+j] = (float(cifarbinary[(i + max_batch_size_ * batch_idx) * imageSize + j])/255.0-0.406)/0.225;
-                }
-            }
-         }
-    std::cout << "Pre processing finished." << std::endl;
+    const auto& format = cifar_dataset_.getFormat();
+    const int volImg = format.pixelBytes();
+    const size_t recordCnt = cifar_dataset_.size();
+    const size_t first = size_t(batch.index) * max_batch_size_;
+    if (first >= recordCnt) {
+        return false;
+    }
+    batch.size = std::min(max_batch_size_, recordCnt - first);
+
+    // (x / 255 - mean[c]) / std[c], folded into one multiply-add per pixel.
+    const float mean[inputC] = {0.485f, 0.456f, 0.406f};
+    const float stddev[inputC] = {0.229f, 0.224f, 0.225f};
+    const auto affine = samplesCommon::ChannelAffine::fromMeanStd(inputC, mean, stddev);
+    for (int i = 0; i < batch.size; ++i) {
+        const auto record = cifar_dataset_.record(first + i);
+        batch.labels[i] = float(record.label(format));
+        samplesCommon::normalizeImage(record.pixels, format.height, format.width, format.layout, affine,
+            batch.data + i * volImg);
+    }
+    // The engine still runs the full batch; keep the unused samples deterministic.
+    std::fill(batch.data + batch.size * volImg, batch.data + max_batch_size_ * volImg, 0.f);
     return true;
 }
 
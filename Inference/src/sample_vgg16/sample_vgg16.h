@@ -1,6 +1,9 @@
 #include "argsParser.h"
 #include "buffers.h"
 #include "common.h"
+#include "ImagePreprocess.h"
+#include "InputPipeline.h"
+#include "MappedDataset.h"
 #include "logger.h"
 
 #include "parserOnnxConfig.h"
@@ -190,7 +193,11 @@ private:
     std::vector<int> stage_type{0, 1, 2, 1, 2, 1, 1, 2, 1, 1, 3};
     std::map<int, int> subToEE;
 
-    std::vector<uint8_t> cifarbinary;
+    samplesCommon::MappedDataset cifar_dataset_;
+    // Normalizes batches of cifar_dataset_ ahead of infer(); declared after it so that it stops first.
+    std::unique_ptr<samplesCommon::InputPipeline> input_pipeline_;
+    int input_slots_{3};
+    int input_workers_{2};
 
     //Logger gLogger_;
 
@@ -208,7 +215,7 @@ private:
 
     std::vector<void*> getDeviceBindings(const size_t& sub_index);
     bool readData();
-    bool processInput(const samplesCommon::BufferManager& buffer, const int batch_idx);
+    bool processInput(samplesCommon::HostBatch& batch);
     float verifyOutput(const samplesCommon::BufferManager& buffer, const std::vector<int> check_list, const int batch_idx);
     bool controller(const int stage_idx, const int ee_idx);
 
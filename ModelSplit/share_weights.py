@@ -0,0 +1,81 @@
+# ------------------------------------------------
+# Shared external weights for split stage models
+# License under The MIT License
+# -----------------------------------------------
+
+import onnx
+from onnx import numpy_helper
+from onnx import TensorProto
+import argparse
+import hashlib
+import os
+
+# Offsets in the weight file are aligned so that the parser can use the bytes in place.
+ALIGNMENT = 64
+
+TYPED_FIELDS = ['float_data', 'int32_data', 'string_data', 'int64_data', 'double_data', 'uint64_data']
+
+def tensor_bytes(tensor):
+    # little-endian payload of a tensor, exactly as it would be stored in raw_data
+    array = numpy_helper.to_array(tensor)
+    return array.astype(array.dtype.newbyteorder('<'), copy=False).tobytes()
+
+def set_external(tensor, location, offset, length, checksum):
+    for field in TYPED_FIELDS + ['raw_data']:
+        tensor.ClearField(field)
+    del tensor.external_data[:]
+    for key, value in [('location', location), ('offset', str(offset)), ('length', str(length)), ('checksum', checksum)]:
+        entry = tensor.external_data.add()
+        entry.key = key
+        entry.value = value
+    tensor.data_location = TensorProto.EXTERNAL
+
+def share_weights(stage_models, weights_path, output_dir, min_bytes):
+    """ moves the initializers of several stage models into one content-addressed weight file.
+    Arguments:
+        stage_models: paths of the stage onnx models, e.g. the outputs of onnx_edit for each stage
+        weights_path: path of the shared weight file to write
+        output_dir: directory the rewritten stage models are saved to, under their original file names
+        min_bytes: initializers smaller than this stay inside the models
+    Identical payloads are written once, so a layer that appears in several stages is stored at one offset. Each
+    initializer is rewritten to reference it with its SHA1 checksum, which the TensorRT parser uses to load and
+    convert every shared tensor once per process.
+    """
+    offsets = dict()  # sha1 -> offset in the weight file
+    total_bytes = 0
+    with open(weights_path, 'wb') as weights:
+        for path in stage_models:
+            # external data of the input models is loaded relative to each of them
+            model = onnx.load(path)
+            location = os.path.relpath(os.path.abspath(weights_path), os.path.abspath(output_dir))
+            for tensor in model.graph.initializer:
+                if tensor.data_type == TensorProto.STRING:
+                    continue
+                payload = tensor_bytes(tensor)
+                if len(payload) < min_bytes:
+                    continue
+                checksum = hashlib.sha1(payload).hexdigest()
+                if checksum not in offsets:
+                    padding = -weights.tell() % ALIGNMENT
+                    weights.write(b'\0' * padding)
+                    offsets[checksum] = weights.tell()
+                    weights.write(payload)
+                total_bytes += len(payload)
+                set_external(tensor, location, offsets[checksum], len(payload), checksum)
+            output_model = os.path.join(output_dir, os.path.basename(path))
+            onnx.save(model, output_model)
+            print("Saved", output_model)
+        unique_bytes = weights.tell()
+    print("Weights:", total_bytes >> 20, "MB in", len(stage_models), "stages,", unique_bytes >> 20,
+          "MB after deduplication, in", weights_path)
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser()
+    parser.add_argument("weights", help="shared weight file to write")
+    parser.add_argument("models", nargs='+', help="stage onnx models")
+    parser.add_argument("--outdir", required=True, help="directory to save the rewritten stage models to; must not hold the input models")
+    parser.add_argument("--min-bytes", type=int, default=1024, help="initializers smaller than this stay in the models (default 1024)")
+    args = parser.parse_args()
+
+    os.makedirs(args.outdir, exist_ok=True)
+    share_weights(args.models, args.weights, args.outdir, args.min_bytes)